@@ -19,6 +19,7 @@ LOCAL_CFLAGS += -DPOMP_API_EXPORTS
 LOCAL_SRC_FILES := \
 	src/pomp_addr.c \
 	src/pomp_buffer.c \
+	src/pomp_capture.c \
 	src/pomp_conn.c \
 	src/pomp_ctx.c \
 	src/pomp_decoder.c \
@@ -27,6 +28,7 @@ LOCAL_SRC_FILES := \
 	src/pomp_loop.c \
 	src/pomp_msg.c \
 	src/pomp_prot.c \
+	src/pomp_rpc.c \
 	src/pomp_timer.c
 
 ifdef NDK_PROJECT_PATH
@@ -29,6 +29,7 @@ LOCAL_CFLAGS += -DPOMP_API_EXPORTS
 LOCAL_SRC_FILES := \
 	src/pomp_addr.c \
 	src/pomp_buffer.c \
+	src/pomp_capture.c \
 	src/pomp_conn.c \
 	src/pomp_ctx.c \
 	src/pomp_decoder.c \
@@ -39,6 +40,7 @@ LOCAL_SRC_FILES := \
 	src/pomp_loop_sync.c \
 	src/pomp_msg.c \
 	src/pomp_prot.c \
+	src/pomp_rpc.c \
 	src/pomp_timer.c \
 	src/pomp_watchdog.c \
 
@@ -82,6 +84,47 @@ LOCAL_SRC_FILES := tools/pomp_cli.c
 LOCAL_LIBRARIES := libpomp
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+LOCAL_MODULE := pomp-bench-rpc
+LOCAL_CATEGORY_PATH := libs/pomp/tools
+LOCAL_DESCRIPTION := Benchmark of libpomp request/response calls
+LOCAL_SRC_FILES := tools/pomp_bench_rpc.c
+LOCAL_LIBRARIES := libpomp
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := pomp-bench
+LOCAL_CATEGORY_PATH := libs/pomp/tools
+LOCAL_DESCRIPTION := Throughput and latency benchmark of libpomp transports
+LOCAL_SRC_FILES := tools/pomp_bench.c
+LOCAL_LIBRARIES := libpomp
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := pomp-bench-codec
+LOCAL_CATEGORY_PATH := libs/pomp/tools
+LOCAL_DESCRIPTION := Microbenchmark of libpomp message codec
+LOCAL_SRC_FILES := tools/pomp_bench_codec.c
+LOCAL_LIBRARIES := libpomp
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := pomp-bench-cxx
+LOCAL_CATEGORY_PATH := libs/pomp/tools
+LOCAL_DESCRIPTION := Benchmark of libpomp c++ wrapper message dispatch
+LOCAL_CXXFLAGS := -std=c++0x
+LOCAL_SRC_FILES := tools/pomp_bench_cxx.cpp
+LOCAL_LIBRARIES := libpomp
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := pomp-bench-invoke
+LOCAL_CATEGORY_PATH := libs/pomp/tools
+LOCAL_DESCRIPTION := Benchmark of libpomp cross-thread loop access
+LOCAL_SRC_FILES := tools/pomp_bench_invoke.c
+LOCAL_LIBRARIES := libpomp
+include $(BUILD_EXECUTABLE)
+
 ###############################################################################
 ###############################################################################
 
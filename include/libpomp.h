@@ -105,6 +105,9 @@ enum pomp_event {
 	POMP_EVENT_CONNECTED = 0,	/**< Peer is connected */
 	POMP_EVENT_DISCONNECTED,	/**< Peer is disconnected */
 	POMP_EVENT_MSG,			/**< Message received from peer */
+	POMP_EVENT_BATCH_END,		/**< End of a burst of messages
+					  *  received from peer (see
+					  *  pomp_ctx_set_batch_end_event) */
 };
 
 /**
@@ -146,6 +149,112 @@ enum pomp_send_status {
 	POMP_SEND_STATUS_QUEUE_EMPTY = 0x08,	/**< No more buffer in queue */
 };
 
+/**
+ * Send priority classes.
+ * Each connection has one send queue per class. When data can not be written
+ * immediately, pending buffers of a higher class are written before those of
+ * a lower class. On stream sockets a buffer whose write has already started
+ * is always completed first so messages are never interleaved.
+ */
+enum pomp_send_prio {
+	POMP_SEND_PRIO_CONTROL = 0,	/**< Urgent control messages */
+	POMP_SEND_PRIO_NORMAL,		/**< Default class */
+	POMP_SEND_PRIO_BULK,		/**< Bulk data transfers */
+	POMP_SEND_PRIO_COUNT,		/**< Number of priority classes */
+};
+
+/**
+ * Message id reserved for subscription messages sent by
+ * 'pomp_conn_subscribe' and 'pomp_conn_unsubscribe'. Servers with
+ * subscription filtering enabled consume them internally.
+ */
+#define POMP_MSGID_SUBSCRIPTION		0xfffffff0u
+
+/** Direction of a captured message */
+enum pomp_capture_dir {
+	POMP_CAPTURE_DIR_RX = 0,	/**< Message received */
+	POMP_CAPTURE_DIR_TX,		/**< Message sent */
+};
+
+/** Magic of capture files ('P', 'M', 'P', 'C' in little endian) */
+#define POMP_CAPTURE_MAGIC		0x43504d50u
+
+/** Version of capture file format */
+#define POMP_CAPTURE_VERSION		1
+
+/** Alignment of records in capture files */
+#define POMP_CAPTURE_ALIGN		8
+
+/**
+ * Header of capture files. It is followed by records, each one starting
+ * with a 'struct pomp_capture_record_header'. All fields are in host byte
+ * order.
+ */
+struct pomp_capture_file_header {
+	uint32_t	magic;		/**< POMP_CAPTURE_MAGIC */
+	uint32_t	version;	/**< POMP_CAPTURE_VERSION */
+	uint32_t	hdrsize;	/**< Size of this header */
+	uint32_t	reserved;	/**< Reserved */
+};
+
+/**
+ * Header of a record in capture files. It is followed by the peer address
+ * (addrlen bytes, struct sockaddr), the message data (datalen bytes,
+ * including protocol header) and padding up to 'size'.
+ */
+struct pomp_capture_record_header {
+	uint32_t	size;		/**< Record size, aligned */
+	uint8_t		dir;		/**< Direction (enum pomp_capture_dir) */
+	uint8_t		reserved;	/**< Reserved */
+	uint16_t	addrlen;	/**< Size of peer address (can be 0) */
+	uint64_t	timestamp;	/**< Realtime date (in ns) */
+	uint32_t	msgid;		/**< Message id */
+	uint32_t	datalen;	/**< Size of message data */
+};
+
+/** Completion status of a call */
+enum pomp_rpc_status {
+	POMP_RPC_STATUS_OK = 0,		/**< Reply received */
+	POMP_RPC_STATUS_TIMEOUT,	/**< No reply received in time */
+	POMP_RPC_STATUS_ABORTED,	/**< Connection closed before reply */
+};
+
+/** Type of a message argument, as encoded in messages */
+enum pomp_arg_type {
+	POMP_ARG_TYPE_I8 = 0x01,	/**< 8-bit signed integer */
+	POMP_ARG_TYPE_U8 = 0x02,	/**< 8-bit unsigned integer */
+	POMP_ARG_TYPE_I16 = 0x03,	/**< 16-bit signed integer */
+	POMP_ARG_TYPE_U16 = 0x04,	/**< 16-bit unsigned integer */
+	POMP_ARG_TYPE_I32 = 0x05,	/**< 32-bit signed integer */
+	POMP_ARG_TYPE_U32 = 0x06,	/**< 32-bit unsigned integer */
+	POMP_ARG_TYPE_I64 = 0x07,	/**< 64-bit signed integer */
+	POMP_ARG_TYPE_U64 = 0x08,	/**< 64-bit unsigned integer */
+	POMP_ARG_TYPE_STR = 0x09,	/**< String */
+	POMP_ARG_TYPE_BUF = 0x0a,	/**< Buffer */
+	POMP_ARG_TYPE_F32 = 0x0b,	/**< 32-bit floating point */
+	POMP_ARG_TYPE_F64 = 0x0c,	/**< 64-bit floating point */
+	POMP_ARG_TYPE_FD = 0x0d,	/**< File descriptor */
+};
+
+/** Value of a message argument */
+union pomp_value {
+	int8_t			i8;		/**< i8 value */
+	uint8_t			u8;		/**< u8 value */
+	int16_t			i16;		/**< i16 value */
+	uint16_t		u16;		/**< u16 value */
+	int32_t			i32;		/**< i32 value */
+	uint32_t		u32;		/**< u32 value */
+	int64_t			i64;		/**< i64 value */
+	uint64_t		u64;		/**< u64 value */
+	char			*str;		/**< str value */
+	const char		*cstr;		/**< cstr value */
+	void			*buf;		/**< buf value */
+	const void		*cbuf;		/**< cbuf value */
+	float			f32;		/**< f32 value */
+	double			f64;		/**< f64 value */
+	int			fd;		/**< fd value */
+};
+
 /** Peer credentials for local sockets */
 struct pomp_cred {
 	uint32_t	pid;	/**< PID of sending process */
@@ -217,6 +326,62 @@ typedef void (*pomp_send_cb_t)(
 		void *cookie,
 		void *userdata);
 
+/**
+ * Batch callback. If set, it is called instead of the event callback with all
+ * the messages received on a connection during one loop iteration (or one
+ * datagram for connection-less contexts).
+ * @param ctx context.
+ * @param conn connection on which the messages were received.
+ * @param msgs array of messages, in reception order. They are only valid
+ * during the callback.
+ * @param count number of messages in the array (never 0).
+ * @param userdata user data given in pomp_ctx_new.
+ */
+typedef void (*pomp_batch_cb_t)(
+		struct pomp_ctx *ctx,
+		struct pomp_conn *conn,
+		const struct pomp_msg *const *msgs,
+		uint32_t count,
+		void *userdata);
+
+/**
+ * Message handler callback, registered for a given message id with
+ * 'pomp_ctx_register_msg_handler'.
+ * @param ctx context.
+ * @param conn connection on which the message was received.
+ * @param msg message received.
+ * @param argv decoded arguments, one per specifier of the format given at
+ * registration (the size following a buffer is in the 'u32' field of its own
+ * entry). Strings and buffers point inside the message and file descriptors
+ * are owned by the message, so they are only valid during the callback. NULL
+ * if no format was given.
+ * @param argc number of decoded arguments.
+ * @param userdata user data given at registration.
+ */
+typedef void (*pomp_msg_handler_cb_t)(
+		struct pomp_ctx *ctx,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		const union pomp_value *argv,
+		uint32_t argc,
+		void *userdata);
+
+/**
+ * Call completion callback. It is called exactly once per successful
+ * 'pomp_conn_call'.
+ * @param conn connection on which the call was issued.
+ * @param status completion status of the call.
+ * @param msg reply message if status is POMP_RPC_STATUS_OK, NULL otherwise.
+ * Its first argument is the call id, use 'pomp_msg_read' with a leading "%u"
+ * to decode it with other arguments.
+ * @param userdata user data given in pomp_conn_call.
+ */
+typedef void (*pomp_rpc_cb_t)(
+		struct pomp_conn *conn,
+		enum pomp_rpc_status status,
+		const struct pomp_msg *msg,
+		void *userdata);
+
 /**
  * Fd event callback.
  * @param fd triggered fd.
@@ -246,6 +411,12 @@ typedef void (*pomp_timer_cb_t) (struct pomp_timer *timer, void *userdata);
  */
 typedef void (*pomp_idle_cb_t)(void *userdata);
 
+/**
+ * Invoke callback, called from the loop thread.
+ * @param userdata callback user data.
+ */
+typedef void (*pomp_invoke_cb_t)(void *userdata);
+
 /**
  * Watchdog callback
  * @param loop associated loop.
@@ -253,6 +424,25 @@ typedef void (*pomp_idle_cb_t)(void *userdata);
  */
 typedef void (*pomp_watchdog_cb_t)(struct pomp_loop *loop, void *userdata);
 
+/**
+ * Buffer release callback, called when external data of a buffer is no
+ * longer used.
+ * @param data external data of the buffer.
+ * @param len length of external data.
+ * @param userdata callback user data.
+ */
+typedef void (*pomp_buffer_release_cb_t)(void *data, size_t len,
+		void *userdata);
+
+/**
+ * Connection user data destructor, called when the connection object is
+ * destroyed or when its user data is replaced.
+ * @param conn connection.
+ * @param userdata user data attached to the connection.
+ */
+typedef void (*pomp_conn_userdata_destroy_cb_t)(struct pomp_conn *conn,
+		void *userdata);
+
 /*
  * Context API.
  */
@@ -310,6 +500,71 @@ POMP_API int pomp_ctx_set_socket_cb(struct pomp_ctx *ctx, pomp_socket_cb_t cb);
  */
 POMP_API int pomp_ctx_set_send_cb(struct pomp_ctx *ctx, pomp_send_cb_t cb);
 
+/**
+ * Set the function to call with batches of received messages. When set,
+ * messages are no longer notified one by one with the event callback but
+ * accumulated and given together once everything that could be read from the
+ * connection has been decoded. This allows application to amortize work over
+ * a burst of messages.
+ * @param ctx context (not raw).
+ * @param cb function to call with batches of messages, NULL to go back to
+ * notification of messages one by one. The userdata argument will be the same
+ * as the one set when creating the context.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks messages given to a handler registered with
+ * 'pomp_ctx_register_msg_handler' are not part of batches.
+ */
+POMP_API int pomp_ctx_set_batch_cb(struct pomp_ctx *ctx, pomp_batch_cb_t cb);
+
+/**
+ * Enable or disable the POMP_EVENT_BATCH_END event. When enabled, it is
+ * notified with the event callback (without message) after the last message
+ * received on a connection during one loop iteration (or one datagram for
+ * connection-less contexts), even if a batch callback is set.
+ * @param ctx context (not raw).
+ * @param enable 1 to enable, 0 to disable.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_ctx_set_batch_end_event(struct pomp_ctx *ctx, int enable);
+
+/**
+ * Limit the amount of data read on each connection every time the loop
+ * reports its fd as readable. Without limit, data is read until the socket
+ * is empty so a peer sending continuously can delay other connections and
+ * timers of the loop. A connection reaching its budget leaves remaining data
+ * in the socket and is processed again at the next loop iteration.
+ * @param ctx context.
+ * @param maxbytes maximum number of bytes read, 0 for no limit.
+ * @param maxmsgs maximum number of messages decoded, 0 for no limit
+ * (ignored for raw contexts).
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks the budget is checked after each read, so it can be exceeded by
+ * at most the content of one read buffer.
+ * @remarks it applies immediately to existing connections. The default is
+ * no limit.
+ */
+POMP_API int pomp_ctx_set_read_budget(struct pomp_ctx *ctx, size_t maxbytes,
+		uint32_t maxmsgs);
+
+/**
+ * Register fds of connections in edge-triggered mode. Writable notifications
+ * are then monitored once for all instead of being enabled and disabled in
+ * the loop each time a connection can not send immediately, saving a system
+ * call on each transition for peers sending in bursts.
+ * @param ctx context.
+ * @param enable 1 to enable, 0 to disable.
+ * @return 0 in case of success, negative errno value in case of error.
+ * -ENOSYS is returned if the loop implementation does not support it.
+ *
+ * @remarks this function can only be called when the context is not started.
+ * @remarks the loop may report a connection writable while nothing is
+ * pending, such wakeups are ignored.
+ * @remarks only supported by the epoll loop implementation.
+ */
+POMP_API int pomp_ctx_set_edge_triggered(struct pomp_ctx *ctx, int enable);
+
 /**
  * Setup TCP keepalive. Settings will be applied to all future TCP connections.
  * Current connections (if any) will not be affected.
@@ -336,6 +591,102 @@ POMP_API int pomp_ctx_setup_keepalive(struct pomp_ctx *ctx, int enable,
  */
 POMP_API int pomp_ctx_set_max_conn(struct pomp_ctx *ctx, size_t count);
 
+/**
+ * Enable or disable latest-value conflation for a message id.
+ * When enabled, sending a message with this id on a connection whose send
+ * queue still holds a not yet started message with the same id (and same
+ * priority class) replaces the queued message in place instead of appending
+ * the new one. Only the newest value is then transmitted to slow peers.
+ * @param ctx context (not raw).
+ * @param msgid message id.
+ * @param enable 1 to enable, 0 to disable.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks replaced messages are notified to the send callback with the
+ * POMP_SEND_STATUS_ABORTED status.
+ */
+POMP_API int pomp_ctx_set_msg_conflation(struct pomp_ctx *ctx, uint32_t msgid,
+		int enable);
+
+/**
+ * Register a handler for a message id. Received messages with this id are
+ * given to the handler instead of the event callback of the context.
+ * @param ctx context (not raw).
+ * @param msgid message id.
+ * @param fmt optional format of the message arguments (same syntax as
+ * 'pomp_msg_read', '%s' being accepted as well as '%ms'). If not NULL, it is
+ * compiled at registration and messages are decoded before calling the
+ * handler. Messages that do not match it are given to the event callback.
+ * @param cb handler to call, NULL to unregister the current one.
+ * @param userdata user data given to the handler.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks a format can have at most 32 specifiers. Registering a handler for
+ * an id that already has one replaces it.
+ */
+POMP_API int pomp_ctx_register_msg_handler(struct pomp_ctx *ctx,
+		uint32_t msgid, const char *fmt,
+		pomp_msg_handler_cb_t cb, void *userdata);
+
+/**
+ * Enable or disable filtering of server broadcasts by peer subscriptions.
+ * When enabled, messages with id POMP_MSGID_SUBSCRIPTION received from
+ * clients are not notified but update the set of message ids each client is
+ * interested in. 'pomp_ctx_send' and co then skip connections whose peer is
+ * not interested in the message id. A peer that never sent a subscription
+ * message receives everything.
+ * @param ctx context (not raw).
+ * @param enable 1 to enable, 0 to disable.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks messages sent explicitly on a connection are never filtered.
+ * @remarks while disabled, broadcasts are sent to all connections. The
+ * subscriptions already received are kept and apply again if re-enabled.
+ * @remarks a peer can have at most 256 disjoint ranges of message ids,
+ * subscription messages that would exceed it are ignored.
+ */
+POMP_API int pomp_ctx_set_subscription_filter(struct pomp_ctx *ctx,
+		int enable);
+
+/**
+ * Restrict the messages received by a dgram context to a set of message ids.
+ * A classic BPF program checking the magic and the message id of the
+ * protocol header is attached to the socket so other datagrams are dropped
+ * by the kernel without waking up the process.
+ * The filter can be set before or after 'pomp_ctx_bind'.
+ * @param ctx context (not raw).
+ * @param msgids array of accepted message ids.
+ * @param count number of message ids. 0 to remove the filter.
+ * @return 0 in case of success, negative errno value in case of error.
+ * -ENOSYS is returned if socket filters are not supported by the system,
+ * -E2BIG if the program would be too large.
+ */
+POMP_API int pomp_ctx_set_dgram_msgid_filter(struct pomp_ctx *ctx,
+		const uint32_t *msgids, size_t count);
+
+/**
+ * Start recording messages received and sent by the context to a capture
+ * file. Records are copied in a preallocated ring by the loop thread and
+ * written to the file by an internal thread. Records are dropped if the ring
+ * is full.
+ * @param ctx context (not raw).
+ * @param path path of capture file. It is truncated if it exists.
+ * @param ringsize size of the record ring in bytes. 0 for a default size.
+ * @return 0 in case of success, negative errno value in case of error.
+ * -ENOSYS is returned if capture is not supported, errors opening or
+ * writing the file are returned as is.
+ */
+POMP_API int pomp_ctx_start_capture(struct pomp_ctx *ctx, const char *path,
+		size_t ringsize);
+
+/**
+ * Stop recording messages. Pending records are written before the capture
+ * file is closed.
+ * @param ctx context.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_ctx_stop_capture(struct pomp_ctx *ctx);
+
 /**
  * Destroy a context.
  * @param ctx context.
@@ -493,6 +844,18 @@ POMP_API const struct sockaddr *pomp_ctx_get_local_addr(struct pomp_ctx *ctx,
 POMP_API int pomp_ctx_send_msg(struct pomp_ctx *ctx,
 		const struct pomp_msg *msg);
 
+/**
+ * Send a message to a context with a given priority class.
+ * Same as pomp_ctx_send_msg but the message is queued in the send queue of
+ * the given class if it can not be written immediately.
+ * @param ctx context.
+ * @param msg message to send.
+ * @param prio priority class of the message.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_ctx_send_msg_prio(struct pomp_ctx *ctx,
+		const struct pomp_msg *msg, enum pomp_send_prio prio);
+
 /**
  * Send a message on dgram context to a remote address.
  * @param ctx context.
@@ -562,6 +925,18 @@ POMP_API int pomp_ctx_sendv(struct pomp_ctx *ctx, uint32_t msgid,
 POMP_API int pomp_ctx_send_raw_buf(struct pomp_ctx *ctx,
 		struct pomp_buffer *buf);
 
+/**
+ * Send a buffer to a raw context with a given priority class.
+ * Same as pomp_ctx_send_raw_buf but the buffer is queued in the send queue of
+ * the given class if it can not be written immediately.
+ * @param ctx context.
+ * @param buf buffer to send.
+ * @param prio priority class of the buffer.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_ctx_send_raw_buf_prio(struct pomp_ctx *ctx,
+		struct pomp_buffer *buf, enum pomp_send_prio prio);
+
 /**
  * Send a buffer on dgram raw context to a remote address.
  * @param ctx context.
@@ -578,6 +953,56 @@ POMP_API int pomp_ctx_send_raw_buf_to(struct pomp_ctx *ctx,
 		struct pomp_buffer *buf,
 		const struct sockaddr *addr, uint32_t addrlen);
 
+/**
+ * Send a message from any thread. The message is queued and actually sent by
+ * the thread of the loop associated with the context, like 'pomp_ctx_send_msg'
+ * (connid 0) or 'pomp_conn_send_msg' (connid of a connection) would.
+ * @param ctx context (not raw).
+ * @param connid id of the connection to send to (see pomp_conn_get_id), or 0
+ * to send to all connections of a server or to the connection of a client.
+ * @param msg message to send, it shall be finished. Its buffer is referenced
+ * so it shall not be modified until sent.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks: this function is safe to call from another thread that the one
+ * associated normally with the context. However caller must ensure that the
+ * given context will be valid for the complete duration of the call. Messages
+ * queued by one thread are sent in order. Messages whose connection is gone
+ * when the queue is processed are silently dropped.
+ */
+POMP_API int pomp_ctx_send_msg_async(struct pomp_ctx *ctx, uint64_t connid,
+		const struct pomp_msg *msg);
+
+/**
+ * Format and send a message from any thread.
+ * @param ctx context (not raw).
+ * @param connid id of the connection to send to, or 0 (see
+ * pomp_ctx_send_msg_async).
+ * @param msgid message id.
+ * @param fmt format string. Can be NULL if no arguments given.
+ * @param ... message arguments.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks: same thread safety as 'pomp_ctx_send_msg_async'.
+ */
+POMP_API int pomp_ctx_send_async(struct pomp_ctx *ctx, uint64_t connid,
+		uint32_t msgid, const char *fmt, ...)
+		POMP_ATTRIBUTE_FORMAT_PRINTF(4, 5);
+
+/**
+ * Send a buffer from any thread (for raw context).
+ * @param ctx context (raw).
+ * @param connid id of the connection to send to, or 0 (see
+ * pomp_ctx_send_msg_async).
+ * @param buf buffer to send. It is referenced so it shall not be modified
+ * until sent.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks: same thread safety as 'pomp_ctx_send_msg_async'.
+ */
+POMP_API int pomp_ctx_send_raw_buf_async(struct pomp_ctx *ctx,
+		uint64_t connid, struct pomp_buffer *buf);
+
 /**
  * Set the context default read buffer length.
  * For server and client contexts, this value can be overriden for each
@@ -636,6 +1061,49 @@ POMP_API const struct pomp_cred *pomp_conn_get_peer_cred(
  */
 POMP_API int pomp_conn_get_fd(struct pomp_conn *conn);
 
+/**
+ * Get the id of the connection. Unlike the connection pointer, it can be
+ * given to other threads to send messages with 'pomp_ctx_send_msg_async'
+ * and co: ids of connections that are gone are never reused.
+ * @param conn connection.
+ * @return id of the connection, 0 in case of error.
+ */
+POMP_API uint64_t pomp_conn_get_id(struct pomp_conn *conn);
+
+/**
+ * Attach application data to the connection, so that it can be retrieved
+ * without any lookup when handling its events.
+ * @param conn connection.
+ * @param userdata application data.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks this is equivalent to pomp_conn_set_userdata_full with a NULL
+ * destructor.
+ */
+POMP_API int pomp_conn_set_userdata(struct pomp_conn *conn, void *userdata);
+
+/**
+ * Attach application data to the connection with a destructor.
+ * @param conn connection.
+ * @param userdata application data.
+ * @param destroy function called with the data when the connection object is
+ * destroyed (after the POMP_EVENT_DISCONNECTED event if any), can be NULL.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks if data was previously attached with a destructor, the destructor
+ * is called on the previous data before it is replaced.
+ */
+POMP_API int pomp_conn_set_userdata_full(struct pomp_conn *conn,
+		void *userdata,
+		pomp_conn_userdata_destroy_cb_t destroy);
+
+/**
+ * Get application data attached to the connection.
+ * @param conn connection.
+ * @return application data or NULL if none was set or in case of error.
+ */
+POMP_API void *pomp_conn_get_userdata(struct pomp_conn *conn);
+
 /**
  * Suspend read operation on connection.
  * @param conn connection.
@@ -663,6 +1131,18 @@ POMP_API int pomp_conn_resume_read(struct pomp_conn *conn);
 POMP_API int pomp_conn_send_msg(struct pomp_conn *conn,
 		const struct pomp_msg *msg);
 
+/**
+ * Send a message to the peer of the connection with a given priority class.
+ * Same as pomp_conn_send_msg but the message is queued in the send queue of
+ * the given class if it can not be written immediately.
+ * @param conn connection.
+ * @param msg message to send.
+ * @param prio priority class of the message.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_conn_send_msg_prio(struct pomp_conn *conn,
+		const struct pomp_msg *msg, enum pomp_send_prio prio);
+
 /**
  * Format and send a message to the peer of the connection.
  * @param conn connection.
@@ -706,6 +1186,114 @@ POMP_API int pomp_conn_sendv(struct pomp_conn *conn, uint32_t msgid,
 POMP_API int pomp_conn_send_raw_buf(struct pomp_conn *conn,
 		struct pomp_buffer *buf);
 
+/**
+ * Send a buffer to the peer of the raw connection with a given priority class.
+ * Same as pomp_conn_send_raw_buf but the buffer is queued in the send queue of
+ * the given class if it can not be written immediately.
+ * @param conn connection.
+ * @param buf buffer to send.
+ * @param prio priority class of the buffer.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_conn_send_raw_buf_prio(struct pomp_conn *conn,
+		struct pomp_buffer *buf, enum pomp_send_prio prio);
+
+/**
+ * Register interest in a range of message ids to the server peer of the
+ * connection. Once a first subscription or unsubscription has been sent,
+ * the server only broadcasts messages with a subscribed id on this
+ * connection (if it has enabled subscription filtering).
+ * @param conn connection.
+ * @param first first message id of the range.
+ * @param last last message id of the range (inclusive).
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_conn_subscribe(struct pomp_conn *conn,
+		uint32_t first, uint32_t last);
+
+/**
+ * Remove interest in a range of message ids to the server peer of the
+ * connection. If no subscription was sent before, the peer is considered
+ * interested in all message ids except the given range.
+ * @param conn connection.
+ * @param first first message id of the range.
+ * @param last last message id of the range (inclusive).
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_conn_unsubscribe(struct pomp_conn *conn,
+		uint32_t first, uint32_t last);
+
+/**
+ * Format and send a request message to the peer of the connection and wait
+ * asynchronously for its reply.
+ * A call id is allocated and written as first argument (u32) of the request.
+ * The peer shall answer with 'pomp_conn_reply' so that the reply carries the
+ * same call id. The reply is then given to the callback instead of the
+ * context event callback.
+ * @param conn connection.
+ * @param msgid message id of request.
+ * @param replyid message id of expected reply.
+ * @param timeout timeout of the call (in ms).
+ * @param cb callback called when the call completes.
+ * @param userdata user data for callback.
+ * @param fmt format string of other arguments. Can be NULL.
+ * @param ... other arguments.
+ * @return 0 in case of success, negative errno value in case of error.
+ * In case of error the callback is not called.
+ *
+ * @remarks not supported on raw contexts and datagram sockets.
+ */
+POMP_API int pomp_conn_call(struct pomp_conn *conn, uint32_t msgid,
+		uint32_t replyid, uint32_t timeout,
+		pomp_rpc_cb_t cb, void *userdata,
+		const char *fmt, ...) POMP_ATTRIBUTE_FORMAT_PRINTF(7, 8);
+
+/**
+ * Format and send a request message to the peer of the connection and wait
+ * asynchronously for its reply.
+ * @param conn connection.
+ * @param msgid message id of request.
+ * @param replyid message id of expected reply.
+ * @param timeout timeout of the call (in ms).
+ * @param cb callback called when the call completes.
+ * @param userdata user data for callback.
+ * @param fmt format string of other arguments. Can be NULL.
+ * @param args other arguments.
+ * @return 0 in case of success, negative errno value in case of error.
+ * In case of error the callback is not called.
+ */
+POMP_API int pomp_conn_callv(struct pomp_conn *conn, uint32_t msgid,
+		uint32_t replyid, uint32_t timeout,
+		pomp_rpc_cb_t cb, void *userdata,
+		const char *fmt, va_list args);
+
+/**
+ * Format and send the reply of a request received on the connection.
+ * The call id of the request is written as first argument (u32) of the reply.
+ * @param conn connection.
+ * @param msgid message id of reply.
+ * @param req request message.
+ * @param fmt format string of other arguments. Can be NULL.
+ * @param ... other arguments.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_conn_reply(struct pomp_conn *conn, uint32_t msgid,
+		const struct pomp_msg *req,
+		const char *fmt, ...) POMP_ATTRIBUTE_FORMAT_PRINTF(4, 5);
+
+/**
+ * Format and send the reply of a request received on the connection.
+ * @param conn connection.
+ * @param msgid message id of reply.
+ * @param req request message.
+ * @param fmt format string of other arguments. Can be NULL.
+ * @param args other arguments.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+POMP_API int pomp_conn_replyv(struct pomp_conn *conn, uint32_t msgid,
+		const struct pomp_msg *req,
+		const char *fmt, va_list args);
+
 /**
  * Set the connection read buffer length
  * @param conn connection.
@@ -755,6 +1343,43 @@ POMP_API struct pomp_buffer *pomp_buffer_new_with_data(
 POMP_API struct pomp_buffer *pomp_buffer_new_get_data(
 		size_t capacity, void **data);
 
+/**
+ * Create a new buffer referencing a range of data of another buffer, without
+ * copying it. The slice takes a reference on the buffer owning the data,
+ * making it read-only until the slice is released.
+ * @param buf buffer to reference (can itself be a slice). It shall not contain
+ * file descriptors or referenced buffers.
+ * @param off offset of the range in the buffer.
+ * @param len length of the range.
+ * @return new read-only buffer with initial ref count at 1 or NULL in case of
+ * error.
+ *
+ * @remarks the slice is always considered as shared: only the read-only
+ * access functions can be used on it (pomp_buffer_get_cdata,
+ * pomp_buffer_read, pomp_buffer_cread...). It can be sent or used to create
+ * a message like any other buffer.
+ */
+POMP_API struct pomp_buffer *pomp_buffer_new_slice(struct pomp_buffer *buf,
+		size_t off, size_t len);
+
+/**
+ * Create a new buffer using external data, without copying it.
+ * @param data external data (mapped file, memory pool...).
+ * @param len length of external data.
+ * @param cb function to call when the ref count of the buffer reaches 0 and
+ * the data is not used anymore (optional, can be NULL).
+ * @param userdata user data given in callback.
+ * @return new read-only buffer with initial ref count at 1 or NULL in case of
+ * error.
+ *
+ * @remarks the buffer is always considered as shared, like a slice.
+ * @remarks the release callback is called by the last pomp_buffer_unref. When
+ * the buffer is sent, this can happen in the loop thread once its pending
+ * writes are done. It is not called if the creation fails.
+ */
+POMP_API struct pomp_buffer *pomp_buffer_new_external(void *data, size_t len,
+		pomp_buffer_release_cb_t cb, void *userdata);
+
 /**
  * Increase ref count of buffer.
  * @param buf buffer.
@@ -771,7 +1396,8 @@ POMP_API void pomp_buffer_unref(struct pomp_buffer *buf);
 /**
  * Determine if the buffer is shared
  * @param buf buffer.
- * @return 1 if the buffer is shared (ref count greater than 1), 0 otherwise.
+ * @return 1 if the buffer is shared (ref count greater than 1 or slice of
+ * another buffer), 0 otherwise.
  */
 POMP_API int pomp_buffer_is_shared(const struct pomp_buffer *buf);
 
@@ -1038,6 +1664,16 @@ POMP_API int pomp_msg_dump(const struct pomp_msg *msg,
  */
 POMP_API int pomp_msg_adump(const struct pomp_msg *msg, char **dst);
 
+/**
+ * Get the call id of a request or reply message.
+ * @param msg message.
+ * @param callid will receive the call id.
+ * @return 0 in case of success, negative errno value in case of error.
+ * -EINVAL is returned if the first argument of the message is not an u32.
+ */
+POMP_API int pomp_msg_get_call_id(const struct pomp_msg *msg,
+		uint32_t *callid);
+
 /*
  * Loop API.
  */
@@ -1257,6 +1893,11 @@ POMP_API int pomp_loop_idle_flush_by_cookie(struct pomp_loop *loop,
  * @remarks: the function is called in the context of an internal thread and
  * should therefore not call other functions of the library. The intent is to
  * provide a way to log something or kill the offending process.
+ * @remarks: a single internal thread monitors all loops of the process with
+ * a watchdog enabled, each one with its own delay and callback. It is
+ * started with the first watchdog and stopped with the last one.
+ * Callbacks are therefore serialized and shall not block: no loop is
+ * monitored until the callback returns.
  * @remarks: it should be called only once before calling any of the 'process'
  * functions.
  */
@@ -1307,6 +1948,31 @@ POMP_API int pomp_loop_lock(struct pomp_loop *loop);
  */
 POMP_API int pomp_loop_unlock(struct pomp_loop *loop);
 
+/**
+ * Run a function on the thread processing the loop, between two iterations
+ * of pomp_loop_wait_and_process. Requests are queued without locking and
+ * the loop is woken up when the queue becomes non empty. Functions are
+ * called in the order they were queued.
+ * @param loop loop.
+ * @param cb function to call.
+ * @param userdata user data for callback.
+ * @param wait 1 to block until the function has been called, 0 to return
+ * immediately after queuing it.
+ * @return 0 in case of success, negative errno value in case of error.
+ * -ECANCELED is returned when waiting and the loop is destroyed before
+ * the function could be called.
+ *
+ * @remarks: when called with wait set by the thread currently owning the
+ * loop, the function is called directly.
+ * @remarks: unlike pomp_loop_lock, the loop does not need to be enabled for
+ * thread safety.
+ * @remarks: this function is safe to call from another thread that the one
+ * associated normally with the loop. However caller must ensure that the
+ * given loop will be valid for the complete duration of the call.
+ */
+POMP_API int pomp_loop_invoke(struct pomp_loop *loop, pomp_invoke_cb_t cb,
+		void *userdata, int wait);
+
 /*
  * Event API.
  */
@@ -1701,6 +2367,21 @@ POMP_API int pomp_encoder_write_str(struct pomp_encoder *enc, const char *v);
 POMP_API int pomp_encoder_write_buf(struct pomp_encoder *enc, const void *v,
 		uint32_t n);
 
+/**
+ * Encode a buffer by reference, without copying its content. The buffer will
+ * be gathered with the rest of the message when it is written to a socket.
+ * @param enc encoder.
+ * @param buf buffer to encode. A new reference is taken on it, making it
+ * read-only. It shall not contain file descriptors.
+ * @return 0 in case of success, negative errno value in case of error.
+ *
+ * @remarks the encoder shall be positioned at the end of the message.
+ * @remarks a message with referenced buffers can only be sent, it can not be
+ * decoded locally. On platforms without gathered write, data is copied.
+ */
+POMP_API int pomp_encoder_write_buf_ref(struct pomp_encoder *enc,
+		struct pomp_buffer *buf);
+
 /**
  * Encode a 32-bit floating point.
  * @param enc encoder.
@@ -1819,6 +2500,23 @@ POMP_API int pomp_decoder_dump(struct pomp_decoder *dec,
  */
 POMP_API int pomp_decoder_adump(struct pomp_decoder *dec, char **dst);
 
+/**
+ * Decode the next argument, whatever its type. This allows inspecting a
+ * message without knowing its format. Nothing is allocated or copied.
+ * @param dec decoder.
+ * @param type type of the decoded argument.
+ * @param v decoded value. For POMP_ARG_TYPE_STR and POMP_ARG_TYPE_BUF, the
+ * 'cstr' and 'cbuf' fields point inside the message and are only valid while
+ * the message is. For POMP_ARG_TYPE_FD the fd is still owned by the message.
+ * @param buflen size of the buffer for POMP_ARG_TYPE_BUF, 0 for other types.
+ * Can be NULL.
+ * @return 1 if an argument has been decoded, 0 if all arguments have been
+ * decoded, negative errno value in case of error.
+ */
+POMP_API int pomp_decoder_next(struct pomp_decoder *dec,
+		enum pomp_arg_type *type, union pomp_value *v,
+		uint32_t *buflen);
+
 /**
  * Decode a 8-bit signed integer.
  * @param dec decoder.
@@ -37,6 +37,7 @@
 
 #include <errno.h>
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -86,6 +87,7 @@ namespace pomp {
 
 /* Forward declarations */
 class Message;
+class Buffer;
 class Connection;
 class EventHandler;
 class Loop;
@@ -385,6 +387,64 @@ public:
 	}
 };
 
+/**
+ * Buffer class. Reference counted view on a buffer, without copy of data.
+ */
+class Buffer {
+private:
+	struct pomp_buffer  *mBuf;  /**< Internal buffer */
+
+public:
+	/** Constructor, takes a new reference on the internal buffer. */
+	inline explicit Buffer(struct pomp_buffer *buf) : mBuf(buf) {
+		if (mBuf != NULL)
+			pomp_buffer_ref(mBuf);
+	}
+
+	/** Copy constructor, shares the internal buffer. */
+	inline Buffer(const Buffer &other) : mBuf(other.mBuf) {
+		if (mBuf != NULL)
+			pomp_buffer_ref(mBuf);
+	}
+
+	/** Assignment operator, shares the internal buffer. */
+	inline Buffer &operator=(const Buffer &other) {
+		if (other.mBuf != NULL)
+			pomp_buffer_ref(other.mBuf);
+		if (mBuf != NULL)
+			pomp_buffer_unref(mBuf);
+		mBuf = other.mBuf;
+		return *this;
+	}
+
+	/** Destructor, releases the reference on the internal buffer. */
+	inline ~Buffer() {
+		if (mBuf != NULL)
+			pomp_buffer_unref(mBuf);
+	}
+
+	/** Get data (read-only). */
+	inline const uint8_t *data() const {
+		const void *cdata = NULL;
+		if (mBuf == NULL || pomp_buffer_get_cdata(mBuf, &cdata, NULL, NULL) < 0)
+			return NULL;
+		return reinterpret_cast<const uint8_t *>(cdata);
+	}
+
+	/** Get size of data. */
+	inline size_t size() const {
+		size_t len = 0;
+		if (mBuf == NULL || pomp_buffer_get_cdata(mBuf, NULL, &len, NULL) < 0)
+			return 0;
+		return len;
+	}
+
+	/** Get internal buffer. */
+	inline struct pomp_buffer *get() const {
+		return mBuf;
+	}
+};
+
 /**
  * Connection class.
  */
@@ -458,6 +518,11 @@ public:
 		return -ENOMEM;
 	}
 
+	/** Send a buffer to the peer of the raw connection, without copy. */
+	inline int send(const Buffer &buf) {
+		return pomp_conn_send_raw_buf(mConn, buf.get());
+	}
+
 #ifdef POMP_CXX11
 	/** Format and send a message to the peer of the connection. */
 	template<typename Fmt, typename... ArgsW>
@@ -592,6 +657,11 @@ public:
 		return pomp_loop_unlock(mLoop);
 	}
 
+	/** Run a function on the loop thread */
+	inline int invoke(pomp_invoke_cb_t cb, void *userdata, bool wait) {
+		return pomp_loop_invoke(mLoop, cb, userdata, wait ? 1 : 0);
+	}
+
 #ifdef POMP_CXX11
 	/** Handler wrapper that can take a std::function */
 	class HandlerFunc : public Handler {
@@ -802,6 +872,12 @@ public:
 	inline virtual void onDisconnected(Context *ctx, Connection *conn) { (void)ctx; (void)conn; }
 	inline virtual void recvMessage(Context *ctx, Connection *conn, const Message &msg) { (void)ctx; (void)conn; (void)msg; }
 	inline virtual void recvRawBuffer(Context *ctx, Connection *conn, const std::vector<uint8_t> &v) { (void)ctx; (void)conn; (void)v; }
+	/** Raw buffer without copy, the default implementation copies it for recvRawBuffer. */
+	inline virtual void recvRawBuf(Context *ctx, Connection *conn, const Buffer &buf) {
+		const uint8_t *start = buf.data();
+		std::vector<uint8_t> v(start, start + buf.size());
+		recvRawBuffer(ctx, conn, v);
+	}
 };
 
 /**
@@ -817,16 +893,6 @@ private:
 	bool             mExtLoop;        /**< True if loop is external */
 
 private:
-	/** Find our own connection object from internal one */
-	inline ConnectionArray::iterator findConn(struct pomp_conn *_conn) {
-		ConnectionArray::iterator it;
-		for (it = mConnections.begin(); it != mConnections.end(); ++it) {
-			if ((*it)->mConn == _conn)
-				return it;
-		}
-		return mConnections.end();
-	}
-
 	/** Internal event callback */
 	inline static void eventCb(struct pomp_ctx *_ctx,
 			enum pomp_event _event,
@@ -835,40 +901,40 @@ private:
 			void *_userdata) {
 		(void)_ctx;
 
-		/* Get our own object from user data */
+		/* Get our own objects from user data */
 		Context *self = reinterpret_cast<Context *>(_userdata);
-		Connection *conn = NULL;
+		Connection *conn = reinterpret_cast<Connection *>(
+				pomp_conn_get_userdata(_conn));
 		ConnectionArray::iterator it;
-		bool allocated = false;
 
 		switch (_event) {
 		case POMP_EVENT_CONNECTED:
 			conn = new Connection(_conn);
 			self->mConnections.push_back(conn);
+			(void)pomp_conn_set_userdata_full(_conn, conn,
+					&Context::connDestroyCb);
 			self->mEventHandler->onConnected(self, conn);
 			break;
 
 		case POMP_EVENT_DISCONNECTED:
-			it = self->findConn(_conn);
-			if (it != self->mConnections.end()) {
-				conn = *it;
+			/* Object deleted by connDestroyCb with the conn */
+			if (conn != NULL) {
 				self->mEventHandler->onDisconnected(self, conn);
-				self->mConnections.erase(it);
-				delete conn;
+				it = std::find(self->mConnections.begin(),
+						self->mConnections.end(), conn);
+				if (it != self->mConnections.end())
+					self->mConnections.erase(it);
 			}
 			break;
 
 		case POMP_EVENT_MSG:
-			it = self->findConn(_conn);
-			if (it != self->mConnections.end())
-				conn = *it;
-			if (!conn) { // likely, a datagram transient connection
-				conn = new Connection(_conn);
-				allocated = true;
+			if (conn != NULL) {
+				self->mEventHandler->recvMessage(self, conn, Message(_msg));
+			} else {
+				/* Likely a datagram transient connection */
+				Connection tmpconn(_conn);
+				self->mEventHandler->recvMessage(self, &tmpconn, Message(_msg));
 			}
-			self->mEventHandler->recvMessage(self, conn, Message(_msg));
-			if (allocated)
-				delete conn;
 			break;
 
 		default:
@@ -876,40 +942,32 @@ private:
 		}
 	}
 
+	/** Internal connection user data destructor */
+	inline static void connDestroyCb(struct pomp_conn *_conn,
+			void *_userdata) {
+		(void)_conn;
+		delete reinterpret_cast<Connection *>(_userdata);
+	}
+
 	/** Internal raw callback */
 	inline static void rawCb(struct pomp_ctx *_ctx,
 			struct pomp_conn *_conn,
 			struct pomp_buffer *_buf,
 			void *_userdata) {
 		(void)_ctx;
-		std::vector<uint8_t> v;
-		const void *cdata = NULL;
-		size_t len;
-		size_t capacity;
-		int res;
-		bool allocated = false;
 
-		/* Get our own object from user data */
+		/* Get our own objects from user data */
 		Context *self = reinterpret_cast<Context *>(_userdata);
+		Connection *conn = reinterpret_cast<Connection *>(
+				pomp_conn_get_userdata(_conn));
 
-		Connection *conn = NULL;
-		ConnectionArray::iterator it;
-		it = self->findConn(_conn);
-		if (it != self->mConnections.end())
-			conn = *it;
-		if (!conn) { // likely, a datagram transient connection
-			conn = new Connection(_conn);
-			allocated = true;
-		}
-		res = pomp_buffer_get_cdata(_buf, &cdata, &len, &capacity);
-		if (res == 0) {
-			const uint8_t *start = reinterpret_cast<const uint8_t *>(cdata);
-			const uint8_t *end = start + len;
-			v.assign(start, end);
-			self->mEventHandler->recvRawBuffer(self, conn, v);
+		if (conn != NULL) {
+			self->mEventHandler->recvRawBuf(self, conn, Buffer(_buf));
+		} else {
+			/* Likely a datagram transient connection */
+			Connection tmpconn(_conn);
+			self->mEventHandler->recvRawBuf(self, &tmpconn, Buffer(_buf));
 		}
-		if (allocated)
-			delete conn;
 	}
 
 public:
@@ -935,6 +993,11 @@ public:
 			delete mLoop;
 	}
 
+	/** Get internal context. */
+	inline struct pomp_ctx *get() const {
+		return mCtx;
+	}
+
 	/** Start a server. */
 	inline int listen(const struct sockaddr *addr, uint32_t addrlen) {
 		return pomp_ctx_listen(mCtx, addr, addrlen);
@@ -1069,6 +1132,11 @@ public:
 		return -ENOMEM;
 	}
 
+	/** Send a buffer to all connections, without copy. */
+	inline int send(const Buffer &buf) {
+		return pomp_ctx_send_raw_buf(mCtx, buf.get());
+	}
+
 #ifdef POMP_CXX11
 	/** Format and send a message to all connections. */
 	template<typename Fmt, typename... ArgsW>
@@ -70,6 +70,8 @@ class Connection(object):
         self.readThread = None
         self.writeThread = None
         self.writeHandler = None
+        self.userData = None
+        self.userDataDestroy = None
         self.cond = threading.Condition()
         self.localAddr = (self.sock.family, self.sock.getsockname())
         if not isDgram:
@@ -83,6 +85,17 @@ class Connection(object):
     def getPeerAddr(self):
         return self.peerAddr
 
+    def setUserData(self, userData, destroy=None):
+        # Release previous data before replacing it
+        (oldUserData, oldDestroy) = (self.userData, self.userDataDestroy)
+        self.userData = userData
+        self.userDataDestroy = destroy
+        if oldDestroy is not None:
+            oldDestroy(self, oldUserData)
+
+    def getUserData(self):
+        return self.userData
+
 #    def getPeerCred(self):
 #        return self.sock.getsockopt(socket.SOL_SOCKET, socket.SO_PEERCRED)
 
@@ -152,6 +165,9 @@ class Connection(object):
         self.writeThread = None
         self.writeHandler = None
 
+        # Release user data (after disconnection notification)
+        self.setUserData(None)
+
     def _reader(self):
         # Read loop
         try:
@@ -80,7 +80,7 @@ int pomp_buffer_register_fd(struct pomp_buffer *buf, size_t off, int fd)
 {
 	int32_t v = 0;
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
 	POMP_RETURN_ERR_IF_FAILED(off + sizeof(v) <= buf->len, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(fd >= 0, -EBADF);
 
@@ -140,7 +140,45 @@ int pomp_buffer_clear_partial(struct pomp_buffer *buf, size_t max_capacity)
 	buf->fdcount = 0;
 	memset(buf->fdoffs, 0, sizeof(buf->fdoffs));
 
-	if (buf->data != NULL) {
+	/* Release referenced external buffers */
+	for (i = 0; i < buf->segcount; i++)
+		pomp_buffer_unref(buf->segs[i].buf);
+	free(buf->segs);
+	buf->segs = NULL;
+	buf->segcount = 0;
+	buf->seglen = 0;
+
+	/* Release parent of a slice, data is not owned */
+	if (buf->parent != NULL) {
+		pomp_buffer_unref(buf->parent);
+		buf->parent = NULL;
+		buf->data = NULL;
+		buf->capacity = 0;
+		buf->len = 0;
+	}
+
+	/* Release external data, not owned either */
+	if (buf->isexternal) {
+		if (buf->release_cb != NULL) {
+			(*buf->release_cb)(buf->data, buf->len,
+					buf->release_userdata);
+		}
+		buf->isexternal = 0;
+		buf->release_cb = NULL;
+		buf->release_userdata = NULL;
+		buf->data = NULL;
+		buf->capacity = 0;
+		buf->len = 0;
+	}
+
+	if (POMP_BUFFER_IS_INLINE(buf)) {
+		/* Inline data can not be freed, only detach it if asked */
+		if (max_capacity == 0) {
+			buf->data = NULL;
+			buf->capacity = 0;
+		}
+		buf->len = 0;
+	} else if (buf->data != NULL) {
 		if (max_capacity > 0 && max_capacity >= buf->capacity) {
 			/* Just clear the used size */
 			buf->len = 0;
@@ -172,12 +210,17 @@ int pomp_buffer_clear_partial(struct pomp_buffer *buf, size_t max_capacity)
 struct pomp_buffer *pomp_buffer_new(size_t capacity)
 {
 	struct pomp_buffer *buf = NULL;
+	size_t inlinecap = 0;
 
-	/* Allocate buffer structure, set initial ref count to 1 */
-	buf = calloc(1, sizeof(*buf));
+	/* Allocate buffer structure with room for data of small buffers,
+	 * set initial ref count to 1 */
+	if (capacity <= POMP_BUFFER_INLINE_SIZE)
+		inlinecap = POMP_BUFFER_INLINE_SIZE;
+	buf = calloc(1, sizeof(*buf) + inlinecap);
 	if (buf == NULL)
 		return NULL;
 	buf->refcount = 1;
+	buf->inlinecap = inlinecap;
 
 	/* Set initial capacity */
 	if (capacity != 0 && pomp_buffer_set_capacity(buf, capacity) < 0) {
@@ -200,21 +243,14 @@ struct pomp_buffer *pomp_buffer_new_copy(const struct pomp_buffer *buf)
 
 	POMP_RETURN_VAL_IF_FAILED(buf != NULL, -EINVAL, NULL);
 
-	/* Allocate buffer structure, set initial ref count to 1 */
-	newbuf = calloc(1, sizeof(*newbuf));
+	/* Allocate buffer structure and internal data */
+	newbuf = pomp_buffer_new(buf->len);
 	if (newbuf == NULL)
 		goto error;
-	newbuf->refcount = 1;
 
 	if (buf->len != 0) {
-		/* Allocate internal data */
-		newbuf->data = malloc(buf->len);
-		if (newbuf->data == NULL)
-			goto error;
-
 		/* Copy data */
 		memcpy(newbuf->data, buf->data, buf->len);
-		newbuf->capacity = buf->len;
 		newbuf->len = buf->len;
 	}
 
@@ -241,6 +277,20 @@ struct pomp_buffer *pomp_buffer_new_copy(const struct pomp_buffer *buf)
 		}
 	}
 
+	/* Share referenced external buffers, they are read-only */
+	if (buf->segcount > 0) {
+		newbuf->segs = calloc(POMP_BUFFER_MAX_SEG_COUNT,
+				sizeof(*newbuf->segs));
+		if (newbuf->segs == NULL)
+			goto error;
+		for (i = 0; i < buf->segcount; i++) {
+			newbuf->segs[i] = buf->segs[i];
+			pomp_buffer_ref(newbuf->segs[i].buf);
+		}
+		newbuf->segcount = buf->segcount;
+		newbuf->seglen = buf->seglen;
+	}
+
 	return newbuf;
 
 	/* Cleanup in case of error */
@@ -276,6 +326,59 @@ struct pomp_buffer *pomp_buffer_new_get_data(size_t capacity, void **data)
 	return buf;
 }
 
+/*
+ * See documentation in public header.
+ */
+struct pomp_buffer *pomp_buffer_new_slice(struct pomp_buffer *buf,
+		size_t off, size_t len)
+{
+	struct pomp_buffer *slice = NULL;
+	POMP_RETURN_VAL_IF_FAILED(buf != NULL, -EINVAL, NULL);
+	POMP_RETURN_VAL_IF_FAILED(off <= buf->len, -EINVAL, NULL);
+	POMP_RETURN_VAL_IF_FAILED(len <= buf->len - off, -EINVAL, NULL);
+	POMP_RETURN_VAL_IF_FAILED(buf->fdcount == 0, -EINVAL, NULL);
+	POMP_RETURN_VAL_IF_FAILED(buf->segcount == 0, -EINVAL, NULL);
+
+	/* Allocate buffer structure, set initial ref count to 1 */
+	slice = calloc(1, sizeof(*slice));
+	if (slice == NULL)
+		return NULL;
+	slice->refcount = 1;
+
+	/* Point to data of parent, always reference the owner of data */
+	slice->data = buf->data + off;
+	slice->capacity = len;
+	slice->len = len;
+	slice->parent = buf->parent != NULL ? buf->parent : buf;
+	pomp_buffer_ref(slice->parent);
+	return slice;
+}
+
+/*
+ * See documentation in public header.
+ */
+struct pomp_buffer *pomp_buffer_new_external(void *data, size_t len,
+		pomp_buffer_release_cb_t cb, void *userdata)
+{
+	struct pomp_buffer *buf = NULL;
+	POMP_RETURN_VAL_IF_FAILED(data != NULL, -EINVAL, NULL);
+
+	/* Allocate buffer structure, set initial ref count to 1 */
+	buf = calloc(1, sizeof(*buf));
+	if (buf == NULL)
+		return NULL;
+	buf->refcount = 1;
+
+	/* Use external data as is */
+	buf->data = data;
+	buf->capacity = len;
+	buf->len = len;
+	buf->isexternal = 1;
+	buf->release_cb = cb;
+	buf->release_userdata = userdata;
+	return buf;
+}
+
 /*
  * See documentation in public header.
  */
@@ -318,7 +421,7 @@ void pomp_buffer_unref(struct pomp_buffer *buf)
  */
 int pomp_buffer_is_shared(const struct pomp_buffer *buf)
 {
-	return buf != NULL && buf->refcount > 1;
+	return buf != NULL && !POMP_BUFFER_IS_WRITABLE(buf);
 }
 
 /*
@@ -329,10 +432,24 @@ int pomp_buffer_set_capacity(struct pomp_buffer *buf, size_t capacity)
 	uint8_t *data = NULL;
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(capacity >= buf->len, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
+
+	/* Use inline data if it is big enough and nothing allocated yet */
+	if (capacity <= buf->inlinecap
+			&& (buf->data == NULL || POMP_BUFFER_IS_INLINE(buf))) {
+		buf->data = buf->inlinedata;
+		buf->capacity = capacity;
+		return 0;
+	}
 
-	/* Resize internal data */
-	data = realloc(buf->data, capacity);
+	/* Resize internal data, moving inline data out of line if needed */
+	if (POMP_BUFFER_IS_INLINE(buf)) {
+		data = malloc(capacity);
+		if (data != NULL)
+			memcpy(data, buf->data, buf->len);
+	} else {
+		data = realloc(buf->data, capacity);
+	}
 	if (data == NULL)
 		return -ENOMEM;
 	buf->data = data;
@@ -347,7 +464,7 @@ int pomp_buffer_set_len(struct pomp_buffer *buf, size_t len)
 {
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(len <= buf->capacity, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
 	buf->len = len;
 	return 0;
 }
@@ -359,7 +476,7 @@ int pomp_buffer_get_data(const struct pomp_buffer *buf,
 		void **data, size_t *len, size_t *capacity)
 {
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
 	if (data != NULL)
 		*data = buf->data;
 	if (len != NULL)
@@ -430,10 +547,13 @@ int pomp_buffer_append_buffer(struct pomp_buffer *buf,
 int pomp_buffer_ensure_capacity(struct pomp_buffer *buf, size_t capacity)
 {
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
 
-	/* Resize internal data if needed */
+	/* Resize internal data if needed, grow geometrically to amortize the
+	 * cost of successive small writes */
 	if (capacity > buf->capacity) {
+		if (capacity < buf->capacity + buf->capacity / 2)
+			capacity = buf->capacity + buf->capacity / 2;
 		capacity = POMP_BUFFER_ALIGN_ALLOC_SIZE(capacity);
 		return pomp_buffer_set_capacity(buf, capacity);
 	}
@@ -451,7 +571,7 @@ int pomp_buffer_write(struct pomp_buffer *buf, size_t *pos,
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(pos != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(p != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
 
 	/* Make sure there is enough room in data buffer */
 	res = pomp_buffer_ensure_capacity(buf, *pos + n);
@@ -494,7 +614,7 @@ int pomp_buffer_write_fd(struct pomp_buffer *buf, size_t *pos, int fd)
 	size_t off = 0;
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(pos != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(buf->refcount <= 1, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
 	POMP_RETURN_ERR_IF_FAILED(fd >= 0, -EINVAL);
 
 	/* Remember position at which fd will be written, write a dummy value */
@@ -611,3 +731,116 @@ int pomp_buffer_read_fd(const struct pomp_buffer *buf, size_t *pos, int *fd)
 	POMP_LOGE("No file descriptor at given position");
 	return -EINVAL;
 }
+
+/**
+ * Reference an external buffer at the end of the data of a buffer. Its content
+ * is not copied, it will be gathered with the rest of the data when written.
+ * @param buf : buffer.
+ * @param seg : external buffer to reference.
+ * @return 0 in case of success, negative errno value in case of error.
+ * -EPERM is returned if the buffer is shared (ref count is greater than 1).
+ *
+ * @remarks a new reference on the external buffer is taken, making it
+ * read-only. It shall not have file descriptors nor segments itself.
+ */
+int pomp_buffer_add_seg(struct pomp_buffer *buf, struct pomp_buffer *seg)
+{
+	struct pomp_buffer_seg *segs = NULL;
+	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(seg != NULL && seg != buf, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(POMP_BUFFER_IS_WRITABLE(buf), -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(seg->fdcount == 0, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(seg->segcount == 0, -EINVAL);
+
+	/* Nothing to reference */
+	if (seg->len == 0)
+		return 0;
+
+	if (buf->segcount >= POMP_BUFFER_MAX_SEG_COUNT) {
+		POMP_LOGE("Too many segments referenced in buffer");
+		return -ENOBUFS;
+	}
+
+	/* Allocate the array of segments on first use */
+	if (buf->segs == NULL) {
+		segs = calloc(POMP_BUFFER_MAX_SEG_COUNT, sizeof(*segs));
+		if (segs == NULL)
+			return -ENOMEM;
+		buf->segs = segs;
+	}
+
+	/* Save offset and take a reference */
+	buf->segs[buf->segcount].off = buf->len;
+	buf->segs[buf->segcount].buf = seg;
+	buf->segcount++;
+	buf->seglen += seg->len;
+	pomp_buffer_ref(seg);
+	return 0;
+}
+
+/**
+ * Get the total length of a buffer, including referenced external buffers.
+ * @param buf : buffer.
+ * @return total length of the buffer.
+ */
+size_t pomp_buffer_get_total_len(const struct pomp_buffer *buf)
+{
+	return buf->len + buf->seglen;
+}
+
+#ifndef _WIN32
+
+/**
+ * Helper to add an io vector if not empty.
+ * @param iov : array of io vectors.
+ * @param iovcnt : number of io vectors in array, updated.
+ * @param data : start of data.
+ * @param len : length of data.
+ * @param skip : number of bytes still to skip, updated.
+ */
+static void add_iov(struct iovec *iov, int *iovcnt,
+		const uint8_t *data, size_t len, size_t *skip)
+{
+	if (len <= *skip) {
+		*skip -= len;
+		return;
+	}
+	iov[*iovcnt].iov_base = (void *)(data + *skip);
+	iov[*iovcnt].iov_len = len - *skip;
+	(*iovcnt)++;
+	*skip = 0;
+}
+
+/**
+ * Get the io vectors to write a buffer with its referenced external buffers.
+ * @param buf : buffer.
+ * @param off : offset of first byte to write (in total length).
+ * @param iov : array of io vectors to fill.
+ * @param maxiov : size of array (at least POMP_BUFFER_MAX_IOV_COUNT).
+ * @return number of io vectors filled in case of success, negative errno value
+ * in case of error.
+ */
+int pomp_buffer_get_iov(const struct pomp_buffer *buf, size_t off,
+		struct iovec *iov, int maxiov)
+{
+	uint32_t i = 0;
+	size_t pos = 0;
+	int iovcnt = 0;
+	const struct pomp_buffer_seg *seg = NULL;
+	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(iov != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(maxiov >= (int)(2 * buf->segcount + 1),
+			-EINVAL);
+
+	/* Interleave own data with referenced buffers */
+	for (i = 0; i < buf->segcount; i++) {
+		seg = &buf->segs[i];
+		add_iov(iov, &iovcnt, buf->data + pos, seg->off - pos, &off);
+		add_iov(iov, &iovcnt, seg->buf->data, seg->buf->len, &off);
+		pos = seg->off;
+	}
+	add_iov(iov, &iovcnt, buf->data + pos, buf->len - pos, &off);
+	return iovcnt;
+}
+
+#endif /* !_WIN32 */
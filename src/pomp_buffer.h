@@ -46,6 +46,9 @@
 /** Allocation step in buffer (shall be a power of 2) */
 #define POMP_BUFFER_ALLOC_STEP	(256u)
 
+/** Size of data stored inline with the structure for small buffers */
+#define POMP_BUFFER_INLINE_SIZE	POMP_BUFFER_ALLOC_STEP
+
 /** Default maximum capacity to reuse a buffer after a partial clear */
 #define POMP_BUFFER_MAX_REUSE_CAPACITY 4096
 
@@ -56,6 +59,27 @@
 /** Maximum number of file descriptor that can be put in a buffer */
 #define POMP_BUFFER_MAX_FD_COUNT	4
 
+/** Maximum number of external buffers that can be referenced by a buffer */
+#define POMP_BUFFER_MAX_SEG_COUNT	16
+
+/** Maximum number of io vectors needed to write a buffer with segments */
+#define POMP_BUFFER_MAX_IOV_COUNT	(2 * POMP_BUFFER_MAX_SEG_COUNT + 1)
+
+/** External buffer referenced (not copied) at some offset of a buffer */
+struct pomp_buffer_seg {
+	size_t			off;	/**< Offset in data */
+	struct pomp_buffer	*buf;	/**< Referenced buffer */
+};
+
+/** Check if data of a buffer is stored inline with the structure */
+#define POMP_BUFFER_IS_INLINE(_buf) \
+	((_buf)->inlinecap != 0 && (_buf)->data == (_buf)->inlinedata)
+
+/** Check if a buffer can be modified (not shared and owning its data) */
+#define POMP_BUFFER_IS_WRITABLE(_buf) \
+	((_buf)->refcount <= 1 && (_buf)->parent == NULL \
+			&& !(_buf)->isexternal)
+
 /** Reference counted buffer */
 struct pomp_buffer {
 	uint32_t	refcount;	/**< Reference count */
@@ -66,6 +90,25 @@ struct pomp_buffer {
 
 	/** Offsets in buffer where a file descriptor was put */
 	size_t		fdoffs[POMP_BUFFER_MAX_FD_COUNT];
+
+	/** External buffers logically inserted in data (allocated on demand) */
+	struct pomp_buffer_seg	*segs;
+	uint32_t	segcount;	/**< Number of external buffers */
+	size_t		seglen;		/**< Total length of segments */
+
+	/** Buffer owning data for a slice (data is not allocated) */
+	struct pomp_buffer	*parent;
+
+	/** External data (not allocated) with optional release function */
+	int				isexternal;
+	pomp_buffer_release_cb_t	release_cb;
+	void				*release_userdata;
+
+	/** Size of inline data storage, 0 if not allocated with structure */
+	size_t		inlinecap;
+
+	/** Inline data storage (single allocation for small buffers) */
+	uint8_t		inlinedata[];
 };
 
 int pomp_buffer_get_fd(const struct pomp_buffer *buf, size_t off);
@@ -86,4 +129,13 @@ int pomp_buffer_readb(const struct pomp_buffer *buf, size_t *pos, uint8_t *b);
 
 int pomp_buffer_read_fd(const struct pomp_buffer *buf, size_t *pos, int *fd);
 
+int pomp_buffer_add_seg(struct pomp_buffer *buf, struct pomp_buffer *seg);
+
+size_t pomp_buffer_get_total_len(const struct pomp_buffer *buf);
+
+#ifndef _WIN32
+int pomp_buffer_get_iov(const struct pomp_buffer *buf, size_t off,
+		struct iovec *iov, int maxiov);
+#endif /* !_WIN32 */
+
 #endif /* !_POMP_BUFFER_H_ */
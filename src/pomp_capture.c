@@ -0,0 +1,323 @@
+/**
+ * @file pomp_capture.c
+ *
+ * @brief Traffic capture to file.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "pomp_priv.h"
+
+#ifdef POMP_HAVE_CAPTURE
+
+/** Default size of the record ring */
+#define POMP_CAPTURE_DEFAULT_RING_SIZE	(1024 * 1024)
+
+/** Delay between checks of an empty ring by the writer thread (in ns) */
+#define POMP_CAPTURE_POLL_DELAY		(10 * 1000 * 1000)
+
+/**
+ * Capture state. Records are produced by the loop thread of the context and
+ * consumed by a writer thread. The ring is single producer single consumer:
+ * each side only writes its own position and reads the other one with
+ * acquire semantics, so no lock is needed.
+ */
+struct pomp_capture {
+	uint8_t		*ring;		/**< Ring of records */
+	size_t		size;		/**< Size of ring (power of 2) */
+	uint64_t	head;		/**< Write position (producer) */
+	uint64_t	tail;		/**< Read position (consumer) */
+	uint64_t	dropped;	/**< Records dropped (ring full) */
+	int		should_stop;	/**< Writer thread shall stop */
+	int		fd;		/**< Capture file */
+	pthread_t	thread;		/**< Writer thread */
+};
+
+/**
+ * Write a chunk of data to the capture file.
+ * @param capture : capture.
+ * @param data : data to write.
+ * @param len : size of data.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_capture_write(struct pomp_capture *capture,
+		const uint8_t *data, size_t len)
+{
+	ssize_t res = 0;
+
+	while (len > 0) {
+		res = write(capture->fd, data, len);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			res = -errno;
+			POMP_LOG_FD_ERRNO("write", capture->fd);
+			return (int)res;
+		}
+		data += res;
+		len -= (size_t)res;
+	}
+	return 0;
+}
+
+/**
+ * Write all records currently in the ring to the capture file.
+ * @param capture : capture.
+ * @return 1 if some records were written, 0 if the ring was empty.
+ */
+static int pomp_capture_drain(struct pomp_capture *capture)
+{
+	uint64_t head = __atomic_load_n(&capture->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = capture->tail;
+	size_t off = 0, len = 0;
+
+	if (head == tail)
+		return 0;
+
+	/* Data may wrap at the end of the ring */
+	off = (size_t)(tail & (capture->size - 1));
+	len = (size_t)(head - tail);
+	if (off + len > capture->size) {
+		(void)pomp_capture_write(capture, capture->ring + off,
+				capture->size - off);
+		len -= capture->size - off;
+		off = 0;
+	}
+	(void)pomp_capture_write(capture, capture->ring + off, len);
+
+	__atomic_store_n(&capture->tail, head, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/**
+ * Writer thread.
+ * @param userdata : capture.
+ * @return NULL.
+ */
+static void *pomp_capture_thread_cb(void *userdata)
+{
+	struct pomp_capture *capture = userdata;
+	struct timespec delay = {0, POMP_CAPTURE_POLL_DELAY};
+
+	while (!__atomic_load_n(&capture->should_stop, __ATOMIC_ACQUIRE)) {
+		if (!pomp_capture_drain(capture))
+			nanosleep(&delay, NULL);
+	}
+
+	/* Flush remaining records */
+	pomp_capture_drain(capture);
+	return NULL;
+}
+
+/**
+ * Create a new capture and start its writer thread.
+ * @param path : path of the capture file. It is truncated if it exists.
+ * @param ringsize : size of the record ring, rounded up to a power of 2.
+ * 0 for a default size.
+ * @param ret : capture in case of success.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_capture_new(const char *path, size_t ringsize,
+		struct pomp_capture **ret)
+{
+	int res = 0;
+	struct pomp_capture *capture = NULL;
+	struct pomp_capture_file_header hdr;
+
+	POMP_RETURN_ERR_IF_FAILED(path != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ret != NULL, -EINVAL);
+
+	capture = calloc(1, sizeof(*capture));
+	if (capture == NULL)
+		return -ENOMEM;
+	capture->fd = -1;
+
+	/* Allocate ring */
+	if (ringsize == 0)
+		ringsize = POMP_CAPTURE_DEFAULT_RING_SIZE;
+	capture->size = POMP_CAPTURE_ALIGN;
+	while (capture->size < ringsize)
+		capture->size *= 2;
+	capture->ring = malloc(capture->size);
+	if (capture->ring == NULL) {
+		res = -ENOMEM;
+		goto error;
+	}
+
+	/* Create file and write its header */
+	capture->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			0644);
+	if (capture->fd < 0) {
+		res = -errno;
+		POMP_LOG_ERRNO("open");
+		goto error;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = POMP_CAPTURE_MAGIC;
+	hdr.version = POMP_CAPTURE_VERSION;
+	hdr.hdrsize = sizeof(hdr);
+	res = pomp_capture_write(capture, (const uint8_t *)&hdr, sizeof(hdr));
+	if (res < 0)
+		goto error;
+
+	res = pthread_create(&capture->thread, NULL,
+			&pomp_capture_thread_cb, capture);
+	if (res != 0) {
+		POMP_LOGE("pthread_create:err=%d(%s)", res, strerror(res));
+		res = -res;
+		goto error;
+	}
+
+	*ret = capture;
+	return 0;
+
+	/* Cleanup in case of error */
+error:
+	if (capture->fd >= 0)
+		close(capture->fd);
+	free(capture->ring);
+	free(capture);
+	return res;
+}
+
+/**
+ * Stop the writer thread after it has written all pending records and
+ * destroy the capture.
+ * @param capture : capture.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_capture_destroy(struct pomp_capture *capture)
+{
+	POMP_RETURN_ERR_IF_FAILED(capture != NULL, -EINVAL);
+
+	__atomic_store_n(&capture->should_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(capture->thread, NULL);
+
+	if (capture->dropped != 0) {
+		POMP_LOGW("capture: %" PRIu64 " records dropped",
+				capture->dropped);
+	}
+
+	close(capture->fd);
+	free(capture->ring);
+	free(capture);
+	return 0;
+}
+
+/**
+ * Copy data in the ring, handling wrap around.
+ * @param capture : capture.
+ * @param pos : position in ring, updated.
+ * @param data : data to copy.
+ * @param len : size of data.
+ */
+static void pomp_capture_copy(struct pomp_capture *capture, uint64_t *pos,
+		const void *data, size_t len)
+{
+	size_t off = (size_t)(*pos & (capture->size - 1));
+	size_t n = len;
+
+	if (off + n > capture->size)
+		n = capture->size - off;
+	memcpy(capture->ring + off, data, n);
+	if (n < len)
+		memcpy(capture->ring, (const uint8_t *)data + n, len - n);
+	*pos += len;
+}
+
+/**
+ * Add a record to the ring. If the ring is full, the record is dropped.
+ * Shall only be called from the loop thread of the context.
+ * @param capture : capture.
+ * @param dir : direction of the message.
+ * @param msg : message.
+ * @param addr : peer address (can be NULL).
+ * @param addrlen : peer address size.
+ */
+void pomp_capture_record(struct pomp_capture *capture,
+		enum pomp_capture_dir dir, const struct pomp_msg *msg,
+		const struct sockaddr *addr, uint32_t addrlen)
+{
+	struct pomp_capture_record_header rec;
+	static const uint8_t padding[POMP_CAPTURE_ALIGN];
+	const uint8_t *data = NULL;
+	size_t datalen = 0, size = 0, off = 0;
+	uint64_t head = 0, tail = 0;
+	uint32_t i = 0;
+	const struct pomp_buffer_seg *seg = NULL;
+	struct timespec ts = {0, 0};
+
+	if (msg->buf == NULL)
+		return;
+	if (addr == NULL || addrlen > UINT16_MAX)
+		addrlen = 0;
+	data = msg->buf->data;
+	datalen = pomp_buffer_get_total_len(msg->buf);
+
+	/* Make sure there is room for the record */
+	size = sizeof(rec) + addrlen + datalen;
+	size = (size + POMP_CAPTURE_ALIGN - 1)
+			& ~((size_t)POMP_CAPTURE_ALIGN - 1);
+	head = capture->head;
+	tail = __atomic_load_n(&capture->tail, __ATOMIC_ACQUIRE);
+	if (size > UINT32_MAX || head - tail + size > capture->size) {
+		capture->dropped++;
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memset(&rec, 0, sizeof(rec));
+	rec.size = (uint32_t)size;
+	rec.dir = (uint8_t)dir;
+	rec.addrlen = (uint16_t)addrlen;
+	rec.timestamp = (uint64_t)ts.tv_sec * 1000000000ULL
+			+ (uint64_t)ts.tv_nsec;
+	rec.msgid = msg->msgid;
+	rec.datalen = (uint32_t)datalen;
+
+	pomp_capture_copy(capture, &head, &rec, sizeof(rec));
+	if (addrlen != 0)
+		pomp_capture_copy(capture, &head, addr, addrlen);
+
+	/* Copy data interleaved with referenced buffers */
+	for (i = 0; i < msg->buf->segcount; i++) {
+		seg = &msg->buf->segs[i];
+		pomp_capture_copy(capture, &head, data + off, seg->off - off);
+		pomp_capture_copy(capture, &head,
+				seg->buf->data, seg->buf->len);
+		off = seg->off;
+	}
+	pomp_capture_copy(capture, &head, data + off, msg->buf->len - off);
+	pomp_capture_copy(capture, &head, padding,
+			size - sizeof(rec) - addrlen - datalen);
+
+	/* Publish record */
+	__atomic_store_n(&capture->head, head, __ATOMIC_RELEASE);
+}
+
+#endif /* POMP_HAVE_CAPTURE */
@@ -53,6 +53,9 @@
 
 #define POMP_CONN_RX_FDS_MAX_COUNT	POMP_BUFFER_MAX_FD_COUNT
 
+/** Maximum number of disjoint message id ranges a peer can subscribe to */
+#define POMP_CONN_MAX_SUB_RANGES	256
+
 /** IO buffer for asynchronous write operations */
 struct pomp_io_buffer {
 	size_t			len;	/**< Buffer size */
@@ -63,6 +66,18 @@ struct pomp_io_buffer {
 	uint32_t		addrlen;/**< Destination address for dgram */
 };
 
+/** Queue of IO buffers pending for write */
+struct pomp_io_queue {
+	struct pomp_io_buffer	*head;	/**< Head io buffer */
+	struct pomp_io_buffer	*tail;	/**< Tail io buffer */
+};
+
+/** Range of message ids a peer is interested in */
+struct pomp_sub_range {
+	uint32_t		first;	/**< First message id */
+	uint32_t		last;	/**< Last message id (inclusive) */
+};
+
 /** Data for send callback in idle mode */
 struct idle_sendcb_data {
 	struct pomp_ctx		*ctx;	/**< context */
@@ -97,6 +112,15 @@ struct pomp_conn {
 	/** Flag indicating that connection shall be removed from context */
 	int			removeflag;
 
+	/** Id of connection in context, never reused */
+	uint64_t		id;
+
+	/** Application data */
+	void			*userdata;
+
+	/** Application data destructor */
+	pomp_conn_userdata_destroy_cb_t	userdata_destroy;
+
 	/** Read buffer */
 	struct pomp_buffer	*readbuf;
 
@@ -112,11 +136,40 @@ struct pomp_conn {
 	/** Protocol state */
 	struct pomp_prot	*prot;
 
-	/** Pending write head io buffer */
-	struct pomp_io_buffer	*headbuf;
+	/** Received messages kept for the batch callback (first 'batchcount'
+	 *  entries), followed by spare messages reused for decoding (next
+	 *  'batchspare' entries) */
+	struct pomp_msg		**batch;
+
+	/** Number of received messages kept for the batch callback */
+	size_t			batchcount;
+
+	/** Number of spare messages */
+	size_t			batchspare;
+
+	/** Allocated size of batch array */
+	size_t			batchsize;
+
+	/** Number of messages received since last batch end notification */
+	size_t			batchrxcount;
 
-	/** Pending write tail io buffer */
-	struct pomp_io_buffer	*tailbuf;
+	/** Pending write io buffers, one queue per priority class */
+	struct pomp_io_queue	writeq[POMP_SEND_PRIO_COUNT];
+
+	/** Pending calls waiting for a reply (created on first call) */
+	struct pomp_rpc_table	*rpc;
+
+	/** 1 if the peer registered its interests, 0 if it wants everything */
+	int			subscribed;
+
+	/** Sorted array of disjoint, non adjacent message id ranges */
+	struct pomp_sub_range	*subs;
+
+	/** Number of message id ranges */
+	size_t			subcount;
+
+	/** Capture of context, NULL if not capturing */
+	struct pomp_capture	*capture;
 
 	/** Local address */
 	struct sockaddr_storage	local_addr;
@@ -169,6 +222,13 @@ struct pomp_conn {
 	/** Read suspended flag */
 	int			read_suspended;
 
+	/** Edge-triggered mode: OUT events are always monitored and the loop
+	 *  only reports changes of readiness */
+	int			edge;
+
+	/** Edge-triggered mode: socket may still have data to read */
+	int			readpending;
+
 	/** Pending callback head */
 	struct idle_sendcb_data	*idlecbs_head;
 
@@ -198,7 +258,7 @@ static struct pomp_io_buffer *pomp_io_buffer_new(struct pomp_buffer *buf,
 		return NULL;
 
 	/* Setup buffer */
-	iobuf->len = buf->len;
+	iobuf->len = pomp_buffer_get_total_len(buf);
 	iobuf->off = off;
 	iobuf->buf = buf;
 	pomp_buffer_ref(buf);
@@ -270,51 +330,68 @@ static int pomp_io_buffer_write_dgram(struct pomp_io_buffer *iobuf,
 }
 
 /**
- * Write an IO buffer to the given connection with associated file descriptors
- * also transmitted as ancillary data. The internal offset is updated
- * in case of success.
+ * Write an IO buffer to the given connection with a single sendmsg call.
+ * Referenced external buffers are gathered with the data, and associated file
+ * descriptors are also transmitted as ancillary data if the write starts at
+ * the beginning of the buffer.
  * @param iobuf : IO buffer.
  * @param conn : connection.
  * @return number of bytes written in case of success, negative errno value in
  * case of error. -EAGAIN is returned if write can not be completed immediately.
  */
-static int pomp_io_buffer_write_with_cmsg(struct pomp_io_buffer *iobuf,
+static int pomp_io_buffer_write_msg(struct pomp_io_buffer *iobuf,
 		struct pomp_conn *conn)
 {
-#ifdef SCM_RIGHTS
+#ifndef _WIN32
 	int res = 0;
 	ssize_t writelen = 0;
-	struct iovec iov;
+	struct iovec iov[POMP_BUFFER_MAX_IOV_COUNT];
 	struct msghdr msg;
+#ifdef SCM_RIGHTS
 	struct cmsghdr *cmsg = NULL;
 	uint8_t cmsg_buf[CMSG_SPACE(POMP_BUFFER_MAX_FD_COUNT * sizeof(int))];
 	uint32_t i = 0;
 	int srcfd = 0;
 	int *dstfd = 0;
+#endif /* SCM_RIGHTS */
 
 	memset(&msg, 0, sizeof(msg));
-	memset(&cmsg_buf, 0, sizeof(cmsg_buf));
 
 	/* Setup the data part of the socket message */
-	iov.iov_base = iobuf->buf->data + iobuf->off;
-	iov.iov_len = iobuf->len - iobuf->off;
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
+	res = pomp_buffer_get_iov(iobuf->buf, iobuf->off,
+			iov, POMP_BUFFER_MAX_IOV_COUNT);
+	if (res < 0)
+		return res;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = (size_t)res;
+
+	/* Setup the destination for dgram sockets */
+	if (conn->isdgram) {
+		msg.msg_name = &iobuf->addr;
+		msg.msg_namelen = iobuf->addrlen;
+	}
 
+#ifdef SCM_RIGHTS
 	/* Setup the control part of the socket message */
-	msg.msg_control = cmsg_buf;
-	msg.msg_controllen = CMSG_SPACE(iobuf->buf->fdcount * sizeof(int));
-	cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level = SOL_SOCKET;
-	cmsg->cmsg_type = SCM_RIGHTS;
-	cmsg->cmsg_len = CMSG_LEN(iobuf->buf->fdcount * sizeof(int));
-
-	/* Copy file descriptors */
-	dstfd = (int *)CMSG_DATA(cmsg);
-	for (i = 0; i < iobuf->buf->fdcount; i++) {
-		srcfd = pomp_buffer_get_fd(iobuf->buf, iobuf->buf->fdoffs[i]);
-		memcpy(&dstfd[i], &srcfd, sizeof(int));
+	if (iobuf->off == 0 && iobuf->buf->fdcount > 0) {
+		memset(&cmsg_buf, 0, sizeof(cmsg_buf));
+		msg.msg_control = cmsg_buf;
+		msg.msg_controllen = CMSG_SPACE(
+				iobuf->buf->fdcount * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(iobuf->buf->fdcount * sizeof(int));
+
+		/* Copy file descriptors */
+		dstfd = (int *)CMSG_DATA(cmsg);
+		for (i = 0; i < iobuf->buf->fdcount; i++) {
+			srcfd = pomp_buffer_get_fd(iobuf->buf,
+					iobuf->buf->fdoffs[i]);
+			memcpy(&dstfd[i], &srcfd, sizeof(int));
+		}
 	}
+#endif /* SCM_RIGHTS */
 
 	/* Write data ignoring interrupts */
 	do {
@@ -331,9 +408,9 @@ static int pomp_io_buffer_write_with_cmsg(struct pomp_io_buffer *iobuf,
 
 	/* Return number of bytes written */
 	return (int)writelen;
-#else /* !SCM_RIGHTS */
+#else /* _WIN32 */
 	return pomp_io_buffer_write_normal(iobuf, conn);
-#endif /* !SCM_RIGHTS */
+#endif /* _WIN32 */
 }
 
 /**
@@ -352,11 +429,14 @@ static int pomp_io_buffer_write(struct pomp_io_buffer *iobuf,
 	if (conn->is_shutdown)
 		return -ENOTCONN;
 
-	/* When offset is 0 and buffer has file descriptors in it, write them */
-	if (conn->isdgram)
+	/* When offset is 0 and buffer has file descriptors in it, write them,
+	 * gather referenced external buffers if any */
+	if (iobuf->buf->segcount > 0)
+		res = pomp_io_buffer_write_msg(iobuf, conn);
+	else if (conn->isdgram)
 		res = pomp_io_buffer_write_dgram(iobuf, conn);
 	else if (iobuf->off == 0 && iobuf->buf->fdcount > 0)
-		res = pomp_io_buffer_write_with_cmsg(iobuf, conn);
+		res = pomp_io_buffer_write_msg(iobuf, conn);
 	else
 		res = pomp_io_buffer_write_normal(iobuf, conn);
 	if (res < 0)
@@ -367,6 +447,80 @@ static int pomp_io_buffer_write(struct pomp_io_buffer *iobuf,
 	return 0;
 }
 
+/**
+ * Add an IO buffer at the tail of a write queue.
+ * @param queue : write queue.
+ * @param iobuf : IO buffer to add.
+ */
+static void pomp_io_queue_push(struct pomp_io_queue *queue,
+		struct pomp_io_buffer *iobuf)
+{
+	iobuf->next = NULL;
+	if (queue->tail == NULL) {
+		queue->head = iobuf;
+		queue->tail = iobuf;
+	} else {
+		queue->tail->next = iobuf;
+		queue->tail = iobuf;
+	}
+}
+
+/**
+ * Remove the IO buffer at the head of a write queue.
+ * @param queue : write queue.
+ * @return removed IO buffer or NULL if the queue was empty.
+ */
+static struct pomp_io_buffer *pomp_io_queue_pop(struct pomp_io_queue *queue)
+{
+	struct pomp_io_buffer *iobuf = queue->head;
+	if (iobuf != NULL) {
+		queue->head = iobuf->next;
+		if (queue->head == NULL)
+			queue->tail = NULL;
+		iobuf->next = NULL;
+	}
+	return iobuf;
+}
+
+/**
+ * Determine if some IO buffers are pending for write on a connection.
+ * @param conn : connection.
+ * @return 1 if some IO buffers are pending, 0 otherwise.
+ */
+static int pomp_conn_has_pending_write(const struct pomp_conn *conn)
+{
+	uint32_t i = 0;
+	for (i = 0; i < POMP_SEND_PRIO_COUNT; i++) {
+		if (conn->writeq[i].head != NULL)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Select the write queue whose head IO buffer shall be written next.
+ * A partially written IO buffer is always completed first so that messages
+ * of different priority classes are never interleaved on stream sockets.
+ * Otherwise the non-empty queue with the highest priority is selected.
+ * @param conn : connection.
+ * @return write queue or NULL if nothing is pending.
+ */
+static struct pomp_io_queue *pomp_conn_next_write_queue(struct pomp_conn *conn)
+{
+	uint32_t i = 0;
+	struct pomp_io_queue *queue = NULL;
+
+	for (i = 0; i < POMP_SEND_PRIO_COUNT; i++) {
+		if (conn->writeq[i].head == NULL)
+			continue;
+		if (conn->writeq[i].head->off != 0)
+			return &conn->writeq[i];
+		if (queue == NULL)
+			queue = &conn->writeq[i];
+	}
+	return queue;
+}
+
 static void pomp_conn_rx_fds_init(struct pomp_conn_rx_fds *rxfds)
 {
 	size_t i = 0;
@@ -488,14 +642,232 @@ static int pomp_conn_fixup_rx_fds(struct pomp_conn *conn,
 	return res;
 }
 
+/**
+ * Record a message in the capture of the context.
+ * @param conn : connection.
+ * @param dir : direction of the message.
+ * @param msg : message.
+ * @param addr : destination address for dgram, NULL to use peer address.
+ * @param addrlen : destination address size.
+ */
+static void pomp_conn_capture(struct pomp_conn *conn,
+		enum pomp_capture_dir dir, const struct pomp_msg *msg,
+		const struct sockaddr *addr, uint32_t addrlen)
+{
+#ifdef POMP_HAVE_CAPTURE
+	if (addr == NULL) {
+		addr = (const struct sockaddr *)&conn->peer_addr;
+		addrlen = conn->peer_addrlen;
+	}
+	pomp_capture_record(conn->capture, dir, msg, addr, addrlen);
+#endif /* POMP_HAVE_CAPTURE */
+}
+
+/**
+ * Update the message id ranges a peer is interested in.
+ * @param conn : connection.
+ * @param first : first message id of the range.
+ * @param last : last message id of the range (inclusive).
+ * @param add : 1 to add the range, 0 to remove it.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_conn_update_subs(struct pomp_conn *conn,
+		uint32_t first, uint32_t last, int add)
+{
+	struct pomp_sub_range *subs = NULL;
+	struct pomp_sub_range merged;
+	struct pomp_sub_range full = {0, UINT32_MAX};
+	const struct pomp_sub_range *cursubs = conn->subs;
+	size_t i = 0, count = 0, curcount = conn->subcount;
+	int inserted = 0;
+
+	/* A peer that never subscribed is interested in everything. Its first
+	 * subscription starts from an empty set, its first unsubscription from
+	 * the full set */
+	if (!conn->subscribed) {
+		cursubs = add ? NULL : &full;
+		curcount = add ? 0 : 1;
+	}
+
+	/* Adding may merge ranges, removing may split one range in two */
+	subs = calloc(curcount + 1, sizeof(*subs));
+	if (subs == NULL)
+		return -ENOMEM;
+
+	merged.first = first;
+	merged.last = last;
+	for (i = 0; i < curcount; i++) {
+		const struct pomp_sub_range *r = &cursubs[i];
+		if (add) {
+			if (r->last != UINT32_MAX && r->last + 1 < first) {
+				/* Strictly before, not adjacent */
+				subs[count++] = *r;
+			} else if (last != UINT32_MAX && last + 1 < r->first) {
+				/* Strictly after, not adjacent */
+				if (!inserted) {
+					subs[count++] = merged;
+					inserted = 1;
+				}
+				subs[count++] = *r;
+			} else {
+				/* Overlapping or adjacent: merge */
+				if (r->first < merged.first)
+					merged.first = r->first;
+				if (r->last > merged.last)
+					merged.last = r->last;
+			}
+		} else if (r->last < first || r->first > last) {
+			/* Not affected by removal */
+			subs[count++] = *r;
+		} else {
+			/* Keep parts outside of removed range */
+			if (r->first < first) {
+				subs[count].first = r->first;
+				subs[count++].last = first - 1;
+			}
+			if (r->last > last) {
+				subs[count].first = last + 1;
+				subs[count++].last = r->last;
+			}
+		}
+	}
+	if (add && !inserted)
+		subs[count++] = merged;
+
+	/* The peer controls the number of ranges, bound memory and time */
+	if (count > POMP_CONN_MAX_SUB_RANGES) {
+		free(subs);
+		return -ENOSPC;
+	}
+
+	free(conn->subs);
+	conn->subs = subs;
+	conn->subcount = count;
+	conn->subscribed = 1;
+	return 0;
+}
+
+/**
+ * Process a subscription message received from the peer.
+ * @param conn : connection.
+ * @param msg : received message.
+ * @return 1 if the message was a subscription message (and shall not be
+ * notified as a regular message), 0 otherwise.
+ */
+static int pomp_conn_process_subscription(struct pomp_conn *conn,
+		const struct pomp_msg *msg)
+{
+	int res = 0;
+	uint32_t op = 0, first = 0, last = 0;
+
+	if (msg->msgid != POMP_MSGID_SUBSCRIPTION
+			|| !pomp_ctx_subscription_filter_is_enabled(conn->ctx))
+		return 0;
+
+	res = pomp_msg_read(msg, "%u%u%u", &op, &first, &last);
+	if (res < 0 || first > last) {
+		POMP_LOGW("Invalid subscription message");
+		return 1;
+	}
+
+	res = pomp_conn_update_subs(conn, first, last, op != 0);
+	if (res < 0)
+		POMP_LOGE("pomp_conn_update_subs failed err=%d", res);
+	return 1;
+}
+
+/**
+ * Keep a received message for the batch callback.
+ * @param conn : connection.
+ * @param msg : message to keep (ownership is taken).
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_conn_batch_add(struct pomp_conn *conn, struct pomp_msg *msg)
+{
+	struct pomp_msg **batch = NULL;
+	struct pomp_msg *spare = NULL;
+	size_t size = 0;
+
+	if (conn->batchspare > 0) {
+		/* Give a spare message to the protocol for next decoding */
+		spare = conn->batch[conn->batchcount];
+		conn->batch[conn->batchcount++] = msg;
+		conn->batchspare--;
+		pomp_prot_release_msg(conn->prot, spare);
+		return 0;
+	}
+
+	if (conn->batchcount == conn->batchsize) {
+		size = conn->batchsize == 0 ? 16 : conn->batchsize * 2;
+		batch = realloc(conn->batch, size * sizeof(*batch));
+		if (batch == NULL)
+			return -ENOMEM;
+		conn->batch = batch;
+		conn->batchsize = size;
+	}
+	conn->batch[conn->batchcount++] = msg;
+	return 0;
+}
+
+/**
+ * Notify messages kept for the batch callback and the end of the batch.
+ * @param conn : connection.
+ */
+static void pomp_conn_batch_flush(struct pomp_conn *conn)
+{
+	size_t i = 0;
+
+	if (conn->batchrxcount == 0)
+		return;
+
+	pomp_ctx_notify_batch(conn->ctx, conn,
+			(const struct pomp_msg *const *)conn->batch,
+			conn->batchcount);
+
+	/* Messages become spare ones, release their file descriptors now */
+	for (i = 0; i < conn->batchcount; i++)
+		pomp_msg_clear_partial(conn->batch[i]);
+	conn->batchspare += conn->batchcount;
+	conn->batchcount = 0;
+	conn->batchrxcount = 0;
+}
+
+/**
+ * Keep a received message for the batch callback. If it can not be kept,
+ * messages already kept are notified and this one is notified alone so none
+ * is lost and the order is preserved.
+ * @param conn : connection.
+ * @param msg : message to keep, set to NULL if ownership is taken.
+ */
+static void pomp_conn_batch_keep(struct pomp_conn *conn,
+		struct pomp_msg **msg)
+{
+	int res = 0;
+
+	res = pomp_conn_batch_add(conn, *msg);
+	if (res == 0) {
+		*msg = NULL;
+		return;
+	}
+
+	POMP_LOGE("pomp_conn_batch_add failed err=%d", res);
+	conn->batchrxcount--;
+	pomp_conn_batch_flush(conn);
+	pomp_ctx_notify_batch(conn->ctx, conn,
+			(const struct pomp_msg *const *)msg, 1);
+}
+
 /**
  * Function called when some data have been read on the connection fd. It
  * tries to decode a message and notify the associated context when a full
  * message has been successfully parsed.
  * @param conn : connection.
+ * @return number of decoded messages.
  */
-static void pomp_conn_process_read_buf(struct pomp_conn *conn)
+static uint32_t pomp_conn_process_read_buf(struct pomp_conn *conn)
 {
+	int res = 0;
+	uint32_t count = 0;
 	size_t len = 0, off = 0;
 	ssize_t usedlen = 0;
 	struct pomp_msg *msg = NULL;
@@ -505,7 +877,7 @@ static void pomp_conn_process_read_buf(struct pomp_conn *conn)
 	/* No protocol decoding for raw context */
 	if (conn->israw) {
 		pomp_ctx_notify_raw_buf(conn->ctx, conn, conn->readbuf);
-		return;
+		return 0;
 	}
 
 	/* Get data from buffer */
@@ -524,11 +896,28 @@ static void pomp_conn_process_read_buf(struct pomp_conn *conn)
 		/* Notify new received message
 		 * (only if file descriptor fixup is OK) */
 		if (msg != NULL) {
+			count++;
+
 			/* Always do the fixup even for inet sockets to at least
 			 * put some invalid markers */
-			if (pomp_conn_fixup_rx_fds(conn, msg) == 0)
-				pomp_ctx_notify_msg(conn->ctx, conn, msg);
-			pomp_prot_release_msg(conn->prot, msg);
+			if (pomp_conn_fixup_rx_fds(conn, msg) == 0) {
+				if (conn->capture != NULL) {
+					pomp_conn_capture(conn,
+						POMP_CAPTURE_DIR_RX, msg,
+						NULL, 0);
+				}
+				if (!pomp_conn_process_subscription(conn, msg)
+						&& !pomp_rpc_table_process_msg(
+							conn->rpc, msg)) {
+					conn->batchrxcount++;
+					res = pomp_ctx_notify_msg(conn->ctx,
+							conn, msg);
+					if (res == 1)
+						pomp_conn_batch_keep(conn, &msg);
+				}
+			}
+			if (msg != NULL)
+				pomp_prot_release_msg(conn->prot, msg);
 			msg = NULL;
 			partial = off < len;
 		}
@@ -544,6 +933,8 @@ static void pomp_conn_process_read_buf(struct pomp_conn *conn)
 			pomp_conn_swap_rx_fds(conn);
 		}
 	}
+
+	return count;
 }
 
 static int pomp_conn_process_read_normal(struct pomp_conn *conn)
@@ -725,17 +1116,22 @@ static int pomp_conn_process_read_with_cmsg(struct pomp_conn *conn)
 /**
  * Function called when the fd is readable. It reads as many bytes as possible
  * until either there is no more data immediately available ('read' returned
- * EAGAIN) or EOF is reached or another error is returned by 'read'.
+ * EAGAIN) or EOF is reached or another error is returned by 'read' or the
+ * read budget of the context is exhausted.
  * @param conn : connection.
  */
 static void pomp_conn_process_read(struct pomp_conn *conn)
 {
 	int res = 0;
+	size_t maxbytes = 0, nbytes = 0;
+	uint32_t maxmsgs = 0, nmsgs = 0;
 
 	/* Do not read fd on read suspended */
 	if (conn->read_suspended)
 		return;
 
+	pomp_ctx_get_read_budget(conn->ctx, &maxbytes, &maxmsgs);
+
 	do {
 		/* If current read buffer is shared, unref it */
 		if (conn->readbuf != NULL && conn->readbuf->refcount > 1) {
@@ -758,7 +1154,20 @@ static void pomp_conn_process_read(struct pomp_conn *conn)
 		/* Process read data */
 		if (res > 0) {
 			conn->readbuf->len = (size_t)res;
-			pomp_conn_process_read_buf(conn);
+			nmsgs += pomp_conn_process_read_buf(conn);
+			nbytes += (size_t)res;
+
+			/* Peer address is only valid for this datagram */
+			if (conn->isdgram)
+				pomp_conn_batch_flush(conn);
+
+			/* Budget exhausted, the fd is still readable so the
+			 * loop will report it again at next iteration (or
+			 * the read is scheduled in edge-triggered mode) */
+			if ((maxbytes != 0 && nbytes >= maxbytes) ||
+					(maxmsgs != 0 && nmsgs >= maxmsgs)) {
+				break;
+			}
 		} else if (res == 0 || !POMP_CONN_WOULD_BLOCK(-res)) {
 			/* Error or EOF, finish this connection */
 			if (!conn->isdgram)
@@ -766,6 +1175,17 @@ static void pomp_conn_process_read(struct pomp_conn *conn)
 		}
 	} while (res > 0 && !conn->read_suspended);
 
+	/* In edge-triggered mode the fd will not be reported again until new
+	 * data arrives, read again at next iteration if not drained */
+	if (conn->edge && !conn->removeflag && !conn->read_suspended
+			&& !POMP_CONN_WOULD_BLOCK(-res)) {
+		conn->readpending = 1;
+		pomp_ctx_schedule_read(conn->ctx);
+	}
+
+	/* Notify everything received during this iteration */
+	pomp_conn_batch_flush(conn);
+
 	/* Reset peer/local addresses after reading message on dgram sockets */
 	if (conn->isdgram) {
 		memset(&conn->peer_addr, 0, sizeof(conn->peer_addr));
@@ -944,13 +1364,15 @@ static int pomp_conn_add_idle_cb(struct pomp_conn *conn, struct pomp_ctx *ctx,
 static void pomp_conn_process_write(struct pomp_conn *conn)
 {
 	int res = 0;
+	struct pomp_io_queue *queue = NULL;
 	struct pomp_io_buffer *iobuf = NULL;
 	uint32_t status = 0;
 
-	/* Write pending buffers */
-	iobuf = conn->headbuf;
-	while (iobuf != NULL) {
+	/* Write pending buffers, highest priority first */
+	queue = pomp_conn_next_write_queue(conn);
+	while (queue != NULL) {
 		/* Try to write buffer */
+		iobuf = queue->head;
 		res = pomp_io_buffer_write(iobuf, conn);
 		if (POMP_CONN_WOULD_BLOCK(-res)) {
 			break;
@@ -962,26 +1384,28 @@ static void pomp_conn_process_write(struct pomp_conn *conn)
 
 		/* Remove pending buffer if completed */
 		if (iobuf->off == iobuf->len) {
-			conn->headbuf = iobuf->next;
-			if (conn->headbuf == NULL)
-				conn->tailbuf = NULL;
+			pomp_io_queue_pop(queue);
 
 			status = POMP_SEND_STATUS_OK;
-			if (conn->headbuf == NULL)
+			if (!pomp_conn_has_pending_write(conn))
 				status |= POMP_SEND_STATUS_QUEUE_EMPTY;
 
 			pomp_conn_add_idle_cb(conn, conn->ctx, iobuf->buf,
 					status);
 
 			pomp_io_buffer_destroy(iobuf);
-			iobuf = conn->headbuf;
+			queue = pomp_conn_next_write_queue(conn);
 		}
 	}
 
-	/* If queue is empty, stop monitoring OUT events */
-	if (conn->headbuf == NULL) {
+	/* If queue is empty, stop monitoring OUT events (always monitored in
+	 * edge-triggered mode) */
+	if (!pomp_conn_has_pending_write(conn)) {
 		POMP_LOGI("conn=%p fd=%d exit async mode", conn, conn->fd);
-		pomp_loop_update2(conn->loop, conn->fd, 0, POMP_FD_EVENT_OUT);
+		if (!conn->edge) {
+			pomp_loop_update2(conn->loop, conn->fd,
+					0, POMP_FD_EVENT_OUT);
+		}
 	}
 }
 
@@ -996,7 +1420,9 @@ static void pomp_conn_cb(int fd, uint32_t revents, void *userdata)
 	struct pomp_conn *conn = userdata;
 	if (!conn->removeflag && (revents & POMP_FD_EVENT_IN))
 		pomp_conn_process_read(conn);
-	if (!conn->removeflag && (revents & POMP_FD_EVENT_OUT))
+	/* In edge-triggered mode, OUT is reported without pending writes */
+	if (!conn->removeflag && (revents & POMP_FD_EVENT_OUT)
+			&& (!conn->edge || pomp_conn_has_pending_write(conn)))
 		pomp_conn_process_write(conn);
 	if (conn->removeflag || (revents & POMP_FD_EVENT_ERR))
 		pomp_ctx_remove_conn(conn->ctx, conn);
@@ -1016,6 +1442,7 @@ struct pomp_conn *pomp_conn_new(struct pomp_ctx *ctx,
 		size_t readbuf_len)
 {
 	int res = 0;
+	uint32_t events = 0;
 	struct pomp_conn *conn = NULL;
 #ifdef SO_PEERCRED
 	socklen_t optlen = 0;
@@ -1040,8 +1467,11 @@ struct pomp_conn *pomp_conn_new(struct pomp_ctx *ctx,
 	conn->israw = israw;
 	conn->removeflag = 0;
 	conn->read_suspended = 0;
+	conn->edge = pomp_ctx_is_edge_triggered(ctx);
+	conn->readpending = 0;
 	conn->readbuf = NULL;
 	conn->readbuf_len = readbuf_len;
+	conn->capture = pomp_ctx_get_capture(ctx);
 	conn->rx_fds_current = &conn->rx_fds[0];
 	conn->rx_fds_next = &conn->rx_fds[1];
 	pomp_conn_rx_fds_init(conn->rx_fds_current);
@@ -1059,9 +1489,12 @@ struct pomp_conn *pomp_conn_new(struct pomp_ctx *ctx,
 			goto error;
 	}
 
-	/* Always monitor IN events */
-	res = pomp_loop_add(conn->loop, conn->fd, POMP_FD_EVENT_IN,
-			&pomp_conn_cb, conn);
+	/* Always monitor IN events, and OUT events once for all in
+	 * edge-triggered mode */
+	events = POMP_FD_EVENT_IN;
+	if (conn->edge)
+		events |= POMP_FD_EVENT_OUT | POMP_FD_EVENT_EDGE;
+	res = pomp_loop_add(conn->loop, conn->fd, events, &pomp_conn_cb, conn);
 	if (res < 0)
 		goto error;
 
@@ -1106,6 +1539,11 @@ struct pomp_conn *pomp_conn_new(struct pomp_ctx *ctx,
 	}
 #endif /* SO_PEERCRED */
 
+	/* Register connection in context to be found by id */
+	res = pomp_ctx_add_conn_id(ctx, conn, &conn->id);
+	if (res < 0)
+		goto error;
+
 	return conn;
 
 	/* Cleanup in case of error */
@@ -1127,14 +1565,23 @@ error:
  */
 int pomp_conn_destroy(struct pomp_conn *conn)
 {
+	size_t i = 0;
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(conn->fd < 0, -EBUSY);
+	if (conn->id != 0)
+		pomp_ctx_remove_conn_id(conn->ctx, conn->id);
+	if (conn->userdata_destroy != NULL)
+		(*conn->userdata_destroy)(conn, conn->userdata);
 	if (conn->sendmsg != NULL)
 		pomp_msg_destroy(conn->sendmsg);
 	if (conn->prot != NULL)
 		pomp_prot_destroy(conn->prot);
 	if (conn->readbuf != NULL)
 		pomp_buffer_unref(conn->readbuf);
+	for (i = 0; i < conn->batchcount + conn->batchspare; i++)
+		pomp_msg_destroy(conn->batch[i]);
+	free(conn->batch);
+	free(conn->subs);
 	free(conn);
 	return 0;
 }
@@ -1147,6 +1594,7 @@ int pomp_conn_destroy(struct pomp_conn *conn)
  */
 int pomp_conn_close(struct pomp_conn *conn)
 {
+	struct pomp_io_queue *queue = NULL;
 	struct pomp_io_buffer *iobuf = NULL;
 	uint32_t status = 0;
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
@@ -1168,20 +1616,24 @@ int pomp_conn_close(struct pomp_conn *conn)
 	/* Clear all pending callbacks */
 	clear_pending_callbacks(conn);
 
+	/* Abort pending calls */
+	if (conn->rpc != NULL) {
+		pomp_rpc_table_destroy(conn->rpc);
+		conn->rpc = NULL;
+	}
+
 	/* Abort pending write buffers */
-	iobuf = conn->headbuf;
-	while (iobuf != NULL) {
-		conn->headbuf = iobuf->next;
-		if (conn->headbuf == NULL)
-			conn->tailbuf = NULL;
+	queue = pomp_conn_next_write_queue(conn);
+	while (queue != NULL) {
+		iobuf = pomp_io_queue_pop(queue);
 
 		status = POMP_SEND_STATUS_ABORTED;
-		if (conn->headbuf == NULL)
+		if (!pomp_conn_has_pending_write(conn))
 			status |= POMP_SEND_STATUS_QUEUE_EMPTY;
 		pomp_ctx_notify_send(conn->ctx, conn, iobuf->buf, status);
 
 		pomp_io_buffer_destroy(iobuf);
-		iobuf = conn->headbuf;
+		queue = pomp_conn_next_write_queue(conn);
 	}
 
 	/* Release resources */
@@ -1190,6 +1642,44 @@ int pomp_conn_close(struct pomp_conn *conn)
 	return 0;
 }
 
+/**
+ * Set the capture where messages of the connection are recorded.
+ * @param conn : connection.
+ * @param capture : capture, NULL to stop recording.
+ */
+void pomp_conn_set_capture(struct pomp_conn *conn,
+		struct pomp_capture *capture)
+{
+	POMP_RETURN_IF_FAILED(conn != NULL, -EINVAL);
+	conn->capture = capture;
+}
+
+/**
+ * Determine if the peer of the connection is interested in a message id.
+ * @param conn : connection.
+ * @param msgid : message id.
+ * @return 1 if the message shall be sent to the peer, 0 otherwise.
+ */
+int pomp_conn_is_subscribed(const struct pomp_conn *conn, uint32_t msgid)
+{
+	size_t lo = 0, hi = 0, mid = 0;
+	POMP_RETURN_VAL_IF_FAILED(conn != NULL, -EINVAL, 0);
+
+	if (!conn->subscribed)
+		return 1;
+
+	/* Find the first range ending at or after msgid */
+	hi = conn->subcount;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (conn->subs[mid].last < msgid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < conn->subcount && conn->subs[lo].first <= msgid;
+}
+
 /**
  * Get the next connection.
  * @param conn : connection.
@@ -1285,6 +1775,68 @@ int pomp_conn_get_fd(struct pomp_conn *conn)
 	return conn->fd;
 }
 
+/*
+ * See documentation in public header.
+ */
+uint64_t pomp_conn_get_id(struct pomp_conn *conn)
+{
+	POMP_RETURN_VAL_IF_FAILED(conn != NULL, -EINVAL, 0);
+	POMP_LOOP_CHECK_OWNER(conn->loop);
+	return conn->id;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_set_userdata(struct pomp_conn *conn, void *userdata)
+{
+	return pomp_conn_set_userdata_full(conn, userdata, NULL);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_set_userdata_full(struct pomp_conn *conn, void *userdata,
+		pomp_conn_userdata_destroy_cb_t destroy)
+{
+	pomp_conn_userdata_destroy_cb_t olddestroy = NULL;
+	void *olduserdata = NULL;
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(conn->loop);
+
+	/* Set new data before calling destructor in case it accesses conn */
+	olddestroy = conn->userdata_destroy;
+	olduserdata = conn->userdata;
+	conn->userdata = userdata;
+	conn->userdata_destroy = destroy;
+	if (olddestroy != NULL)
+		(*olddestroy)(conn, olduserdata);
+	return 0;
+}
+
+/*
+ * See documentation in public header.
+ */
+void *pomp_conn_get_userdata(struct pomp_conn *conn)
+{
+	POMP_RETURN_VAL_IF_FAILED(conn != NULL, -EINVAL, NULL);
+	POMP_LOOP_CHECK_OWNER(conn->loop);
+	return conn->userdata;
+}
+
+/**
+ * Resume reading a connection that stopped before its socket was empty in
+ * edge-triggered mode.
+ * @param conn : connection.
+ */
+void pomp_conn_process_pending_read(struct pomp_conn *conn)
+{
+	if (!conn->readpending)
+		return;
+	conn->readpending = 0;
+	pomp_conn_cb(conn->fd, POMP_FD_EVENT_IN, conn);
+}
+
 /*
  * See documentation in public header.
  */
@@ -1294,6 +1846,13 @@ int pomp_conn_suspend_read(struct pomp_conn *conn)
 
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(conn->loop);
+
+	/* In edge-triggered mode, keep the registration unchanged */
+	if (conn->edge) {
+		conn->read_suspended = 1;
+		return 0;
+	}
+
 	res = pomp_loop_update2(conn->loop, conn->fd, 0, POMP_FD_EVENT_IN);
 	if (res == 0)
 		conn->read_suspended = 1;
@@ -1310,6 +1869,15 @@ int pomp_conn_resume_read(struct pomp_conn *conn)
 
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(conn->loop);
+
+	/* In edge-triggered mode, data received while suspended will not be
+	 * reported again, read it at next iteration */
+	if (conn->edge) {
+		conn->read_suspended = 0;
+		conn->readpending = 1;
+		return pomp_ctx_schedule_read(conn->ctx);
+	}
+
 	res = pomp_loop_update2(conn->loop, conn->fd, POMP_FD_EVENT_IN, 0);
 	if (res == 0)
 		conn->read_suspended = 0;
@@ -1317,22 +1885,99 @@ int pomp_conn_resume_read(struct pomp_conn *conn)
 	return res;
 }
 
+/**
+ * Get the message id from the protocol header of a buffer.
+ * @param buf : buffer.
+ * @param msgid : will receive the message id.
+ * @return 1 if the buffer has a complete header, 0 otherwise.
+ */
+static int pomp_conn_get_buf_msgid(const struct pomp_buffer *buf,
+		uint32_t *msgid)
+{
+	uint32_t val = 0;
+	if (buf->len < POMP_PROT_HEADER_SIZE)
+		return 0;
+	memcpy(&val, buf->data + 4, sizeof(val));
+	*msgid = POMP_LE32TOH(val);
+	return 1;
+}
+
+/**
+ * Try to replace a queued buffer by a newer one with the same message id when
+ * latest-value conflation is enabled for it in the context. Only buffers
+ * whose write has not started yet are considered.
+ * @param conn : connection.
+ * @param buf : new buffer to send.
+ * @param addr : peer address (dgram only).
+ * @param addrlen : peer address length.
+ * @param prio : priority class of the buffer.
+ * @return 1 if a queued buffer was replaced, 0 otherwise.
+ */
+static int pomp_conn_conflate_buf(struct pomp_conn *conn,
+		struct pomp_buffer *buf,
+		const struct sockaddr *addr, uint32_t addrlen,
+		enum pomp_send_prio prio)
+{
+	uint32_t msgid = 0, qmsgid = 0;
+	struct pomp_io_buffer *iobuf = NULL;
+	struct pomp_buffer *oldbuf = NULL;
+
+	if (conn->israw || !pomp_conn_get_buf_msgid(buf, &msgid))
+		return 0;
+	if (!pomp_ctx_is_msg_conflated(conn->ctx, msgid))
+		return 0;
+
+	for (iobuf = conn->writeq[prio].head; iobuf != NULL;
+			iobuf = iobuf->next) {
+		if (iobuf->off != 0)
+			continue;
+		if (!pomp_conn_get_buf_msgid(iobuf->buf, &qmsgid)
+				|| qmsgid != msgid)
+			continue;
+		if (conn->isdgram && (iobuf->addrlen != addrlen
+				|| memcmp(&iobuf->addr, addr, addrlen) != 0))
+			continue;
+
+		/* Replace in place, the old buffer is notified as aborted */
+		oldbuf = iobuf->buf;
+		iobuf->buf = buf;
+		iobuf->len = pomp_buffer_get_total_len(buf);
+		pomp_buffer_ref(buf);
+		pomp_conn_add_idle_cb(conn, conn->ctx, oldbuf,
+				POMP_SEND_STATUS_ABORTED);
+		pomp_buffer_unref(oldbuf);
+		return 1;
+	}
+
+	return 0;
+}
+
 /**
  * Internal send buffer function.
+ * @param conn : connection.
+ * @param buf : buffer to send.
+ * @param addr : peer address (dgram only, can be NULL).
+ * @param addrlen : peer address length.
+ * @param prio : priority class of the buffer.
+ * @return 0 in case of success, negative errno value in case of error.
  */
 static int pomp_conn_send_buf_internal(struct pomp_conn *conn,
 		struct pomp_buffer *buf,
-		const struct sockaddr *addr, uint32_t addrlen)
+		const struct sockaddr *addr, uint32_t addrlen,
+		enum pomp_send_prio prio)
 {
 	int res = 0;
 	size_t off = 0;
 	struct pomp_io_buffer *iobuf = NULL;
 	struct pomp_io_buffer tmpiobuf;
+	int pending = 0;
 
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(conn->fd >= 0, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(buf->data != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED((uint32_t)prio < POMP_SEND_PRIO_COUNT,
+			-EINVAL);
 
 	if (conn->is_shutdown)
 		return -ENOTCONN;
@@ -1356,12 +2001,17 @@ static int pomp_conn_send_buf_internal(struct pomp_conn *conn,
 		return -EPERM;
 	}
 
-	/* Try to send now if possible */
-	if (conn->headbuf == NULL) {
+	/* Try to send now if possible, otherwise try to conflate it with a
+	 * pending buffer */
+	pending = pomp_conn_has_pending_write(conn);
+	if (pending) {
+		if (pomp_conn_conflate_buf(conn, buf, addr, addrlen, prio))
+			return 0;
+	} else {
 		/* Prepare a local temp io buffer */
 		memset(&tmpiobuf, 0, sizeof(tmpiobuf));
 		tmpiobuf.buf = buf;
-		tmpiobuf.len = buf->len;
+		tmpiobuf.len = pomp_buffer_get_total_len(buf);
 		tmpiobuf.off = 0;
 		tmpiobuf.next = NULL;
 		if (conn->isdgram) {
@@ -1396,16 +2046,15 @@ static int pomp_conn_send_buf_internal(struct pomp_conn *conn,
 		iobuf->addrlen = addrlen;
 	}
 
-	if (conn->tailbuf == NULL) {
+	/* Add at the tail of the queue of its priority class */
+	pomp_io_queue_push(&conn->writeq[prio], iobuf);
+	if (!pending) {
 		/* No previous pending buffer */
 		POMP_LOGI("conn=%p fd=%d enter async mode", conn, conn->fd);
-		conn->headbuf = iobuf;
-		conn->tailbuf = iobuf;
-		pomp_loop_update2(conn->loop, conn->fd, POMP_FD_EVENT_OUT, 0);
-	} else {
-		/* Simply add tail */
-		conn->tailbuf->next = iobuf;
-		conn->tailbuf = iobuf;
+		if (!conn->edge) {
+			pomp_loop_update2(conn->loop, conn->fd,
+					POMP_FD_EVENT_OUT, 0);
+		}
 	}
 
 	return 0;
@@ -1423,10 +2072,15 @@ static int pomp_conn_send_buf_internal(struct pomp_conn *conn,
 int pomp_conn_send_msg_to(struct pomp_conn *conn, const struct pomp_msg *msg,
 		const struct sockaddr *addr, uint32_t addrlen)
 {
+	int res = 0;
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(conn->loop);
-	return pomp_conn_send_buf_internal(conn, msg->buf, addr, addrlen);
+	res = pomp_conn_send_buf_internal(conn, msg->buf, addr, addrlen,
+			POMP_SEND_PRIO_NORMAL);
+	if (res == 0 && conn->capture != NULL)
+		pomp_conn_capture(conn, POMP_CAPTURE_DIR_TX, msg, addr, addrlen);
+	return res;
 }
 
 /*
@@ -1434,10 +2088,23 @@ int pomp_conn_send_msg_to(struct pomp_conn *conn, const struct pomp_msg *msg,
  */
 int pomp_conn_send_msg(struct pomp_conn *conn, const struct pomp_msg *msg)
 {
+	return pomp_conn_send_msg_prio(conn, msg, POMP_SEND_PRIO_NORMAL);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_send_msg_prio(struct pomp_conn *conn,
+		const struct pomp_msg *msg, enum pomp_send_prio prio)
+{
+	int res = 0;
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(conn->loop);
-	return pomp_conn_send_buf_internal(conn, msg->buf, NULL, 0);
+	res = pomp_conn_send_buf_internal(conn, msg->buf, NULL, 0, prio);
+	if (res == 0 && conn->capture != NULL)
+		pomp_conn_capture(conn, POMP_CAPTURE_DIR_TX, msg, NULL, 0);
+	return res;
 }
 
 /*
@@ -1472,6 +2139,151 @@ int pomp_conn_sendv(struct pomp_conn *conn, uint32_t msgid,
 	return res;
 }
 
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_call(struct pomp_conn *conn, uint32_t msgid,
+		uint32_t replyid, uint32_t timeout,
+		pomp_rpc_cb_t cb, void *userdata,
+		const char *fmt, ...)
+{
+	int res = 0;
+	va_list args;
+	va_start(args, fmt);
+	res = pomp_conn_callv(conn, msgid, replyid, timeout,
+			cb, userdata, fmt, args);
+	va_end(args);
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_callv(struct pomp_conn *conn, uint32_t msgid,
+		uint32_t replyid, uint32_t timeout,
+		pomp_rpc_cb_t cb, void *userdata,
+		const char *fmt, va_list args)
+{
+	int res = 0;
+	uint32_t callid = 0;
+	struct pomp_rpc_sched *sched = NULL;
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!conn->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!conn->isdgram, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(conn->loop);
+
+	if (conn->is_shutdown)
+		return -EPIPE;
+
+	/* Create table of pending calls on first call */
+	if (conn->rpc == NULL) {
+		sched = pomp_ctx_get_rpc_sched(conn->ctx);
+		if (sched == NULL)
+			return -ENOMEM;
+		conn->rpc = pomp_rpc_table_new(conn->ctx, conn, sched);
+		if (conn->rpc == NULL)
+			return -ENOMEM;
+	}
+
+	res = pomp_rpc_table_add(conn->rpc, replyid, timeout,
+			cb, userdata, &callid);
+	if (res < 0)
+		return res;
+
+	/* Write request using pre-allocated message and send it */
+	res = pomp_rpc_msg_writev(conn->sendmsg, msgid, callid, fmt, args);
+	if (res == 0)
+		res = pomp_conn_send_msg(conn, conn->sendmsg);
+
+	/* Forget the call if the request could not be sent */
+	if (res < 0)
+		(void)pomp_rpc_table_cancel(conn->rpc, callid);
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_reply(struct pomp_conn *conn, uint32_t msgid,
+		const struct pomp_msg *req, const char *fmt, ...)
+{
+	int res = 0;
+	va_list args;
+	va_start(args, fmt);
+	res = pomp_conn_replyv(conn, msgid, req, fmt, args);
+	va_end(args);
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_replyv(struct pomp_conn *conn, uint32_t msgid,
+		const struct pomp_msg *req, const char *fmt, va_list args)
+{
+	int res = 0;
+	uint32_t callid = 0;
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(req != NULL, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(conn->loop);
+
+	res = pomp_msg_get_call_id(req, &callid);
+	if (res < 0)
+		return res;
+
+	/* Write reply using pre-allocated message and send it */
+	res = pomp_rpc_msg_writev(conn->sendmsg, msgid, callid, fmt, args);
+	if (res == 0)
+		res = pomp_conn_send_msg(conn, conn->sendmsg);
+
+	/* Do not clean message, to avoid re-allocation */
+	return res;
+}
+
+/**
+ * Send a subscription message to the peer.
+ * @param conn : connection.
+ * @param first : first message id of the range.
+ * @param last : last message id of the range (inclusive).
+ * @param add : 1 to subscribe, 0 to unsubscribe.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_conn_send_subscription(struct pomp_conn *conn,
+		uint32_t first, uint32_t last, int add)
+{
+	int res = 0;
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!conn->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(first <= last, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(conn->loop);
+
+	res = pomp_msg_write(conn->sendmsg, POMP_MSGID_SUBSCRIPTION,
+			"%u%u%u", (uint32_t)add, first, last);
+	if (res == 0) {
+		res = pomp_conn_send_msg_prio(conn, conn->sendmsg,
+				POMP_SEND_PRIO_CONTROL);
+	}
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_subscribe(struct pomp_conn *conn, uint32_t first, uint32_t last)
+{
+	return pomp_conn_send_subscription(conn, first, last, 1);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_unsubscribe(struct pomp_conn *conn,
+		uint32_t first, uint32_t last)
+{
+	return pomp_conn_send_subscription(conn, first, last, 0);
+}
+
 /**
  * Send a buffer on the given raw connection. For dgram socket, it will sent it
  * to given peer address or internal one if responding to a received message.
@@ -1487,17 +2299,27 @@ int pomp_conn_send_raw_buf_to(struct pomp_conn *conn,
 {
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(conn->loop);
-	return pomp_conn_send_buf_internal(conn, buf, addr, addrlen);
+	return pomp_conn_send_buf_internal(conn, buf, addr, addrlen,
+			POMP_SEND_PRIO_NORMAL);
 }
 
 /*
  * See documentation in public header.
  */
 int pomp_conn_send_raw_buf(struct pomp_conn *conn, struct pomp_buffer *buf)
+{
+	return pomp_conn_send_raw_buf_prio(conn, buf, POMP_SEND_PRIO_NORMAL);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_conn_send_raw_buf_prio(struct pomp_conn *conn,
+		struct pomp_buffer *buf, enum pomp_send_prio prio)
 {
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(conn->loop);
-	return pomp_conn_send_buf_internal(conn, buf, NULL, 0);
+	return pomp_conn_send_buf_internal(conn, buf, NULL, 0, prio);
 }
 
 /*
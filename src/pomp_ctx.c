@@ -46,6 +46,12 @@
 /** Next bind attempt for dgram (in ms) */
 #define POMP_DGRAM_RECONNECT_DELAY	2000
 
+/** Number of message ids covered by the dense table of message handlers */
+#define POMP_CTX_MSG_HANDLER_DENSE_COUNT	256
+
+/** Number of buckets of the hash table of handlers for larger message ids */
+#define POMP_CTX_MSG_HANDLER_HASH_LEN		64
+
 /** Determine if a socket address family is TCP/IP */
 #define POMP_IS_INET(_family) \
 	((_family) == AF_INET || (_family) == AF_INET6)
@@ -80,6 +86,60 @@ enum pomp_ctx_type {
 	POMP_CTX_TYPE_DGRAM,		/**< Connection-less (inet-udp) */
 };
 
+/** Handler registered for a message id */
+struct pomp_msg_handler {
+	/** Message id */
+	uint32_t		msgid;
+
+	/** Function to call */
+	pomp_msg_handler_cb_t	cb;
+
+	/** User data for handler */
+	void			*userdata;
+
+	/** 1 if messages shall be decoded with the compiled format */
+	int			hasfmt;
+
+	/** Compiled format */
+	uint8_t			types[POMP_DECODER_MAX_VALUES];
+
+	/** Number of entries in compiled format */
+	size_t			typecount;
+
+	/** Next handler in the same hash bucket */
+	struct pomp_msg_handler	*next;
+};
+
+/** Slot of the table used to find connections by id */
+struct pomp_conn_slot {
+	/** Connection, NULL if the slot is free */
+	struct pomp_conn	*conn;
+
+	/** Generation, incremented each time the slot is freed */
+	uint32_t		gen;
+
+	/** Index of next free slot if this one is free */
+	uint32_t		nextfree;
+};
+
+/** No free connection slot */
+#define POMP_CONN_SLOT_NONE	UINT32_MAX
+
+/** Send operation queued by another thread */
+struct pomp_async_send {
+	/** Next operation in queue */
+	struct pomp_async_send	*next;
+
+	/** Id of target connection, 0 for all */
+	uint64_t		connid;
+
+	/** Message id (not used for raw context) */
+	uint32_t		msgid;
+
+	/** Buffer to send */
+	struct pomp_buffer	*buf;
+};
+
 /** Client/Server context */
 struct pomp_ctx {
 	/** Type of context */
@@ -113,6 +173,12 @@ struct pomp_ctx {
 	/** Function to call when send operation are completed */
 	pomp_send_cb_t		sendcb;
 
+	/** Function to call with batches of received messages */
+	pomp_batch_cb_t		batchcb;
+
+	/** 1 if POMP_EVENT_BATCH_END shall be notified */
+	int			batch_end_event;
+
 	/** Timer for connection retries */
 	struct pomp_timer	*timer;
 
@@ -131,6 +197,22 @@ struct pomp_ctx {
 	/** Default read buffer len */
 	size_t readbuf_len;
 
+	/** Read budget of connections per loop iteration (0: no limit) */
+	struct {
+		size_t		maxbytes;
+		uint32_t	maxmsgs;
+	} readbudget;
+
+	/** Register connection fds in edge-triggered mode */
+	int			edge;
+
+	/** Event signaled when connections have data left to read in
+	 *  edge-triggered mode */
+	struct pomp_evt		*edge_evt;
+
+	/** 1 if edge_evt is signaled and not yet processed */
+	int			edge_scheduled;
+
 	/** Pre-allocated message for sending operation */
 	struct pomp_msg		*sendmsg;
 
@@ -145,6 +227,55 @@ struct pomp_ctx {
 	/** maximum number of active connections for a server */
 	size_t max_conn_count;
 
+	/** Sorted array of message ids using latest-value conflation */
+	uint32_t		*conflated_ids;
+
+	/** Number of message ids using latest-value conflation */
+	size_t			conflated_count;
+
+	/** Sorted array of message ids accepted by dgram socket filter */
+	uint32_t		*dgram_filter_ids;
+
+	/** Number of message ids accepted by dgram socket filter */
+	size_t			dgram_filter_count;
+
+	/** Capture of messages, NULL if not capturing */
+	struct pomp_capture	*capture;
+
+	/** 1 if broadcasts are filtered by peer subscriptions */
+	int			subscription_filter;
+
+	/** Expiration scheduler of pending calls (created on first call) */
+	struct pomp_rpc_sched	*rpc_sched;
+
+	/** Message handlers indexed by small message ids (allocated on first
+	 *  registration) */
+	struct pomp_msg_handler	**msg_handlers;
+
+	/** Hash table of message handlers for larger message ids (allocated on
+	 *  first registration) */
+	struct pomp_msg_handler	**msg_handlers_hash;
+
+	/** Number of registered message handlers */
+	size_t			msg_handler_count;
+
+	/** Table to find connections by id, indexed by low 32 bits of id */
+	struct pomp_conn_slot	*conn_slots;
+
+	/** Number of slots in table */
+	uint32_t		conn_slot_count;
+
+	/** Index of first free slot, POMP_CONN_SLOT_NONE if none */
+	uint32_t		conn_slot_free;
+
+	/** Send operations queued by other threads, newest first. Producers
+	 *  push with a compare and swap, the loop takes everything at once */
+	struct pomp_async_send	*async_head;
+
+	/** Event signaled when the queue of send operations becomes non
+	 *  empty */
+	struct pomp_evt		*async_evt;
+
 	/** Client/Server specific parameters */
 	union {
 		/** Server specific parameters */
@@ -187,6 +318,136 @@ struct pomp_ctx {
 	} u;
 };
 
+#ifdef POMP_HAVE_SOCKET_FILTER
+
+/** Size of udp header seen by socket filters before the payload */
+#define POMP_SOCKET_FILTER_UDP_HEADER_SIZE	8
+
+/** Maximum number of instructions in a socket filter */
+#define POMP_SOCKET_FILTER_MAX_INSNS	4096
+
+/**
+ * Build a classic BPF program accepting only pomp messages whose id is in
+ * the dgram filter of the context.
+ * @param ctx : context.
+ * @param family : socket address family.
+ * @param prog : program to fill, its filter shall be freed by caller.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int dgram_filter_build(struct pomp_ctx *ctx, int family,
+		struct sock_fprog *prog)
+{
+	struct sock_filter *insns = NULL;
+	uint32_t off = POMP_IS_INET(family) ?
+			POMP_SOCKET_FILTER_UDP_HEADER_SIZE : 0;
+	size_t i = 0, n = 0, max = 0;
+	uint32_t first = 0, last = 0;
+
+	/* Header checks (16) + at most 3 per range + final drop */
+	max = 16 + 3 * ctx->dgram_filter_count + 1;
+	if (max > POMP_SOCKET_FILTER_MAX_INSNS)
+		return -E2BIG;
+	insns = calloc(max, sizeof(*insns));
+	if (insns == NULL)
+		return -ENOMEM;
+
+#define EMIT_STMT(_code, _k) \
+	insns[n++] = (struct sock_filter)BPF_STMT(_code, _k)
+#define EMIT_JUMP(_code, _k, _jt, _jf) \
+	insns[n++] = (struct sock_filter)BPF_JUMP(_code, _k, _jt, _jf)
+
+	/* Check magic (absolute loads are big endian) */
+	EMIT_STMT(BPF_LD | BPF_W | BPF_ABS, off);
+	EMIT_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+			((uint32_t)POMP_PROT_HEADER_MAGIC_0 << 24) |
+			((uint32_t)POMP_PROT_HEADER_MAGIC_1 << 16) |
+			((uint32_t)POMP_PROT_HEADER_MAGIC_2 << 8) |
+			((uint32_t)POMP_PROT_HEADER_MAGIC_3), 1, 0);
+	EMIT_STMT(BPF_RET | BPF_K, 0);
+
+	/* Load little endian message id in A */
+	EMIT_STMT(BPF_LD | BPF_B | BPF_ABS, off + 7);
+	EMIT_STMT(BPF_ALU | BPF_LSH | BPF_K, 8);
+	EMIT_STMT(BPF_MISC | BPF_TAX, 0);
+	EMIT_STMT(BPF_LD | BPF_B | BPF_ABS, off + 6);
+	EMIT_STMT(BPF_ALU | BPF_OR | BPF_X, 0);
+	EMIT_STMT(BPF_ALU | BPF_LSH | BPF_K, 8);
+	EMIT_STMT(BPF_MISC | BPF_TAX, 0);
+	EMIT_STMT(BPF_LD | BPF_B | BPF_ABS, off + 5);
+	EMIT_STMT(BPF_ALU | BPF_OR | BPF_X, 0);
+	EMIT_STMT(BPF_ALU | BPF_LSH | BPF_K, 8);
+	EMIT_STMT(BPF_MISC | BPF_TAX, 0);
+	EMIT_STMT(BPF_LD | BPF_B | BPF_ABS, off + 4);
+	EMIT_STMT(BPF_ALU | BPF_OR | BPF_X, 0);
+
+	/* Accept if in one of the ranges of consecutive ids */
+	i = 0;
+	while (i < ctx->dgram_filter_count) {
+		first = last = ctx->dgram_filter_ids[i++];
+		while (i < ctx->dgram_filter_count
+				&& ctx->dgram_filter_ids[i] == last + 1) {
+			last = ctx->dgram_filter_ids[i++];
+		}
+		if (first == last) {
+			EMIT_JUMP(BPF_JMP | BPF_JEQ | BPF_K, first, 0, 1);
+		} else {
+			EMIT_JUMP(BPF_JMP | BPF_JGE | BPF_K, first, 0, 2);
+			EMIT_JUMP(BPF_JMP | BPF_JGT | BPF_K, last, 1, 0);
+		}
+		EMIT_STMT(BPF_RET | BPF_K, UINT32_MAX);
+	}
+
+	/* Drop everything else */
+	EMIT_STMT(BPF_RET | BPF_K, 0);
+
+#undef EMIT_STMT
+#undef EMIT_JUMP
+
+	prog->len = (unsigned short)n;
+	prog->filter = insns;
+	return 0;
+}
+
+#endif /* POMP_HAVE_SOCKET_FILTER */
+
+/**
+ * Attach (or detach) the message id filter of the context to a dgram socket.
+ * @param ctx : context.
+ * @param fd : dgram socket fd.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int dgram_filter_attach(struct pomp_ctx *ctx, int fd)
+{
+#ifdef POMP_HAVE_SOCKET_FILTER
+	int res = 0;
+	int dummy = 0;
+	struct sock_fprog prog;
+
+	/* Detach any previous filter (error if none is attached) */
+	if (ctx->dgram_filter_ids == NULL) {
+		(void)setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER,
+				&dummy, sizeof(dummy));
+		return 0;
+	}
+
+	memset(&prog, 0, sizeof(prog));
+	res = dgram_filter_build(ctx, ctx->addr->sa_family, &prog);
+	if (res < 0)
+		return res;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER,
+			&prog, sizeof(prog)) < 0) {
+		res = -errno;
+		POMP_LOG_FD_ERRNO("setsockopt.SO_ATTACH_FILTER", fd);
+	}
+
+	free(prog.filter);
+	return res;
+#else /* !POMP_HAVE_SOCKET_FILTER */
+	return ctx->dgram_filter_ids == NULL ? 0 : -ENOSYS;
+#endif /* !POMP_HAVE_SOCKET_FILTER */
+}
+
 /**
  * Setup keep alive for inet socket fd.
  * @param ctx : context.
@@ -794,6 +1055,11 @@ static int dgram_start(struct pomp_ctx *ctx)
 		goto error;
 	}
 
+	/* Attach message id filter before receiving anything */
+	res = dgram_filter_attach(ctx, ctx->u.dgram.fd);
+	if (res < 0)
+		goto error;
+
 	/* Bind to address  */
 	if (bind(ctx->u.dgram.fd, ctx->addr, ctx->addrlen) < 0) {
 		/* Handle case where address do not match an existent
@@ -876,6 +1142,185 @@ static int dgram_stop(struct pomp_ctx *ctx)
 	return 0;
 }
 
+/**
+ * Find a connection of the context by id.
+ * @param ctx : context.
+ * @param id : id of the connection.
+ * @return connection or NULL if not found (or gone).
+ */
+static struct pomp_conn *pomp_ctx_find_conn_by_id(struct pomp_ctx *ctx,
+		uint64_t id)
+{
+	uint32_t idx = (uint32_t)id;
+	uint32_t gen = (uint32_t)(id >> 32);
+
+	if (idx >= ctx->conn_slot_count || ctx->conn_slots[idx].gen != gen)
+		return NULL;
+	return ctx->conn_slots[idx].conn;
+}
+
+#ifdef POMP_HAVE_ASYNC_SEND
+
+/**
+ * Execute a send operation queued by another thread.
+ * @param ctx : context.
+ * @param item : send operation.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_ctx_do_async_send(struct pomp_ctx *ctx,
+		const struct pomp_async_send *item)
+{
+	struct pomp_conn *conn = NULL;
+	struct pomp_msg msg = POMP_MSG_INITIALIZER;
+
+	if (item->connid != 0) {
+		conn = pomp_ctx_find_conn_by_id(ctx, item->connid);
+		if (conn == NULL)
+			return -ENOTCONN;
+	}
+
+	if (ctx->israw) {
+		return conn != NULL ? pomp_conn_send_raw_buf(conn, item->buf) :
+				pomp_ctx_send_raw_buf(ctx, item->buf);
+	}
+
+	/* Wrap buffer in a message without copying it */
+	msg.msgid = item->msgid;
+	msg.finished = 1;
+	msg.buf = item->buf;
+	return conn != NULL ? pomp_conn_send_msg(conn, &msg) :
+			pomp_ctx_send_msg(ctx, &msg);
+}
+
+/**
+ * Take all send operations queued by other threads.
+ * @param ctx : context.
+ * @return list of send operations in queuing order.
+ */
+static struct pomp_async_send *pomp_ctx_take_async(struct pomp_ctx *ctx)
+{
+	struct pomp_async_send *item = NULL;
+	struct pomp_async_send *next = NULL;
+	struct pomp_async_send *list = NULL;
+
+	/* Queue is newest first, reverse it */
+	item = __atomic_exchange_n(&ctx->async_head, NULL, __ATOMIC_ACQUIRE);
+	while (item != NULL) {
+		next = item->next;
+		item->next = list;
+		list = item;
+		item = next;
+	}
+	return list;
+}
+
+/**
+ * Function called when send operations have been queued by other threads.
+ * All pending operations are processed in one batch.
+ * @param evt : event.
+ * @param userdata : context object.
+ */
+static void async_evt_cb(struct pomp_evt *evt, void *userdata)
+{
+	struct pomp_ctx *ctx = userdata;
+	struct pomp_async_send *item = NULL;
+	struct pomp_async_send *next = NULL;
+
+	for (item = pomp_ctx_take_async(ctx); item != NULL; item = next) {
+		next = item->next;
+		(void)pomp_ctx_do_async_send(ctx, item);
+		pomp_buffer_unref(item->buf);
+		free(item);
+	}
+}
+
+/**
+ * Function called when some connections stopped reading before their socket
+ * was empty in edge-triggered mode. The loop will not report their fd again
+ * until new data arrives so reading is resumed here.
+ * @param evt : event.
+ * @param userdata : context object.
+ */
+static void edge_evt_cb(struct pomp_evt *evt, void *userdata)
+{
+	struct pomp_ctx *ctx = userdata;
+	struct pomp_conn *conn = NULL;
+	struct pomp_conn *next = NULL;
+
+	ctx->edge_scheduled = 0;
+	if (ctx->addr == NULL || ctx->stopping)
+		return;
+
+	switch (ctx->type) {
+	case POMP_CTX_TYPE_SERVER:
+		/* Processing may remove the connection, get next first */
+		for (conn = ctx->u.server.conns; conn != NULL; conn = next) {
+			next = pomp_conn_get_next(conn);
+			pomp_conn_process_pending_read(conn);
+		}
+		break;
+
+	case POMP_CTX_TYPE_CLIENT:
+		if (ctx->u.client.conn != NULL)
+			pomp_conn_process_pending_read(ctx->u.client.conn);
+		break;
+
+	case POMP_CTX_TYPE_DGRAM:
+		if (ctx->u.dgram.conn != NULL)
+			pomp_conn_process_pending_read(ctx->u.dgram.conn);
+		break;
+	}
+}
+
+/**
+ * Drop all send operations queued by other threads.
+ * @param ctx : context.
+ */
+static void pomp_ctx_clear_async(struct pomp_ctx *ctx)
+{
+	struct pomp_async_send *item = NULL;
+	struct pomp_async_send *next = NULL;
+
+	for (item = pomp_ctx_take_async(ctx); item != NULL; item = next) {
+		next = item->next;
+		pomp_buffer_unref(item->buf);
+		free(item);
+	}
+}
+
+/**
+ * Queue a send operation from any thread.
+ * @param ctx : context.
+ * @param connid : id of target connection, 0 for all.
+ * @param msgid : message id.
+ * @param buf : buffer to send, a reference is taken.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_ctx_queue_async(struct pomp_ctx *ctx, uint64_t connid,
+		uint32_t msgid, struct pomp_buffer *buf)
+{
+	struct pomp_async_send *item = NULL;
+	struct pomp_async_send *head = NULL;
+
+	item = malloc(sizeof(*item));
+	if (item == NULL)
+		return -ENOMEM;
+	item->connid = connid;
+	item->msgid = msgid;
+	item->buf = buf;
+	pomp_buffer_ref(buf);
+
+	/* Push it, only the first operation of a batch wakes up the loop */
+	head = __atomic_load_n(&ctx->async_head, __ATOMIC_RELAXED);
+	do {
+		item->next = head;
+	} while (!__atomic_compare_exchange_n(&ctx->async_head, &head, item,
+			1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return head == NULL ? pomp_evt_signal(ctx->async_evt) : 0;
+}
+
+#endif /* POMP_HAVE_ASYNC_SEND */
+
 /**
  * Function called when the timer is triggered.
  * @param timer : timer
@@ -913,6 +1358,7 @@ const char *pomp_event_str(enum pomp_event event)
 	case POMP_EVENT_CONNECTED: return "CONNECTED";
 	case POMP_EVENT_DISCONNECTED: return "DISCONNECTED";
 	case POMP_EVENT_MSG: return "MSG";
+	case POMP_EVENT_BATCH_END: return "BATCH_END";
 	default: return "UNKNOWN";
 	}
 }
@@ -991,6 +1437,7 @@ struct pomp_ctx *pomp_ctx_new_with_loop(pomp_event_cb_t cb,
 	ctx->readbuf_len = POMP_CONN_READ_SIZE;
 
 	ctx->max_conn_count = POMP_SERVER_MAX_CONN_COUNT;
+	ctx->conn_slot_free = POMP_CONN_SLOT_NONE;
 
 	/* Pre-allocate a message for sending operation */
 	ctx->sendmsg = pomp_msg_new();
@@ -1002,6 +1449,19 @@ struct pomp_ctx *pomp_ctx_new_with_loop(pomp_event_cb_t cb,
 	if (ctx->timer == NULL)
 		goto error;
 
+#ifdef POMP_HAVE_ASYNC_SEND
+	/* Allocate event for send operations from other threads */
+	ctx->async_evt = pomp_evt_new();
+	if (ctx->async_evt == NULL)
+		goto error;
+	if (pomp_evt_attach_to_loop(ctx->async_evt, ctx->loop,
+			&async_evt_cb, ctx) < 0) {
+		pomp_evt_destroy(ctx->async_evt);
+		ctx->async_evt = NULL;
+		goto error;
+	}
+#endif /* POMP_HAVE_ASYNC_SEND */
+
 	return ctx;
 
 	/* Cleanup in case of error */
@@ -1054,127 +1514,601 @@ int pomp_ctx_set_send_cb(struct pomp_ctx *ctx, pomp_send_cb_t cb)
 /*
  * See documentation in public header.
  */
-int pomp_ctx_setup_keepalive(struct pomp_ctx *ctx, int enable,
-		int idle, int interval, int count)
+int pomp_ctx_set_batch_cb(struct pomp_ctx *ctx, pomp_batch_cb_t cb)
 {
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->addr == NULL, -EBUSY);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
-	ctx->keepalive.enable = enable;
-	ctx->keepalive.idle = idle;
-	ctx->keepalive.interval = interval;
-	ctx->keepalive.count = count;
+	ctx->batchcb = cb;
 	return 0;
 }
 
 /*
  * See documentation in public header.
  */
-POMP_API int pomp_ctx_set_max_conn(struct pomp_ctx *ctx, size_t count)
+int pomp_ctx_set_batch_end_event(struct pomp_ctx *ctx, int enable)
 {
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(count > 0, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->addr == NULL, -EBUSY);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
-
-	ctx->max_conn_count = count;
-
+	ctx->batch_end_event = enable ? 1 : 0;
 	return 0;
 }
 
 /*
  * See documentation in public header.
  */
-int pomp_ctx_destroy(struct pomp_ctx *ctx)
+int pomp_ctx_set_read_budget(struct pomp_ctx *ctx, size_t maxbytes,
+		uint32_t maxmsgs)
 {
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(ctx->addr == NULL, -EBUSY);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
-	if (ctx->sendmsg != NULL)
-		pomp_msg_destroy(ctx->sendmsg);
-	if (ctx->timer != NULL)
-		pomp_timer_destroy(ctx->timer);
-	if (ctx->loop != NULL && !ctx->extloop)
-		pomp_loop_destroy(ctx->loop);
-	free(ctx);
+	ctx->readbudget.maxbytes = maxbytes;
+	ctx->readbudget.maxmsgs = maxmsgs;
 	return 0;
 }
 
-/**
- * Internal start function.
- * @param ctx : context.
- * @param type : context type.
- * @param addr : local address to listen on.
- * @param addrlen : local address size.
- * @return 0 in case of success, negative errno value in case of error.
+/*
+ * See documentation in public header.
  */
-static int pomp_ctx_start(struct pomp_ctx *ctx, enum pomp_ctx_type type,
-		const struct sockaddr *addr, uint32_t addrlen)
+int pomp_ctx_set_edge_triggered(struct pomp_ctx *ctx, int enable)
 {
 	int res = 0;
+
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
-	POMP_RETURN_ERR_IF_FAILED(addr != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(ctx->addr == NULL, -EBUSY);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
 
-	/* Copy address */
-	ctx->addr = malloc(addrlen);
-	if (ctx->addr == NULL)
-		return -ENOMEM;
-	ctx->addrlen = addrlen;
-	memcpy(ctx->addr, addr, addrlen);
-
-	/* Save type */
-	ctx->type = type;
-
-	/* Setup server/client/dgram specific stuff */
-	switch (ctx->type) {
-	case POMP_CTX_TYPE_SERVER:
-		ctx->u.server.fd = -1;
-		ctx->u.server.conns = NULL;
-		ctx->u.server.conncount = 0;
-		memset(&ctx->u.server.local_addr, 0,
-				sizeof(ctx->u.server.local_addr));
-		ctx->u.server.local_addrlen = 0;
-		res = server_start(ctx);
-		break;
-
-	case POMP_CTX_TYPE_CLIENT:
-		ctx->u.client.fd = -1;
-		ctx->u.client.conn = NULL;
-		res = client_start(ctx);
-		break;
-
-	case POMP_CTX_TYPE_DGRAM:
-		ctx->u.dgram.fd = -1;
-		memset(&ctx->u.dgram.local_addr, 0,
-				sizeof(ctx->u.dgram.local_addr));
-		ctx->u.dgram.local_addrlen = 0;
-		res = dgram_start(ctx);
-		break;
+	if (enable && !pomp_loop_has_edge(ctx->loop))
+		return -ENOSYS;
 
-	default:
-		res = -EINVAL;
-		break;
+	/* Allocate event used to resume reads left pending */
+	if (enable && ctx->edge_evt == NULL) {
+		ctx->edge_evt = pomp_evt_new();
+		if (ctx->edge_evt == NULL)
+			return -ENOMEM;
+		res = pomp_evt_attach_to_loop(ctx->edge_evt, ctx->loop,
+				&edge_evt_cb, ctx);
+		if (res < 0) {
+			pomp_evt_destroy(ctx->edge_evt);
+			ctx->edge_evt = NULL;
+			return res;
+		}
 	}
 
-	/* Cleanup address in case of error */
-	if (res < 0) {
-		free(ctx->addr);
-		ctx->addr = NULL;
-		ctx->addrlen = 0;
-	}
-	return res;
+	ctx->edge = enable ? 1 : 0;
+	return 0;
 }
 
 /*
  * See documentation in public header.
  */
-int pomp_ctx_listen(struct pomp_ctx *ctx,
-		const struct sockaddr *addr, uint32_t addrlen)
+int pomp_ctx_setup_keepalive(struct pomp_ctx *ctx, int enable,
+		int idle, int interval, int count)
 {
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
-	ctx->mode = 0;
-	return pomp_ctx_start(ctx, POMP_CTX_TYPE_SERVER, addr, addrlen);
+	ctx->keepalive.enable = enable;
+	ctx->keepalive.idle = idle;
+	ctx->keepalive.interval = interval;
+	ctx->keepalive.count = count;
+	return 0;
+}
+
+/*
+ * See documentation in public header.
+ */
+POMP_API int pomp_ctx_set_max_conn(struct pomp_ctx *ctx, size_t count)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(count > 0, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+	ctx->max_conn_count = count;
+
+	return 0;
+}
+
+/**
+ * Search a message id in the sorted array of conflated message ids.
+ * @param ctx : context.
+ * @param msgid : message id to search.
+ * @param idx : will receive the index of the message id if found, or the
+ * index where it shall be inserted otherwise.
+ * @return 1 if found, 0 otherwise.
+ */
+static int pomp_ctx_find_conflated(const struct pomp_ctx *ctx, uint32_t msgid,
+		size_t *idx)
+{
+	size_t lo = 0, hi = ctx->conflated_count, mid = 0;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (ctx->conflated_ids[mid] == msgid) {
+			*idx = mid;
+			return 1;
+		} else if (ctx->conflated_ids[mid] < msgid) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*idx = lo;
+	return 0;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_set_msg_conflation(struct pomp_ctx *ctx, uint32_t msgid,
+		int enable)
+{
+	size_t idx = 0;
+	uint32_t *ids = NULL;
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+	if (pomp_ctx_find_conflated(ctx, msgid, &idx)) {
+		/* Remove it if needed */
+		if (!enable) {
+			memmove(&ctx->conflated_ids[idx],
+					&ctx->conflated_ids[idx + 1],
+					(ctx->conflated_count - idx - 1) *
+					sizeof(uint32_t));
+			ctx->conflated_count--;
+		}
+		return 0;
+	}
+
+	if (!enable)
+		return 0;
+
+	/* Insert it keeping the array sorted */
+	ids = realloc(ctx->conflated_ids,
+			(ctx->conflated_count + 1) * sizeof(uint32_t));
+	if (ids == NULL)
+		return -ENOMEM;
+	memmove(&ids[idx + 1], &ids[idx],
+			(ctx->conflated_count - idx) * sizeof(uint32_t));
+	ids[idx] = msgid;
+	ctx->conflated_ids = ids;
+	ctx->conflated_count++;
+	return 0;
+}
+
+/**
+ * Return hash table index for given message id.
+ * @param msgid : message id to hash.
+ * @return an index in ctx->msg_handlers_hash[].
+ */
+static inline unsigned int pomp_ctx_index_msgid(uint32_t msgid)
+{
+	uint32_t x = msgid;
+
+	x *= UINT32_C(0xefec2401);
+	x ^= x >> 16;
+
+	return x % POMP_CTX_MSG_HANDLER_HASH_LEN;
+}
+
+/**
+ * Get the location of the handler of a message id.
+ * @param ctx : context.
+ * @param msgid : message id.
+ * @return location where the handler of the message id is stored (or shall
+ * be inserted), NULL if the table for this message id is not allocated.
+ */
+static struct pomp_msg_handler **pomp_ctx_get_msg_handler_slot(
+		struct pomp_ctx *ctx, uint32_t msgid)
+{
+	struct pomp_msg_handler **slot = NULL;
+
+	if (msgid < POMP_CTX_MSG_HANDLER_DENSE_COUNT) {
+		if (ctx->msg_handlers == NULL)
+			return NULL;
+		return &ctx->msg_handlers[msgid];
+	}
+
+	if (ctx->msg_handlers_hash == NULL)
+		return NULL;
+	slot = &ctx->msg_handlers_hash[pomp_ctx_index_msgid(msgid)];
+	while (*slot != NULL && (*slot)->msgid != msgid)
+		slot = &(*slot)->next;
+	return slot;
+}
+
+/**
+ * Free all registered message handlers.
+ * @param ctx : context.
+ */
+static void pomp_ctx_clear_msg_handlers(struct pomp_ctx *ctx)
+{
+	struct pomp_msg_handler *handler = NULL;
+	size_t i = 0;
+
+	if (ctx->msg_handlers != NULL) {
+		for (i = 0; i < POMP_CTX_MSG_HANDLER_DENSE_COUNT; i++)
+			free(ctx->msg_handlers[i]);
+		free(ctx->msg_handlers);
+		ctx->msg_handlers = NULL;
+	}
+
+	if (ctx->msg_handlers_hash != NULL) {
+		for (i = 0; i < POMP_CTX_MSG_HANDLER_HASH_LEN; i++) {
+			while (ctx->msg_handlers_hash[i] != NULL) {
+				handler = ctx->msg_handlers_hash[i];
+				ctx->msg_handlers_hash[i] = handler->next;
+				free(handler);
+			}
+		}
+		free(ctx->msg_handlers_hash);
+		ctx->msg_handlers_hash = NULL;
+	}
+
+	ctx->msg_handler_count = 0;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_register_msg_handler(struct pomp_ctx *ctx, uint32_t msgid,
+		const char *fmt, pomp_msg_handler_cb_t cb, void *userdata)
+{
+	int res = 0;
+	struct pomp_msg_handler *handler = NULL;
+	struct pomp_msg_handler *old = NULL;
+	struct pomp_msg_handler **slot = NULL;
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+	/* Unregister current handler if any */
+	if (cb == NULL) {
+		slot = pomp_ctx_get_msg_handler_slot(ctx, msgid);
+		if (slot != NULL && *slot != NULL) {
+			old = *slot;
+			*slot = old->next;
+			free(old);
+			ctx->msg_handler_count--;
+		}
+		return 0;
+	}
+
+	/* Allocate handler and compile format */
+	handler = calloc(1, sizeof(*handler));
+	if (handler == NULL)
+		return -ENOMEM;
+	handler->msgid = msgid;
+	handler->cb = cb;
+	handler->userdata = userdata;
+	if (fmt != NULL) {
+		res = pomp_decoder_compile_fmt(fmt, handler->types,
+				POMP_DECODER_MAX_VALUES, &handler->typecount);
+		if (res < 0)
+			goto error;
+		handler->hasfmt = 1;
+	}
+
+	/* Allocate table on first registration */
+	if (msgid < POMP_CTX_MSG_HANDLER_DENSE_COUNT
+			&& ctx->msg_handlers == NULL) {
+		ctx->msg_handlers = calloc(POMP_CTX_MSG_HANDLER_DENSE_COUNT,
+				sizeof(*ctx->msg_handlers));
+		if (ctx->msg_handlers == NULL) {
+			res = -ENOMEM;
+			goto error;
+		}
+	} else if (msgid >= POMP_CTX_MSG_HANDLER_DENSE_COUNT
+			&& ctx->msg_handlers_hash == NULL) {
+		ctx->msg_handlers_hash = calloc(POMP_CTX_MSG_HANDLER_HASH_LEN,
+				sizeof(*ctx->msg_handlers_hash));
+		if (ctx->msg_handlers_hash == NULL) {
+			res = -ENOMEM;
+			goto error;
+		}
+	}
+
+	/* Insert it, replacing current handler if any */
+	slot = pomp_ctx_get_msg_handler_slot(ctx, msgid);
+	old = *slot;
+	if (old != NULL) {
+		handler->next = old->next;
+		free(old);
+	} else {
+		ctx->msg_handler_count++;
+	}
+	*slot = handler;
+	return 0;
+
+error:
+	free(handler);
+	return res;
+}
+
+/**
+ * Compare 2 message ids for qsort.
+ */
+static int msgid_cmp(const void *a, const void *b)
+{
+	uint32_t ida = *(const uint32_t *)a;
+	uint32_t idb = *(const uint32_t *)b;
+	return ida < idb ? -1 : (ida > idb ? 1 : 0);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_set_dgram_msgid_filter(struct pomp_ctx *ctx,
+		const uint32_t *msgids, size_t count)
+{
+	int res = 0;
+	uint32_t *ids = NULL;
+	size_t i = 0, n = 0;
+	uint32_t *oldids = NULL;
+	size_t oldcount = 0;
+
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(msgids != NULL || count == 0, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+#ifndef POMP_HAVE_SOCKET_FILTER
+	if (count != 0)
+		return -ENOSYS;
+#endif /* !POMP_HAVE_SOCKET_FILTER */
+
+	/* Keep a sorted copy without duplicates */
+	if (count != 0) {
+		ids = malloc(count * sizeof(*ids));
+		if (ids == NULL)
+			return -ENOMEM;
+		memcpy(ids, msgids, count * sizeof(*ids));
+		qsort(ids, count, sizeof(*ids), &msgid_cmp);
+		for (i = 0; i < count; i++) {
+			if (n == 0 || ids[n - 1] != ids[i])
+				ids[n++] = ids[i];
+		}
+	}
+
+	oldids = ctx->dgram_filter_ids;
+	oldcount = ctx->dgram_filter_count;
+	ctx->dgram_filter_ids = ids;
+	ctx->dgram_filter_count = n;
+
+	/* Apply now if already bound, otherwise it will be done when bound */
+	if (ctx->addr != NULL && ctx->type == POMP_CTX_TYPE_DGRAM
+			&& ctx->u.dgram.conn != NULL) {
+		res = dgram_filter_attach(ctx,
+				pomp_conn_get_fd(ctx->u.dgram.conn));
+		if (res < 0) {
+			/* Restore previous filter */
+			ctx->dgram_filter_ids = oldids;
+			ctx->dgram_filter_count = oldcount;
+			free(ids);
+			return res;
+		}
+	}
+
+	free(oldids);
+	return 0;
+}
+
+#ifdef POMP_HAVE_CAPTURE
+
+/**
+ * Set the capture of all current connections of the context.
+ * @param ctx : context.
+ * @param capture : capture, NULL to stop recording.
+ */
+static void pomp_ctx_set_conns_capture(struct pomp_ctx *ctx,
+		struct pomp_capture *capture)
+{
+	struct pomp_conn *conn = NULL;
+
+	if (ctx->addr == NULL)
+		return;
+
+	switch (ctx->type) {
+	case POMP_CTX_TYPE_SERVER:
+		conn = ctx->u.server.conns;
+		while (conn != NULL) {
+			pomp_conn_set_capture(conn, capture);
+			conn = pomp_conn_get_next(conn);
+		}
+		break;
+
+	case POMP_CTX_TYPE_CLIENT:
+		if (ctx->u.client.conn != NULL)
+			pomp_conn_set_capture(ctx->u.client.conn, capture);
+		break;
+
+	case POMP_CTX_TYPE_DGRAM:
+		if (ctx->u.dgram.conn != NULL)
+			pomp_conn_set_capture(ctx->u.dgram.conn, capture);
+		break;
+	}
+}
+
+#endif /* POMP_HAVE_CAPTURE */
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_start_capture(struct pomp_ctx *ctx, const char *path,
+		size_t ringsize)
+{
+#ifdef POMP_HAVE_CAPTURE
+	int res = 0;
+#endif /* POMP_HAVE_CAPTURE */
+
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(path != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->capture == NULL, -EBUSY);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+#ifdef POMP_HAVE_CAPTURE
+	res = pomp_capture_new(path, ringsize, &ctx->capture);
+	if (res < 0)
+		return res;
+	pomp_ctx_set_conns_capture(ctx, ctx->capture);
+	return 0;
+#else /* !POMP_HAVE_CAPTURE */
+	return -ENOSYS;
+#endif /* !POMP_HAVE_CAPTURE */
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_stop_capture(struct pomp_ctx *ctx)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->capture != NULL, -ENOENT);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+#ifdef POMP_HAVE_CAPTURE
+	pomp_ctx_set_conns_capture(ctx, NULL);
+	pomp_capture_destroy(ctx->capture);
+	ctx->capture = NULL;
+	return 0;
+#else /* !POMP_HAVE_CAPTURE */
+	return -ENOSYS;
+#endif /* !POMP_HAVE_CAPTURE */
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_set_subscription_filter(struct pomp_ctx *ctx, int enable)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+	ctx->subscription_filter = enable ? 1 : 0;
+	return 0;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_destroy(struct pomp_ctx *ctx)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->addr == NULL, -EBUSY);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+	free(ctx->conflated_ids);
+	free(ctx->dgram_filter_ids);
+	pomp_ctx_clear_msg_handlers(ctx);
+#ifdef POMP_HAVE_CAPTURE
+	if (ctx->capture != NULL)
+		pomp_capture_destroy(ctx->capture);
+#endif /* POMP_HAVE_CAPTURE */
+	if (ctx->rpc_sched != NULL)
+		pomp_rpc_sched_destroy(ctx->rpc_sched);
+	if (ctx->sendmsg != NULL)
+		pomp_msg_destroy(ctx->sendmsg);
+	if (ctx->timer != NULL)
+		pomp_timer_destroy(ctx->timer);
+	if (ctx->edge_evt != NULL) {
+		pomp_evt_detach_from_loop(ctx->edge_evt, ctx->loop);
+		pomp_evt_destroy(ctx->edge_evt);
+	}
+#ifdef POMP_HAVE_ASYNC_SEND
+	if (ctx->async_evt != NULL) {
+		pomp_evt_detach_from_loop(ctx->async_evt, ctx->loop);
+		pomp_evt_destroy(ctx->async_evt);
+	}
+	pomp_ctx_clear_async(ctx);
+#endif /* POMP_HAVE_ASYNC_SEND */
+	free(ctx->conn_slots);
+	if (ctx->loop != NULL && !ctx->extloop)
+		pomp_loop_destroy(ctx->loop);
+	free(ctx);
+	return 0;
+}
+
+/**
+ * Internal start function.
+ * @param ctx : context.
+ * @param type : context type.
+ * @param addr : local address to listen on.
+ * @param addrlen : local address size.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_ctx_start(struct pomp_ctx *ctx, enum pomp_ctx_type type,
+		const struct sockaddr *addr, uint32_t addrlen)
+{
+	int res = 0;
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(addr != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->addr == NULL, -EBUSY);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+	/* Copy address */
+	ctx->addr = malloc(addrlen);
+	if (ctx->addr == NULL)
+		return -ENOMEM;
+	ctx->addrlen = addrlen;
+	memcpy(ctx->addr, addr, addrlen);
+
+	/* Save type */
+	ctx->type = type;
+
+	/* Setup server/client/dgram specific stuff */
+	switch (ctx->type) {
+	case POMP_CTX_TYPE_SERVER:
+		ctx->u.server.fd = -1;
+		ctx->u.server.conns = NULL;
+		ctx->u.server.conncount = 0;
+		memset(&ctx->u.server.local_addr, 0,
+				sizeof(ctx->u.server.local_addr));
+		ctx->u.server.local_addrlen = 0;
+		res = server_start(ctx);
+		break;
+
+	case POMP_CTX_TYPE_CLIENT:
+		ctx->u.client.fd = -1;
+		ctx->u.client.conn = NULL;
+		res = client_start(ctx);
+		break;
+
+	case POMP_CTX_TYPE_DGRAM:
+		ctx->u.dgram.fd = -1;
+		memset(&ctx->u.dgram.local_addr, 0,
+				sizeof(ctx->u.dgram.local_addr));
+		ctx->u.dgram.local_addrlen = 0;
+		res = dgram_start(ctx);
+		break;
+
+	default:
+		res = -EINVAL;
+		break;
+	}
+
+	/* Cleanup address in case of error */
+	if (res < 0) {
+		free(ctx->addr);
+		ctx->addr = NULL;
+		ctx->addrlen = 0;
+	}
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_listen(struct pomp_ctx *ctx,
+		const struct sockaddr *addr, uint32_t addrlen)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+	ctx->mode = 0;
+	return pomp_ctx_start(ctx, POMP_CTX_TYPE_SERVER, addr, addrlen);
 }
 
 /*
@@ -1294,6 +2228,62 @@ int pomp_ctx_wait_and_process(struct pomp_ctx *ctx, int timeout)
 	return pomp_loop_wait_and_process(ctx->loop, timeout);
 }
 
+/*
+ * See documentation in public header.
+ * Thread safe.
+ */
+int pomp_ctx_send_msg_async(struct pomp_ctx *ctx, uint64_t connid,
+		const struct pomp_msg *msg)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(msg->finished, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!ctx->israw, -EINVAL);
+#ifdef POMP_HAVE_ASYNC_SEND
+	return pomp_ctx_queue_async(ctx, connid, msg->msgid, msg->buf);
+#else /* !POMP_HAVE_ASYNC_SEND */
+	return -ENOSYS;
+#endif /* !POMP_HAVE_ASYNC_SEND */
+}
+
+/*
+ * See documentation in public header.
+ * Thread safe.
+ */
+int pomp_ctx_send_async(struct pomp_ctx *ctx, uint64_t connid,
+		uint32_t msgid, const char *fmt, ...)
+{
+	int res = 0;
+	va_list args;
+	struct pomp_msg msg = POMP_MSG_INITIALIZER;
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+
+	va_start(args, fmt);
+	res = pomp_msg_writev(&msg, msgid, fmt, args);
+	va_end(args);
+	if (res == 0)
+		res = pomp_ctx_send_msg_async(ctx, connid, &msg);
+	pomp_msg_clear(&msg);
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ * Thread safe.
+ */
+int pomp_ctx_send_raw_buf_async(struct pomp_ctx *ctx, uint64_t connid,
+		struct pomp_buffer *buf)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->israw, -EINVAL);
+#ifdef POMP_HAVE_ASYNC_SEND
+	return pomp_ctx_queue_async(ctx, connid, 0, buf);
+#else /* !POMP_HAVE_ASYNC_SEND */
+	return -ENOSYS;
+#endif /* !POMP_HAVE_ASYNC_SEND */
+}
+
 /*
  * See documentation in public header.
  * Thread safe.
@@ -1364,20 +2354,35 @@ const struct sockaddr *pomp_ctx_get_local_addr(struct pomp_ctx *ctx,
  * See documentation in public header.
  */
 int pomp_ctx_send_msg(struct pomp_ctx *ctx, const struct pomp_msg *msg)
+{
+	return pomp_ctx_send_msg_prio(ctx, msg, POMP_SEND_PRIO_NORMAL);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_send_msg_prio(struct pomp_ctx *ctx, const struct pomp_msg *msg,
+		enum pomp_send_prio prio)
 {
 	int res = 0;
 	struct pomp_conn *conn = NULL;
 
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED((uint32_t)prio < POMP_SEND_PRIO_COUNT,
+			-EINVAL);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
 
 	switch (ctx->type) {
 	case POMP_CTX_TYPE_SERVER:
-		/* Broadcast to all connections, ignore errors */
+		/* Broadcast to all interested connections, ignore errors */
 		conn = ctx->u.server.conns;
 		while (conn != NULL) {
-			(void)pomp_conn_send_msg(conn, msg);
+			if (!ctx->subscription_filter ||
+					pomp_conn_is_subscribed(conn,
+						msg->msgid)) {
+				(void)pomp_conn_send_msg_prio(conn, msg, prio);
+			}
 			conn = pomp_conn_get_next(conn);
 		}
 		break;
@@ -1385,7 +2390,8 @@ int pomp_ctx_send_msg(struct pomp_ctx *ctx, const struct pomp_msg *msg)
 	case POMP_CTX_TYPE_CLIENT:
 		/* Send if connected */
 		if (ctx->u.client.conn != NULL)
-			res = pomp_conn_send_msg(ctx->u.client.conn, msg);
+			res = pomp_conn_send_msg_prio(ctx->u.client.conn,
+					msg, prio);
 		else
 			res = -ENOTCONN;
 		break;
@@ -1451,6 +2457,15 @@ int pomp_ctx_sendv(struct pomp_ctx *ctx, uint32_t msgid,
  * See documentation in public header.
  */
 int pomp_ctx_send_raw_buf(struct pomp_ctx *ctx, struct pomp_buffer *buf)
+{
+	return pomp_ctx_send_raw_buf_prio(ctx, buf, POMP_SEND_PRIO_NORMAL);
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_ctx_send_raw_buf_prio(struct pomp_ctx *ctx, struct pomp_buffer *buf,
+		enum pomp_send_prio prio)
 {
 	int res = 0;
 	struct pomp_conn *conn = NULL;
@@ -1458,6 +2473,8 @@ int pomp_ctx_send_raw_buf(struct pomp_ctx *ctx, struct pomp_buffer *buf)
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(ctx->israw, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED((uint32_t)prio < POMP_SEND_PRIO_COUNT,
+			-EINVAL);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
 
 	switch (ctx->type) {
@@ -1465,7 +2482,7 @@ int pomp_ctx_send_raw_buf(struct pomp_ctx *ctx, struct pomp_buffer *buf)
 		/* Broadcast to all connections, ignore errors */
 		conn = ctx->u.server.conns;
 		while (conn != NULL) {
-			(void)pomp_conn_send_raw_buf(conn, buf);
+			(void)pomp_conn_send_raw_buf_prio(conn, buf, prio);
 			conn = pomp_conn_get_next(conn);
 		}
 		break;
@@ -1473,7 +2490,8 @@ int pomp_ctx_send_raw_buf(struct pomp_ctx *ctx, struct pomp_buffer *buf)
 	case POMP_CTX_TYPE_CLIENT:
 		/* Send if connected */
 		if (ctx->u.client.conn != NULL)
-			res = pomp_conn_send_raw_buf(ctx->u.client.conn, buf);
+			res = pomp_conn_send_raw_buf_prio(ctx->u.client.conn,
+					buf, prio);
 		else
 			res = -ENOTCONN;
 		break;
@@ -1516,6 +2534,76 @@ int pomp_ctx_set_read_buffer_len(struct pomp_ctx *ctx,
 	return 0;
 }
 
+/**
+ * Give an id to a new connection of the context.
+ * @param ctx : context.
+ * @param conn : connection.
+ * @param id : will receive the id of the connection.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_ctx_add_conn_id(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		uint64_t *id)
+{
+	uint32_t idx = 0, count = 0;
+	struct pomp_conn_slot *slots = NULL;
+
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(id != NULL, -EINVAL);
+
+	/* Grow the table if no slot is free, new slots are chained in the
+	 * list of free slots */
+	if (ctx->conn_slot_free == POMP_CONN_SLOT_NONE) {
+		count = ctx->conn_slot_count == 0 ? 8 :
+				ctx->conn_slot_count * 2;
+		slots = realloc(ctx->conn_slots, count * sizeof(*slots));
+		if (slots == NULL)
+			return -ENOMEM;
+		memset(&slots[ctx->conn_slot_count], 0,
+				(count - ctx->conn_slot_count) *
+				sizeof(*slots));
+		for (idx = ctx->conn_slot_count; idx < count; idx++) {
+			slots[idx].gen = 1;
+			slots[idx].nextfree = idx + 1 < count ?
+					idx + 1 : POMP_CONN_SLOT_NONE;
+		}
+		ctx->conn_slot_free = ctx->conn_slot_count;
+		ctx->conn_slots = slots;
+		ctx->conn_slot_count = count;
+	}
+
+	/* Take the first free slot */
+	idx = ctx->conn_slot_free;
+	ctx->conn_slot_free = ctx->conn_slots[idx].nextfree;
+	ctx->conn_slots[idx].conn = conn;
+	*id = ((uint64_t)ctx->conn_slots[idx].gen << 32) | idx;
+	return 0;
+}
+
+/**
+ * Release the id of a connection of the context.
+ * @param ctx : context.
+ * @param id : id of the connection.
+ */
+void pomp_ctx_remove_conn_id(struct pomp_ctx *ctx, uint64_t id)
+{
+	struct pomp_conn_slot *slot = NULL;
+
+	if (ctx == NULL || pomp_ctx_find_conn_by_id(ctx, id) == NULL)
+		return;
+
+	/* Bump generation so the id is never valid again (0 is skipped) */
+	slot = &ctx->conn_slots[(uint32_t)id];
+	slot->conn = NULL;
+	slot->gen++;
+	if (slot->gen == 0)
+		slot->gen = 1;
+
+	/* Put it back in the list of free slots */
+	slot->nextfree = ctx->conn_slot_free;
+	ctx->conn_slot_free = (uint32_t)id;
+}
+
 /**
  * Remove a connection from the context.
  * @param ctx : context.
@@ -1616,21 +2704,80 @@ int pomp_ctx_notify_event(struct pomp_ctx *ctx, enum pomp_event event,
 	return 0;
 }
 
+/**
+ * Call a registered message handler.
+ * @param ctx : context.
+ * @param conn : connection on which the message has been received.
+ * @param msg : message to notify.
+ * @param handler : handler registered for the message id.
+ * @return 0 in case of success, negative errno value if the message could not
+ * be decoded with the format of the handler.
+ */
+static int pomp_ctx_notify_msg_handler(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		const struct pomp_msg_handler *handler)
+{
+	int res = 0;
+	struct pomp_decoder dec = POMP_DECODER_INITIALIZER;
+	union pomp_value argv[POMP_DECODER_MAX_VALUES];
+	uint32_t argc = 0;
+	pomp_msg_handler_cb_t cb = handler->cb;
+	void *userdata = handler->userdata;
+
+	/* Decode before calling, the handler may be unregistered by the call */
+	if (handler->hasfmt) {
+		res = pomp_decoder_init(&dec, msg);
+		if (res == 0) {
+			res = pomp_decoder_read_values(&dec, handler->types,
+					handler->typecount, argv);
+		}
+		pomp_decoder_clear(&dec);
+		if (res < 0) {
+			POMP_LOGW("ctx %p: msgid %u does not match format",
+					ctx, msg->msgid);
+			return res;
+		}
+		argc = (uint32_t)handler->typecount;
+	}
+
+	ctx->notifying++;
+	(*cb)(ctx, conn, msg, handler->hasfmt ? argv : NULL, argc, userdata);
+	ctx->notifying--;
+	return 0;
+}
+
 /**
  * Notify a message event.
  * @param ctx : context.
  * @param conn : connection on which the message has been received.
  * @param msg : message to notify.
- * @return 0 in case of success, negative errno value in case of error.
+ * @return 0 in case of success, 1 if the message shall be kept by the caller
+ * and given later with pomp_ctx_notify_batch, negative errno value in case of
+ * error.
  */
 int pomp_ctx_notify_msg(struct pomp_ctx *ctx, struct pomp_conn *conn,
 		const struct pomp_msg *msg)
 {
+	struct pomp_msg_handler **slot = NULL;
 	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(ctx->loop);
 
+	/* Give it to the registered handler if any */
+	if (ctx->msg_handler_count > 0) {
+		slot = pomp_ctx_get_msg_handler_slot(ctx, msg->msgid);
+		if (slot != NULL && *slot != NULL
+				&& pomp_ctx_notify_msg_handler(ctx, conn, msg,
+						*slot) == 0) {
+			return 0;
+		}
+	}
+
+	/* Delay it if batches are requested */
+	if (ctx->batchcb != NULL)
+		return 1;
+
 	if (ctx->eventcb != NULL) {
 		ctx->notifying++;
 		(*ctx->eventcb)(ctx, POMP_EVENT_MSG, conn, msg, ctx->userdata);
@@ -1640,6 +2787,36 @@ int pomp_ctx_notify_msg(struct pomp_ctx *ctx, struct pomp_conn *conn,
 	return 0;
 }
 
+/**
+ * Notify the end of a batch of received messages.
+ * @param ctx : context.
+ * @param conn : connection on which the messages have been received.
+ * @param msgs : messages kept for the batch callback.
+ * @param count : number of messages kept (can be 0 if all messages have
+ * already been notified individually).
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_ctx_notify_batch(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		const struct pomp_msg *const *msgs, size_t count)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(count == 0 || msgs != NULL, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+	ctx->notifying++;
+	if (count > 0 && ctx->batchcb != NULL) {
+		(*ctx->batchcb)(ctx, conn, msgs, (uint32_t)count,
+				ctx->userdata);
+	}
+	if (ctx->batch_end_event && ctx->eventcb != NULL) {
+		(*ctx->eventcb)(ctx, POMP_EVENT_BATCH_END, conn, NULL,
+				ctx->userdata);
+	}
+	ctx->notifying--;
+	return 0;
+}
+
 /**
  * Notify a raw buffer read.
  * @param ctx : context.
@@ -1697,3 +2874,132 @@ int pomp_ctx_sendcb_is_set(struct pomp_ctx *ctx)
 
 	return (ctx->sendcb != NULL) ? 1 : 0;
 }
+
+/**
+ * Determine if latest-value conflation is enabled for a message id.
+ * @param ctx : context.
+ * @param msgid : message id.
+ * @return 1 if enabled, 0 otherwise.
+ */
+int pomp_ctx_is_msg_conflated(struct pomp_ctx *ctx, uint32_t msgid)
+{
+	size_t idx = 0;
+	POMP_RETURN_VAL_IF_FAILED(ctx != NULL, -EINVAL, 0);
+
+	if (ctx->conflated_count == 0)
+		return 0;
+	return pomp_ctx_find_conflated(ctx, msgid, &idx);
+}
+
+/**
+ * Determine if broadcasts are filtered by peer subscriptions.
+ * @param ctx : context.
+ * @return 1 if enabled, 0 otherwise.
+ */
+int pomp_ctx_subscription_filter_is_enabled(struct pomp_ctx *ctx)
+{
+	POMP_RETURN_VAL_IF_FAILED(ctx != NULL, -EINVAL, 0);
+	return ctx->subscription_filter;
+}
+
+/**
+ * Get the capture of the context.
+ * @param ctx : context.
+ * @return capture or NULL if not capturing.
+ */
+struct pomp_capture *pomp_ctx_get_capture(struct pomp_ctx *ctx)
+{
+	POMP_RETURN_VAL_IF_FAILED(ctx != NULL, -EINVAL, NULL);
+	return ctx->capture;
+}
+
+/**
+ * Get the read budget of connections of the context.
+ * @param ctx : context.
+ * @param maxbytes : maximum number of bytes read per iteration (0: no limit).
+ * @param maxmsgs : maximum number of messages per iteration (0: no limit).
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_ctx_get_read_budget(struct pomp_ctx *ctx, size_t *maxbytes,
+		uint32_t *maxmsgs)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(maxbytes != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(maxmsgs != NULL, -EINVAL);
+	*maxbytes = ctx->readbudget.maxbytes;
+	*maxmsgs = ctx->readbudget.maxmsgs;
+	return 0;
+}
+
+/**
+ * Determine if connection fds are registered in edge-triggered mode.
+ * @param ctx : context.
+ * @return 1 if enabled, 0 otherwise.
+ */
+int pomp_ctx_is_edge_triggered(struct pomp_ctx *ctx)
+{
+	POMP_RETURN_VAL_IF_FAILED(ctx != NULL, -EINVAL, 0);
+	return ctx->edge;
+}
+
+/**
+ * Request a call to pomp_conn_process_pending_read on connections of the
+ * context at next loop iteration.
+ * @param ctx : context.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_ctx_schedule_read(struct pomp_ctx *ctx)
+{
+	int res = 0;
+
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(ctx->edge_evt != NULL, -EINVAL);
+
+	/* Only one signal needed until processed */
+	if (ctx->edge_scheduled)
+		return 0;
+
+	res = pomp_evt_signal(ctx->edge_evt);
+	if (res == 0)
+		ctx->edge_scheduled = 1;
+	return res;
+}
+
+/**
+ * Get the expiration scheduler of pending calls, create it if needed.
+ * @param ctx : context.
+ * @return scheduler or NULL in case of error.
+ */
+struct pomp_rpc_sched *pomp_ctx_get_rpc_sched(struct pomp_ctx *ctx)
+{
+	POMP_RETURN_VAL_IF_FAILED(ctx != NULL, -EINVAL, NULL);
+
+	if (ctx->rpc_sched == NULL)
+		ctx->rpc_sched = pomp_rpc_sched_new(ctx->loop);
+	return ctx->rpc_sched;
+}
+
+/**
+ * Notify completion of a call.
+ * @param ctx : context.
+ * @param conn : connection on which the call was issued.
+ * @param cb : completion callback of the call.
+ * @param status : completion status.
+ * @param msg : reply message (NULL if status is not OK).
+ * @param userdata : callback user data.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_ctx_notify_rpc(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		pomp_rpc_cb_t cb, enum pomp_rpc_status status,
+		const struct pomp_msg *msg, void *userdata)
+{
+	POMP_RETURN_ERR_IF_FAILED(ctx != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(conn != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
+	POMP_LOOP_CHECK_OWNER(ctx->loop);
+
+	ctx->notifying++;
+	(*cb)(conn, status, msg, userdata);
+	ctx->notifying--;
+	return 0;
+}
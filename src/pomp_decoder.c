@@ -77,6 +77,11 @@ int pomp_decoder_init(struct pomp_decoder *dec, const struct pomp_msg *msg)
 {
 	POMP_RETURN_ERR_IF_FAILED(dec != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
+
+	/* Referenced buffers are only gathered when writing to a socket */
+	if (msg->buf != NULL && msg->buf->segcount > 0)
+		return -ENOTSUP;
+
 	dec->msg = msg;
 	dec->pos = POMP_PROT_HEADER_SIZE;
 	return 0;
@@ -210,6 +215,144 @@ static int decoder_read_size_u32(struct pomp_decoder *dec, uint32_t *n)
 	return res;
 }
 
+/**
+ * Parse the next format specifier of a format string.
+ * @param fmt : format string, updated to point after the specifier.
+ * @param type : will receive the protocol data type of the argument. For
+ * '%p%u', POMP_PROT_DATA_TYPE_BUF is given for both specifiers.
+ * @param flags : will receive the flags of the specifier (FLAG_XXX).
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int decoder_parse_fmt(const char **fmt, uint8_t *type, int *flags)
+{
+	const char *f = *fmt;
+	char c = 0;
+
+	/* Only formatting spec expected here */
+	c = *f++;
+	if (c != '%') {
+		POMP_LOGW("decoder : invalid format char (%c)", c);
+		return -EINVAL;
+	}
+	*flags = 0;
+
+again:
+	c = *f++;
+	switch (c) {
+	case 'l':
+		if (*f == 'l') {
+			f++;
+			*flags |= FLAG_LL;
+		} else {
+			*flags |= FLAG_L;
+		}
+		goto again;
+
+	case 'h':
+		if (*f == 'h') {
+			f++;
+			*flags |= FLAG_HH;
+		} else {
+			*flags |= FLAG_H;
+		}
+		goto again;
+
+	case 'm':
+		*flags |= FLAG_M;
+		goto again;
+
+#ifdef _WIN32
+	case 'I':
+		if (*f == '6' && *(f + 1) == '4') {
+			f += 2;
+			*flags |= FLAG_LL;
+			goto again;
+		}
+		POMP_LOGW("decoder : invalid format specifier (%c)", c);
+		return -EINVAL;
+#endif /* _WIN32 */
+
+	/* Signed integer */
+	case 'i': /* NO BREAK */
+	case 'd':
+		if (*flags & FLAG_LL)
+			*type = POMP_PROT_DATA_TYPE_I64;
+#if defined(__WORDSIZE) && (__WORDSIZE == 64)
+		else if (*flags & FLAG_L)
+			*type = POMP_PROT_DATA_TYPE_I64;
+#endif
+		else if (*flags & FLAG_HH)
+			*type = POMP_PROT_DATA_TYPE_I8;
+		else if (*flags & FLAG_H)
+			*type = POMP_PROT_DATA_TYPE_I16;
+		else
+			*type = POMP_PROT_DATA_TYPE_I32;
+		break;
+
+	/* Unsigned integer */
+	case 'u':
+		if (*flags & FLAG_LL)
+			*type = POMP_PROT_DATA_TYPE_U64;
+#if defined(__WORDSIZE) && (__WORDSIZE == 64)
+		else if (*flags & FLAG_L)
+			*type = POMP_PROT_DATA_TYPE_U64;
+#endif
+		else if (*flags & FLAG_HH)
+			*type = POMP_PROT_DATA_TYPE_U8;
+		else if (*flags & FLAG_H)
+			*type = POMP_PROT_DATA_TYPE_U16;
+		else
+			*type = POMP_PROT_DATA_TYPE_U32;
+		break;
+
+	/* String */
+	case 's':
+		*type = POMP_PROT_DATA_TYPE_STR;
+		break;
+
+	/* Buffer */
+	case 'p':
+		/* Size expected after pointer */
+		if (*f++ != '%' || *f++ != 'u') {
+			POMP_LOGW("decoder : expected %%u after %%p");
+			return -EINVAL;
+		}
+		*type = POMP_PROT_DATA_TYPE_BUF;
+		break;
+
+	/* Floating point */
+	case 'f': /* NO BREAK */
+	case 'F': /* NO BREAK */
+	case 'e': /* NO BREAK */
+	case 'E': /* NO BREAK */
+	case 'g': /* NO BREAK */
+	case 'G':
+		if (*flags & (FLAG_LL | FLAG_H | FLAG_HH)) {
+			POMP_LOGW("decoder : unsupported format width");
+			return -EINVAL;
+		}
+		*type = (*flags & FLAG_L) ? POMP_PROT_DATA_TYPE_F64 :
+				POMP_PROT_DATA_TYPE_F32;
+		break;
+
+	/* File descriptor (hack) */
+	case 'x':
+		if (*flags & (FLAG_LL | FLAG_L | FLAG_H | FLAG_HH)) {
+			POMP_LOGW("decoder : unsupported format width");
+			return -EINVAL;
+		}
+		*type = POMP_PROT_DATA_TYPE_FD;
+		break;
+
+	default:
+		POMP_LOGW("decoder : invalid format specifier (%c)", c);
+		return -EINVAL;
+	}
+
+	*fmt = f;
+	return 0;
+}
+
 /*
  * See documentation in public header.
  */
@@ -230,7 +373,7 @@ int pomp_decoder_readv(struct pomp_decoder *dec, const char *fmt, va_list args)
 {
 	int res = 0;
 	int flags = 0;
-	char c = 0;
+	uint8_t type = 0;
 	uint32_t len = 0;
 	union pomp_value v;
 	char **strsav[MAX_DECODE_STR];
@@ -244,129 +387,83 @@ int pomp_decoder_readv(struct pomp_decoder *dec, const char *fmt, va_list args)
 
 	memset(strsav, 0, sizeof(strsav));
 	while (*fmt != '\0') {
-		/* Only formatting spec expected here */
-		c = *fmt++;
-		if (c != '%') {
-			POMP_LOGW("decoder : invalid format char (%c)", c);
-			res = -EINVAL;
+		res = decoder_parse_fmt(&fmt, &type, &flags);
+		if (res < 0)
 			goto error;
-		}
-		flags = 0;
-
-again:
-		c = *fmt++;
-		switch (c) {
-		case 'l':
-			if (*fmt == 'l') {
-				fmt++;
-				flags |= FLAG_LL;
-			} else {
-				flags |= FLAG_L;
-			}
-			goto again;
 
-		case 'h':
-			if (*fmt == 'h') {
-				fmt++;
-				flags |= FLAG_HH;
-			} else {
-				flags |= FLAG_H;
-			}
-			goto again;
+		switch (type) {
+		/* Signed integer */
+		case POMP_PROT_DATA_TYPE_I8:
+			res = pomp_decoder_read_i8(dec, &v.i8);
+			if (res < 0)
+				goto error;
+			*va_arg(args, signed char *) = v.i8;
+			break;
 
-		case 'm':
-			flags |= FLAG_M;
-			goto again;
+		case POMP_PROT_DATA_TYPE_I16:
+			res = pomp_decoder_read_i16(dec, &v.i16);
+			if (res < 0)
+				goto error;
+			*va_arg(args, signed short *) = v.i16;
+			break;
 
-#ifdef _WIN32
-		case 'I':
-			if (*fmt == '6' && *(fmt + 1) == '4') {
-				fmt += 2;
-				flags |= FLAG_LL;
-				goto again;
-			}
-			POMP_LOGW("decoder : invalid format specifier (%c)", c);
-			res = -EINVAL;
+		case POMP_PROT_DATA_TYPE_I32:
+			res = pomp_decoder_read_i32(dec, &v.i32);
+			if (res < 0)
+				goto error;
+			if (flags & FLAG_L)
+				*va_arg(args, signed long int *) = v.i32;
+			else
+				*va_arg(args, signed int *) = v.i32;
 			break;
-#endif /* _WIN32 */
 
-		/* Signed integer */
-		case 'i': /* NO BREAK */
-		case 'd':
-			if (flags & FLAG_LL) {
-				res = pomp_decoder_read_i64(dec, &v.i64);
-				if (res < 0)
-					goto error;
+		case POMP_PROT_DATA_TYPE_I64:
+			res = pomp_decoder_read_i64(dec, &v.i64);
+			if (res < 0)
+				goto error;
+			if (flags & FLAG_LL)
 				*va_arg(args, signed long long int *) = v.i64;
-			} else if (flags & FLAG_L) {
-#if defined(__WORDSIZE) && (__WORDSIZE == 64)
-				res = pomp_decoder_read_i64(dec, &v.i64);
-				if (res < 0)
-					goto error;
+			else
 				*va_arg(args, signed long int *) = v.i64;
-#else
-				res = pomp_decoder_read_i32(dec, &v.i32);
-				if (res < 0)
-					goto error;
-				*va_arg(args, signed long int *) = v.i32;
-#endif
-			} else if (flags & FLAG_HH) {
-				res = pomp_decoder_read_i8(dec, &v.i8);
-				if (res < 0)
-					goto error;
-				*va_arg(args, signed char *) = v.i8;
-			} else if (flags & FLAG_H) {
-				res = pomp_decoder_read_i16(dec, &v.i16);
-				if (res < 0)
-					goto error;
-				*va_arg(args, signed short *) = v.i16;
-			} else {
-				res = pomp_decoder_read_i32(dec, &v.i32);
-				if (res < 0)
-					goto error;
-				*va_arg(args, signed int *) = v.i32;
-			}
 			break;
 
 		/* Unsigned integer */
-		case 'u':
-			if (flags & FLAG_LL) {
-				res = pomp_decoder_read_u64(dec, &v.u64);
-				if (res < 0)
-					goto error;
-				*va_arg(args, unsigned long long int *) = v.u64;
-			} else if (flags & FLAG_L) {
-#if defined(__WORDSIZE) && (__WORDSIZE == 64)
-				res = pomp_decoder_read_u64(dec, &v.u64);
-				if (res < 0)
-					goto error;
-				*va_arg(args, unsigned long int *) = v.u64;
-#else
-				res = pomp_decoder_read_u32(dec, &v.u32);
-				if (res < 0)
-					goto error;
+		case POMP_PROT_DATA_TYPE_U8:
+			res = pomp_decoder_read_u8(dec, &v.u8);
+			if (res < 0)
+				goto error;
+			*va_arg(args, unsigned char *) = v.u8;
+			break;
+
+		case POMP_PROT_DATA_TYPE_U16:
+			res = pomp_decoder_read_u16(dec, &v.u16);
+			if (res < 0)
+				goto error;
+			*va_arg(args, unsigned short *) = v.u16;
+			break;
+
+		case POMP_PROT_DATA_TYPE_U32:
+			res = pomp_decoder_read_u32(dec, &v.u32);
+			if (res < 0)
+				goto error;
+			if (flags & FLAG_L)
 				*va_arg(args, unsigned long int *) = v.u32;
-#endif
-			} else if (flags & FLAG_HH) {
-				res = pomp_decoder_read_u8(dec, &v.u8);
-				if (res < 0)
-					goto error;
-				*va_arg(args, unsigned char *) = v.u8;
-			} else if (flags & FLAG_H) {
-				res = pomp_decoder_read_u16(dec, &v.u16);
-				if (res < 0)
-					goto error;
-				*va_arg(args, unsigned short *) = v.u16;
-			} else {
-				res = pomp_decoder_read_u32(dec, &v.u32);
-				if (res < 0)
-					goto error;
+			else
 				*va_arg(args, unsigned int *) = v.u32;
-			}
+			break;
+
+		case POMP_PROT_DATA_TYPE_U64:
+			res = pomp_decoder_read_u64(dec, &v.u64);
+			if (res < 0)
+				goto error;
+			if (flags & FLAG_LL)
+				*va_arg(args, unsigned long long int *) = v.u64;
+			else
+				*va_arg(args, unsigned long int *) = v.u64;
 			break;
 
 		/* String */
-		case 's':
+		case POMP_PROT_DATA_TYPE_STR:
 			if (!(flags & FLAG_M)) {
 				/* Only dynamically allocated string allowed */
 				POMP_LOGW("decoder : use %%ms instead of %%s");
@@ -390,62 +487,38 @@ again:
 			break;
 
 		/* Buffer */
-		case 'p':
-			/* Size expected after pointer */
-			if (*fmt++ != '%' || *fmt++ != 'u') {
-				POMP_LOGW("decoder : expected %%u after %%p");
-				res = -EINVAL;
+		case POMP_PROT_DATA_TYPE_BUF:
+			res = pomp_decoder_read_cbuf(dec, &v.cbuf, &len);
+			if (res < 0)
 				goto error;
-			} else {
-				/* codecheck_ignore[LONG_LINE] */
-				res = pomp_decoder_read_cbuf(dec, &v.cbuf, &len);
-				if (res < 0)
-					goto error;
-				*va_arg(args, const void **) = v.cbuf;
-				*va_arg(args, unsigned int *) = len;
-			}
+			*va_arg(args, const void **) = v.cbuf;
+			*va_arg(args, unsigned int *) = len;
 			break;
 
 		/* Floating point */
-		case 'f': /* NO BREAK */
-		case 'F': /* NO BREAK */
-		case 'e': /* NO BREAK */
-		case 'E': /* NO BREAK */
-		case 'g': /* NO BREAK */
-		case 'G':
-			if (flags & (FLAG_LL | FLAG_H | FLAG_HH)) {
-				POMP_LOGW("decoder : unsupported format width");
-				res = -EINVAL;
+		case POMP_PROT_DATA_TYPE_F32:
+			res = pomp_decoder_read_f32(dec, &v.f32);
+			if (res < 0)
 				goto error;
-			} else if (flags & FLAG_L) {
-				res = pomp_decoder_read_f64(dec, &v.f64);
-				if (res < 0)
-					goto error;
-				*va_arg(args, double *) = v.f64;
-			} else {
-				res = pomp_decoder_read_f32(dec, &v.f32);
-				if (res < 0)
-					goto error;
-				*va_arg(args, float *) = v.f32;
-			}
+			*va_arg(args, float *) = v.f32;
+			break;
+
+		case POMP_PROT_DATA_TYPE_F64:
+			res = pomp_decoder_read_f64(dec, &v.f64);
+			if (res < 0)
+				goto error;
+			*va_arg(args, double *) = v.f64;
 			break;
 
 		/* File descriptor (hack) */
-		case 'x':
-			if (flags & (FLAG_LL | FLAG_L | FLAG_H | FLAG_HH)) {
-				POMP_LOGW("decoder : unsupported format width");
-				res = -EINVAL;
+		case POMP_PROT_DATA_TYPE_FD:
+			res = pomp_decoder_read_fd(dec, &v.fd);
+			if (res < 0)
 				goto error;
-			} else {
-				res = pomp_decoder_read_fd(dec, &v.fd);
-				if (res < 0)
-					goto error;
-				*va_arg(args, int *) = v.fd;
-			}
+			*va_arg(args, int *) = v.fd;
 			break;
 
 		default:
-			POMP_LOGW("decoder : invalid format specifier (%c)", c);
 			res = -EINVAL;
 			goto error;
 		}
@@ -725,6 +798,104 @@ int pomp_decoder_adump(struct pomp_decoder *dec, char **dst)
 	return res;
 }
 
+/**
+ * Decode next argument, whatever its type.
+ * @param dec : decoder.
+ * @param type : type of decoded argument.
+ * @param v : decoded value.
+ * @param buflen : buffer length for buffer argument, 0 otherwise.
+ * @param checkfds : 1 to check that file descriptors are correctly registered
+ * in buffer, 0 to simply skip them (value set to -1).
+ * @return 1 if an argument has been decoded, 0 if there is no more argument,
+ * negative errno value in case of error.
+ */
+static int decoder_next(struct pomp_decoder *dec, uint8_t *type,
+		union pomp_value *v, uint32_t *buflen, int checkfds)
+{
+	int res = 0;
+	uint8_t skipped[sizeof(uint8_t) + sizeof(int32_t)];
+
+	if (dec->pos >= dec->msg->buf->len)
+		return 0;
+
+	/* Read type */
+	res = pomp_buffer_readb(dec->msg->buf, &dec->pos, type);
+	if (res < 0)
+		return res;
+
+	/* Rewind for further decoding */
+	dec->pos -= sizeof(uint8_t);
+	memset(v, 0, sizeof(*v));
+	*buflen = 0;
+	switch (*type) {
+	case POMP_PROT_DATA_TYPE_I8:
+		res = pomp_decoder_read_i8(dec, &v->i8);
+		break;
+
+	case POMP_PROT_DATA_TYPE_U8:
+		res = pomp_decoder_read_u8(dec, &v->u8);
+		break;
+
+	case POMP_PROT_DATA_TYPE_I16:
+		res = pomp_decoder_read_i16(dec, &v->i16);
+		break;
+
+	case POMP_PROT_DATA_TYPE_U16:
+		res = pomp_decoder_read_u16(dec, &v->u16);
+		break;
+
+	case POMP_PROT_DATA_TYPE_I32:
+		res = pomp_decoder_read_i32(dec, &v->i32);
+		break;
+
+	case POMP_PROT_DATA_TYPE_U32:
+		res = pomp_decoder_read_u32(dec, &v->u32);
+		break;
+
+	case POMP_PROT_DATA_TYPE_I64:
+		res = pomp_decoder_read_i64(dec, &v->i64);
+		break;
+
+	case POMP_PROT_DATA_TYPE_U64:
+		res = pomp_decoder_read_u64(dec, &v->u64);
+		break;
+
+	case POMP_PROT_DATA_TYPE_STR:
+		res = pomp_decoder_read_cstr(dec, &v->cstr);
+		break;
+
+	case POMP_PROT_DATA_TYPE_BUF:
+		res = pomp_decoder_read_cbuf(dec, &v->cbuf, buflen);
+		break;
+
+	case POMP_PROT_DATA_TYPE_F32:
+		res = pomp_decoder_read_f32(dec, &v->f32);
+		break;
+
+	case POMP_PROT_DATA_TYPE_F64:
+		res = pomp_decoder_read_f64(dec, &v->f64);
+		break;
+
+	case POMP_PROT_DATA_TYPE_FD:
+		if (checkfds) {
+			res = pomp_decoder_read_fd(dec, &v->fd);
+		} else {
+			/* Skip type and data */
+			res = pomp_buffer_read(dec->msg->buf, &dec->pos,
+					skipped, sizeof(skipped));
+			v->fd = -1;
+		}
+		break;
+
+	default:
+		POMP_LOGW("decoder : unknown type: %d", *type);
+		res = -EINVAL;
+		break;
+	}
+
+	return res < 0 ? res : 1;
+}
+
 /**
  * Walk the internal buffer and call given callback for each argument found.
  * @param dec : decoder.
@@ -742,7 +913,6 @@ int pomp_decoder_walk(struct pomp_decoder *dec,
 	int res = 0;
 	uint8_t type = 0;
 	uint32_t buflen = 0;
-	uint8_t skipped[sizeof(uint8_t) + sizeof(int32_t)];
 	union pomp_value v;
 
 	POMP_RETURN_ERR_IF_FAILED(dec != NULL, -EINVAL);
@@ -750,93 +920,123 @@ int pomp_decoder_walk(struct pomp_decoder *dec,
 	POMP_RETURN_ERR_IF_FAILED(dec->msg->buf != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
 
-	/* Process message arguments */
-	while (res == 0 && dec->pos < dec->msg->buf->len) {
-		/* Read type */
-		res = pomp_buffer_readb(dec->msg->buf, &dec->pos, &type);
-		if (res < 0)
-			goto out;
-
-		/* Rewind for further decoding */
-		dec->pos -= sizeof(uint8_t);
-		memset(&v, 0, sizeof(v));
-		buflen = 0;
-		switch (type) {
-		case POMP_PROT_DATA_TYPE_I8:
-			res = pomp_decoder_read_i8(dec, &v.i8);
-			break;
-
-		case POMP_PROT_DATA_TYPE_U8:
-			res = pomp_decoder_read_u8(dec, &v.u8);
-			break;
-
-		case POMP_PROT_DATA_TYPE_I16:
-			res = pomp_decoder_read_i16(dec, &v.i16);
-			break;
-
-		case POMP_PROT_DATA_TYPE_U16:
-			res = pomp_decoder_read_u16(dec, &v.u16);
-			break;
-
-		case POMP_PROT_DATA_TYPE_I32:
-			res = pomp_decoder_read_i32(dec, &v.i32);
-			break;
+	/* Process message arguments, stop if user callback returns 0 */
+	do {
+		res = decoder_next(dec, &type, &v, &buflen, checkfds);
+	} while (res > 0 && (*cb)(dec, type, &v, buflen, userdata) != 0);
 
-		case POMP_PROT_DATA_TYPE_U32:
-			res = pomp_decoder_read_u32(dec, &v.u32);
-			break;
+	return res < 0 ? res : 0;
+}
 
-		case POMP_PROT_DATA_TYPE_I64:
-			res = pomp_decoder_read_i64(dec, &v.i64);
-			break;
+/**
+ * Compile a format string into the sequence of argument types it expects, so
+ * that messages can later be decoded without parsing the format again.
+ * @param fmt : format string (same syntax as pomp_decoder_read, '%s' is
+ * accepted as well as '%ms').
+ * @param types : array that will receive one entry per format specifier.
+ * The size following a buffer is given POMP_DECODER_TYPE_BUFLEN.
+ * @param maxcount : maximum number of entries in types.
+ * @param count : number of entries written in types.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_decoder_compile_fmt(const char *fmt, uint8_t *types,
+		size_t maxcount, size_t *count)
+{
+	int res = 0;
+	int flags = 0;
+	uint8_t type = 0;
+	size_t n = 0;
 
-		case POMP_PROT_DATA_TYPE_U64:
-			res = pomp_decoder_read_u64(dec, &v.u64);
-			break;
+	POMP_RETURN_ERR_IF_FAILED(fmt != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(types != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(count != NULL, -EINVAL);
 
-		case POMP_PROT_DATA_TYPE_STR:
-			res = pomp_decoder_read_cstr(dec, &v.cstr);
-			break;
+	while (*fmt != '\0') {
+		res = decoder_parse_fmt(&fmt, &type, &flags);
+		if (res < 0)
+			return res;
 
-		case POMP_PROT_DATA_TYPE_BUF:
-			res = pomp_decoder_read_cbuf(dec, &v.cbuf, &buflen);
-			break;
+		/* The size of a buffer has its own entry */
+		if (n + (type == POMP_PROT_DATA_TYPE_BUF ? 2 : 1) > maxcount) {
+			POMP_LOGW("decoder : too many arguments");
+			return -E2BIG;
+		}
+		types[n++] = type;
+		if (type == POMP_PROT_DATA_TYPE_BUF)
+			types[n++] = POMP_DECODER_TYPE_BUFLEN;
+	}
 
-		case POMP_PROT_DATA_TYPE_F32:
-			res = pomp_decoder_read_f32(dec, &v.f32);
-			break;
+	*count = n;
+	return 0;
+}
 
-		case POMP_PROT_DATA_TYPE_F64:
-			res = pomp_decoder_read_f64(dec, &v.f64);
-			break;
+/**
+ * Decode arguments according to a compiled format.
+ * @param dec : decoder.
+ * @param types : argument types given by pomp_decoder_compile_fmt.
+ * @param count : number of argument types.
+ * @param argv : array of 'count' values to fill. Strings and buffers point
+ * inside the message, file descriptors are still owned by the message.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_decoder_read_values(struct pomp_decoder *dec, const uint8_t *types,
+		size_t count, union pomp_value *argv)
+{
+	int res = 0;
+	uint8_t type = 0;
+	uint32_t buflen = 0;
+	size_t i = 0;
 
-		case POMP_PROT_DATA_TYPE_FD:
-			if (checkfds) {
-				res = pomp_decoder_read_fd(dec, &v.fd);
-			} else {
-				/* Skip type and data */
-				res = pomp_buffer_read(dec->msg->buf,
-						&dec->pos, skipped,
-						sizeof(skipped));
-				v.fd = -1;
-			}
-			break;
+	POMP_RETURN_ERR_IF_FAILED(dec != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(dec->msg != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(dec->msg->buf != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(count == 0 || types != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(count == 0 || argv != NULL, -EINVAL);
+
+	for (i = 0; i < count; i++) {
+		/* Size of previous buffer, nothing to decode */
+		if (types[i] == POMP_DECODER_TYPE_BUFLEN) {
+			memset(&argv[i], 0, sizeof(argv[i]));
+			argv[i].u32 = buflen;
+			continue;
+		}
 
-		default:
-			POMP_LOGW("decoder : unknown type: %d", type);
-			res = -EINVAL;
-			break;
+		res = decoder_next(dec, &type, &argv[i], &buflen, 1);
+		if (res == 0) {
+			POMP_LOGW("decoder : no more data");
+			return -EINVAL;
+		} else if (res < 0) {
+			return res;
+		} else if (type != types[i]) {
+			POMP_LOGW("decoder : type mismatch %d(%d)",
+					type, types[i]);
+			return -EINVAL;
 		}
+	}
 
-		if (res < 0)
-			goto out;
+	return 0;
+}
 
-		/* Call user callback, stop it it returns 0 */
-		if ((*cb)(dec, type, &v, buflen, userdata) == 0)
-			goto out;
-	}
+/*
+ * See documentation in public header.
+ */
+int pomp_decoder_next(struct pomp_decoder *dec, enum pomp_arg_type *type,
+		union pomp_value *v, uint32_t *buflen)
+{
+	int res = 0;
+	uint8_t t = 0;
+	uint32_t len = 0;
 
-out:
+	POMP_RETURN_ERR_IF_FAILED(dec != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(dec->msg != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(dec->msg->buf != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(type != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(v != NULL, -EINVAL);
+
+	res = decoder_next(dec, &t, v, &len, 1);
+	*type = (enum pomp_arg_type)t;
+	if (buflen != NULL)
+		*buflen = len;
 	return res;
 }
 
@@ -226,6 +226,165 @@ static int parse_buffer_argv(const char *decodepos, uint32_t len, void *out)
 	return 0;
 }
 
+/**
+ * Get the number of bytes needed to encode an integer as a varint.
+ * @param v : value to encode.
+ * @return number of bytes.
+ */
+static size_t varint_size(uint64_t v)
+{
+	size_t n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+/**
+ * Compute the exact size of arguments encoded with a format string, without
+ * writing them.
+ * @param fmt : format string.
+ * @param args : arguments (consumed).
+ * @return size of encoded arguments, 0 if the format string or an argument
+ * is invalid (the error is reported by the actual write).
+ */
+static size_t encoder_get_size(const char *fmt, va_list args)
+{
+	size_t size = 0;
+	int flags = 0;
+	char c = 0;
+	int32_t i32 = 0;
+	int64_t i64 = 0;
+	const char *str = NULL;
+	size_t len = 0;
+
+	while (*fmt != '\0') {
+		if (*fmt++ != '%')
+			return 0;
+		flags = 0;
+
+again:
+		c = *fmt++;
+		switch (c) {
+		case 'l':
+			if (*fmt == 'l') {
+				fmt++;
+				flags |= FLAG_LL;
+			} else {
+				flags |= FLAG_L;
+			}
+			goto again;
+
+		case 'h':
+			if (*fmt == 'h') {
+				fmt++;
+				flags |= FLAG_HH;
+			} else {
+				flags |= FLAG_H;
+			}
+			goto again;
+
+#ifdef _WIN32
+		case 'I':
+			if (*fmt != '6' || *(fmt + 1) != '4')
+				return 0;
+			fmt += 2;
+			flags |= FLAG_LL;
+			goto again;
+#endif /* _WIN32 */
+
+		/* Signed integer: fixed size or zigzag varint */
+		case 'i': /* NO BREAK */
+		case 'd':
+			if (flags & FLAG_LL) {
+				i64 = va_arg(args, signed long long int);
+				size += 1 + varint_size(
+					(uint64_t)((i64 << 1) ^ (i64 >> 63)));
+			} else if (flags & FLAG_L) {
+#if defined(__WORDSIZE) && (__WORDSIZE == 64)
+				i64 = va_arg(args, signed long int);
+				size += 1 + varint_size(
+					(uint64_t)((i64 << 1) ^ (i64 >> 63)));
+#else
+				i32 = va_arg(args, signed long int);
+				size += 1 + varint_size(
+					(uint32_t)((i32 << 1) ^ (i32 >> 31)));
+#endif
+			} else if (flags & (FLAG_HH | FLAG_H)) {
+				(void)va_arg(args, signed int);
+				size += (flags & FLAG_HH) ? 2 : 3;
+			} else {
+				i32 = va_arg(args, signed int);
+				size += 1 + varint_size(
+					(uint32_t)((i32 << 1) ^ (i32 >> 31)));
+			}
+			break;
+
+		/* Unsigned integer: fixed size or varint */
+		case 'u':
+			if (flags & FLAG_LL) {
+				size += 1 + varint_size(
+					va_arg(args, unsigned long long int));
+			} else if (flags & FLAG_L) {
+				size += 1 + varint_size(
+					va_arg(args, unsigned long int));
+			} else if (flags & (FLAG_HH | FLAG_H)) {
+				(void)va_arg(args, unsigned int);
+				size += (flags & FLAG_HH) ? 2 : 3;
+			} else {
+				size += 1 + varint_size(
+					va_arg(args, unsigned int));
+			}
+			break;
+
+		/* String: type, size, data with null byte */
+		case 's':
+			str = va_arg(args, const char *);
+			if (str == NULL)
+				return 0;
+			len = strlen(str) + 1;
+			size += 1 + varint_size(len) + len;
+			break;
+
+		/* Buffer: type, size, data */
+		case 'p':
+			if (*fmt++ != '%' || *fmt++ != 'u')
+				return 0;
+			(void)va_arg(args, const void *);
+			len = va_arg(args, unsigned int);
+			size += 1 + varint_size(len) + len;
+			break;
+
+		/* Floating point (float is promoted to double) */
+		case 'f': /* NO BREAK */
+		case 'F': /* NO BREAK */
+		case 'e': /* NO BREAK */
+		case 'E': /* NO BREAK */
+		case 'g': /* NO BREAK */
+		case 'G':
+			if (flags & (FLAG_LL | FLAG_H | FLAG_HH))
+				return 0;
+			(void)va_arg(args, double);
+			size += (flags & FLAG_L) ? 9 : 5;
+			break;
+
+		/* File descriptor */
+		case 'x':
+			if (flags != 0)
+				return 0;
+			(void)va_arg(args, int);
+			size += 5;
+			break;
+
+		default:
+			return 0;
+		}
+	}
+
+	return size;
+}
+
 /**
  * Internal write
  * @param enc : encoder.
@@ -244,6 +403,8 @@ static int encoder_writev_internal(struct pomp_encoder *enc, const char *fmt,
 	uint32_t len = 0;
 	int argidx = 0;
 	union pomp_value v;
+	size_t size = 0;
+	va_list argscopy;
 
 	POMP_RETURN_ERR_IF_FAILED(enc != NULL, -EINVAL);
 
@@ -251,6 +412,19 @@ static int encoder_writev_internal(struct pomp_encoder *enc, const char *fmt,
 	if (fmt == NULL)
 		return 0;
 
+	/* Reserve room for all arguments at once */
+	if (argv == NULL && enc->msg != NULL && !enc->msg->finished) {
+		va_copy(argscopy, args);
+		size = encoder_get_size(fmt, argscopy);
+		va_end(argscopy);
+		if (size != 0) {
+			res = pomp_buffer_ensure_capacity(enc->msg->buf,
+					enc->pos + size);
+			if (res < 0)
+				return res;
+		}
+	}
+
 	while (res == 0 && *fmt != '\0') {
 		/* Only formatting spec expected here */
 		c = *fmt++;
@@ -670,6 +844,44 @@ int pomp_encoder_write_buf(struct pomp_encoder *enc, const void *v, uint32_t n)
 	return pomp_buffer_write(enc->msg->buf, &enc->pos, v, n);
 }
 
+/*
+ * See documentation in public header.
+ */
+int pomp_encoder_write_buf_ref(struct pomp_encoder *enc,
+		struct pomp_buffer *buf)
+{
+	int res = 0;
+
+	POMP_RETURN_ERR_IF_FAILED(enc != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(enc->msg != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!enc->msg->finished, -EPERM);
+	POMP_RETURN_ERR_IF_FAILED(buf != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(buf->len <= UINT32_MAX, -EINVAL);
+
+#ifdef _WIN32
+	/* No gathered write available, simply copy data */
+	res = pomp_encoder_write_buf(enc, buf->data, (uint32_t)buf->len);
+	return res;
+#else /* !_WIN32 */
+	/* Buffer can only be referenced when appending */
+	POMP_RETURN_ERR_IF_FAILED(enc->pos == enc->msg->buf->len, -EINVAL);
+
+	/* Write type */
+	res = pomp_buffer_writeb(enc->msg->buf, &enc->pos,
+			POMP_PROT_DATA_TYPE_BUF);
+	if (res < 0)
+		return res;
+
+	/* Write length */
+	res = encoder_write_size_u32(enc, (uint32_t)buf->len);
+	if (res < 0)
+		return res;
+
+	/* Reference data */
+	return pomp_buffer_add_seg(enc->msg->buf, buf);
+#endif /* !_WIN32 */
+}
+
 /*
  * See documentation in public header.
  */
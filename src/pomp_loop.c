@@ -126,6 +126,92 @@ static intptr_t pomp_loop_do_get_fd(struct pomp_loop *loop)
 	return (*s_pomp_loop_ops->do_get_fd)(loop);
 }
 
+#ifdef POMP_HAVE_LOOP_INVOKE
+
+/**
+ * Signal the completion of an invoke entry. Entries with a blocked caller
+ * live on the caller stack and shall not be accessed once marked as done.
+ * Other entries are freed.
+ * @param entry : invoke entry.
+ * @param status : completion status.
+ */
+static void pomp_invoke_entry_complete(struct pomp_invoke_entry *entry,
+		int status)
+{
+	if (!entry->wait) {
+		free(entry);
+		return;
+	}
+
+	entry->status = status;
+#ifdef POMP_HAVE_FUTEX
+	__atomic_store_n(&entry->done, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &entry->done, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else /* !POMP_HAVE_FUTEX */
+	pthread_mutex_lock(&entry->mutex);
+	entry->done = 1;
+	pthread_cond_signal(&entry->cond);
+	pthread_mutex_unlock(&entry->mutex);
+#endif /* !POMP_HAVE_FUTEX */
+}
+
+/**
+ * Wait for the completion of an invoke entry.
+ * @param entry : invoke entry.
+ * @return completion status of the entry.
+ */
+static int pomp_invoke_entry_wait(struct pomp_invoke_entry *entry)
+{
+#ifdef POMP_HAVE_FUTEX
+	while (!__atomic_load_n(&entry->done, __ATOMIC_ACQUIRE)) {
+		syscall(SYS_futex, &entry->done, FUTEX_WAIT_PRIVATE, 0,
+				NULL, NULL, 0);
+	}
+#else /* !POMP_HAVE_FUTEX */
+	pthread_mutex_lock(&entry->mutex);
+	while (!entry->done)
+		pthread_cond_wait(&entry->cond, &entry->mutex);
+	pthread_mutex_unlock(&entry->mutex);
+	pthread_cond_destroy(&entry->cond);
+	pthread_mutex_destroy(&entry->mutex);
+#endif /* !POMP_HAVE_FUTEX */
+	return entry->status;
+}
+
+/**
+ * Process pending invocations of the loop.
+ * @param loop : loop.
+ * @param status : 0 to call the functions, negative errno value to cancel
+ * them with this status.
+ */
+static void pomp_loop_invoke_process(struct pomp_loop *loop, int status)
+{
+	struct pomp_invoke_entry *entry = NULL, *next = NULL, *list = NULL;
+
+	/* Fast path, nothing queued */
+	if (__atomic_load_n(&loop->invoke_head, __ATOMIC_RELAXED) == NULL)
+		return;
+
+	/* Take the whole queue and restore the submission order */
+	entry = __atomic_exchange_n(&loop->invoke_head, NULL,
+			__ATOMIC_ACQUIRE);
+	while (entry != NULL) {
+		next = entry->next;
+		entry->next = list;
+		list = entry;
+		entry = next;
+	}
+
+	for (entry = list; entry != NULL; entry = next) {
+		next = entry->next;
+		if (status == 0)
+			(*entry->cb)(entry->userdata);
+		pomp_invoke_entry_complete(entry, status);
+	}
+}
+
+#endif /* POMP_HAVE_LOOP_INVOKE */
+
 /**
  * Implementation specific 'wait_and_process' operation.
  * @param loop : loop.
@@ -147,6 +233,11 @@ static int pomp_loop_do_wait_and_process(struct pomp_loop *loop, int timeout)
 
 	res = (*s_pomp_loop_ops->do_wait_and_process)(loop, timeout);
 
+#ifdef POMP_HAVE_LOOP_INVOKE
+	/* Run functions queued by other threads */
+	pomp_loop_invoke_process(loop, 0);
+#endif /* POMP_HAVE_LOOP_INVOKE */
+
 	/* Restore ownership to creator */
 	loop->owner.current = loop->owner.creator;
 
@@ -395,6 +486,11 @@ int pomp_loop_destroy(struct pomp_loop *loop)
 	if (res < 0)
 		return res;
 
+#ifdef POMP_HAVE_LOOP_INVOKE
+	/* Release callers of functions that will never be called */
+	pomp_loop_invoke_process(loop, -ECANCELED);
+#endif /* POMP_HAVE_LOOP_INVOKE */
+
 	pthread_mutex_destroy(&loop->lock);
 	pomp_watchdog_clear(&loop->watchdog);
 	pomp_loop_sync_clear(&loop->sync);
@@ -424,6 +520,10 @@ int pomp_loop_add(struct pomp_loop *loop, int fd, uint32_t events,
 	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
 	POMP_LOOP_CHECK_OWNER(loop);
 
+	/* Edge-triggered notifications are implementation specific */
+	if ((events & POMP_FD_EVENT_EDGE) && !pomp_loop_has_edge(loop))
+		return -ENOSYS;
+
 	/* Make sure fd is not already registered */
 	pfd = pomp_loop_find_pfd(loop, fd);
 	if (pfd != NULL) {
@@ -851,6 +951,75 @@ int pomp_loop_unlock(struct pomp_loop *loop)
 	return pomp_loop_sync_unlock(&loop->sync);
 }
 
+/*
+ * See documentation in public header.
+ * Thread safe.
+ */
+int pomp_loop_invoke(struct pomp_loop *loop, pomp_invoke_cb_t cb,
+		void *userdata, int wait)
+{
+#ifdef POMP_HAVE_LOOP_INVOKE
+	int res = 0;
+	struct pomp_invoke_entry *entry = NULL;
+	struct pomp_invoke_entry local;
+	struct pomp_invoke_entry *head = NULL;
+	POMP_RETURN_ERR_IF_FAILED(loop != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(!loop->is_destroying, -EPERM);
+
+	/* Waiting on ourself would dead lock, call directly */
+	if (wait && pthread_equal(loop->owner.current, pthread_self())) {
+		(*cb)(userdata);
+		return 0;
+	}
+
+	/* A blocked caller can keep the entry on its stack */
+	if (wait) {
+		entry = &local;
+		memset(entry, 0, sizeof(*entry));
+#ifndef POMP_HAVE_FUTEX
+		pthread_mutex_init(&entry->mutex, NULL);
+		pthread_cond_init(&entry->cond, NULL);
+#endif /* !POMP_HAVE_FUTEX */
+	} else {
+		entry = calloc(1, sizeof(*entry));
+		if (entry == NULL)
+			return -ENOMEM;
+	}
+	entry->cb = cb;
+	entry->userdata = userdata;
+	entry->wait = wait ? 1 : 0;
+
+	/* Push the entry, only the first one needs to wake up the loop */
+	head = __atomic_load_n(&loop->invoke_head, __ATOMIC_RELAXED);
+	do {
+		entry->next = head;
+	} while (!__atomic_compare_exchange_n(&loop->invoke_head, &head, entry,
+			1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	if (head == NULL) {
+		res = pomp_loop_do_wakeup(loop);
+		if (res < 0)
+			POMP_LOGE("pomp_loop_wakeup err=%d(%s)",
+					-res, strerror(-res));
+	}
+
+	return wait ? pomp_invoke_entry_wait(entry) : 0;
+#else /* !POMP_HAVE_LOOP_INVOKE */
+	return -ENOSYS;
+#endif /* !POMP_HAVE_LOOP_INVOKE */
+}
+
+/**
+ * Check if the loop implementation supports edge-triggered notifications.
+ * @param loop : loop.
+ * @return 1 if POMP_FD_EVENT_EDGE can be used, 0 otherwise.
+ */
+int pomp_loop_has_edge(struct pomp_loop *loop)
+{
+	POMP_RETURN_VAL_IF_FAILED(loop != NULL, -EINVAL, 0);
+	return s_pomp_loop_ops->has_edge;
+}
+
 void pomp_loop_check_owner(struct pomp_loop *loop, const char *caller)
 {
 	POMP_RETURN_IF_FAILED(loop != NULL, -EINVAL);
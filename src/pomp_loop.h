@@ -39,6 +39,12 @@
 #define POMP_LOOP_CHECK_OWNER(loop) \
 	pomp_loop_check_owner(loop, __func__)
 
+/**
+ * Private fd event flag requesting edge-triggered notifications. Only
+ * available if the implementation sets 'has_edge' in its operations.
+ */
+#define POMP_FD_EVENT_EDGE	0x100
+
 /** Idle entry */
 struct pomp_idle_entry {
 	pomp_idle_cb_t		cb;		/**< Registered callback */
@@ -47,6 +53,20 @@ struct pomp_idle_entry {
 	struct pomp_list_node	node;		/**< Entry in list */
 };
 
+/** Invoke entry */
+struct pomp_invoke_entry {
+	pomp_invoke_cb_t	cb;		/**< Function to call */
+	void			*userdata;	/**< Callback user data */
+	int			wait;		/**< 1 if caller is blocked */
+	int			done;		/**< Completion flag */
+	int			status;		/**< Completion status */
+#ifndef POMP_HAVE_FUTEX
+	pthread_mutex_t		mutex;		/**< Completion lock */
+	pthread_cond_t		cond;		/**< Completion condition */
+#endif /* !POMP_HAVE_FUTEX */
+	struct pomp_invoke_entry *next;	/**< Next entry in queue */
+};
+
 /** Fd structure */
 struct pomp_fd {
 	intptr_t		fd;		/**< Associated fd (or ptr) */
@@ -79,6 +99,9 @@ struct pomp_loop {
 
 	struct pomp_loop_sync	sync;		/**< Thread synchronization */
 
+	/** Pending invocations (lock-free stack, most recent first) */
+	struct pomp_invoke_entry	*invoke_head;
+
 	struct {
 		/* Thread that created the loop */
 		pthread_t	creator;
@@ -142,6 +165,9 @@ struct pomp_loop_ops {
 
 	/** Implementation specific 'wakeup' operation. */
 	int (*do_wakeup)(struct pomp_loop *loop);
+
+	/** 1 if implementation supports POMP_FD_EVENT_EDGE. */
+	int has_edge;
 };
 
 /** Loop operations for 'poll' implementation */
@@ -170,6 +196,8 @@ struct pomp_fd *pomp_loop_add_pfd(struct pomp_loop *loop, intptr_t fd,
 
 int pomp_loop_remove_pfd(struct pomp_loop *loop, struct pomp_fd *pfd);
 
+int pomp_loop_has_edge(struct pomp_loop *loop);
+
 void pomp_loop_check_owner(struct pomp_loop *loop, const char *caller);
 
 #endif /* !_POMP_TIMER_H_ */
@@ -80,6 +80,8 @@ static uint32_t fd_events_to_epoll(uint32_t events)
 		res |= EPOLLERR;
 	if (events & POMP_FD_EVENT_HUP)
 		res |= EPOLLHUP;
+	if (events & POMP_FD_EVENT_EDGE)
+		res |= EPOLLET;
 	return res;
 }
 
@@ -325,6 +327,7 @@ const struct pomp_loop_ops pomp_loop_epoll_ops = {
 	.do_get_fd = &pomp_loop_epoll_do_get_fd,
 	.do_wait_and_process = &pomp_loop_epoll_do_wait_and_process,
 	.do_wakeup = &pomp_loop_epoll_do_wakeup,
+	.has_edge = 1,
 };
 
 #endif /* POMP_HAVE_LOOP_EPOLL */
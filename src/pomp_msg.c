@@ -125,9 +125,10 @@ struct pomp_msg *pomp_msg_new_with_buffer(struct pomp_buffer *buf)
 
 	/* Check message size */
 	(void)pomp_buffer_read(msg->buf, &pos, &d, sizeof(d));
-	if (POMP_LE32TOH(d) != buf->len) {
+	if (POMP_LE32TOH(d) != pomp_buffer_get_total_len(buf)) {
 		POMP_LOGW("Bad message size: %08" PRIx32 "(%08" PRIx32 ")",
-				(uint32_t)buf->len, POMP_LE32TOH(d));
+				(uint32_t)pomp_buffer_get_total_len(buf),
+				POMP_LE32TOH(d));
 		goto error;
 	}
 
@@ -215,12 +216,12 @@ int pomp_msg_finish(struct pomp_msg *msg)
 	d = POMP_HTOLE32(msg->msgid);
 	(void)pomp_buffer_write(msg->buf, &pos, &d, sizeof(d));
 
-	/* Message size (make sure we have at least the header size in
-	 * case no payload was written in buffer) */
+	/* Message size including referenced buffers (make sure we have at
+	 * least the header size in case no payload was written in buffer) */
 	if (msg->buf->len < POMP_PROT_HEADER_SIZE)
 		d = POMP_HTOLE32(POMP_PROT_HEADER_SIZE);
 	else
-		d = POMP_HTOLE32((uint32_t)msg->buf->len);
+		d = POMP_HTOLE32((uint32_t)pomp_buffer_get_total_len(msg->buf));
 	(void)pomp_buffer_write(msg->buf, &pos, &d, sizeof(d));
 
 	/* Message can not be modified anymore */
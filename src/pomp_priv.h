@@ -92,6 +92,7 @@
 #endif
 #ifdef HAVE_SYS_SOCKET_H
 #  include <sys/socket.h>
+#  include <sys/uio.h>
 #endif
 #ifdef HAVE_SYS_TIMERFD_H
 #  include <sys/timerfd.h>
@@ -106,6 +107,15 @@
 #ifdef HAVE_NETINET_TCP_H
 #  include <netinet/tcp.h>
 #endif
+#ifdef __linux__
+#  include <linux/filter.h>
+#  define POMP_HAVE_SOCKET_FILTER
+#endif
+#ifdef __linux__
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  define POMP_HAVE_FUTEX
+#endif
 
 /* Detect available implementations */
 #if !defined(POMP_HAVE_TIMER_POSIX) && defined(HAVE_TIMER_CREATE)
@@ -137,6 +147,18 @@
 
 #define POMP_HAVE_LOOP_SYNC
 
+#if defined(__GNUC__) && !defined(_WIN32)
+#  define POMP_HAVE_CAPTURE
+#endif /* __GNUC__ && !_WIN32 */
+
+#if defined(__GNUC__)
+#  define POMP_HAVE_ASYNC_SEND
+#endif /* __GNUC__ */
+
+#if defined(__GNUC__)
+#  define POMP_HAVE_LOOP_INVOKE
+#endif /* __GNUC__ */
+
 #include "libpomp.h"
 
 #include "pomp_log.h"
@@ -148,6 +170,8 @@
 #include "pomp_loop_sync.h"
 #include "pomp_loop.h"
 #include "pomp_prot.h"
+#include "pomp_rpc.h"
+#include "pomp_capture.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -184,25 +208,6 @@ struct pomp_decoder {
 	size_t			pos;		/**< Position in data */
 };
 
-/** Value union */
-union pomp_value {
-	int8_t			i8;		/**< i8 value */
-	uint8_t			u8;		/**< u8 value */
-	int16_t			i16;		/**< i16 value */
-	uint16_t		u16;		/**< u16 value */
-	int32_t			i32;		/**< i32 value */
-	uint32_t		u32;		/**< u32 value */
-	int64_t			i64;		/**< i64 value */
-	uint64_t		u64;		/**< u64 value */
-	char			*str;		/**< str value */
-	const char		*cstr;		/**< cstr value */
-	void			*buf;		/**< buf value */
-	const void		*cbuf;		/**< cbuf value */
-	float			f32;		/**< f32 value */
-	double			f64;		/**< f64 value */
-	int			fd;		/**< fd value */
-};
-
 /* Context functions not part of public API and called from connection */
 
 int pomp_ctx_remove_conn(struct pomp_ctx *ctx, struct pomp_conn *conn);
@@ -213,6 +218,9 @@ int pomp_ctx_notify_event(struct pomp_ctx *ctx, enum pomp_event event,
 int pomp_ctx_notify_msg(struct pomp_ctx *ctx, struct pomp_conn *conn,
 		const struct pomp_msg *msg);
 
+int pomp_ctx_notify_batch(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		const struct pomp_msg *const *msgs, size_t count);
+
 int pomp_ctx_notify_raw_buf(struct pomp_ctx *ctx, struct pomp_conn *conn,
 		struct pomp_buffer *buf);
 
@@ -221,6 +229,30 @@ int pomp_ctx_notify_send(struct pomp_ctx *ctx, struct pomp_conn *conn,
 
 int pomp_ctx_sendcb_is_set(struct pomp_ctx *ctx);
 
+int pomp_ctx_add_conn_id(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		uint64_t *id);
+
+void pomp_ctx_remove_conn_id(struct pomp_ctx *ctx, uint64_t id);
+
+int pomp_ctx_is_msg_conflated(struct pomp_ctx *ctx, uint32_t msgid);
+
+int pomp_ctx_subscription_filter_is_enabled(struct pomp_ctx *ctx);
+
+struct pomp_capture *pomp_ctx_get_capture(struct pomp_ctx *ctx);
+
+int pomp_ctx_get_read_budget(struct pomp_ctx *ctx, size_t *maxbytes,
+		uint32_t *maxmsgs);
+
+int pomp_ctx_is_edge_triggered(struct pomp_ctx *ctx);
+
+int pomp_ctx_schedule_read(struct pomp_ctx *ctx);
+
+struct pomp_rpc_sched *pomp_ctx_get_rpc_sched(struct pomp_ctx *ctx);
+
+int pomp_ctx_notify_rpc(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		pomp_rpc_cb_t cb, enum pomp_rpc_status status,
+		const struct pomp_msg *msg, void *userdata);
+
 /* Connection functions not part of public API */
 
 struct pomp_conn *pomp_conn_new(struct pomp_ctx *ctx,
@@ -231,6 +263,13 @@ int pomp_conn_destroy(struct pomp_conn *conn);
 
 int pomp_conn_close(struct pomp_conn *conn);
 
+int pomp_conn_is_subscribed(const struct pomp_conn *conn, uint32_t msgid);
+
+void pomp_conn_set_capture(struct pomp_conn *conn,
+		struct pomp_capture *capture);
+
+void pomp_conn_process_pending_read(struct pomp_conn *conn);
+
 struct pomp_conn *pomp_conn_get_next(const struct pomp_conn *conn);
 
 int pomp_conn_set_next(struct pomp_conn *conn, struct pomp_conn *next);
@@ -261,6 +300,18 @@ int pomp_decoder_walk(struct pomp_decoder *dec,
 		pomp_decoder_walk_cb_t cb, void *userdata,
 		int checkfds);
 
+/** Maximum number of arguments in a compiled format */
+#define POMP_DECODER_MAX_VALUES		32
+
+/** Compiled format entry for the size following a buffer */
+#define POMP_DECODER_TYPE_BUFLEN	0x00
+
+int pomp_decoder_compile_fmt(const char *fmt, uint8_t *types,
+		size_t maxcount, size_t *count);
+
+int pomp_decoder_read_values(struct pomp_decoder *dec, const uint8_t *types,
+		size_t count, union pomp_value *argv);
+
 /* Fd utilities */
 
 /**
@@ -0,0 +1,661 @@
+/**
+ * @file pomp_rpc.c
+ *
+ * @brief Request/response calls with correlation ids and timeouts.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "pomp_priv.h"
+
+/** Initial number of slots in a pending call table (power of 2) */
+#define POMP_RPC_TABLE_INITIAL_CAPACITY	16
+
+/** Initial number of entries in the scheduler heap */
+#define POMP_RPC_SCHED_INITIAL_CAPACITY	16
+
+/** Marker for end of free list and invalid heap index */
+#define POMP_RPC_INVALID_INDEX		UINT32_MAX
+
+/** Pending call */
+struct pomp_rpc_call {
+	uint32_t		callid;		/**< Call id (0 if slot is free) */
+	uint32_t		replyid;	/**< Expected reply message id */
+	pomp_rpc_cb_t		cb;		/**< Completion callback */
+	void			*userdata;	/**< Callback user data */
+	uint64_t		deadline;	/**< Expiration date (in ms) */
+	uint32_t		heapidx;	/**< Index in scheduler heap */
+	uint32_t		nextfree;	/**< Next free slot */
+};
+
+/**
+ * Pending call table of a connection.
+ * The call id encodes the slot index in its low bits so a reply is matched
+ * with a single array access. The remaining bits hold a sequence number so a
+ * late reply for an expired call never matches a newer call in the same slot.
+ */
+struct pomp_rpc_table {
+	struct pomp_ctx		*ctx;		/**< Associated context */
+	struct pomp_conn	*conn;		/**< Associated connection */
+	struct pomp_rpc_sched	*sched;		/**< Shared scheduler */
+	struct pomp_rpc_call	*calls;		/**< Array of slots */
+	uint32_t		capacity;	/**< Number of slots (power of 2) */
+	uint32_t		shift;		/**< log2(capacity) */
+	uint32_t		count;		/**< Number of pending calls */
+	uint32_t		freehead;	/**< First free slot */
+	uint32_t		seq;		/**< Sequence for call ids */
+};
+
+/** Scheduler heap entry */
+struct pomp_rpc_heap_entry {
+	struct pomp_rpc_table	*table;		/**< Table of the call */
+	uint32_t		slot;		/**< Slot of the call */
+};
+
+/**
+ * Call expiration scheduler shared by all connections of a context.
+ * It is a binary min-heap of deadlines driven by a single timer.
+ */
+struct pomp_rpc_sched {
+	struct pomp_timer		*timer;		/**< Expiration timer */
+	struct pomp_rpc_heap_entry	*heap;		/**< Heap of calls */
+	uint32_t			count;		/**< Heap size */
+	uint32_t			capacity;	/**< Allocated size */
+	uint64_t			armed;		/**< Timer date, 0 if none */
+};
+
+/**
+ * Get current monotonic time.
+ * @return current time in ms.
+ */
+static uint64_t pomp_rpc_get_time(void)
+{
+#ifdef _WIN32
+	return (uint64_t)GetTickCount64();
+#else /* !_WIN32 */
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+#endif /* !_WIN32 */
+}
+
+/**
+ * Get the deadline of a heap entry.
+ * @param sched : scheduler.
+ * @param idx : index in heap.
+ * @return deadline of the entry.
+ */
+static inline uint64_t heap_deadline(const struct pomp_rpc_sched *sched,
+		uint32_t idx)
+{
+	const struct pomp_rpc_heap_entry *entry = &sched->heap[idx];
+	return entry->table->calls[entry->slot].deadline;
+}
+
+/**
+ * Store an entry in the heap and update its back reference.
+ * @param sched : scheduler.
+ * @param idx : index in heap.
+ * @param entry : entry to store.
+ */
+static inline void heap_set(struct pomp_rpc_sched *sched, uint32_t idx,
+		const struct pomp_rpc_heap_entry *entry)
+{
+	sched->heap[idx] = *entry;
+	entry->table->calls[entry->slot].heapidx = idx;
+}
+
+/**
+ * Move an entry towards the root of the heap.
+ * @param sched : scheduler.
+ * @param idx : index of entry to move.
+ */
+static void heap_sift_up(struct pomp_rpc_sched *sched, uint32_t idx)
+{
+	struct pomp_rpc_heap_entry entry = sched->heap[idx];
+	uint64_t deadline = heap_deadline(sched, idx);
+	uint32_t parent = 0;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (heap_deadline(sched, parent) <= deadline)
+			break;
+		heap_set(sched, idx, &sched->heap[parent]);
+		idx = parent;
+	}
+	heap_set(sched, idx, &entry);
+}
+
+/**
+ * Move an entry towards the leaves of the heap.
+ * @param sched : scheduler.
+ * @param idx : index of entry to move.
+ */
+static void heap_sift_down(struct pomp_rpc_sched *sched, uint32_t idx)
+{
+	struct pomp_rpc_heap_entry entry = sched->heap[idx];
+	uint64_t deadline = heap_deadline(sched, idx);
+	uint32_t child = 0;
+
+	for (;;) {
+		child = 2 * idx + 1;
+		if (child >= sched->count)
+			break;
+		if (child + 1 < sched->count && heap_deadline(sched, child + 1)
+				< heap_deadline(sched, child))
+			child++;
+		if (deadline <= heap_deadline(sched, child))
+			break;
+		heap_set(sched, idx, &sched->heap[child]);
+		idx = child;
+	}
+	heap_set(sched, idx, &entry);
+}
+
+/**
+ * Remove an entry from the heap.
+ * @param sched : scheduler.
+ * @param idx : index of entry to remove.
+ */
+static void heap_remove(struct pomp_rpc_sched *sched, uint32_t idx)
+{
+	struct pomp_rpc_heap_entry *entry = &sched->heap[idx];
+	entry->table->calls[entry->slot].heapidx = POMP_RPC_INVALID_INDEX;
+
+	sched->count--;
+	if (idx == sched->count)
+		return;
+
+	/* Move last entry in the hole and restore heap property */
+	heap_set(sched, idx, &sched->heap[sched->count]);
+	if (idx > 0 && heap_deadline(sched, idx)
+			< heap_deadline(sched, (idx - 1) / 2))
+		heap_sift_up(sched, idx);
+	else
+		heap_sift_down(sched, idx);
+}
+
+/**
+ * Arm the timer of the scheduler for the first deadline if needed.
+ * The timer is only moved to an earlier date. When it fires too early
+ * because calls were removed, it is simply re-armed.
+ * @param sched : scheduler.
+ * @param now : current time in ms.
+ */
+static void pomp_rpc_sched_arm(struct pomp_rpc_sched *sched, uint64_t now)
+{
+	uint64_t deadline = 0;
+
+	if (sched->count == 0)
+		return;
+
+	deadline = heap_deadline(sched, 0);
+	if (sched->armed != 0 && sched->armed <= deadline)
+		return;
+
+	sched->armed = deadline;
+	(void)pomp_timer_set(sched->timer,
+			deadline > now ? (uint32_t)(deadline - now) : 1);
+}
+
+/**
+ * Release a call slot and put it back in the free list.
+ * @param table : call table.
+ * @param slot : slot to release.
+ */
+static void pomp_rpc_table_release(struct pomp_rpc_table *table,
+		uint32_t slot)
+{
+	struct pomp_rpc_call *call = &table->calls[slot];
+
+	if (call->heapidx != POMP_RPC_INVALID_INDEX)
+		heap_remove(table->sched, call->heapidx);
+
+	memset(call, 0, sizeof(*call));
+	call->heapidx = POMP_RPC_INVALID_INDEX;
+	call->nextfree = table->freehead;
+	table->freehead = slot;
+	table->count--;
+}
+
+/**
+ * Complete a call: release its slot and notify its callback.
+ * @param table : call table.
+ * @param slot : slot of the call.
+ * @param status : completion status.
+ * @param msg : reply message (NULL if status is not OK).
+ */
+static void pomp_rpc_table_complete(struct pomp_rpc_table *table,
+		uint32_t slot, enum pomp_rpc_status status,
+		const struct pomp_msg *msg)
+{
+	pomp_rpc_cb_t cb = table->calls[slot].cb;
+	void *userdata = table->calls[slot].userdata;
+
+	/* Release first, the callback may issue new calls */
+	pomp_rpc_table_release(table, slot);
+	pomp_ctx_notify_rpc(table->ctx, table->conn, cb, status, msg, userdata);
+}
+
+/**
+ * Function called when the scheduler timer expires.
+ * @param timer : timer.
+ * @param userdata : scheduler.
+ */
+static void pomp_rpc_sched_timer_cb(struct pomp_timer *timer, void *userdata)
+{
+	struct pomp_rpc_sched *sched = userdata;
+	struct pomp_rpc_heap_entry entry;
+	uint64_t now = pomp_rpc_get_time();
+
+	sched->armed = 0;
+
+	/* Expire all calls whose deadline is reached */
+	while (sched->count > 0 && heap_deadline(sched, 0) <= now) {
+		entry = sched->heap[0];
+		pomp_rpc_table_complete(entry.table, entry.slot,
+				POMP_RPC_STATUS_TIMEOUT, NULL);
+	}
+
+	pomp_rpc_sched_arm(sched, now);
+}
+
+/**
+ * Create a new call scheduler.
+ * @param loop : loop used for the expiration timer.
+ * @return scheduler or NULL in case of error.
+ */
+struct pomp_rpc_sched *pomp_rpc_sched_new(struct pomp_loop *loop)
+{
+	struct pomp_rpc_sched *sched = NULL;
+	POMP_RETURN_VAL_IF_FAILED(loop != NULL, -EINVAL, NULL);
+
+	sched = calloc(1, sizeof(*sched));
+	if (sched == NULL)
+		goto error;
+
+	sched->heap = calloc(POMP_RPC_SCHED_INITIAL_CAPACITY,
+			sizeof(*sched->heap));
+	if (sched->heap == NULL)
+		goto error;
+	sched->capacity = POMP_RPC_SCHED_INITIAL_CAPACITY;
+
+	sched->timer = pomp_timer_new(loop, &pomp_rpc_sched_timer_cb, sched);
+	if (sched->timer == NULL)
+		goto error;
+
+	return sched;
+
+	/* Cleanup in case of error */
+error:
+	if (sched != NULL) {
+		free(sched->heap);
+		free(sched);
+	}
+	return NULL;
+}
+
+/**
+ * Destroy a call scheduler.
+ * @param sched : scheduler.
+ * @return 0 in case of success, negative errno value in case of error.
+ * If some calls are still scheduled, -EBUSY is returned.
+ */
+int pomp_rpc_sched_destroy(struct pomp_rpc_sched *sched)
+{
+	POMP_RETURN_ERR_IF_FAILED(sched != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(sched->count == 0, -EBUSY);
+	pomp_timer_destroy(sched->timer);
+	free(sched->heap);
+	free(sched);
+	return 0;
+}
+
+/**
+ * Build the free list of a range of slots.
+ * @param table : call table.
+ * @param start : first slot of the range.
+ */
+static void pomp_rpc_table_init_free(struct pomp_rpc_table *table,
+		uint32_t start)
+{
+	uint32_t i = table->capacity;
+
+	/* Push in reverse order so that lower slots are used first */
+	while (i > start) {
+		i--;
+		if (table->calls[i].callid != 0)
+			continue;
+		table->calls[i].heapidx = POMP_RPC_INVALID_INDEX;
+		table->calls[i].nextfree = table->freehead;
+		table->freehead = i;
+	}
+}
+
+/**
+ * Double the number of slots of a call table. Pending calls are moved to the
+ * slot given by their call id with the new mask. As they had different
+ * slots with the previous mask, they can not collide.
+ * @param table : call table.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_rpc_table_grow(struct pomp_rpc_table *table)
+{
+	struct pomp_rpc_call *calls = NULL;
+	uint32_t capacity = table->capacity * 2;
+	uint32_t i = 0, slot = 0;
+
+	if (table->shift >= 16)
+		return -ENOBUFS;
+
+	calls = calloc(capacity, sizeof(*calls));
+	if (calls == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < table->capacity; i++) {
+		if (table->calls[i].callid == 0)
+			continue;
+		slot = table->calls[i].callid & (capacity - 1);
+		calls[slot] = table->calls[i];
+		if (calls[slot].heapidx != POMP_RPC_INVALID_INDEX)
+			table->sched->heap[calls[slot].heapidx].slot = slot;
+	}
+
+	free(table->calls);
+	table->calls = calls;
+	table->capacity = capacity;
+	table->shift++;
+	table->freehead = POMP_RPC_INVALID_INDEX;
+	pomp_rpc_table_init_free(table, 0);
+	return 0;
+}
+
+/**
+ * Create a new pending call table for a connection.
+ * @param ctx : context of the connection.
+ * @param conn : connection.
+ * @param sched : scheduler shared by the connections of the context.
+ * @return call table or NULL in case of error.
+ */
+struct pomp_rpc_table *pomp_rpc_table_new(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, struct pomp_rpc_sched *sched)
+{
+	struct pomp_rpc_table *table = NULL;
+	POMP_RETURN_VAL_IF_FAILED(ctx != NULL, -EINVAL, NULL);
+	POMP_RETURN_VAL_IF_FAILED(conn != NULL, -EINVAL, NULL);
+	POMP_RETURN_VAL_IF_FAILED(sched != NULL, -EINVAL, NULL);
+
+	table = calloc(1, sizeof(*table));
+	if (table == NULL)
+		return NULL;
+
+	table->calls = calloc(POMP_RPC_TABLE_INITIAL_CAPACITY,
+			sizeof(*table->calls));
+	if (table->calls == NULL) {
+		free(table);
+		return NULL;
+	}
+
+	table->ctx = ctx;
+	table->conn = conn;
+	table->sched = sched;
+	table->capacity = POMP_RPC_TABLE_INITIAL_CAPACITY;
+	while ((1u << table->shift) < table->capacity)
+		table->shift++;
+	table->seq = 1;
+	table->freehead = POMP_RPC_INVALID_INDEX;
+	pomp_rpc_table_init_free(table, 0);
+	return table;
+}
+
+/**
+ * Destroy a pending call table. Remaining calls are completed with the
+ * POMP_RPC_STATUS_ABORTED status.
+ * @param table : call table.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_rpc_table_destroy(struct pomp_rpc_table *table)
+{
+	uint32_t i = 0;
+	POMP_RETURN_ERR_IF_FAILED(table != NULL, -EINVAL);
+
+	for (i = 0; i < table->capacity && table->count > 0; i++) {
+		if (table->calls[i].callid != 0) {
+			pomp_rpc_table_complete(table, i,
+					POMP_RPC_STATUS_ABORTED, NULL);
+		}
+	}
+
+	free(table->calls);
+	free(table);
+	return 0;
+}
+
+/**
+ * Register a new pending call.
+ * @param table : call table.
+ * @param replyid : expected reply message id.
+ * @param timeout : timeout of the call (in ms).
+ * @param cb : completion callback.
+ * @param userdata : callback user data.
+ * @param callid : will receive the allocated call id.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_rpc_table_add(struct pomp_rpc_table *table, uint32_t replyid,
+		uint32_t timeout, pomp_rpc_cb_t cb, void *userdata,
+		uint32_t *callid)
+{
+	int res = 0;
+	uint32_t slot = 0;
+	uint64_t now = 0;
+	struct pomp_rpc_call *call = NULL;
+	struct pomp_rpc_sched *sched = NULL;
+	struct pomp_rpc_heap_entry *heap = NULL;
+	struct pomp_rpc_heap_entry entry;
+
+	POMP_RETURN_ERR_IF_FAILED(table != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(callid != NULL, -EINVAL);
+	sched = table->sched;
+
+	/* Make sure there is room in the heap */
+	if (sched->count == sched->capacity) {
+		heap = realloc(sched->heap,
+				2 * sched->capacity * sizeof(*heap));
+		if (heap == NULL)
+			return -ENOMEM;
+		sched->heap = heap;
+		sched->capacity *= 2;
+	}
+
+	/* Get a free slot */
+	if (table->freehead == POMP_RPC_INVALID_INDEX) {
+		res = pomp_rpc_table_grow(table);
+		if (res < 0)
+			return res;
+	}
+	slot = table->freehead;
+	call = &table->calls[slot];
+	table->freehead = call->nextfree;
+	table->count++;
+
+	/* Generate a non-zero call id mapping to this slot */
+	if ((table->seq << table->shift) == 0)
+		table->seq = 1;
+	call->callid = (table->seq++ << table->shift) | slot;
+	call->replyid = replyid;
+	call->cb = cb;
+	call->userdata = userdata;
+	call->nextfree = POMP_RPC_INVALID_INDEX;
+
+	/* Schedule its expiration */
+	now = pomp_rpc_get_time();
+	call->deadline = now + timeout;
+	entry.table = table;
+	entry.slot = slot;
+	heap_set(sched, sched->count++, &entry);
+	heap_sift_up(sched, call->heapidx);
+	pomp_rpc_sched_arm(sched, now);
+
+	*callid = call->callid;
+	return 0;
+}
+
+/**
+ * Cancel a pending call without notifying its callback.
+ * @param table : call table.
+ * @param callid : id of the call.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_rpc_table_cancel(struct pomp_rpc_table *table, uint32_t callid)
+{
+	uint32_t slot = 0;
+	POMP_RETURN_ERR_IF_FAILED(table != NULL, -EINVAL);
+
+	slot = callid & (table->capacity - 1);
+	if (callid == 0 || table->calls[slot].callid != callid)
+		return -ENOENT;
+
+	pomp_rpc_table_release(table, slot);
+	return 0;
+}
+
+/**
+ * Get the call id of a message without logging in case it is not an rpc
+ * message.
+ * @param msg : message.
+ * @param callid : will receive the call id.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_rpc_peek_callid(const struct pomp_msg *msg, uint32_t *callid)
+{
+	size_t pos = POMP_PROT_HEADER_SIZE;
+	uint8_t type = 0, b = 0;
+	uint32_t shift = 0;
+	uint64_t v = 0;
+
+	if (msg->buf == NULL || !pomp_buffer_can_read(msg->buf, pos, 2))
+		return -EINVAL;
+
+	/* First argument must be an u32 encoded as a varint */
+	(void)pomp_buffer_readb(msg->buf, &pos, &type);
+	if (type != POMP_PROT_DATA_TYPE_U32)
+		return -EINVAL;
+
+	do {
+		if (shift > 28 || pomp_buffer_readb(msg->buf, &pos, &b) < 0)
+			return -EINVAL;
+		v |= ((uint64_t)(b & 0x7f)) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	*callid = (uint32_t)v;
+	return 0;
+}
+
+/**
+ * Process a received message and complete the matching pending call.
+ * @param table : call table.
+ * @param msg : received message.
+ * @return 1 if the message was the reply of a pending call (and shall not be
+ * notified as a regular message), 0 otherwise.
+ */
+int pomp_rpc_table_process_msg(struct pomp_rpc_table *table,
+		const struct pomp_msg *msg)
+{
+	uint32_t callid = 0, slot = 0;
+	const struct pomp_rpc_call *call = NULL;
+
+	if (table == NULL || table->count == 0)
+		return 0;
+	if (pomp_rpc_peek_callid(msg, &callid) < 0 || callid == 0)
+		return 0;
+
+	slot = callid & (table->capacity - 1);
+	call = &table->calls[slot];
+	if (call->callid != callid || call->replyid != msg->msgid)
+		return 0;
+
+	pomp_rpc_table_complete(table, slot, POMP_RPC_STATUS_OK, msg);
+	return 1;
+}
+
+/**
+ * Write a request or reply message with its call id as first argument.
+ * @param msg : message to write.
+ * @param msgid : message id.
+ * @param callid : call id.
+ * @param fmt : format string of other arguments. Can be NULL.
+ * @param args : other arguments.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+int pomp_rpc_msg_writev(struct pomp_msg *msg, uint32_t msgid,
+		uint32_t callid, const char *fmt, va_list args)
+{
+	int res = 0;
+	struct pomp_encoder enc = POMP_ENCODER_INITIALIZER;
+
+	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
+
+	/* Initialize message */
+	res = pomp_msg_init(msg, msgid);
+	if (res < 0)
+		goto out;
+
+	/* Setup encoder */
+	res = pomp_encoder_init(&enc, msg);
+	if (res < 0)
+		goto out;
+
+	/* Encode call id then other arguments */
+	res = pomp_encoder_write_u32(&enc, callid);
+	if (res < 0)
+		goto out;
+	res = pomp_encoder_writev(&enc, fmt, args);
+	if (res < 0)
+		goto out;
+
+	/* Finish it */
+	res = pomp_msg_finish(msg);
+	if (res < 0)
+		goto out;
+
+out:
+	/* Cleanup */
+	(void)pomp_encoder_clear(&enc);
+	return res;
+}
+
+/*
+ * See documentation in public header.
+ */
+int pomp_msg_get_call_id(const struct pomp_msg *msg, uint32_t *callid)
+{
+	POMP_RETURN_ERR_IF_FAILED(msg != NULL, -EINVAL);
+	POMP_RETURN_ERR_IF_FAILED(callid != NULL, -EINVAL);
+	return pomp_rpc_peek_callid(msg, callid);
+}
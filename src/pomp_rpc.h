@@ -0,0 +1,70 @@
+/**
+ * @file pomp_rpc.h
+ *
+ * @brief Request/response calls with correlation ids and timeouts.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _POMP_RPC_H_
+#define _POMP_RPC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+struct pomp_rpc_table;
+struct pomp_rpc_sched;
+
+/* RPC functions not part of public API */
+
+struct pomp_rpc_sched *pomp_rpc_sched_new(struct pomp_loop *loop);
+
+int pomp_rpc_sched_destroy(struct pomp_rpc_sched *sched);
+
+struct pomp_rpc_table *pomp_rpc_table_new(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, struct pomp_rpc_sched *sched);
+
+int pomp_rpc_table_destroy(struct pomp_rpc_table *table);
+
+int pomp_rpc_table_add(struct pomp_rpc_table *table, uint32_t replyid,
+		uint32_t timeout, pomp_rpc_cb_t cb, void *userdata,
+		uint32_t *callid);
+
+int pomp_rpc_table_cancel(struct pomp_rpc_table *table, uint32_t callid);
+
+int pomp_rpc_table_process_msg(struct pomp_rpc_table *table,
+		const struct pomp_msg *msg);
+
+int pomp_rpc_msg_writev(struct pomp_msg *msg, uint32_t msgid,
+		uint32_t callid, const char *fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_POMP_RPC_H_ */
@@ -36,16 +36,12 @@
 
 #ifdef POMP_HAVE_WATCHDOG
 
-static int check_timeout(const struct timespec *timeout)
+/* Monotonic time in ms, wraps after ~49 days, use differences only */
+static uint32_t get_time_ms(void)
 {
 	struct timespec now;
-	int64_t delta_ns;
 	clock_gettime(CLOCK_MONOTONIC, &now);
-
-	/* Make sure that the timeout really expired */
-	delta_ns = (int64_t)(now.tv_sec - timeout->tv_sec) * 1000000000 +
-			(int64_t)(now.tv_nsec - timeout->tv_nsec);
-	return delta_ns >= 0;
+	return (uint32_t)now.tv_sec * 1000 + (uint32_t)(now.tv_nsec / 1000000);
 }
 
 static void get_absolute_timeout(uint32_t delay, struct timespec *timeout)
@@ -61,18 +57,164 @@ static void get_absolute_timeout(uint32_t delay, struct timespec *timeout)
 	}
 }
 
-static void notify_watchdog_expired(struct pomp_watchdog *watchdog)
+/** Invalid heap index */
+#define POMP_WATCHDOG_NO_IDX	UINT32_MAX
+
+/** Process-wide service monitoring all loops from a single thread */
+static struct {
+	pthread_mutex_t		mutex;
+	pthread_cond_t		cond;		/**< Heap changes, stop */
+	pthread_cond_t		cond_done;	/**< End of a notification */
+	int			initialized;	/**< Conditions initialized */
+	int			running;	/**< Thread running */
+	uint32_t		gen;		/**< Generation of thread */
+	pthread_t		thread;
+	struct pomp_watchdog	*current;	/**< Being notified */
+	pthread_t		notifier;	/**< Thread notifying current */
+
+	/* Min-heap of watchdogs ordered by next check time */
+	struct pomp_watchdog	**heap;
+	uint32_t		count;
+	uint32_t		size;
+} s_service = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Compare times that can wrap, valid while less than ~24 days apart */
+static int time_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+static void heap_set(uint32_t idx, struct pomp_watchdog *watchdog)
+{
+	s_service.heap[idx] = watchdog;
+	watchdog->heapidx = idx;
+}
+
+static void heap_up(uint32_t idx)
+{
+	struct pomp_watchdog *watchdog = s_service.heap[idx];
+	uint32_t parent = 0;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (!time_before(watchdog->wakeup,
+				s_service.heap[parent]->wakeup)) {
+			break;
+		}
+		heap_set(idx, s_service.heap[parent]);
+		idx = parent;
+	}
+	heap_set(idx, watchdog);
+}
+
+static void heap_down(uint32_t idx)
+{
+	struct pomp_watchdog *watchdog = s_service.heap[idx];
+	uint32_t child = 0;
+
+	for (;;) {
+		child = 2 * idx + 1;
+		if (child >= s_service.count)
+			break;
+		if (child + 1 < s_service.count &&
+				time_before(s_service.heap[child + 1]->wakeup,
+					s_service.heap[child]->wakeup)) {
+			child++;
+		}
+		if (!time_before(s_service.heap[child]->wakeup,
+				watchdog->wakeup)) {
+			break;
+		}
+		heap_set(idx, s_service.heap[child]);
+		idx = child;
+	}
+	heap_set(idx, watchdog);
+}
+
+static int heap_push(struct pomp_watchdog *watchdog)
+{
+	uint32_t newsize = 0;
+	struct pomp_watchdog **newheap = NULL;
+
+	if (s_service.count == s_service.size) {
+		newsize = s_service.size == 0 ? 8 : 2 * s_service.size;
+		newheap = realloc(s_service.heap,
+				newsize * sizeof(*newheap));
+		if (newheap == NULL)
+			return -ENOMEM;
+		s_service.heap = newheap;
+		s_service.size = newsize;
+	}
+
+	heap_set(s_service.count++, watchdog);
+	heap_up(watchdog->heapidx);
+	return 0;
+}
+
+static void heap_remove(struct pomp_watchdog *watchdog)
+{
+	uint32_t idx = watchdog->heapidx;
+	struct pomp_watchdog *last = NULL;
+
+	if (idx == POMP_WATCHDOG_NO_IDX)
+		return;
+
+	/* Move last entry in the hole and restore heap order */
+	watchdog->heapidx = POMP_WATCHDOG_NO_IDX;
+	last = s_service.heap[--s_service.count];
+	if (last != watchdog) {
+		heap_set(idx, last);
+		heap_up(idx);
+		heap_down(last->heapidx);
+	}
+}
+
+/**
+ * Check the heartbeat of a loop.
+ * @param watchdog : watchdog of the loop.
+ * @param now : current monotonic time (ms).
+ * @return 1 if the current processing of the loop just expired, 0 otherwise.
+ * In both cases the next check time of the watchdog is updated.
+ */
+static int pomp_watchdog_check(struct pomp_watchdog *watchdog, uint32_t now)
 {
-	POMP_LOGE("Watchdog on loop=%p expired", watchdog->loop);
-	(*watchdog->cb)(watchdog->loop, watchdog->userdata);
+	uint32_t counter = 0, deadline = 0;
+
+	/* A processing starting before next check with the same delay
+	 * expires after it, so checking at this rate is enough */
+	watchdog->wakeup = now + watchdog->delay;
+
+	/* Snapshot of the heartbeat, retried on next check if the loop
+	 * changed it while we were reading */
+	counter = __atomic_load_n(&watchdog->counter, __ATOMIC_ACQUIRE);
+	deadline = __atomic_load_n(&watchdog->deadline, __ATOMIC_ACQUIRE);
+	if ((counter & 1) == 0 || counter == watchdog->expired ||
+			counter != __atomic_load_n(&watchdog->counter,
+					__ATOMIC_RELAXED)) {
+		return 0;
+	}
+
+	/* Still in the same processing, check its deadline */
+	if (time_before(now, deadline)) {
+		watchdog->wakeup = deadline;
+		return 0;
+	}
+	watchdog->expired = counter;
+	return 1;
 }
 
 static void *pomp_watchdog_thread_cb(void *userdata)
 {
 	int res = 0;
-	struct pomp_watchdog *watchdog = userdata;
+	uint32_t gen = (uint32_t)(uintptr_t)userdata;
+	struct pomp_watchdog *watchdog = NULL;
+	struct pomp_loop *loop = NULL;
+	pomp_watchdog_cb_t cb = NULL;
+	void *cbuserdata = NULL;
 	struct timespec timeout = {0, 0};
-	uint32_t counter = 0;
+	uint32_t now = 0;
 
 #if defined(__APPLE__)
 #	if !TARGET_OS_IPHONE
@@ -86,36 +228,131 @@ static void *pomp_watchdog_thread_cb(void *userdata)
 		ULOG_ERRNO("pthread_setname_np", res);
 #endif
 
-	pthread_mutex_lock(&watchdog->mutex);
-
-	while (!watchdog->should_stop) {
-		/* Do we have an absolute timeout configured ? */
-		counter = watchdog->counter;
-		timeout = watchdog->next_timeout;
-		if (!watchdog->monitoring) {
-			/* Infinite wait, on wakeup recheck if monitoring with
-			 * a timeout */
-			pthread_cond_wait(&watchdog->cond, &watchdog->mutex);
-		} else {
-			res = pthread_cond_timedwait(&watchdog->cond,
-					&watchdog->mutex, &timeout);
-			/* In case of timeout, check if still monitoring and
-			 * in the same critical block (counter) */
-			if (res == ETIMEDOUT &&
-					watchdog->monitoring &&
-					watchdog->counter == counter &&
-					check_timeout(&timeout)) {
-				notify_watchdog_expired(watchdog);
-				watchdog->monitoring = 0;
-			}
+	pthread_mutex_lock(&s_service.mutex);
+
+	/* A newer thread may have been started after our stop */
+	while (s_service.gen == gen) {
+		if (s_service.count == 0) {
+			pthread_cond_wait(&s_service.cond, &s_service.mutex);
+			continue;
+		}
+
+		/* A thread of a previous generation may still be notifying,
+		 * notifications are never done concurrently */
+		if (s_service.current != NULL) {
+			pthread_cond_wait(&s_service.cond_done,
+					&s_service.mutex);
+			continue;
 		}
+
+		/* Sleep until the earliest check */
+		watchdog = s_service.heap[0];
+		now = get_time_ms();
+		if (time_before(now, watchdog->wakeup)) {
+			get_absolute_timeout(watchdog->wakeup - now, &timeout);
+			pthread_cond_timedwait(&s_service.cond,
+					&s_service.mutex, &timeout);
+			continue;
+		}
+
+		res = pomp_watchdog_check(watchdog, now);
+		heap_down(0);
+		if (!res)
+			continue;
+
+		/* Notify without the lock so loops can start or stop their
+		 * watchdog (a stop of this one waits for the end of it). No
+		 * loop is checked until the callback returns */
+		s_service.current = watchdog;
+		s_service.notifier = pthread_self();
+		loop = watchdog->loop;
+		cb = watchdog->cb;
+		cbuserdata = watchdog->userdata;
+		pthread_mutex_unlock(&s_service.mutex);
+		POMP_LOGE("Watchdog on loop=%p expired", loop);
+		(*cb)(loop, cbuserdata);
+		pthread_mutex_lock(&s_service.mutex);
+
+		/* Even if stopped meanwhile, a stop of this watchdog may be
+		 * waiting for the end of the notification */
+		s_service.current = NULL;
+		pthread_cond_broadcast(&s_service.cond_done);
 	}
 
-	pthread_mutex_unlock(&watchdog->mutex);
+	pthread_mutex_unlock(&s_service.mutex);
 
 	return NULL;
 }
 
+/**
+ * Start the service thread if needed. Shall be called with service lock.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int pomp_watchdog_service_start(void)
+{
+	int res = 0;
+	pthread_condattr_t condattr;
+
+	if (!s_service.initialized) {
+		pthread_condattr_init(&condattr);
+#ifdef POMP_HAVE_WATCHDOG_MONOTONIC
+		pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+#endif /* POMP_HAVE_WATCHDOG_MONOTONIC */
+		pthread_cond_init(&s_service.cond, &condattr);
+		pthread_cond_init(&s_service.cond_done, &condattr);
+		pthread_condattr_destroy(&condattr);
+		s_service.initialized = 1;
+	}
+
+	if (s_service.running)
+		return 0;
+
+	/* Create the internal thread */
+	s_service.gen++;
+	res = pthread_create(&s_service.thread, NULL,
+			&pomp_watchdog_thread_cb,
+			(void *)(uintptr_t)s_service.gen);
+	if (res != 0) {
+		POMP_LOGE("pthread_create:err=%d(%s)", res, strerror(res));
+		memset(&s_service.thread, 0, sizeof(s_service.thread));
+		return -res;
+	}
+	s_service.running = 1;
+	return 0;
+}
+
+/**
+ * Stop the service thread once no more loop is monitored. Shall be called
+ * with service lock.
+ * @param thread : thread to join after releasing the lock.
+ * @return 1 if the thread shall be joined, 0 otherwise.
+ */
+static int pomp_watchdog_service_stop(pthread_t *thread)
+{
+	if (!s_service.running || s_service.count != 0)
+		return 0;
+
+	/* Make the current thread exit, after the end of its notification
+	 * if any */
+	s_service.gen++;
+	s_service.running = 0;
+	pthread_cond_signal(&s_service.cond);
+
+	free(s_service.heap);
+	s_service.heap = NULL;
+	s_service.size = 0;
+
+	*thread = s_service.thread;
+	memset(&s_service.thread, 0, sizeof(s_service.thread));
+
+	/* Stopped from a notification, the thread can not join itself */
+	if (pthread_equal(*thread, pthread_self())) {
+		pthread_detach(*thread);
+		return 0;
+	}
+	return 1;
+}
+
 int pomp_watchdog_start(struct pomp_watchdog *watchdog,
 	struct pomp_loop *loop,
 	uint32_t delay,
@@ -123,109 +360,133 @@ int pomp_watchdog_start(struct pomp_watchdog *watchdog,
 	void *userdata)
 {
 	int res = 0;
-	pthread_condattr_t condattr;
+	pthread_t thread;
 	POMP_RETURN_ERR_IF_FAILED(watchdog != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(loop != NULL, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(delay > 0, -EINVAL);
 	POMP_RETURN_ERR_IF_FAILED(cb != NULL, -EINVAL);
 
+	pthread_mutex_lock(&s_service.mutex);
+
 	if (watchdog->started) {
 		/* If already started, should be the same loop, update delay */
-		POMP_RETURN_ERR_IF_FAILED(watchdog->loop == loop, -EBUSY);
-		pthread_mutex_lock(&watchdog->mutex);
-		watchdog->delay = delay;
+		if (watchdog->loop != loop) {
+			res = -EBUSY;
+			goto out;
+		}
+		__atomic_store_n(&watchdog->delay, delay, __ATOMIC_RELAXED);
 		watchdog->cb = cb;
 		watchdog->userdata = userdata;
-		pthread_mutex_unlock(&watchdog->mutex);
-		return 0;
-	}
-	POMP_RETURN_ERR_IF_FAILED(watchdog->loop == NULL, -EBUSY);
-
-	pthread_mutex_init(&watchdog->mutex, NULL);
 
-	pthread_condattr_init(&condattr);
-#ifdef POMP_HAVE_WATCHDOG_MONOTONIC
-	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
-#endif /* POMP_HAVE_WATCHDOG_MONOTONIC */
-	pthread_cond_init(&watchdog->cond, &condattr);
-	pthread_condattr_destroy(&condattr);
-
-	/* Create an internal thread */
-	res = pthread_create(&watchdog->thread, NULL,
-			&pomp_watchdog_thread_cb, watchdog);
-	if (res != 0) {
-		POMP_LOGE("pthread_create:err=%d(%s)", res, strerror(res));
-		res = -res;
-		goto error;
+		/* Check it again with the new delay */
+		watchdog->wakeup = get_time_ms();
+		heap_up(watchdog->heapidx);
+		heap_down(watchdog->heapidx);
+		pthread_cond_signal(&s_service.cond);
+		goto out;
+	}
+	if (watchdog->loop != NULL) {
+		res = -EBUSY;
+		goto out;
 	}
-	watchdog->started = 1;
+
+	res = pomp_watchdog_service_start();
+	if (res < 0)
+		goto out;
 
 	watchdog->loop = loop;
 	watchdog->delay = delay;
 	watchdog->cb = cb;
 	watchdog->userdata = userdata;
+	watchdog->expired = 0;
+	watchdog->wakeup = get_time_ms();
+	res = heap_push(watchdog);
+	if (res < 0) {
+		watchdog->heapidx = POMP_WATCHDOG_NO_IDX;
+		watchdog->loop = NULL;
+		if (pomp_watchdog_service_stop(&thread)) {
+			pthread_mutex_unlock(&s_service.mutex);
+			pthread_join(thread, NULL);
+			return res;
+		}
+		goto out;
+	}
+	watchdog->started = 1;
+	pthread_cond_signal(&s_service.cond);
 
-	return 0;
-
-	/* Cleanup in case of error */
-error:
-	pomp_watchdog_stop(watchdog);
+out:
+	pthread_mutex_unlock(&s_service.mutex);
 	return res;
 }
 
 int pomp_watchdog_stop(struct pomp_watchdog *watchdog)
 {
+	int join = 0;
+	pthread_t thread;
 	POMP_RETURN_ERR_IF_FAILED(watchdog != NULL, -EINVAL);
 
-	/* Stop and join internal thread */
+	pthread_mutex_lock(&s_service.mutex);
+
 	if (watchdog->started) {
-		pthread_mutex_lock(&watchdog->mutex);
-		watchdog->should_stop = 1;
-		pthread_cond_signal(&watchdog->cond);
-		pthread_mutex_unlock(&watchdog->mutex);
-
-		pthread_join(watchdog->thread, NULL);
-		memset(&watchdog->thread, 0, sizeof(watchdog->thread));
-		pthread_mutex_lock(&watchdog->mutex);
-		watchdog->should_stop = 0;
-		pthread_mutex_unlock(&watchdog->mutex);
+		heap_remove(watchdog);
 		watchdog->started = 0;
-	}
 
-	pthread_mutex_destroy(&watchdog->mutex);
-	pthread_cond_destroy(&watchdog->cond);
+		/* Wait for the end of a notification of this watchdog,
+		 * unless it is the one calling us */
+		while (s_service.current == watchdog &&
+				!pthread_equal(s_service.notifier,
+						pthread_self())) {
+			pthread_cond_wait(&s_service.cond_done,
+					&s_service.mutex);
+		}
+
+		/* Last monitored loop, stop the thread */
+		join = pomp_watchdog_service_stop(&thread);
+	}
 
 	watchdog->loop = NULL;
 	watchdog->delay = 0;
 	watchdog->cb = NULL;
 	watchdog->userdata = NULL;
 
+	pthread_mutex_unlock(&s_service.mutex);
+
+	if (join)
+		pthread_join(thread, NULL);
 	return 0;
 }
 
 void pomp_watchdog_enter(struct pomp_watchdog *watchdog)
 {
+	uint32_t counter = 0, delay = 0;
 	POMP_RETURN_IF_FAILED(watchdog != NULL, -EINVAL);
-	if (watchdog->started) {
-		pthread_mutex_lock(&watchdog->mutex);
-		watchdog->counter++;
-		watchdog->monitoring = 1;
-		get_absolute_timeout(watchdog->delay, &watchdog->next_timeout);
-		pthread_cond_signal(&watchdog->cond);
-		pthread_mutex_unlock(&watchdog->mutex);
-	}
+	if (!watchdog->started)
+		return;
+
+	/* Only the loop writes the heartbeat, no read-modify-write needed */
+	counter = __atomic_load_n(&watchdog->counter, __ATOMIC_RELAXED);
+	if ((counter & 1) != 0)
+		return;
+
+	/* Time is truncated to ms, add one so it never expires early.
+	 * The deadline shall be visible before the counter becomes odd */
+	delay = __atomic_load_n(&watchdog->delay, __ATOMIC_RELAXED);
+	__atomic_store_n(&watchdog->deadline, get_time_ms() + delay + 1,
+			__ATOMIC_RELEASE);
+	__atomic_store_n(&watchdog->counter, counter + 1, __ATOMIC_RELEASE);
 }
 
 void pomp_watchdog_leave(struct pomp_watchdog *watchdog)
 {
+	uint32_t counter = 0;
 	POMP_RETURN_IF_FAILED(watchdog != NULL, -EINVAL);
-	if (watchdog->started) {
-		pthread_mutex_lock(&watchdog->mutex);
-		watchdog->monitoring = 0;
-		watchdog->next_timeout.tv_sec = 0;
-		watchdog->next_timeout.tv_nsec = 0;
-		pthread_cond_signal(&watchdog->cond);
-		pthread_mutex_unlock(&watchdog->mutex);
+
+	/* Done even if not started, the watchdog may have been stopped
+	 * during the processing */
+	counter = __atomic_load_n(&watchdog->counter, __ATOMIC_RELAXED);
+	if ((counter & 1) != 0) {
+		__atomic_store_n(&watchdog->counter, counter + 1,
+				__ATOMIC_RELEASE);
 	}
 }
 
@@ -36,20 +36,26 @@
 #define _POMP_WATCHDOG_H_
 
 struct pomp_watchdog {
-	pthread_mutex_t		mutex;
-	pthread_cond_t		cond;
-	pthread_t		thread;
+	/* Configuration, protected by the lock of the shared service */
 	int			started;
-	int			should_stop;
-
 	struct pomp_loop	*loop;
 	uint32_t		delay;
 	pomp_watchdog_cb_t	cb;
 	void			*userdata;
 
+	/* Heartbeat published by the loop with atomic operations only.
+	 * counter is odd while processing events and deadline is the
+	 * monotonic time (ms) at which the current processing expires */
 	uint32_t		counter;
-	int			monitoring;
-	struct timespec		next_timeout;
+	uint32_t		deadline;
+
+	/* Counter of the last expired processing (service thread only) */
+	uint32_t		expired;
+
+	/* Position in the deadline heap of the service and monotonic time
+	 * (ms) of the next check of this watchdog */
+	uint32_t		heapidx;
+	uint32_t		wakeup;
 };
 
 void pomp_watchdog_init(struct pomp_watchdog *watchdog);
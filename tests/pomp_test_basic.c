@@ -704,6 +704,230 @@ static void test_buffer_perm(void)
 	pomp_buffer_unref(buf);
 }
 
+/** */
+static void test_buffer_inline(void)
+{
+	int res = 0;
+	struct pomp_buffer *buf = NULL;
+	static const uint8_t refdata[4] = {0x11, 0x22, 0x33, 0x44};
+
+	/* Small capacity uses inline data */
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	CU_ASSERT_PTR_NULL(buf->data);
+	res = pomp_buffer_append_data(buf, refdata, sizeof(refdata));
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(buf->data, buf->inlinedata);
+
+	/* Growth moves data out of line */
+	res = pomp_buffer_ensure_capacity(buf, POMP_BUFFER_INLINE_SIZE + 1);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_TRUE(buf->data != buf->inlinedata);
+	CU_ASSERT_EQUAL(buf->len, sizeof(refdata));
+	CU_ASSERT_EQUAL(memcmp(buf->data, refdata, sizeof(refdata)), 0);
+
+	/* Inline data is used again after a full clear */
+	res = pomp_buffer_clear(buf);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_buffer_append_data(buf, refdata, sizeof(refdata));
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(buf->data, buf->inlinedata);
+	res = pomp_buffer_clear_partial(buf, POMP_BUFFER_MAX_REUSE_CAPACITY);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(buf->data, buf->inlinedata);
+	CU_ASSERT_EQUAL(buf->len, 0);
+	pomp_buffer_unref(buf);
+
+	/* Big capacity is allocated out of line */
+	buf = pomp_buffer_new(POMP_BUFFER_INLINE_SIZE + 1);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	CU_ASSERT_EQUAL(buf->inlinecap, 0);
+	CU_ASSERT_PTR_NOT_NULL(buf->data);
+	pomp_buffer_unref(buf);
+}
+
+/** */
+static void test_buffer_growth(void)
+{
+	int res = 0;
+	struct pomp_buffer *buf = NULL;
+
+	buf = pomp_buffer_new(1024);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+
+	/* Small growth is amortized */
+	res = pomp_buffer_ensure_capacity(buf, 1025);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(buf->capacity, 1536);
+
+	/* Big growth is exact (aligned) */
+	res = pomp_buffer_ensure_capacity(buf, 100000);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(buf->capacity,
+			POMP_BUFFER_ALIGN_ALLOC_SIZE(100000));
+	pomp_buffer_unref(buf);
+}
+
+/** */
+static void test_buffer_slice(void)
+{
+	int res = 0;
+	size_t pos = 0;
+	uint8_t b = 0;
+	struct pomp_buffer *buf = NULL;
+	struct pomp_buffer *slice = NULL;
+	struct pomp_buffer *slice2 = NULL;
+	struct pomp_msg *msg = NULL;
+	struct pomp_msg *msg2 = NULL;
+	const void *cdata = NULL;
+	const void *slicedata = NULL;
+	void *data = NULL;
+	size_t len = 0, len2 = 0, capacity = 0;
+	uint32_t v = 0;
+
+	/* Two messages back to back in the same buffer */
+	msg = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(msg);
+	res = pomp_msg_write(msg, 1, "%u", 42);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_buffer_get_cdata(pomp_msg_get_buffer(msg),
+			&cdata, &len, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	buf = pomp_buffer_new(0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	res = pomp_buffer_append_data(buf, cdata, len);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_msg_write(msg, 2, "%u", 43);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_buffer_get_cdata(pomp_msg_get_buffer(msg),
+			&cdata, &len2, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_buffer_append_data(buf, cdata, len2);
+	CU_ASSERT_EQUAL(res, 0);
+	pomp_msg_destroy(msg);
+	msg = NULL;
+
+	/* Invalid ranges */
+	slice = pomp_buffer_new_slice(NULL, 0, 0);
+	CU_ASSERT_PTR_NULL(slice);
+	slice = pomp_buffer_new_slice(buf, len + len2 + 1, 0);
+	CU_ASSERT_PTR_NULL(slice);
+	slice = pomp_buffer_new_slice(buf, len, len2 + 1);
+	CU_ASSERT_PTR_NULL(slice);
+
+	/* Slice of second message, data is shared with parent */
+	slice = pomp_buffer_new_slice(buf, len, len2);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(slice);
+	CU_ASSERT_EQUAL(pomp_buffer_is_shared(slice), 1);
+	CU_ASSERT_EQUAL(pomp_buffer_is_shared(buf), 1);
+	res = pomp_buffer_get_cdata(buf, &cdata, NULL, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_buffer_get_cdata(slice, &slicedata, &len2, &capacity);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(slicedata, (const uint8_t *)cdata + len);
+	CU_ASSERT_EQUAL(capacity, len2);
+
+	/* Read-only */
+	res = pomp_buffer_get_data(slice, &data, NULL, NULL);
+	CU_ASSERT_EQUAL(res, -EPERM);
+	res = pomp_buffer_set_len(slice, 0);
+	CU_ASSERT_EQUAL(res, -EPERM);
+	res = pomp_buffer_ensure_capacity(slice, 1024);
+	CU_ASSERT_EQUAL(res, -EPERM);
+	pos = 0;
+	res = pomp_buffer_write(slice, &pos, &b, sizeof(b));
+	CU_ASSERT_EQUAL(res, -EPERM);
+	res = pomp_buffer_append_data(buf, &b, sizeof(b));
+	CU_ASSERT_EQUAL(res, -EPERM);
+	pos = 0;
+	res = pomp_buffer_read(slice, &pos, &b, sizeof(b));
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(b, 'P');
+
+	/* Decode message from slice */
+	msg2 = pomp_msg_new_with_buffer(slice);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(msg2);
+	CU_ASSERT_EQUAL(pomp_msg_get_id(msg2), 2);
+	res = pomp_msg_read(msg2, "%u", &v);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(v, 43);
+
+	/* Slice of slice references the owner of data */
+	slice2 = pomp_buffer_new_slice(slice, 1, 2);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(slice2);
+	CU_ASSERT_PTR_EQUAL(slice2->parent, buf);
+	CU_ASSERT_PTR_EQUAL(slice2->data, (const uint8_t *)slicedata + 1);
+	pomp_buffer_unref(slice);
+	pomp_msg_destroy(msg2);
+	CU_ASSERT_EQUAL(pomp_buffer_is_shared(buf), 1);
+	pomp_buffer_unref(slice2);
+
+	/* Parent is writable again once all slices are released */
+	CU_ASSERT_EQUAL(pomp_buffer_is_shared(buf), 0);
+	res = pomp_buffer_append_data(buf, &b, sizeof(b));
+	CU_ASSERT_EQUAL(res, 0);
+	pomp_buffer_unref(buf);
+}
+
+/** */
+static void test_buffer_external_release_cb(void *data, size_t len,
+		void *userdata)
+{
+	int *count = userdata;
+	CU_ASSERT_EQUAL(len, 4);
+	CU_ASSERT_EQUAL(((const uint8_t *)data)[0], 0x11);
+	(*count)++;
+}
+
+/** */
+static void test_buffer_external(void)
+{
+	static uint8_t extdata[4] = {0x11, 0x22, 0x33, 0x44};
+	int res = 0;
+	int count = 0;
+	size_t pos = 0;
+	uint8_t b = 0;
+	struct pomp_buffer *buf = NULL;
+	struct pomp_buffer *slice = NULL;
+	const void *cdata = NULL;
+	size_t len = 0;
+
+	/* Invalid data */
+	buf = pomp_buffer_new_external(NULL, 4, NULL, NULL);
+	CU_ASSERT_PTR_NULL(buf);
+
+	/* No copy, read-only */
+	buf = pomp_buffer_new_external(extdata, sizeof(extdata),
+			&test_buffer_external_release_cb, &count);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	CU_ASSERT_EQUAL(pomp_buffer_is_shared(buf), 1);
+	res = pomp_buffer_get_cdata(buf, &cdata, &len, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(cdata, extdata);
+	CU_ASSERT_EQUAL(len, sizeof(extdata));
+	res = pomp_buffer_append_data(buf, &b, sizeof(b));
+	CU_ASSERT_EQUAL(res, -EPERM);
+	pos = 1;
+	res = pomp_buffer_read(buf, &pos, &b, sizeof(b));
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(b, 0x22);
+
+	/* Released only when the last reference is dropped */
+	slice = pomp_buffer_new_slice(buf, 2, 2);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(slice);
+	pomp_buffer_ref(buf);
+	pomp_buffer_unref(buf);
+	pomp_buffer_unref(buf);
+	CU_ASSERT_EQUAL(count, 0);
+	pomp_buffer_unref(slice);
+	CU_ASSERT_EQUAL(count, 1);
+
+	/* Without release function */
+	buf = pomp_buffer_new_external(extdata, sizeof(extdata), NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	pomp_buffer_unref(buf);
+}
+
 /** */
 static void test_buffer_fd(void)
 {
@@ -1701,6 +1925,63 @@ static void test_encoder_argv(void)
 	CU_ASSERT_EQUAL(res, 0);
 }
 
+/** */
+static void test_encoder_reserve(void)
+{
+	int res = 0;
+	struct pomp_msg *msg = NULL;
+	uint8_t *payload = NULL;
+	const void *p = NULL;
+	uint32_t len = 0;
+	int8_t i8 = 0;
+	uint16_t u16 = 0;
+	int32_t i32 = 0;
+	signed long long int i64 = 0;
+	unsigned long long int u64 = 0;
+	char *str = NULL;
+	float f32 = 0;
+	double f64 = 0;
+
+	payload = calloc(1, 100000);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(payload);
+	payload[99999] = 0x42;
+
+	/* Room for all arguments is reserved once with the exact size */
+	msg = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(msg);
+	res = pomp_msg_write(msg, 1, "%hhd%hu%d%lld%s%p%u%f%lf%llu",
+			-1, 1000, -100000, -1LL, "pomp", payload, 100000,
+			1.5f, 2.5, 1ULL << 63);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(msg->buf->len, POMP_PROT_HEADER_SIZE
+			+ 2 + 3 + 4 + 2 + 7 + 1 + 3 + 100000 + 5 + 9 + 11);
+	CU_ASSERT_EQUAL(msg->buf->capacity,
+			POMP_BUFFER_ALIGN_ALLOC_SIZE(msg->buf->len));
+
+	res = pomp_msg_read(msg, "%hhd%hu%d%lld%ms%p%u%f%lf%llu",
+			&i8, &u16, &i32, &i64, &str, &p, &len,
+			&f32, &f64, &u64);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(i8, -1);
+	CU_ASSERT_EQUAL(u16, 1000);
+	CU_ASSERT_EQUAL(i32, -100000);
+	CU_ASSERT_EQUAL(i64, -1);
+	CU_ASSERT_STRING_EQUAL(str, "pomp");
+	CU_ASSERT_EQUAL(len, 100000);
+	CU_ASSERT_EQUAL(((const uint8_t *)p)[99999], 0x42);
+	CU_ASSERT_EQUAL(f32, 1.5f);
+	CU_ASSERT_EQUAL(f64, 2.5);
+	CU_ASSERT_EQUAL(u64, 1ULL << 63);
+	free(str);
+
+	/* Invalid format is still reported by the write itself */
+	res = pomp_msg_write(msg, 1, "%p%d", payload, 4);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	pomp_msg_destroy(msg);
+	free(payload);
+}
+
 /** */
 static void test_encoder_fd(void)
 {
@@ -2597,6 +2878,103 @@ static void test_decoder_dump(void)
 	CU_ASSERT_EQUAL(res, 0);
 }
 
+/** */
+static void test_decoder_next(void)
+{
+	int res = 0;
+	struct pomp_msg *msg = NULL;
+	struct pomp_decoder *dec = NULL;
+	enum pomp_arg_type type = 0;
+	union pomp_value v;
+	uint32_t buflen = 0;
+	const void *data = NULL;
+	size_t len = 0;
+
+	msg = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(msg);
+	res = pomp_msg_write(msg, TEST_MSGID, "%hhd%llu%s%p%u%lf",
+			TEST_VAL_I8, (unsigned long long)TEST_VAL_U64,
+			TEST_VAL_STR, TEST_VAL_BUF, TEST_VAL_BUFLEN,
+			TEST_VAL_F64);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = pomp_buffer_get_cdata(pomp_msg_get_buffer(msg), &data, &len,
+			NULL);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	dec = pomp_decoder_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(dec);
+	res = pomp_decoder_init(dec, msg);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Iterate over all arguments */
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 1);
+	CU_ASSERT_EQUAL(type, POMP_ARG_TYPE_I8);
+	CU_ASSERT_EQUAL(v.i8, TEST_VAL_I8);
+	CU_ASSERT_EQUAL(buflen, 0);
+
+	res = pomp_decoder_next(dec, &type, &v, NULL);
+	CU_ASSERT_EQUAL(res, 1);
+	CU_ASSERT_EQUAL(type, POMP_ARG_TYPE_U64);
+	CU_ASSERT_EQUAL(v.u64, TEST_VAL_U64);
+
+	/* String and buffer point inside the message */
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 1);
+	CU_ASSERT_EQUAL(type, POMP_ARG_TYPE_STR);
+	CU_ASSERT_STRING_EQUAL(v.cstr, TEST_VAL_STR);
+	CU_ASSERT_TRUE((const uint8_t *)v.cstr > (const uint8_t *)data);
+	CU_ASSERT_TRUE((const uint8_t *)v.cstr < (const uint8_t *)data + len);
+
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 1);
+	CU_ASSERT_EQUAL(type, POMP_ARG_TYPE_BUF);
+	CU_ASSERT_EQUAL(buflen, TEST_VAL_BUFLEN);
+	CU_ASSERT_EQUAL(memcmp(v.cbuf, TEST_VAL_BUF, TEST_VAL_BUFLEN), 0);
+	CU_ASSERT_TRUE((const uint8_t *)v.cbuf > (const uint8_t *)data);
+	CU_ASSERT_TRUE((const uint8_t *)v.cbuf < (const uint8_t *)data + len);
+
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 1);
+	CU_ASSERT_EQUAL(type, POMP_ARG_TYPE_F64);
+	CU_ASSERT_EQUAL(v.f64, TEST_VAL_F64);
+	CU_ASSERT_EQUAL(buflen, 0);
+
+	/* End of message, several times */
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Mix with typed reads */
+	res = pomp_decoder_init(dec, msg);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_decoder_read_i8(dec, &v.i8);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, 1);
+	CU_ASSERT_EQUAL(type, POMP_ARG_TYPE_U64);
+
+	/* Invalid parameters */
+	res = pomp_decoder_next(NULL, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_decoder_next(dec, NULL, &v, &buflen);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_decoder_next(dec, &type, NULL, &buflen);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	/* Invalid (cleared decoder) */
+	res = pomp_decoder_clear(dec);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_decoder_next(dec, &type, &v, &buflen);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	res = pomp_decoder_destroy(dec);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_msg_destroy(msg);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
 /** */
 static void test_decoder_fd(void)
 {
@@ -3045,6 +3423,10 @@ static CU_TestInfo s_buffer_tests[] = {
 	{(char *)"test_buffer_append_buffer", &test_buffer_append_buffer},
 	{(char *)"read_write", &test_buffer_read_write},
 	{(char *)"perm", &test_buffer_perm},
+	{(char *)"inline", &test_buffer_inline},
+	{(char *)"growth", &test_buffer_growth},
+	{(char *)"slice", &test_buffer_slice},
+	{(char *)"external", &test_buffer_external},
 	{(char *)"fd", &test_buffer_fd},
 	CU_TEST_INFO_NULL,
 };
@@ -3067,6 +3449,7 @@ static CU_TestInfo s_encoder_tests[] = {
 	{(char *)"printf_no_payload", &test_encoder_printf_no_payload},
 	{(char *)"printf_32_64", &test_encoder_printf_32_64},
 	{(char *)"argv", &test_encoder_argv},
+	{(char *)"reserve", &test_encoder_reserve},
 	{(char *)"fd", &test_encoder_fd},
 	CU_TEST_INFO_NULL,
 };
@@ -3079,6 +3462,7 @@ static CU_TestInfo s_decoder_tests[] = {
 	{(char *)"scanf_no_payload", &test_decoder_scanf_no_payload},
 	{(char *)"scanf_32_64", &test_decoder_scanf_32_64},
 	{(char *)"dump", &test_decoder_dump},
+	{(char *)"next", &test_decoder_next},
 	{(char *)"fd", &test_decoder_fd},
 	CU_TEST_INFO_NULL,
 };
@@ -1374,6 +1374,1899 @@ static void test_invalid_addr(void)
 
 }
 
+#ifndef _WIN32
+
+#define TEST_UNIX_PEERS_MAX_CLI	2
+
+/** Server and clients connected through a unix socket on a shared loop */
+struct test_unix_peers {
+	struct pomp_loop	*loop;
+	struct pomp_ctx		*srv_ctx;
+	struct pomp_ctx		*cli_ctx[TEST_UNIX_PEERS_MAX_CLI];
+	uint32_t		clicount;
+	struct sockaddr_un	addr_un;
+};
+
+/**
+ * Create the loop and contexts, they can be configured before being started.
+ * @param peers : peers to initialize.
+ * @param path : path of the unix socket.
+ * @param srvcb : event callback of the server.
+ * @param clicb : event callback of the clients.
+ * @param userdata : user data given to all callbacks.
+ * @param clicount : number of clients.
+ */
+static void test_unix_peers_init(struct test_unix_peers *peers,
+		const char *path, pomp_event_cb_t srvcb, pomp_event_cb_t clicb,
+		void *userdata, uint32_t clicount)
+{
+	uint32_t i = 0;
+
+	CU_ASSERT_TRUE_FATAL(clicount <= TEST_UNIX_PEERS_MAX_CLI);
+	memset(peers, 0, sizeof(*peers));
+	peers->clicount = clicount;
+	peers->addr_un.sun_family = AF_UNIX;
+	strcpy(peers->addr_un.sun_path, path);
+
+	peers->loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(peers->loop);
+	peers->srv_ctx = pomp_ctx_new_with_loop(srvcb, userdata, peers->loop);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(peers->srv_ctx);
+	for (i = 0; i < clicount; i++) {
+		peers->cli_ctx[i] = pomp_ctx_new_with_loop(clicb, userdata,
+				peers->loop);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(peers->cli_ctx[i]);
+	}
+}
+
+/**
+ * Start the server and the clients and wait until all are connected.
+ * @param peers : peers to start.
+ */
+static void test_unix_peers_start(struct test_unix_peers *peers)
+{
+	int res = 0;
+	uint32_t i = 0, srvcount = 0, clicount = 0;
+	struct pomp_conn *conn = NULL;
+
+	res = pomp_ctx_listen(peers->srv_ctx,
+			(const struct sockaddr *)&peers->addr_un,
+			sizeof(peers->addr_un));
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	for (i = 0; i < peers->clicount; i++) {
+		res = pomp_ctx_connect(peers->cli_ctx[i],
+				(const struct sockaddr *)&peers->addr_un,
+				sizeof(peers->addr_un));
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	while (srvcount < peers->clicount || clicount < peers->clicount) {
+		res = pomp_loop_wait_and_process(peers->loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+
+		srvcount = 0;
+		conn = pomp_ctx_get_next_conn(peers->srv_ctx, NULL);
+		while (conn != NULL) {
+			srvcount++;
+			conn = pomp_ctx_get_next_conn(peers->srv_ctx, conn);
+		}
+		clicount = 0;
+		for (i = 0; i < peers->clicount; i++) {
+			if (pomp_ctx_get_conn(peers->cli_ctx[i]) != NULL)
+				clicount++;
+		}
+	}
+}
+
+/**
+ * Stop and destroy the contexts and the loop.
+ * @param peers : peers to clean.
+ */
+static void test_unix_peers_cleanup(struct test_unix_peers *peers)
+{
+	int res = 0;
+	uint32_t i = 0;
+
+	for (i = 0; i < peers->clicount; i++) {
+		res = pomp_ctx_stop(peers->cli_ctx[i]);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_ctx_stop(peers->srv_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	for (i = 0; i < peers->clicount; i++) {
+		res = pomp_ctx_destroy(peers->cli_ctx[i]);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_ctx_destroy(peers->srv_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_loop_destroy(peers->loop);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+#define TEST_PRIO_BULK_COUNT	64
+#define TEST_PRIO_BULK_SIZE	(64 * 1024)
+#define TEST_PRIO_MSGID_CONTROL	1
+#define TEST_PRIO_MSGID_BULK	2
+
+/** */
+struct test_prio_data {
+	uint32_t	rxcount;
+	uint32_t	control_rank;
+	uint8_t		*payload;
+};
+
+/** */
+static void test_prio_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct test_prio_data *data = userdata;
+	struct pomp_msg *bulk = NULL;
+	struct pomp_msg *control = NULL;
+
+	if (event != POMP_EVENT_CONNECTED)
+		return;
+
+	/* Fill the socket and the queue with bulk data */
+	bulk = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(bulk);
+	res = pomp_msg_write(bulk, TEST_PRIO_MSGID_BULK, "%p%u",
+			data->payload, TEST_PRIO_BULK_SIZE);
+	CU_ASSERT_EQUAL(res, 0);
+	for (i = 0; i < TEST_PRIO_BULK_COUNT; i++) {
+		res = pomp_conn_send_msg_prio(conn, bulk, POMP_SEND_PRIO_BULK);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	pomp_msg_destroy(bulk);
+
+	/* Then an urgent control message */
+	control = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(control);
+	res = pomp_msg_write(control, TEST_PRIO_MSGID_CONTROL, "%u", 42);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_send_msg_prio(conn, control, POMP_SEND_PRIO_CONTROL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Invalid priority class */
+	res = pomp_conn_send_msg_prio(conn, control, POMP_SEND_PRIO_COUNT);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_send_msg_prio(ctx, control, POMP_SEND_PRIO_COUNT);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	pomp_msg_destroy(control);
+}
+
+/** */
+static void test_prio_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	struct test_prio_data *data = userdata;
+
+	if (event != POMP_EVENT_MSG)
+		return;
+
+	if (pomp_msg_get_id(msg) == TEST_PRIO_MSGID_CONTROL)
+		data->control_rank = data->rxcount;
+	data->rxcount++;
+}
+
+/** */
+static void test_ctx_send_prio(void)
+{
+	int res = 0;
+	struct test_unix_peers peers;
+	struct test_prio_data data;
+
+	memset(&data, 0, sizeof(data));
+	data.control_rank = UINT32_MAX;
+	data.payload = calloc(1, TEST_PRIO_BULK_SIZE);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.payload);
+
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-prio",
+			&test_prio_srv_event_cb, &test_prio_cli_event_cb,
+			&data, 1);
+	test_unix_peers_start(&peers);
+
+	while (data.rxcount < TEST_PRIO_BULK_COUNT + 1) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* The control message shall have overtaken queued bulk messages */
+	CU_ASSERT_TRUE(data.control_rank < TEST_PRIO_BULK_COUNT);
+
+	test_unix_peers_cleanup(&peers);
+	free(data.payload);
+}
+
+#define TEST_BUF_REF_MSGID	4
+#define TEST_BUF_REF_SIZE	(1024 * 1024)
+
+/** */
+struct test_buf_ref_data {
+	uint32_t	rxcount;
+	struct pomp_buffer	*seg1;
+	struct pomp_buffer	*seg2;
+};
+
+/** */
+static void test_buf_ref_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	struct test_buf_ref_data *data = userdata;
+	struct pomp_msg *refmsg = NULL;
+	struct pomp_encoder *enc = NULL;
+	struct pomp_decoder *dec = NULL;
+
+	if (event != POMP_EVENT_CONNECTED)
+		return;
+
+	refmsg = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(refmsg);
+	enc = pomp_encoder_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(enc);
+	res = pomp_msg_init(refmsg, TEST_BUF_REF_MSGID);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_encoder_init(enc, refmsg);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Interleave copied and referenced data */
+	res = pomp_encoder_write_u32(enc, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_encoder_write_buf_ref(enc, data->seg1);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_encoder_write_u32(enc, 2);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_encoder_write_buf_ref(enc, data->seg2);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_encoder_write_u32(enc, 3);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_msg_finish(refmsg);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Referenced buffers are read-only */
+	CU_ASSERT_TRUE(pomp_buffer_is_shared(data->seg1));
+
+	/* Message can not be decoded locally */
+	dec = pomp_decoder_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(dec);
+	res = pomp_decoder_init(dec, refmsg);
+	CU_ASSERT_EQUAL(res, -ENOTSUP);
+	pomp_decoder_destroy(dec);
+
+	res = pomp_conn_send_msg(conn, refmsg);
+	CU_ASSERT_EQUAL(res, 0);
+
+	pomp_encoder_destroy(enc);
+	pomp_msg_destroy(refmsg);
+}
+
+/** */
+static void test_buf_ref_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	struct test_buf_ref_data *data = userdata;
+	uint32_t v1 = 0, v2 = 0, v3 = 0, len1 = 0, len2 = 0;
+	const void *p1 = NULL, *p2 = NULL;
+	const void *cdata = NULL;
+	size_t len = 0;
+
+	if (event != POMP_EVENT_MSG)
+		return;
+
+	CU_ASSERT_EQUAL(pomp_msg_get_id(msg), TEST_BUF_REF_MSGID);
+	res = pomp_msg_read(msg, "%u%p%u%u%p%u%u",
+			&v1, &p1, &len1, &v2, &p2, &len2, &v3);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	CU_ASSERT_EQUAL(v1, 1);
+	CU_ASSERT_EQUAL(v2, 2);
+	CU_ASSERT_EQUAL(v3, 3);
+
+	(void)pomp_buffer_get_cdata(data->seg1, &cdata, &len, NULL);
+	CU_ASSERT_EQUAL_FATAL(len1, len);
+	CU_ASSERT_TRUE(memcmp(p1, cdata, len) == 0);
+	(void)pomp_buffer_get_cdata(data->seg2, &cdata, &len, NULL);
+	CU_ASSERT_EQUAL_FATAL(len2, len);
+	CU_ASSERT_TRUE(memcmp(p2, cdata, len) == 0);
+	data->rxcount++;
+}
+
+/** */
+static void test_ctx_buf_ref(void)
+{
+	int res = 0;
+	size_t i = 0;
+	uint8_t *p = NULL;
+	struct test_unix_peers peers;
+	struct test_buf_ref_data data;
+
+	memset(&data, 0, sizeof(data));
+	data.seg1 = pomp_buffer_new_get_data(TEST_BUF_REF_SIZE, (void **)&p);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.seg1);
+	for (i = 0; i < TEST_BUF_REF_SIZE; i++)
+		p[i] = (uint8_t)(i * 7);
+	res = pomp_buffer_set_len(data.seg1, TEST_BUF_REF_SIZE);
+	CU_ASSERT_EQUAL(res, 0);
+	data.seg2 = pomp_buffer_new_with_data("pomp", 4);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.seg2);
+
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-buf-ref",
+			&test_buf_ref_srv_event_cb, &test_buf_ref_cli_event_cb,
+			&data, 1);
+	test_unix_peers_start(&peers);
+
+	while (data.rxcount < 1) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* All references released once written */
+	CU_ASSERT_FALSE(pomp_buffer_is_shared(data.seg1));
+	CU_ASSERT_FALSE(pomp_buffer_is_shared(data.seg2));
+
+	test_unix_peers_cleanup(&peers);
+	pomp_buffer_unref(data.seg1);
+	pomp_buffer_unref(data.seg2);
+}
+
+#define TEST_CONFLATION_SAMPLE_COUNT	100
+#define TEST_CONFLATION_MSGID_SAMPLE	3
+
+/** */
+struct test_conflation_data {
+	uint32_t	bulkcount;
+	uint32_t	samplecount;
+	uint32_t	lastsample;
+	uint32_t	abortcount;
+	uint8_t		*payload;
+};
+
+/** */
+static void test_conflation_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct test_conflation_data *data = userdata;
+	struct pomp_msg *bulk = NULL;
+
+	if (event != POMP_EVENT_CONNECTED)
+		return;
+
+	/* Stall the connection with bulk data */
+	bulk = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(bulk);
+	res = pomp_msg_write(bulk, TEST_PRIO_MSGID_BULK, "%p%u",
+			data->payload, TEST_PRIO_BULK_SIZE);
+	CU_ASSERT_EQUAL(res, 0);
+	for (i = 0; i < TEST_PRIO_BULK_COUNT; i++) {
+		res = pomp_conn_send_msg(conn, bulk);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	pomp_msg_destroy(bulk);
+
+	/* Only the latest sample shall remain in the queue */
+	for (i = 0; i < TEST_CONFLATION_SAMPLE_COUNT; i++) {
+		res = pomp_conn_send(conn, TEST_CONFLATION_MSGID_SAMPLE,
+				"%u", i);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+}
+
+/** */
+static void test_conflation_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	struct test_conflation_data *data = userdata;
+
+	if (event != POMP_EVENT_MSG)
+		return;
+
+	if (pomp_msg_get_id(msg) == TEST_CONFLATION_MSGID_SAMPLE) {
+		res = pomp_msg_read(msg, "%u", &data->lastsample);
+		CU_ASSERT_EQUAL(res, 0);
+		data->samplecount++;
+	} else {
+		data->bulkcount++;
+	}
+}
+
+/** */
+static void test_conflation_send_cb(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, struct pomp_buffer *buf,
+		uint32_t status, void *cookie, void *userdata)
+{
+	struct test_conflation_data *data = userdata;
+	if (status & POMP_SEND_STATUS_ABORTED)
+		data->abortcount++;
+}
+
+/** */
+static void test_ctx_msg_conflation(void)
+{
+	int res = 0;
+	struct test_unix_peers peers;
+	struct test_conflation_data data;
+
+	memset(&data, 0, sizeof(data));
+	data.payload = calloc(1, TEST_PRIO_BULK_SIZE);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.payload);
+
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-conflation",
+			&test_conflation_srv_event_cb,
+			&test_conflation_cli_event_cb, &data, 1);
+
+	/* Invalid arguments */
+	res = pomp_ctx_set_msg_conflation(NULL,
+			TEST_CONFLATION_MSGID_SAMPLE, 1);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	/* Enable, disable and enable again */
+	res = pomp_ctx_set_msg_conflation(peers.srv_ctx,
+			TEST_CONFLATION_MSGID_SAMPLE, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_msg_conflation(peers.srv_ctx,
+			TEST_CONFLATION_MSGID_SAMPLE, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_msg_conflation(peers.srv_ctx,
+			TEST_CONFLATION_MSGID_SAMPLE, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_msg_conflation(peers.srv_ctx,
+			TEST_CONFLATION_MSGID_SAMPLE + 1, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_send_cb(peers.srv_ctx, &test_conflation_send_cb);
+	CU_ASSERT_EQUAL(res, 0);
+
+	test_unix_peers_start(&peers);
+
+	/* Wait for all messages and all send notifications */
+	while (data.bulkcount < TEST_PRIO_BULK_COUNT
+			|| data.lastsample != TEST_CONFLATION_SAMPLE_COUNT - 1
+			|| data.samplecount + data.abortcount
+				< TEST_CONFLATION_SAMPLE_COUNT) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Intermediate samples shall have been dropped */
+	CU_ASSERT_TRUE(data.samplecount < TEST_CONFLATION_SAMPLE_COUNT);
+	CU_ASSERT_EQUAL(data.samplecount + data.abortcount,
+			TEST_CONFLATION_SAMPLE_COUNT);
+
+	test_unix_peers_cleanup(&peers);
+	free(data.payload);
+}
+
+#define TEST_USERDATA_MSGID	20
+
+struct test_userdata_data;
+
+/** */
+struct test_userdata_slot {
+	struct test_userdata_data	*data;
+};
+
+/** */
+struct test_userdata_data {
+	struct test_userdata_slot	slots[2];
+	uint32_t			msgcount;
+	uint32_t			disconnected;
+	uint32_t			destroycount;
+	uint32_t			destroyafterdisc;
+};
+
+/** */
+static void test_userdata_destroy_cb(struct pomp_conn *conn, void *userdata)
+{
+	struct test_userdata_slot *slot = userdata;
+	struct test_userdata_data *data = slot->data;
+
+	data->destroycount++;
+	if (data->disconnected)
+		data->destroyafterdisc++;
+}
+
+/** */
+static void test_userdata_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	struct test_userdata_data *data = userdata;
+
+	switch (event) {
+	case POMP_EVENT_CONNECTED:
+		/* Invalid arguments */
+		res = pomp_conn_set_userdata(NULL, data);
+		CU_ASSERT_EQUAL(res, -EINVAL);
+		CU_ASSERT_PTR_NULL(pomp_conn_get_userdata(NULL));
+		CU_ASSERT_PTR_NULL(pomp_conn_get_userdata(conn));
+
+		/* Replacing data shall release the previous one */
+		data->slots[0].data = data;
+		data->slots[1].data = data;
+		res = pomp_conn_set_userdata_full(conn, &data->slots[0],
+				&test_userdata_destroy_cb);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pomp_conn_set_userdata_full(conn, &data->slots[1],
+				&test_userdata_destroy_cb);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_EQUAL(data->destroycount, 1);
+		break;
+
+	case POMP_EVENT_MSG:
+		CU_ASSERT_PTR_EQUAL(pomp_conn_get_userdata(conn),
+				&data->slots[1]);
+		data->msgcount++;
+		break;
+
+	case POMP_EVENT_DISCONNECTED:
+		/* Still attached during the notification */
+		CU_ASSERT_PTR_EQUAL(pomp_conn_get_userdata(conn),
+				&data->slots[1]);
+		CU_ASSERT_EQUAL(data->destroycount, 1);
+		data->disconnected++;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/** */
+static void test_userdata_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+
+	if (event != POMP_EVENT_CONNECTED)
+		return;
+
+	/* No destructor set on this side */
+	res = pomp_conn_set_userdata(conn, userdata);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_PTR_EQUAL(pomp_conn_get_userdata(conn), userdata);
+	res = pomp_conn_send(conn, TEST_USERDATA_MSGID, "%u", 42);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+/** */
+static void test_ctx_conn_userdata(void)
+{
+	int res = 0;
+	struct test_unix_peers peers;
+	struct test_userdata_data data;
+
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-userdata",
+			&test_userdata_srv_event_cb,
+			&test_userdata_cli_event_cb, &data, 1);
+	test_unix_peers_start(&peers);
+
+	while (data.msgcount == 0) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Disconnect client, destructor called after server notification */
+	res = pomp_ctx_stop(peers.cli_ctx[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	while (data.destroycount < 2) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	CU_ASSERT_EQUAL(data.disconnected, 1);
+	CU_ASSERT_EQUAL(data.destroyafterdisc, 1);
+
+	test_unix_peers_cleanup(&peers);
+	CU_ASSERT_EQUAL(data.destroycount, 2);
+}
+
+#define TEST_HANDLER_MSGID_SMALL	1
+#define TEST_HANDLER_MSGID_LARGE	100000
+#define TEST_HANDLER_MSGID_MISMATCH	2
+#define TEST_HANDLER_MSGID_NONE		3
+
+/** */
+struct test_handler_data {
+	uint32_t	smallcount;
+	uint32_t	largecount;
+	uint32_t	eventcount;
+	uint32_t	mismatchcount;
+};
+
+/** */
+static void test_handler_small_cb(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		const union pomp_value *argv, uint32_t argc, void *userdata)
+{
+	struct test_handler_data *data = userdata;
+
+	CU_ASSERT_EQUAL(pomp_msg_get_id(msg), TEST_HANDLER_MSGID_SMALL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(argv);
+	CU_ASSERT_EQUAL_FATAL(argc, 5);
+	CU_ASSERT_EQUAL(argv[0].u32, 42);
+	CU_ASSERT_STRING_EQUAL(argv[1].cstr, "hello");
+	CU_ASSERT_EQUAL(argv[3].u32, 4);
+	CU_ASSERT_EQUAL(memcmp(argv[2].cbuf, "\x01\x02\x03\x04", 4), 0);
+	CU_ASSERT_EQUAL(argv[4].i64, -7);
+	data->smallcount++;
+}
+
+/** */
+static void test_handler_large_cb(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		const union pomp_value *argv, uint32_t argc, void *userdata)
+{
+	int res = 0;
+	uint32_t v = 0;
+	struct test_handler_data *data = userdata;
+
+	/* No format, message given as is */
+	CU_ASSERT_EQUAL(pomp_msg_get_id(msg), TEST_HANDLER_MSGID_LARGE);
+	CU_ASSERT_PTR_NULL(argv);
+	CU_ASSERT_EQUAL(argc, 0);
+	res = pomp_msg_read(msg, "%u", &v);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(v, 43);
+	data->largecount++;
+
+	/* Unregister itself from the callback */
+	res = pomp_ctx_register_msg_handler(ctx, TEST_HANDLER_MSGID_LARGE,
+			NULL, NULL, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+/** */
+static void test_handler_mismatch_cb(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		const union pomp_value *argv, uint32_t argc, void *userdata)
+{
+	struct test_handler_data *data = userdata;
+	data->mismatchcount++;
+}
+
+/** */
+static void test_handler_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	struct test_handler_data *data = userdata;
+
+	if (event == POMP_EVENT_MSG)
+		data->eventcount++;
+}
+
+/** */
+static void test_handler_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	signed long long int i64 = -7;
+
+	if (event != POMP_EVENT_CONNECTED)
+		return;
+
+	res = pomp_conn_send(conn, TEST_HANDLER_MSGID_SMALL, "%u%s%p%u%lld",
+			42, "hello", "\x01\x02\x03\x04", 4, i64);
+	CU_ASSERT_EQUAL(res, 0);
+	/* Second one handled by event callback after unregistration */
+	res = pomp_conn_send(conn, TEST_HANDLER_MSGID_LARGE, "%u", 43);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_send(conn, TEST_HANDLER_MSGID_LARGE, "%u", 43);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_send(conn, TEST_HANDLER_MSGID_MISMATCH, "%s", "x");
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_send(conn, TEST_HANDLER_MSGID_NONE, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_send(conn, TEST_HANDLER_MSGID_SMALL, "%u%s%p%u%lld",
+			42, "hello", "\x01\x02\x03\x04", 4, i64);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+/** */
+static void test_ctx_msg_handler(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct pomp_ctx *srv_ctx = NULL;
+	struct pomp_ctx *raw_ctx = NULL;
+	struct test_unix_peers peers;
+	struct test_handler_data data;
+
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-handler",
+			&test_handler_srv_event_cb, &test_handler_cli_event_cb,
+			&data, 1);
+	srv_ctx = peers.srv_ctx;
+
+	/* Invalid arguments */
+	res = pomp_ctx_register_msg_handler(NULL, TEST_HANDLER_MSGID_SMALL,
+			NULL, &test_handler_small_cb, &data);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_SMALL,
+			"%u%k", &test_handler_small_cb, &data);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_SMALL,
+			"%p", &test_handler_small_cb, &data);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_SMALL,
+			"%u%u%u%u%u%u%u%u%u%u%u%u%u%u%u%u"
+			"%u%u%u%u%u%u%u%u%u%u%u%u%u%u%u%u%u",
+			&test_handler_small_cb, &data);
+	CU_ASSERT_EQUAL(res, -E2BIG);
+	raw_ctx = pomp_ctx_new_with_loop(&test_handler_srv_event_cb,
+			&data, peers.loop);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(raw_ctx);
+	res = pomp_ctx_set_raw(raw_ctx, &test_ctx_raw_cb);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_register_msg_handler(raw_ctx, TEST_HANDLER_MSGID_SMALL,
+			NULL, &test_handler_small_cb, &data);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_destroy(raw_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Unregistering an unknown id is not an error */
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_NONE,
+			NULL, NULL, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Register (replacing the first one), fill the hash table a bit */
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_SMALL,
+			"%u", &test_handler_mismatch_cb, &data);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_SMALL,
+			"%u%s%p%u%lld", &test_handler_small_cb, &data);
+	CU_ASSERT_EQUAL(res, 0);
+	for (i = 0; i < 200; i++) {
+		res = pomp_ctx_register_msg_handler(srv_ctx,
+				TEST_HANDLER_MSGID_LARGE + 1 + i, NULL,
+				&test_handler_mismatch_cb, &data);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_ctx_register_msg_handler(srv_ctx, TEST_HANDLER_MSGID_LARGE,
+			NULL, &test_handler_large_cb, &data);
+	CU_ASSERT_EQUAL(res, 0);
+	for (i = 0; i < 200; i += 2) {
+		res = pomp_ctx_register_msg_handler(srv_ctx,
+				TEST_HANDLER_MSGID_LARGE + 1 + i, NULL,
+				NULL, NULL);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_ctx_register_msg_handler(srv_ctx,
+			TEST_HANDLER_MSGID_MISMATCH, "%u",
+			&test_handler_mismatch_cb, &data);
+	CU_ASSERT_EQUAL(res, 0);
+
+	test_unix_peers_start(&peers);
+
+	while (data.smallcount < 2) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Second large, mismatch and none given to event callback */
+	CU_ASSERT_EQUAL(data.largecount, 1);
+	CU_ASSERT_EQUAL(data.mismatchcount, 0);
+	CU_ASSERT_EQUAL(data.eventcount, 3);
+
+	test_unix_peers_cleanup(&peers);
+}
+
+#define TEST_BATCH_MSGID	30
+#define TEST_BATCH_MSG_COUNT	200
+
+/** */
+struct test_batch_data {
+	uint32_t	srvmsgcount;
+	uint32_t	srvbatchcount;
+	uint32_t	srvbatchends;
+	uint32_t	srvmaxbatch;
+	uint32_t	climsgcount;
+	uint32_t	clibatchends;
+	uint32_t	climsgatend;
+};
+
+/** */
+static void test_batch_srv_batch_cb(struct pomp_ctx *ctx,
+		struct pomp_conn *conn, const struct pomp_msg *const *msgs,
+		uint32_t count, void *userdata)
+{
+	int res = 0;
+	uint32_t i = 0, v = 0;
+	struct test_batch_data *data = userdata;
+
+	CU_ASSERT_TRUE(count > 0);
+	/* Batch end shall be notified after each batch */
+	CU_ASSERT_EQUAL(data->srvbatchends, data->srvbatchcount);
+	for (i = 0; i < count; i++) {
+		/* All messages alive and in order */
+		CU_ASSERT_EQUAL(pomp_msg_get_id(msgs[i]), TEST_BATCH_MSGID);
+		res = pomp_msg_read(msgs[i], "%u", &v);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_EQUAL(v, data->srvmsgcount);
+		data->srvmsgcount++;
+	}
+	if (count > data->srvmaxbatch)
+		data->srvmaxbatch = count;
+	data->srvbatchcount++;
+}
+
+/** */
+static void test_batch_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct test_batch_data *data = userdata;
+
+	switch (event) {
+	case POMP_EVENT_CONNECTED:
+		/* Per-message mode with batch end on client side */
+		for (i = 0; i < TEST_BATCH_MSG_COUNT; i++) {
+			res = pomp_conn_send(conn, TEST_BATCH_MSGID, "%u", i);
+			CU_ASSERT_EQUAL(res, 0);
+		}
+		break;
+
+	case POMP_EVENT_MSG:
+		/* Everything shall go through the batch callback */
+		CU_ASSERT_TRUE(0);
+		break;
+
+	case POMP_EVENT_BATCH_END:
+		CU_ASSERT_PTR_NULL(msg);
+		data->srvbatchends++;
+		CU_ASSERT_EQUAL(data->srvbatchends, data->srvbatchcount);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/** */
+static void test_batch_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct test_batch_data *data = userdata;
+
+	switch (event) {
+	case POMP_EVENT_CONNECTED:
+		for (i = 0; i < TEST_BATCH_MSG_COUNT; i++) {
+			res = pomp_conn_send(conn, TEST_BATCH_MSGID, "%u", i);
+			CU_ASSERT_EQUAL(res, 0);
+		}
+		break;
+
+	case POMP_EVENT_MSG:
+		data->climsgcount++;
+		break;
+
+	case POMP_EVENT_BATCH_END:
+		/* At least one message since previous end */
+		CU_ASSERT_TRUE(data->climsgcount > data->climsgatend);
+		data->climsgatend = data->climsgcount;
+		data->clibatchends++;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/** */
+static void test_ctx_batch(void)
+{
+	int res = 0;
+	struct pomp_ctx *raw_ctx = NULL;
+	struct test_unix_peers peers;
+	struct test_batch_data data;
+
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-batch",
+			&test_batch_srv_event_cb, &test_batch_cli_event_cb,
+			&data, 1);
+
+	/* Invalid arguments */
+	res = pomp_ctx_set_batch_cb(NULL, &test_batch_srv_batch_cb);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_set_batch_end_event(NULL, 1);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	raw_ctx = pomp_ctx_new_with_loop(&test_batch_srv_event_cb,
+			&data, peers.loop);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(raw_ctx);
+	res = pomp_ctx_set_raw(raw_ctx, &test_ctx_raw_cb);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_batch_cb(raw_ctx, &test_batch_srv_batch_cb);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_set_batch_end_event(raw_ctx, 1);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_destroy(raw_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+
+	res = pomp_ctx_set_batch_cb(peers.srv_ctx, &test_batch_srv_batch_cb);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_batch_end_event(peers.srv_ctx, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_set_batch_end_event(peers.cli_ctx[0], 1);
+	CU_ASSERT_EQUAL(res, 0);
+
+	test_unix_peers_start(&peers);
+
+	/* Can not be changed once started */
+	res = pomp_ctx_set_batch_cb(peers.srv_ctx, NULL);
+	CU_ASSERT_EQUAL(res, -EBUSY);
+	res = pomp_ctx_set_batch_end_event(peers.srv_ctx, 0);
+	CU_ASSERT_EQUAL(res, -EBUSY);
+
+	while (data.srvmsgcount < TEST_BATCH_MSG_COUNT
+			|| data.climsgcount < TEST_BATCH_MSG_COUNT) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Messages sent together shall have been received in batches */
+	CU_ASSERT_TRUE(data.srvmaxbatch > 1);
+	CU_ASSERT_TRUE(data.srvbatchcount < TEST_BATCH_MSG_COUNT);
+	CU_ASSERT_EQUAL(data.srvbatchends, data.srvbatchcount);
+	CU_ASSERT_TRUE(data.clibatchends > 0);
+	CU_ASSERT_TRUE(data.clibatchends < TEST_BATCH_MSG_COUNT);
+	CU_ASSERT_EQUAL(data.climsgatend, data.climsgcount);
+
+	test_unix_peers_cleanup(&peers);
+}
+
+#define TEST_ASYNC_MSGID		40
+#define TEST_ASYNC_MSGID_STALE		41
+#define TEST_ASYNC_THREAD_COUNT		4
+#define TEST_ASYNC_MSG_COUNT		500
+
+/** */
+struct test_async_data {
+	struct pomp_ctx	*srv_ctx;
+	uint64_t	connid;
+	uint32_t	connected;
+	uint32_t	msgcount;
+	uint32_t	stalecount;
+	uint32_t	next[TEST_ASYNC_THREAD_COUNT];
+};
+
+/** */
+struct test_async_thread {
+	struct test_async_data	*data;
+	uint32_t		idx;
+	uint32_t		errors;
+	pthread_t		thread;
+};
+
+/** */
+static void *test_async_thread(void *arg)
+{
+	uint32_t i = 0;
+	struct test_async_thread *t = arg;
+	struct pomp_msg *msg = NULL;
+
+	/* Alternate formatted sends and prepared messages, CUnit asserts are
+	 * not thread safe so only count errors here */
+	for (i = 0; i < TEST_ASYNC_MSG_COUNT; i++) {
+		if (i % 2 == 0) {
+			if (pomp_ctx_send_async(t->data->srv_ctx,
+					t->data->connid, TEST_ASYNC_MSGID,
+					"%u%u", t->idx, i) < 0)
+				t->errors++;
+			continue;
+		}
+		msg = pomp_msg_new();
+		if (msg == NULL
+				|| pomp_msg_write(msg, TEST_ASYNC_MSGID, "%u%u",
+					t->idx, i) < 0
+				|| pomp_ctx_send_msg_async(t->data->srv_ctx,
+					t->data->connid, msg) < 0)
+			t->errors++;
+		if (msg != NULL)
+			pomp_msg_destroy(msg);
+	}
+	return NULL;
+}
+
+/** */
+static void test_async_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	struct test_async_data *data = userdata;
+
+	if (event != POMP_EVENT_CONNECTED)
+		return;
+
+	/* Ids are unique and never 0 */
+	CU_ASSERT_EQUAL(pomp_conn_get_id(NULL), 0);
+	CU_ASSERT_NOT_EQUAL(pomp_conn_get_id(conn), 0);
+	CU_ASSERT_NOT_EQUAL(pomp_conn_get_id(conn), data->connid);
+	data->connid = pomp_conn_get_id(conn);
+	data->connected++;
+}
+
+/** */
+static void test_async_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	int res = 0;
+	uint32_t idx = 0, seq = 0;
+	struct test_async_data *data = userdata;
+
+	if (event != POMP_EVENT_MSG)
+		return;
+
+	if (pomp_msg_get_id(msg) == TEST_ASYNC_MSGID_STALE) {
+		data->stalecount++;
+		return;
+	}
+
+	/* Messages of each thread received in order */
+	res = pomp_msg_read(msg, "%u%u", &idx, &seq);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_TRUE_FATAL(idx < TEST_ASYNC_THREAD_COUNT);
+	CU_ASSERT_EQUAL(seq, data->next[idx]);
+	data->next[idx] = seq + 1;
+	data->msgcount++;
+}
+
+/** */
+static void test_ctx_send_async(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	uint64_t oldid = 0;
+	struct pomp_ctx *cli_ctx = NULL;
+	struct pomp_buffer *buf = NULL;
+	struct pomp_msg *msg = NULL;
+	struct test_unix_peers peers;
+	struct test_async_data data;
+	struct test_async_thread threads[TEST_ASYNC_THREAD_COUNT];
+
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-async",
+			&test_async_srv_event_cb, &test_async_cli_event_cb,
+			&data, 1);
+	data.srv_ctx = peers.srv_ctx;
+	cli_ctx = peers.cli_ctx[0];
+
+	/* Invalid arguments */
+	msg = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(msg);
+	res = pomp_ctx_send_msg_async(NULL, 0, msg);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_send_msg_async(data.srv_ctx, 0, NULL);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_send_msg_async(data.srv_ctx, 0, msg);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	pomp_msg_destroy(msg);
+	buf = pomp_buffer_new(16);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buf);
+	res = pomp_ctx_send_raw_buf_async(data.srv_ctx, 0, buf);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	pomp_buffer_unref(buf);
+
+	test_unix_peers_start(&peers);
+	CU_ASSERT_EQUAL(data.connected, 1);
+
+	/* Send from several threads while the loop runs */
+	for (i = 0; i < TEST_ASYNC_THREAD_COUNT; i++) {
+		threads[i].data = &data;
+		threads[i].idx = i;
+		threads[i].errors = 0;
+		res = pthread_create(&threads[i].thread, NULL,
+				&test_async_thread, &threads[i]);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	while (data.msgcount < TEST_ASYNC_THREAD_COUNT * TEST_ASYNC_MSG_COUNT) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	for (i = 0; i < TEST_ASYNC_THREAD_COUNT; i++) {
+		pthread_join(threads[i].thread, NULL);
+		CU_ASSERT_EQUAL(threads[i].errors, 0);
+	}
+
+	/* Reconnect: the previous id shall not reach the new connection */
+	oldid = data.connid;
+	res = pomp_ctx_stop(cli_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_connect(cli_ctx,
+			(const struct sockaddr *)&peers.addr_un,
+			sizeof(peers.addr_un));
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	while (data.connected < 2) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	CU_ASSERT_NOT_EQUAL(data.connid, oldid);
+	res = pomp_ctx_send_async(data.srv_ctx, oldid,
+			TEST_ASYNC_MSGID_STALE, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_send_async(data.srv_ctx, 0, TEST_ASYNC_MSGID_STALE,
+			NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	while (data.stalecount == 0) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	/* Only the broadcast one shall be received */
+	res = pomp_loop_wait_and_process(peers.loop, 100);
+	CU_ASSERT_EQUAL(data.stalecount, 1);
+
+	/* Pending operations are dropped on destroy */
+	res = pomp_ctx_send_async(data.srv_ctx, 0, TEST_ASYNC_MSGID, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	test_unix_peers_cleanup(&peers);
+}
+
+#define TEST_BUDGET_MSGID_FLOOD		50
+#define TEST_BUDGET_MSGID_PING		51
+#define TEST_BUDGET_FLOOD_COUNT		1000
+
+/** */
+struct test_budget_data {
+	uint32_t	floodcount;
+	uint32_t	pingcount;
+	uint32_t	pingat;
+};
+
+/** */
+static void test_budget_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	struct test_budget_data *data = userdata;
+
+	if (event != POMP_EVENT_MSG)
+		return;
+
+	if (pomp_msg_get_id(msg) == TEST_BUDGET_MSGID_FLOOD) {
+		data->floodcount++;
+	} else if (pomp_msg_get_id(msg) == TEST_BUDGET_MSGID_PING) {
+		/* Flood messages processed before the ping */
+		data->pingcount++;
+		data->pingat = data->floodcount;
+	}
+}
+
+/** */
+static void test_ctx_read_budget_run(size_t maxbytes, uint32_t maxmsgs,
+		int edge)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct test_unix_peers peers;
+	struct test_budget_data data;
+
+	/* First client floods, second one pings */
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-budget",
+			&test_budget_event_cb, &test_budget_event_cb,
+			&data, 2);
+
+	res = pomp_ctx_set_read_budget(peers.srv_ctx, maxbytes, maxmsgs);
+	CU_ASSERT_EQUAL(res, 0);
+	if (edge) {
+		res = pomp_ctx_set_edge_triggered(peers.srv_ctx, 1);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	test_unix_peers_start(&peers);
+
+	/* The flood is queued in the socket before the ping */
+	for (i = 0; i < TEST_BUDGET_FLOOD_COUNT; i++) {
+		res = pomp_ctx_send(peers.cli_ctx[0], TEST_BUDGET_MSGID_FLOOD,
+				"%u%s", i, "flood flood flood flood");
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_ctx_send(peers.cli_ctx[1], TEST_BUDGET_MSGID_PING, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	while (data.pingcount == 0
+			|| data.floodcount < TEST_BUDGET_FLOOD_COUNT) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* The ping did not wait for the whole flood */
+	CU_ASSERT_EQUAL(data.pingcount, 1);
+	CU_ASSERT_TRUE(data.pingat < TEST_BUDGET_FLOOD_COUNT / 4);
+
+	test_unix_peers_cleanup(&peers);
+}
+
+/** */
+static void test_ctx_read_budget(void)
+{
+	int res = 0;
+
+	/* Invalid arguments */
+	res = pomp_ctx_set_read_budget(NULL, 0, 0);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	/* Budget in messages, then in bytes */
+	test_ctx_read_budget_run(0, 32, 0);
+	test_ctx_read_budget_run(1024, 0, 0);
+}
+
+#ifdef __linux__
+
+#define TEST_EDGE_MSGID_BULK		60
+#define TEST_EDGE_BULK_SIZE		(64 * 1024)
+#define TEST_EDGE_BULK_COUNT		64
+
+/** */
+struct test_edge_data {
+	uint32_t	bulkcount;
+};
+
+/** */
+static void test_edge_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event, struct pomp_conn *conn,
+		const struct pomp_msg *msg, void *userdata)
+{
+	struct test_edge_data *data = userdata;
+
+	if (event == POMP_EVENT_MSG
+			&& pomp_msg_get_id(msg) == TEST_EDGE_MSGID_BULK)
+		data->bulkcount++;
+}
+
+/** */
+static uint32_t test_edge_get_events(struct pomp_loop *loop,
+		struct pomp_conn *conn)
+{
+	struct pomp_fd *pfd = pomp_loop_find_pfd(loop, pomp_conn_get_fd(conn));
+	return pfd != NULL ? pfd->events : 0;
+}
+
+/** */
+static void test_ctx_edge_triggered(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	uint8_t *bulk = NULL;
+	struct pomp_ctx *ctx = NULL;
+	struct pomp_conn *srv_conn = NULL;
+	struct pomp_conn *cli_conn = NULL;
+	struct test_unix_peers peers;
+	struct test_edge_data data;
+	const uint32_t edge_events = POMP_FD_EVENT_IN | POMP_FD_EVENT_OUT |
+			POMP_FD_EVENT_EDGE;
+#ifdef POMP_HAVE_LOOP_POLL
+	const struct pomp_loop_ops *loop_ops = NULL;
+#endif /* POMP_HAVE_LOOP_POLL */
+
+	memset(&data, 0, sizeof(data));
+
+	/* Invalid arguments */
+	res = pomp_ctx_set_edge_triggered(NULL, 1);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+#ifdef POMP_HAVE_LOOP_POLL
+	/* Not supported by the poll implementation */
+	loop_ops = pomp_loop_set_ops(&pomp_loop_poll_ops);
+	ctx = pomp_ctx_new(&test_edge_event_cb, &data);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx);
+	res = pomp_ctx_set_edge_triggered(ctx, 1);
+	CU_ASSERT_EQUAL(res, -ENOSYS);
+	res = pomp_ctx_set_edge_triggered(ctx, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_destroy(ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	pomp_loop_set_ops(loop_ops);
+#endif /* POMP_HAVE_LOOP_POLL */
+
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-edge",
+			&test_edge_event_cb, &test_edge_event_cb, &data, 1);
+	res = pomp_ctx_set_edge_triggered(peers.srv_ctx, 1);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = pomp_ctx_set_edge_triggered(peers.cli_ctx[0], 1);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	test_unix_peers_start(&peers);
+
+	/* Only when not started */
+	res = pomp_ctx_set_edge_triggered(peers.srv_ctx, 0);
+	CU_ASSERT_EQUAL(res, -EBUSY);
+
+	srv_conn = pomp_ctx_get_next_conn(peers.srv_ctx, NULL);
+	cli_conn = pomp_ctx_get_conn(peers.cli_ctx[0]);
+	CU_ASSERT_EQUAL(test_edge_get_events(peers.loop, srv_conn),
+			edge_events);
+	CU_ASSERT_EQUAL(test_edge_get_events(peers.loop, cli_conn),
+			edge_events);
+
+	/* Fill the socket while the client does not read so the server
+	 * connection enters async mode */
+	res = pomp_conn_suspend_read(cli_conn);
+	CU_ASSERT_EQUAL(res, 0);
+	bulk = calloc(1, TEST_EDGE_BULK_SIZE);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(bulk);
+	for (i = 0; i < TEST_EDGE_BULK_COUNT; i++) {
+		res = pomp_conn_send(srv_conn, TEST_EDGE_MSGID_BULK, "%p%u",
+				bulk, TEST_EDGE_BULK_SIZE);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	free(bulk);
+
+	/* Nothing received while suspended, registration unchanged */
+	for (i = 0; i < 5; i++)
+		pomp_loop_wait_and_process(peers.loop, 20);
+	CU_ASSERT_EQUAL(data.bulkcount, 0);
+	CU_ASSERT_EQUAL(test_edge_get_events(peers.loop, srv_conn),
+			edge_events);
+	CU_ASSERT_EQUAL(test_edge_get_events(peers.loop, cli_conn),
+			edge_events);
+
+	/* Data already in the socket is read after resume without any new
+	 * notification, then the server is notified when it can write */
+	res = pomp_conn_resume_read(cli_conn);
+	CU_ASSERT_EQUAL(res, 0);
+	while (data.bulkcount < TEST_EDGE_BULK_COUNT) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	CU_ASSERT_EQUAL(test_edge_get_events(peers.loop, srv_conn),
+			edge_events);
+
+	test_unix_peers_cleanup(&peers);
+
+	/* Reads stopped by the budget are resumed without new data */
+	test_ctx_read_budget_run(0, 32, 1);
+	test_ctx_read_budget_run(1024, 0, 1);
+}
+
+#endif /* __linux__ */
+
+#define TEST_RPC_MSGID_ECHO		10
+#define TEST_RPC_MSGID_ECHO_REPLY	11
+#define TEST_RPC_MSGID_IGNORED		12
+#define TEST_RPC_MSGID_IGNORED_REPLY	13
+
+struct test_rpc_data {
+	uint32_t		value;
+	uint32_t		okcount;
+	uint32_t		timeoutcount;
+	uint32_t		abortcount;
+	uint32_t		msgcount;
+};
+
+static void test_rpc_cb(struct pomp_conn *conn,
+		enum pomp_rpc_status status,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	int res = 0;
+	uint32_t callid = 0;
+	struct test_rpc_data *data = userdata;
+
+	switch (status) {
+	case POMP_RPC_STATUS_OK:
+		CU_ASSERT_PTR_NOT_NULL(msg);
+		CU_ASSERT_EQUAL(pomp_msg_get_id(msg),
+				TEST_RPC_MSGID_ECHO_REPLY);
+		res = pomp_msg_read(msg, "%u%u", &callid, &data->value);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_NOT_EQUAL(callid, 0);
+		data->okcount++;
+		break;
+	case POMP_RPC_STATUS_TIMEOUT:
+		CU_ASSERT_PTR_NULL(msg);
+		data->timeoutcount++;
+		break;
+	case POMP_RPC_STATUS_ABORTED:
+		CU_ASSERT_PTR_NULL(msg);
+		data->abortcount++;
+		break;
+	}
+}
+
+static void test_rpc_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	int res = 0;
+	uint32_t callid = 0, value = 0;
+
+	if (event == POMP_EVENT_CONNECTED) {
+		/* Not a reply to a pending call, shall be notified normally */
+		res = pomp_conn_send(conn, TEST_RPC_MSGID_ECHO_REPLY,
+				"%u%u", 12345, 0);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+
+	if (event != POMP_EVENT_MSG
+			|| pomp_msg_get_id(msg) != TEST_RPC_MSGID_ECHO)
+		return;
+
+	res = pomp_msg_read(msg, "%u%u", &callid, &value);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_reply(conn, TEST_RPC_MSGID_ECHO_REPLY, msg,
+			"%u", value * 2);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+static void test_rpc_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct test_rpc_data *data = userdata;
+
+	if (event == POMP_EVENT_MSG)
+		data->msgcount++;
+}
+
+static void test_ctx_rpc(void)
+{
+	int res = 0;
+	struct pomp_conn *cliconn = NULL;
+	struct test_unix_peers peers;
+	struct test_rpc_data data;
+
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-rpc",
+			&test_rpc_srv_event_cb, &test_rpc_cli_event_cb,
+			&data, 1);
+	test_unix_peers_start(&peers);
+	cliconn = pomp_ctx_get_conn(peers.cli_ctx[0]);
+
+	while (data.msgcount == 0) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Invalid arguments */
+	res = pomp_conn_call(NULL, TEST_RPC_MSGID_ECHO,
+			TEST_RPC_MSGID_ECHO_REPLY, 1000,
+			&test_rpc_cb, &data, NULL);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_conn_call(cliconn, TEST_RPC_MSGID_ECHO,
+			TEST_RPC_MSGID_ECHO_REPLY, 1000,
+			NULL, &data, NULL);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_conn_reply(cliconn, TEST_RPC_MSGID_ECHO_REPLY,
+			NULL, NULL);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	/* One call answered, one call expiring */
+	res = pomp_conn_call(cliconn, TEST_RPC_MSGID_ECHO,
+			TEST_RPC_MSGID_ECHO_REPLY, 5000,
+			&test_rpc_cb, &data, "%u", 21);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_call(cliconn, TEST_RPC_MSGID_IGNORED,
+			TEST_RPC_MSGID_IGNORED_REPLY, 50,
+			&test_rpc_cb, &data, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	while (data.okcount + data.timeoutcount < 2) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	CU_ASSERT_EQUAL(data.okcount, 1);
+	CU_ASSERT_EQUAL(data.timeoutcount, 1);
+	CU_ASSERT_EQUAL(data.value, 42);
+	CU_ASSERT_EQUAL(data.msgcount, 1);
+
+	/* Pending call aborted when connection is closed */
+	res = pomp_conn_call(cliconn, TEST_RPC_MSGID_IGNORED,
+			TEST_RPC_MSGID_IGNORED_REPLY, 10000,
+			&test_rpc_cb, &data, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	res = pomp_ctx_stop(peers.cli_ctx[0]);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(data.abortcount, 1);
+	CU_ASSERT_EQUAL(data.timeoutcount, 1);
+
+	test_unix_peers_cleanup(&peers);
+}
+
+#define TEST_SUB_MSGID_READY	100
+#define TEST_SUB_MSGID_END	18
+
+struct test_sub_data {
+	uint32_t		readycount;
+	uint32_t		endcount;
+	uint32_t		rxmask[2];
+	struct pomp_ctx		*cli_ctx[2];
+};
+
+static void test_sub_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct test_sub_data *data = userdata;
+
+	/* Subscription messages shall be consumed internally */
+	if (event == POMP_EVENT_MSG) {
+		CU_ASSERT_EQUAL(pomp_msg_get_id(msg), TEST_SUB_MSGID_READY);
+		data->readycount++;
+	}
+}
+
+static void test_sub_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct test_sub_data *data = userdata;
+	int idx = ctx == data->cli_ctx[0] ? 0 : 1;
+
+	if (event == POMP_EVENT_MSG) {
+		data->rxmask[idx] |= 1u << pomp_msg_get_id(msg);
+		if (pomp_msg_get_id(msg) == TEST_SUB_MSGID_END)
+			data->endcount++;
+	}
+}
+
+static void test_sub_broadcast(struct test_unix_peers *peers,
+		struct test_sub_data *data)
+{
+	int res = 0;
+	uint32_t i = 0;
+	static const uint32_t msgids[] = {5, 10, 15, 19, 20, TEST_SUB_MSGID_END};
+
+	data->endcount = 0;
+	data->rxmask[0] = 0;
+	data->rxmask[1] = 0;
+	for (i = 0; i < sizeof(msgids) / sizeof(msgids[0]); i++) {
+		res = pomp_ctx_send(peers->srv_ctx, msgids[i], NULL);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	while (data->endcount < 2) {
+		res = pomp_loop_wait_and_process(peers->loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+}
+
+static void test_ctx_subscription(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct pomp_conn *cliconn[2];
+	struct test_unix_peers peers;
+	struct test_sub_data data;
+	const uint32_t allmask = (1u << 5) | (1u << 10) | (1u << 15)
+			| (1u << 18) | (1u << 19) | (1u << 20);
+
+	memset(&data, 0, sizeof(data));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-subscription",
+			&test_sub_srv_event_cb, &test_sub_cli_event_cb,
+			&data, 2);
+	data.cli_ctx[0] = peers.cli_ctx[0];
+	data.cli_ctx[1] = peers.cli_ctx[1];
+
+	res = pomp_ctx_set_subscription_filter(NULL, 1);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_set_subscription_filter(peers.srv_ctx, 1);
+	CU_ASSERT_EQUAL(res, 0);
+
+	test_unix_peers_start(&peers);
+	for (i = 0; i < 2; i++)
+		cliconn[i] = pomp_ctx_get_conn(peers.cli_ctx[i]);
+
+	/* First client only wants 10-19 except 15 */
+	res = pomp_conn_subscribe(cliconn[0], 20, 10);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_conn_subscribe(cliconn[0], 10, 14);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_subscribe(cliconn[0], 12, 19);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_conn_unsubscribe(cliconn[0], 15, 15);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Second client splits its set until the limit of ranges is reached,
+	 * removing 20 is then ignored */
+	for (i = 0; i < 300; i++) {
+		res = pomp_conn_unsubscribe(cliconn[1],
+				1000 + 2 * i, 1000 + 2 * i);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_conn_unsubscribe(cliconn[1], 20, 20);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Subscriptions are processed before these in stream order */
+	for (i = 0; i < 2; i++) {
+		res = pomp_conn_send(cliconn[i], TEST_SUB_MSGID_READY,
+				NULL);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	while (data.readycount < 2) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	test_sub_broadcast(&peers, &data);
+	CU_ASSERT_EQUAL(data.rxmask[0], (1u << 10) | (1u << 18) | (1u << 19));
+	CU_ASSERT_EQUAL(data.rxmask[1], allmask);
+
+	/* Subscriptions are ignored once the filter is disabled */
+	res = pomp_ctx_set_subscription_filter(peers.srv_ctx, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	test_sub_broadcast(&peers, &data);
+	CU_ASSERT_EQUAL(data.rxmask[0], allmask);
+	CU_ASSERT_EQUAL(data.rxmask[1], allmask);
+
+	/* And apply again when re-enabled */
+	res = pomp_ctx_set_subscription_filter(peers.srv_ctx, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	test_sub_broadcast(&peers, &data);
+	CU_ASSERT_EQUAL(data.rxmask[0], (1u << 10) | (1u << 18) | (1u << 19));
+
+	test_unix_peers_cleanup(&peers);
+}
+
+#endif /* !_WIN32 */
+
+#ifdef __linux__
+
+struct test_dgram_filter_data {
+	uint32_t	rxmask;
+};
+
+static void test_dgram_filter_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct test_dgram_filter_data *data = userdata;
+	if (event == POMP_EVENT_MSG)
+		data->rxmask |= 1u << pomp_msg_get_id(msg);
+}
+
+static void test_dgram_filter_run(const char *addr1_str,
+		const char *addr2_str, int beforebind)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct pomp_loop *loop = NULL;
+	struct pomp_ctx *rx_ctx = NULL;
+	struct pomp_ctx *tx_ctx = NULL;
+	struct sockaddr_storage addr1, addr2;
+	uint32_t addrlen1 = sizeof(addr1), addrlen2 = sizeof(addr2);
+	struct test_dgram_filter_data data;
+	struct pomp_msg *msg = NULL;
+	static const uint32_t msgids[] = {12, 4, 3, 10, 5, 4};
+
+	memset(&data, 0, sizeof(data));
+	msg = pomp_msg_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(msg);
+	res = pomp_addr_parse(addr1_str, (struct sockaddr *)&addr1, &addrlen1);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = pomp_addr_parse(addr2_str, (struct sockaddr *)&addr2, &addrlen2);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+
+	loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(loop);
+	rx_ctx = pomp_ctx_new_with_loop(&test_dgram_filter_event_cb,
+			&data, loop);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(rx_ctx);
+	tx_ctx = pomp_ctx_new_with_loop(&test_dgram_filter_event_cb,
+			&data, loop);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(tx_ctx);
+
+	res = pomp_ctx_set_dgram_msgid_filter(rx_ctx, NULL, 1);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+
+	if (beforebind) {
+		res = pomp_ctx_set_dgram_msgid_filter(rx_ctx, msgids,
+				sizeof(msgids) / sizeof(msgids[0]));
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	res = pomp_ctx_bind(rx_ctx, (const struct sockaddr *)&addr1, addrlen1);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = pomp_ctx_bind(tx_ctx, (const struct sockaddr *)&addr2, addrlen2);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	if (!beforebind) {
+		res = pomp_ctx_set_dgram_msgid_filter(rx_ctx, msgids,
+				sizeof(msgids) / sizeof(msgids[0]));
+		CU_ASSERT_EQUAL(res, 0);
+	}
+
+	/* Only allowed ids shall be received, 12 is sent last */
+	for (i = 1; i <= 12; i++) {
+		res = pomp_msg_write(msg, i, NULL);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pomp_ctx_send_msg_to(tx_ctx, msg,
+				(const struct sockaddr *)&addr1, addrlen1);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pomp_msg_clear(msg);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	while ((data.rxmask & (1u << 12)) == 0) {
+		res = pomp_loop_wait_and_process(loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	CU_ASSERT_EQUAL(data.rxmask, (1u << 3) | (1u << 4) | (1u << 5)
+			| (1u << 10) | (1u << 12));
+
+	/* Remove filter */
+	res = pomp_ctx_set_dgram_msgid_filter(rx_ctx, NULL, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_msg_write(msg, 1, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_send_msg_to(tx_ctx, msg,
+			(const struct sockaddr *)&addr1, addrlen1);
+	CU_ASSERT_EQUAL(res, 0);
+	while ((data.rxmask & (1u << 1)) == 0) {
+		res = pomp_loop_wait_and_process(loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	res = pomp_ctx_stop(tx_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_stop(rx_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_destroy(tx_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_ctx_destroy(rx_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_loop_destroy(loop);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_msg_destroy(msg);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+static void test_ctx_dgram_filter(void)
+{
+	test_dgram_filter_run("inet:127.0.0.1:5656", "inet:127.0.0.1:5657", 1);
+	test_dgram_filter_run("inet:127.0.0.1:5656", "inet:127.0.0.1:5657", 0);
+	test_dgram_filter_run("unix:@tst-pomp-filter1",
+			"unix:@tst-pomp-filter2", 1);
+}
+
+struct test_capture_data {
+	uint32_t		srvmsgcount;
+	uint32_t		climsgcount;
+};
+
+static void test_capture_srv_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct test_capture_data *data = userdata;
+
+	if (event == POMP_EVENT_MSG)
+		data->srvmsgcount++;
+}
+
+static void test_capture_cli_event_cb(struct pomp_ctx *ctx,
+		enum pomp_event event,
+		struct pomp_conn *conn,
+		const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct test_capture_data *data = userdata;
+
+	if (event == POMP_EVENT_MSG)
+		data->climsgcount++;
+}
+
+static void test_ctx_capture(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct pomp_ctx *srv_ctx = NULL;
+	struct test_unix_peers peers;
+	struct test_capture_data capdata;
+	struct pomp_capture_file_header hdr;
+	struct pomp_capture_record_header rec;
+	uint8_t data[256];
+	FILE *file = NULL;
+	uint32_t value = 0;
+	const char *path = "/tmp/tst-pomp-capture.bin";
+
+	memset(&capdata, 0, sizeof(capdata));
+	test_unix_peers_init(&peers, "/tmp/tst-pomp-capture",
+			&test_capture_srv_event_cb, &test_capture_cli_event_cb,
+			&capdata, 1);
+	srv_ctx = peers.srv_ctx;
+
+	/* Invalid arguments */
+	res = pomp_ctx_start_capture(NULL, path, 0);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_start_capture(srv_ctx, NULL, 0);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_ctx_stop_capture(srv_ctx);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	/* Errors of the file are reported as is */
+	res = pomp_ctx_start_capture(srv_ctx, "/tmp", 0);
+	CU_ASSERT_EQUAL(res, -EISDIR);
+	res = pomp_ctx_start_capture(srv_ctx,
+			"/tmp/tst-pomp-no-such-dir/capture", 0);
+	CU_ASSERT_EQUAL(res, -ENOENT);
+
+	/* Capture on server, started before connection */
+	res = pomp_ctx_start_capture(srv_ctx, path, 0);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	res = pomp_ctx_start_capture(srv_ctx, path, 0);
+	CU_ASSERT_EQUAL(res, -EBUSY);
+
+	test_unix_peers_start(&peers);
+
+	/* 3 messages received by server then 1 sent by server */
+	for (i = 0; i < 3; i++) {
+		res = pomp_ctx_send(peers.cli_ctx[0], 100 + i, "%u", i);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+	while (capdata.srvmsgcount < 3) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	res = pomp_ctx_send(srv_ctx, 200, "%u", 42);
+	CU_ASSERT_EQUAL(res, 0);
+	while (capdata.climsgcount < 1) {
+		res = pomp_loop_wait_and_process(peers.loop, 5000);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+
+	/* Stopping flushes all records */
+	res = pomp_ctx_stop_capture(srv_ctx);
+	CU_ASSERT_EQUAL(res, 0);
+
+	file = fopen(path, "rb");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	CU_ASSERT_EQUAL(fread(&hdr, sizeof(hdr), 1, file), 1);
+	CU_ASSERT_EQUAL(hdr.magic, POMP_CAPTURE_MAGIC);
+	CU_ASSERT_EQUAL(hdr.version, POMP_CAPTURE_VERSION);
+	CU_ASSERT_EQUAL(hdr.hdrsize, sizeof(hdr));
+
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT_EQUAL_FATAL(fread(&rec, sizeof(rec), 1, file), 1);
+		CU_ASSERT_EQUAL(rec.size % POMP_CAPTURE_ALIGN, 0);
+		CU_ASSERT_TRUE_FATAL(rec.size - sizeof(rec) <= sizeof(data));
+		CU_ASSERT_EQUAL_FATAL(fread(data, rec.size - sizeof(rec), 1,
+				file), 1);
+		CU_ASSERT_EQUAL(rec.dir, i < 3 ? POMP_CAPTURE_DIR_RX :
+				POMP_CAPTURE_DIR_TX);
+		CU_ASSERT_EQUAL(rec.msgid, i < 3 ? 100 + i : 200);
+
+		/* Data is the full message, last argument is an u32 */
+		CU_ASSERT_EQUAL(rec.datalen, POMP_PROT_HEADER_SIZE + 2);
+		CU_ASSERT_EQUAL(data[rec.addrlen], 'P');
+		value = data[rec.addrlen + POMP_PROT_HEADER_SIZE + 1];
+		CU_ASSERT_EQUAL(value, i < 3 ? i : 42);
+	}
+	CU_ASSERT_EQUAL(fread(&rec, sizeof(rec), 1, file), 0);
+	fclose(file);
+	unlink(path);
+
+	test_unix_peers_cleanup(&peers);
+}
+
+#endif /* __linux__ */
+
 /* Disable some gcc warnings for test suite descriptions */
 #ifdef __GNUC__
 #  pragma GCC diagnostic ignored "-Wcast-qual"
@@ -1389,7 +3282,22 @@ static CU_TestInfo s_ctx_tests[] = {
 #ifndef _WIN32
 	{(char *)"ctx_normal_unix", &test_ctx_normal_unix},
 	{(char *)"ctx_raw_unix", &test_ctx_raw_unix},
+	{(char *)"ctx_send_prio", &test_ctx_send_prio},
+	{(char *)"ctx_buf_ref", &test_ctx_buf_ref},
+	{(char *)"ctx_msg_conflation", &test_ctx_msg_conflation},
+	{(char *)"ctx_conn_userdata", &test_ctx_conn_userdata},
+	{(char *)"ctx_msg_handler", &test_ctx_msg_handler},
+	{(char *)"ctx_batch", &test_ctx_batch},
+	{(char *)"ctx_send_async", &test_ctx_send_async},
+	{(char *)"ctx_read_budget", &test_ctx_read_budget},
+	{(char *)"ctx_rpc", &test_ctx_rpc},
+	{(char *)"ctx_subscription", &test_ctx_subscription},
 #endif /* !_WIN32 */
+#ifdef __linux__
+	{(char *)"ctx_dgram_filter", &test_ctx_dgram_filter},
+	{(char *)"ctx_capture", &test_ctx_capture},
+	{(char *)"ctx_edge_triggered", &test_ctx_edge_triggered},
+#endif /* __linux__ */
 	{(char *)"ctx_local_addr", &test_local_addr},
 	{(char *)"ctx_invalid_addr", &test_invalid_addr},
 	CU_TEST_INFO_NULL,
@@ -806,6 +806,221 @@ static void test_loop_watchdog(void)
 	CU_ASSERT_EQUAL(res, 0);
 }
 
+#define WATCHDOG_LOOP_COUNT	8
+
+static void watchdog_shared_cb(struct pomp_loop *loop, void *userdata)
+{
+	struct watchdog_data *data = userdata;
+	if (loop == data->loop)
+		__atomic_add_fetch(&data->expired, 1, __ATOMIC_RELAXED);
+}
+
+static void *test_loop_watchdog_thread(void *arg)
+{
+	struct watchdog_data *data = arg;
+	pomp_loop_wait_and_process(data->loop, -1);
+	return NULL;
+}
+
+#ifdef __linux__
+static int count_watchdog_threads(void)
+{
+	int count = 0;
+	DIR *dir = NULL;
+	struct dirent *entry = NULL;
+	FILE *file = NULL;
+	char path[320] = "";
+	char name[32] = "";
+
+	dir = opendir("/proc/self/task");
+	if (dir == NULL)
+		return -1;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "/proc/self/task/%s/comm",
+				entry->d_name);
+		file = fopen(path, "r");
+		if (file == NULL)
+			continue;
+		if (fgets(name, sizeof(name), file) != NULL &&
+				strcmp(name, "pomp_watchdog\n") == 0) {
+			count++;
+		}
+		fclose(file);
+	}
+	closedir(dir);
+	return count;
+}
+#endif /* __linux__ */
+
+/** */
+static void test_loop_watchdog_shared(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct watchdog_data data[WATCHDOG_LOOP_COUNT];
+	struct pomp_evt *evts[WATCHDOG_LOOP_COUNT];
+	pthread_t threads[WATCHDOG_LOOP_COUNT];
+
+	/* Loops with even index are stuck longer than their delay */
+	memset(data, 0, sizeof(data));
+	for (i = 0; i < WATCHDOG_LOOP_COUNT; i++) {
+		data[i].loop = pomp_loop_new();
+		CU_ASSERT_PTR_NOT_NULL_FATAL(data[i].loop);
+		data[i].sleep_value = 600;
+		evts[i] = pomp_evt_new();
+		CU_ASSERT_PTR_NOT_NULL_FATAL(evts[i]);
+		res = pomp_evt_attach_to_loop(evts[i], data[i].loop,
+				&watchdog_evt_cb, &data[i]);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pomp_loop_watchdog_enable(data[i].loop,
+				i % 2 == 0 ? 200 : 1000,
+				&watchdog_shared_cb, &data[i]);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+
+	/* Process all loops at the same time */
+	for (i = 0; i < WATCHDOG_LOOP_COUNT; i++) {
+		res = pomp_evt_signal(evts[i]);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pthread_create(&threads[i], NULL,
+				&test_loop_watchdog_thread, &data[i]);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	for (i = 0; i < WATCHDOG_LOOP_COUNT; i++) {
+		res = pthread_join(threads[i], NULL);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+#ifdef __linux__
+	/* All loops are monitored by a single thread */
+	CU_ASSERT_EQUAL(count_watchdog_threads(), 1);
+#endif /* __linux__ */
+
+	/* Disable all but the last one, the thread is kept */
+	for (i = 0; i < WATCHDOG_LOOP_COUNT - 1; i++) {
+		res = pomp_loop_watchdog_disable(data[i].loop);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+#ifdef __linux__
+	CU_ASSERT_EQUAL(count_watchdog_threads(), 1);
+#endif /* __linux__ */
+	res = pomp_loop_watchdog_disable(data[i].loop);
+	CU_ASSERT_EQUAL(res, 0);
+#ifdef __linux__
+	/* The joined thread can be listed until the kernel reaps it */
+	for (i = 0; i < 100 && count_watchdog_threads() != 0; i++)
+		usleep(10 * 1000);
+	CU_ASSERT_EQUAL(count_watchdog_threads(), 0);
+#endif /* __linux__ */
+
+	/* Each loop got its own notification */
+	for (i = 0; i < WATCHDOG_LOOP_COUNT; i++) {
+		CU_ASSERT_EQUAL(data[i].expired, i % 2 == 0 ? 1 : 0);
+		res = pomp_evt_detach_from_loop(evts[i], data[i].loop);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pomp_evt_destroy(evts[i]);
+		CU_ASSERT_EQUAL(res, 0);
+		res = pomp_loop_destroy(data[i].loop);
+		CU_ASSERT_EQUAL(res, 0);
+	}
+}
+
+/** */
+struct watchdog_stop_data {
+	struct watchdog_data	wd;
+	int			incb;
+	int			cbdone;
+	int			stopped;
+	int			cbdone_at_stop;
+};
+
+static void watchdog_blocking_cb(struct pomp_loop *loop, void *userdata)
+{
+	struct watchdog_stop_data *data = userdata;
+	__atomic_store_n(&data->incb, 1, __ATOMIC_RELEASE);
+	usleep(300 * 1000);
+	__atomic_store_n(&data->cbdone, 1, __ATOMIC_RELEASE);
+}
+
+static void *test_loop_watchdog_stop_thread(void *arg)
+{
+	struct watchdog_stop_data *data = arg;
+	pomp_loop_watchdog_disable(data->wd.loop);
+	data->cbdone_at_stop = __atomic_load_n(&data->cbdone,
+			__ATOMIC_ACQUIRE);
+	__atomic_store_n(&data->stopped, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/** */
+static void test_loop_watchdog_stop_concurrent(void)
+{
+	int res = 0, i = 0;
+	struct watchdog_stop_data data;
+	struct pomp_loop *other = NULL;
+	struct pomp_evt *evt = NULL;
+	pthread_t loop_thread, stop_thread;
+
+	memset(&data, 0, sizeof(data));
+	data.wd.loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.wd.loop);
+	data.wd.sleep_value = 400;
+	evt = pomp_evt_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(evt);
+	res = pomp_evt_attach_to_loop(evt, data.wd.loop,
+			&watchdog_evt_cb, &data.wd);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_loop_watchdog_enable(data.wd.loop, 100,
+			&watchdog_blocking_cb, &data);
+	CU_ASSERT_EQUAL(res, 0);
+	other = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(other);
+	res = pomp_loop_watchdog_enable(other, 1000, &watchdog_cb, &data.wd);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Get the watchdog of the first loop notified */
+	res = pomp_evt_signal(evt);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pthread_create(&loop_thread, NULL,
+			&test_loop_watchdog_thread, &data.wd);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	while (!__atomic_load_n(&data.incb, __ATOMIC_ACQUIRE))
+		usleep(10 * 1000);
+
+	/* Stop it from another thread during the notification, and the
+	 * other one (last one) at the same time */
+	res = pthread_create(&stop_thread, NULL,
+			&test_loop_watchdog_stop_thread, &data);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	usleep(50 * 1000);
+	res = pomp_loop_watchdog_disable(other);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* The stop returns, after the end of the notification */
+	for (i = 0; i < 200; i++) {
+		if (__atomic_load_n(&data.stopped, __ATOMIC_ACQUIRE))
+			break;
+		usleep(10 * 1000);
+	}
+	CU_ASSERT_TRUE_FATAL(data.stopped);
+	CU_ASSERT_TRUE(data.cbdone_at_stop);
+	res = pthread_join(stop_thread, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pthread_join(loop_thread, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+
+	/* Cleanup */
+	res = pomp_evt_detach_from_loop(evt, data.wd.loop);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_evt_destroy(evt);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_loop_destroy(data.wd.loop);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_loop_destroy(other);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
 #endif /* POMP_HAVE_WATCHDOG */
 
 #ifdef POMP_HAVE_LOOP_SYNC
@@ -894,6 +1109,173 @@ static void test_loop_sync()
 
 #endif /* POMP_HAVE_LOOP_SYNC */
 
+#ifdef POMP_HAVE_LOOP_INVOKE
+
+#define INVOKE_THREAD_COUNT	4
+#define INVOKE_COUNT		1000
+
+/** */
+struct invoke_data {
+	struct pomp_loop  *loop;
+	pthread_t         loopthread;
+	uint32_t          counter;
+	uint32_t          last[INVOKE_THREAD_COUNT];
+	uint32_t          errors;
+	uint32_t          running;
+	int               cancelres;
+};
+
+/** */
+struct invoke_thread {
+	struct invoke_data  *data;
+	uint32_t            idx;
+	uint32_t            seq;
+	uint32_t            errors;
+};
+
+static void invoke_count_cb(void *userdata)
+{
+	struct invoke_data *data = userdata;
+	if (!pthread_equal(pthread_self(), data->loopthread))
+		data->errors++;
+	data->counter++;
+}
+
+static void invoke_seq_cb(void *userdata)
+{
+	struct invoke_thread *thread = userdata;
+	struct invoke_data *data = thread->data;
+
+	/* Functions of a thread are called in order */
+	if (!pthread_equal(pthread_self(), data->loopthread))
+		data->errors++;
+	if (thread->seq != data->last[thread->idx] + 1)
+		data->errors++;
+	data->last[thread->idx] = thread->seq;
+	data->counter++;
+}
+
+static void *test_loop_invoke_thread(void *arg)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct invoke_thread *thread = arg;
+
+	/* Blocking invoke: the sequence can be updated after each call */
+	for (i = 1; i <= INVOKE_COUNT; i++) {
+		thread->seq = i;
+		res = pomp_loop_invoke(thread->data->loop, &invoke_seq_cb,
+				thread, 1);
+		if (res != 0)
+			thread->errors++;
+	}
+
+	return NULL;
+}
+
+static void *test_loop_invoke_runner(void *arg)
+{
+	struct invoke_data *data = arg;
+	data->loopthread = pthread_self();
+	__atomic_store_n(&data->running, 1, __ATOMIC_RELEASE);
+	while (__atomic_load_n(&data->running, __ATOMIC_ACQUIRE))
+		pomp_loop_wait_and_process(data->loop, 100);
+	return NULL;
+}
+
+static void *test_loop_invoke_cancel(void *arg)
+{
+	struct invoke_data *data = arg;
+	data->cancelres = pomp_loop_invoke(data->loop, &invoke_count_cb,
+			data, 1);
+	return NULL;
+}
+
+static void test_loop_invoke(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct invoke_data data;
+	struct invoke_thread threads[INVOKE_THREAD_COUNT];
+	pthread_t tids[INVOKE_THREAD_COUNT];
+	pthread_t runner;
+
+	memset(&data, 0, sizeof(data));
+	memset(threads, 0, sizeof(threads));
+	data.loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.loop);
+
+	/* Non blocking invoke from loop thread, called at next iteration */
+	data.loopthread = pthread_self();
+	res = pomp_loop_invoke(data.loop, &invoke_count_cb, &data, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pomp_loop_invoke(data.loop, &invoke_count_cb, &data, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(data.counter, 0);
+	res = pomp_loop_wait_and_process(data.loop, 1000);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(data.counter, 2);
+
+	/* Blocking invoke from loop thread is called directly */
+	res = pomp_loop_invoke(data.loop, &invoke_count_cb, &data, 1);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(data.counter, 3);
+
+	/* Blocking invokes from several threads with loop run by another */
+	data.counter = 0;
+	res = pthread_create(&runner, NULL, &test_loop_invoke_runner, &data);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	while (!__atomic_load_n(&data.running, __ATOMIC_ACQUIRE))
+		usleep(1000);
+	for (i = 0; i < INVOKE_THREAD_COUNT; i++) {
+		threads[i].data = &data;
+		threads[i].idx = i;
+		res = pthread_create(&tids[i], NULL,
+				&test_loop_invoke_thread, &threads[i]);
+		CU_ASSERT_EQUAL_FATAL(res, 0);
+	}
+	for (i = 0; i < INVOKE_THREAD_COUNT; i++) {
+		res = pthread_join(tids[i], NULL);
+		CU_ASSERT_EQUAL(res, 0);
+		CU_ASSERT_EQUAL(threads[i].errors, 0);
+		CU_ASSERT_EQUAL(data.last[i], INVOKE_COUNT);
+	}
+	CU_ASSERT_EQUAL(data.counter, INVOKE_THREAD_COUNT * INVOKE_COUNT);
+	__atomic_store_n(&data.running, 0, __ATOMIC_RELEASE);
+	pomp_loop_wakeup(data.loop);
+	res = pthread_join(runner, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(data.errors, 0);
+
+	/* Pending invocations are cancelled by destroy */
+	data.counter = 0;
+	data.loopthread = pthread_self();
+	res = pomp_loop_invoke(data.loop, &invoke_count_cb, &data, 0);
+	CU_ASSERT_EQUAL(res, 0);
+	data.cancelres = 1;
+	res = pthread_create(&runner, NULL, &test_loop_invoke_cancel, &data);
+	CU_ASSERT_EQUAL_FATAL(res, 0);
+	usleep(100 * 1000);
+	res = pomp_loop_destroy(data.loop);
+	CU_ASSERT_EQUAL(res, 0);
+	res = pthread_join(runner, NULL);
+	CU_ASSERT_EQUAL(res, 0);
+	CU_ASSERT_EQUAL(data.cancelres, -ECANCELED);
+	CU_ASSERT_EQUAL(data.counter, 0);
+
+	/* Invalid parameters checks */
+	res = pomp_loop_invoke(NULL, &invoke_count_cb, &data, 0);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	data.loop = pomp_loop_new();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data.loop);
+	res = pomp_loop_invoke(data.loop, NULL, &data, 0);
+	CU_ASSERT_EQUAL(res, -EINVAL);
+	res = pomp_loop_destroy(data.loop);
+	CU_ASSERT_EQUAL(res, 0);
+}
+
+#endif /* POMP_HAVE_LOOP_INVOKE */
+
 /** */
 #ifdef POMP_HAVE_LOOP_EPOLL
 static void test_loop_epoll(void)
@@ -905,10 +1287,15 @@ static void test_loop_epoll(void)
 	test_loop_idle();
 #ifdef POMP_HAVE_WATCHDOG
 	test_loop_watchdog();
+	test_loop_watchdog_shared();
+	test_loop_watchdog_stop_concurrent();
 #endif /* POMP_HAVE_WATCHDOG */
 #ifdef POMP_HAVE_LOOP_SYNC
 	test_loop_sync();
 #endif /* POMP_HAVE_LOOP_SYNC */
+#ifdef POMP_HAVE_LOOP_INVOKE
+	test_loop_invoke();
+#endif /* POMP_HAVE_LOOP_INVOKE */
 	pomp_loop_set_ops(loop_ops);
 }
 #endif /* POMP_HAVE_LOOP_EPOLL */
@@ -924,10 +1311,15 @@ static void test_loop_poll(void)
 	test_loop_idle();
 #ifdef POMP_HAVE_WATCHDOG
 	test_loop_watchdog();
+	test_loop_watchdog_shared();
+	test_loop_watchdog_stop_concurrent();
 #endif /* POMP_HAVE_WATCHDOG */
 #ifdef POMP_HAVE_LOOP_SYNC
 	test_loop_sync();
 #endif /* POMP_HAVE_LOOP_SYNC */
+#ifdef POMP_HAVE_LOOP_INVOKE
+	test_loop_invoke();
+#endif /* POMP_HAVE_LOOP_INVOKE */
 	pomp_loop_set_ops(loop_ops);
 }
 #endif /* POMP_HAVE_LOOP_POLL */
@@ -943,10 +1335,15 @@ static void test_loop_win32(void)
 	test_loop_idle();
 #ifdef POMP_HAVE_WATCHDOG
 	test_loop_watchdog();
+	test_loop_watchdog_shared();
+	test_loop_watchdog_stop_concurrent();
 #endif /* POMP_HAVE_WATCHDOG */
 #ifdef POMP_HAVE_LOOP_SYNC
 	test_loop_sync();
 #endif /* POMP_HAVE_LOOP_SYNC */
+#ifdef POMP_HAVE_LOOP_INVOKE
+	test_loop_invoke();
+#endif /* POMP_HAVE_LOOP_INVOKE */
 	pomp_loop_set_ops(loop_ops);
 }
 #endif /* POMP_HAVE_LOOP_WIN32 */
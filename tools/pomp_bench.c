@@ -0,0 +1,1008 @@
+/**
+ * @file pomp_bench.c
+ *
+ * @brief Transport benchmark: throughput and latency scenarios.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Standard headers */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif /* !_GNU_SOURCE */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <fcntl.h>
+
+/* Unix headers */
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "libpomp.h"
+
+#define DIAG_PFX "POMPBENCH: "
+
+#define diag(_fmt, ...) \
+	fprintf(stderr, DIAG_PFX _fmt "\n", ##__VA_ARGS__)
+
+#define MSGID_DATA	1
+
+/** Maximum number of values in a list option */
+#define MAX_LIST	16
+
+/** Largest payload sent over udp */
+#define UDP_MAX_SIZE	(60 * 1024)
+
+/** Maximum payload bytes in flight across all connections */
+#define INFLIGHT_BUDGET	(64 * 1024 * 1024)
+
+/** Time without progress after which a scenario is aborted (ns) */
+#define STALL_TIMEOUT	(2ULL * 1000 * 1000 * 1000)
+
+/** Time without progress after which udp messages are deemed lost (ns) */
+#define LOSS_TIMEOUT	(200ULL * 1000 * 1000)
+
+/** Time allowed to establish all connections (ns) */
+#define SETUP_TIMEOUT	(10ULL * 1000 * 1000 * 1000)
+
+/** Transports */
+enum transport {
+	TRANSPORT_UNIX = 0,
+	TRANSPORT_TCP,
+	TRANSPORT_UDP,
+	TRANSPORT_COUNT,
+};
+
+/** Traffic patterns */
+enum mode {
+	MODE_PINGPONG = 0,	/**< Server echoes, round-trip latency */
+	MODE_STREAM,		/**< Client streams, one-way latency */
+	MODE_COUNT,
+};
+
+static const char * const s_transport_names[TRANSPORT_COUNT] = {
+	"unix", "tcp", "udp",
+};
+
+static const char * const s_mode_names[MODE_COUNT] = {
+	"pingpong", "stream",
+};
+
+/** One combination of parameters */
+struct scenario {
+	enum transport          transport;
+	enum mode               mode;
+	uint32_t                size;
+	uint32_t                fds;
+	uint32_t                conns;
+};
+
+/** Measures of a scenario */
+struct result {
+	uint32_t                msgs;
+	uint32_t                lost;
+	uint64_t                bytes;
+	double                  elapsed;
+	double                  cpu;
+	double                  p50;
+	double                  p99;
+	double                  p999;
+};
+
+/** Client side of a connection */
+struct client {
+	uint32_t                idx;
+	struct pomp_ctx         *ctx;
+	struct pomp_conn        *conn;
+	uint32_t                quota;
+	uint32_t                sent;
+	uint32_t                completed;
+};
+
+/** A list option */
+struct list {
+	uint32_t                values[MAX_LIST];
+	uint32_t                count;
+};
+
+/** */
+struct app {
+	/* Options */
+	struct list             transports;
+	struct list             modes;
+	struct list             sizes;
+	struct list             fds;
+	struct list             conns;
+	uint32_t                count;
+	uint64_t                budget;
+	uint32_t                window;
+	int                     csv;
+	const char              *path;
+
+	/* Current scenario */
+	const struct scenario   *scn;
+	struct pomp_loop        *loop;
+	struct pomp_ctx         *srv;
+	struct sockaddr_storage srvaddr;
+	uint32_t                srvaddrlen;
+	struct client           *clients;
+	uint32_t                accepted;
+	uint32_t                connected;
+	uint32_t                window_eff;
+	struct pomp_msg         *msg;
+	void                    *payload;
+	int                     fd;
+	uint64_t                *latencies;
+	uint32_t                latcount;
+	uint32_t                total;
+	uint32_t                completed;
+	uint32_t                lost;
+	uint64_t                bytes;
+	uint64_t                progress;
+	int                     error;
+	int                     running;
+};
+static struct app s_app = {
+		.count = 20000,
+		.budget = 256 * 1024 * 1024,
+		.window = 16,
+		.csv = 0,
+		.path = "/tmp/pomp-bench",
+		.fd = -1,
+		.running = 1,
+};
+
+/**
+ *
+ */
+static uint64_t get_time(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ *
+ */
+static double get_cpu_time(void)
+{
+	struct rusage ru;
+	memset(&ru, 0, sizeof(ru));
+	getrusage(RUSAGE_SELF, &ru);
+	return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6
+		+ (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ *
+ */
+static void sig_handler(int signum)
+{
+	s_app.running = 0;
+}
+
+/**
+ *
+ */
+static void record_latency(unsigned long long stamp)
+{
+	if (s_app.latcount < s_app.total)
+		s_app.latencies[s_app.latcount++] = get_time() - stamp;
+}
+
+/**
+ * Send messages of a client while its window allows it.
+ */
+static void client_pump(struct client *client)
+{
+	int res = 0;
+	const struct scenario *scn = s_app.scn;
+
+	while (client->sent < client->quota
+			&& client->sent - client->completed < s_app.window_eff
+			&& s_app.error == 0) {
+		if (scn->transport != TRANSPORT_UDP && client->conn == NULL)
+			return;
+
+		pomp_msg_clear(s_app.msg);
+		if (scn->fds) {
+			res = pomp_msg_write(s_app.msg, MSGID_DATA,
+					"%u%llu%p%u%x", client->idx,
+					(unsigned long long)get_time(),
+					s_app.payload, scn->size, s_app.fd);
+		} else {
+			res = pomp_msg_write(s_app.msg, MSGID_DATA,
+					"%u%llu%p%u", client->idx,
+					(unsigned long long)get_time(),
+					s_app.payload, scn->size);
+		}
+		if (res < 0) {
+			diag("pomp_msg_write: err=%d(%s)", res, strerror(-res));
+			s_app.error = res;
+			return;
+		}
+
+		if (scn->transport == TRANSPORT_UDP) {
+			res = pomp_ctx_send_msg_to(client->ctx, s_app.msg,
+					(const struct sockaddr *)&s_app.srvaddr,
+					s_app.srvaddrlen);
+		} else {
+			res = pomp_conn_send_msg(client->conn, s_app.msg);
+		}
+		if (res < 0) {
+			diag("send: err=%d(%s)", res, strerror(-res));
+			s_app.error = res;
+			return;
+		}
+
+		client->sent++;
+		s_app.bytes += scn->size;
+	}
+}
+
+/**
+ * Account a message that reached its final destination.
+ */
+static void client_complete(uint32_t idx, const struct pomp_msg *msg)
+{
+	uint32_t msgidx = 0;
+	unsigned long long stamp = 0;
+	struct client *client = NULL;
+
+	/* Only the leading arguments are needed */
+	if (pomp_msg_read(msg, "%u%llu", &msgidx, &stamp) < 0)
+		return;
+	if (idx == UINT32_MAX)
+		idx = msgidx;
+	if (idx >= s_app.scn->conns)
+		return;
+
+	record_latency(stamp);
+	client = &s_app.clients[idx];
+
+	/* Late datagram already accounted as lost */
+	if (client->completed >= client->sent)
+		return;
+
+	client->completed++;
+	s_app.completed++;
+	s_app.progress = get_time();
+	client_pump(client);
+}
+
+/**
+ *
+ */
+static void srv_event_cb(struct pomp_ctx *ctx, enum pomp_event event,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		void *userdata)
+{
+	int res = 0;
+
+	switch (event) {
+	case POMP_EVENT_CONNECTED:
+		s_app.accepted++;
+		break;
+
+	case POMP_EVENT_DISCONNECTED:
+		s_app.accepted--;
+		break;
+
+	case POMP_EVENT_MSG:
+		if (s_app.scn->mode == MODE_STREAM) {
+			client_complete(UINT32_MAX, msg);
+			break;
+		}
+		res = pomp_conn_send_msg(conn, msg);
+		if (res < 0) {
+			diag("pomp_conn_send_msg: err=%d(%s)", res,
+					strerror(-res));
+			s_app.error = res;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ *
+ */
+static void cli_event_cb(struct pomp_ctx *ctx, enum pomp_event event,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct client *client = userdata;
+
+	switch (event) {
+	case POMP_EVENT_CONNECTED:
+		client->conn = conn;
+		s_app.connected++;
+		break;
+
+	case POMP_EVENT_DISCONNECTED:
+		client->conn = NULL;
+		s_app.connected--;
+		break;
+
+	case POMP_EVENT_MSG:
+		if (s_app.scn->mode == MODE_PINGPONG)
+			client_complete(client->idx, msg);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ *
+ */
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a;
+	uint64_t vb = *(const uint64_t *)b;
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+/**
+ * Get a percentile of sorted latencies, in us.
+ */
+static double percentile(double p)
+{
+	uint32_t idx = 0;
+	if (s_app.latcount == 0)
+		return 0.0;
+	idx = (uint32_t)(p * (s_app.latcount - 1) + 0.5);
+	return (double)s_app.latencies[idx] / 1e3;
+}
+
+/**
+ * Enlarge the receive buffer of a datagram socket (best effort).
+ */
+static void set_rcvbuf(struct pomp_ctx *ctx, uint32_t conns)
+{
+	int fd = (int)pomp_ctx_get_fd(ctx);
+	int size = 0;
+
+	if (fd < 0)
+		return;
+	size = conns * (UDP_MAX_SIZE + 1024) < 16 * 1024 * 1024 ?
+			(int)(conns * (UDP_MAX_SIZE + 1024)) : 16 * 1024 * 1024;
+	if (size < 1024 * 1024)
+		size = 1024 * 1024;
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+			sizeof(size)) < 0) {
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+}
+
+/**
+ * Setup server side of a scenario.
+ */
+static int setup_server(const struct scenario *scn)
+{
+	int res = 0;
+	struct sockaddr_un *addr_un = NULL;
+	struct sockaddr_in *addr_in = NULL;
+	const struct sockaddr *addr = NULL;
+	uint32_t addrlen = 0;
+
+	s_app.srv = pomp_ctx_new_with_loop(&srv_event_cb, NULL, s_app.loop);
+	if (s_app.srv == NULL)
+		return -ENOMEM;
+	pomp_ctx_set_max_conn(s_app.srv, scn->conns);
+	if (scn->transport == TRANSPORT_UDP)
+		pomp_ctx_set_read_buffer_len(s_app.srv, UDP_MAX_SIZE + 1024);
+
+	/* Unix socket path or loopback with a port chosen by the system */
+	memset(&s_app.srvaddr, 0, sizeof(s_app.srvaddr));
+	if (scn->transport == TRANSPORT_UNIX) {
+		addr_un = (struct sockaddr_un *)&s_app.srvaddr;
+		addr_un->sun_family = AF_UNIX;
+		snprintf(addr_un->sun_path, sizeof(addr_un->sun_path), "%s",
+				s_app.path);
+		unlink(s_app.path);
+		s_app.srvaddrlen = sizeof(*addr_un);
+	} else {
+		addr_in = (struct sockaddr_in *)&s_app.srvaddr;
+		addr_in->sin_family = AF_INET;
+		addr_in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr_in->sin_port = 0;
+		s_app.srvaddrlen = sizeof(*addr_in);
+	}
+
+	if (scn->transport == TRANSPORT_UDP) {
+		res = pomp_ctx_bind(s_app.srv,
+				(const struct sockaddr *)&s_app.srvaddr,
+				s_app.srvaddrlen);
+	} else {
+		res = pomp_ctx_listen(s_app.srv,
+				(const struct sockaddr *)&s_app.srvaddr,
+				s_app.srvaddrlen);
+	}
+	if (res < 0) {
+		diag("pomp_ctx_%s: err=%d(%s)",
+				scn->transport == TRANSPORT_UDP ?
+					"bind" : "listen",
+				res, strerror(-res));
+		return res;
+	}
+
+	/* Room for a datagram from every client */
+	if (scn->transport == TRANSPORT_UDP)
+		set_rcvbuf(s_app.srv, scn->conns);
+
+	/* Retrieve the actual port */
+	if (scn->transport != TRANSPORT_UNIX) {
+		addr = pomp_ctx_get_local_addr(s_app.srv, &addrlen);
+		if (addr == NULL || addrlen > sizeof(s_app.srvaddr))
+			return -EINVAL;
+		memcpy(&s_app.srvaddr, addr, addrlen);
+		s_app.srvaddrlen = addrlen;
+	}
+
+	return 0;
+}
+
+/**
+ * Setup client side of a scenario and wait for all connections.
+ */
+static int setup_clients(const struct scenario *scn)
+{
+	int res = 0;
+	uint32_t i = 0;
+	uint64_t deadline = 0;
+	struct client *client = NULL;
+	struct sockaddr_in bindaddr;
+
+	s_app.clients = calloc(scn->conns, sizeof(*s_app.clients));
+	if (s_app.clients == NULL)
+		return -ENOMEM;
+
+	memset(&bindaddr, 0, sizeof(bindaddr));
+	bindaddr.sin_family = AF_INET;
+	bindaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	for (i = 0; i < scn->conns; i++) {
+		client = &s_app.clients[i];
+		client->idx = i;
+		client->quota = s_app.total / scn->conns
+				+ (i < s_app.total % scn->conns ? 1 : 0);
+		client->ctx = pomp_ctx_new_with_loop(&cli_event_cb, client,
+				s_app.loop);
+		if (client->ctx == NULL)
+			return -ENOMEM;
+		if (scn->transport == TRANSPORT_UDP) {
+			pomp_ctx_set_read_buffer_len(client->ctx,
+					UDP_MAX_SIZE + 1024);
+		}
+
+		if (scn->transport == TRANSPORT_UDP) {
+			res = pomp_ctx_bind(client->ctx,
+					(const struct sockaddr *)&bindaddr,
+					sizeof(bindaddr));
+		} else {
+			res = pomp_ctx_connect(client->ctx,
+					(const struct sockaddr *)&s_app.srvaddr,
+					s_app.srvaddrlen);
+		}
+		if (res < 0) {
+			diag("pomp_ctx_%s: err=%d(%s)",
+					scn->transport == TRANSPORT_UDP ?
+						"bind" : "connect",
+					res, strerror(-res));
+			return res;
+		}
+	}
+
+	/* Wait for both ends of all connections */
+	if (scn->transport == TRANSPORT_UDP)
+		return 0;
+	deadline = get_time() + SETUP_TIMEOUT;
+	while (s_app.running && (s_app.connected < scn->conns
+			|| s_app.accepted < scn->conns)) {
+		if (get_time() > deadline) {
+			diag("Only %u/%u connections established",
+					s_app.connected, scn->conns);
+			return -ETIMEDOUT;
+		}
+		pomp_loop_wait_and_process(s_app.loop, 100);
+	}
+
+	return 0;
+}
+
+/**
+ * Release everything allocated for a scenario.
+ */
+static void cleanup_scenario(const struct scenario *scn)
+{
+	uint32_t i = 0;
+
+	if (s_app.clients != NULL) {
+		for (i = 0; i < scn->conns; i++) {
+			if (s_app.clients[i].ctx == NULL)
+				continue;
+			pomp_ctx_stop(s_app.clients[i].ctx);
+			pomp_ctx_destroy(s_app.clients[i].ctx);
+		}
+		free(s_app.clients);
+		s_app.clients = NULL;
+	}
+	if (s_app.srv != NULL) {
+		pomp_ctx_stop(s_app.srv);
+		pomp_ctx_destroy(s_app.srv);
+		s_app.srv = NULL;
+	}
+	if (scn->transport == TRANSPORT_UNIX)
+		unlink(s_app.path);
+
+	free(s_app.latencies);
+	s_app.latencies = NULL;
+	s_app.latcount = 0;
+	s_app.accepted = 0;
+	s_app.connected = 0;
+	s_app.completed = 0;
+	s_app.lost = 0;
+	s_app.bytes = 0;
+	s_app.error = 0;
+}
+
+/**
+ * Account messages still in flight as lost and restart sending.
+ */
+static void recover_loss(const struct scenario *scn)
+{
+	uint32_t i = 0, inflight = 0;
+	struct client *client = NULL;
+
+	s_app.progress = get_time();
+	for (i = 0; i < scn->conns; i++) {
+		client = &s_app.clients[i];
+		inflight = client->sent - client->completed;
+		client->completed += inflight;
+		s_app.lost += inflight;
+	}
+	for (i = 0; i < scn->conns; i++)
+		client_pump(&s_app.clients[i]);
+}
+
+/**
+ * Run a scenario.
+ * @return 0 if run, 1 if skipped, negative errno value in case of error.
+ */
+static int run_scenario(const struct scenario *scn, struct result *result)
+{
+	int res = 0;
+	uint32_t i = 0;
+	uint64_t start = 0, end = 0, perconn = 0;
+	double cpu = 0.0;
+
+	/* Skip combinations the transport does not support */
+	if (scn->fds && scn->transport != TRANSPORT_UNIX)
+		return 1;
+	if (scn->transport == TRANSPORT_UDP && scn->size > UDP_MAX_SIZE)
+		return 1;
+
+	/* Number of messages bounded by the byte budget */
+	s_app.scn = scn;
+	s_app.total = s_app.count;
+	if ((uint64_t)s_app.total * scn->size > s_app.budget)
+		s_app.total = (uint32_t)(s_app.budget / scn->size);
+	if (s_app.total == 0)
+		s_app.total = 1;
+
+	/* Window bounded by the bytes in flight */
+	s_app.window_eff = scn->mode == MODE_PINGPONG ? 1 : s_app.window;
+	perconn = INFLIGHT_BUDGET / ((uint64_t)scn->size * scn->conns);
+	if (perconn < s_app.window_eff)
+		s_app.window_eff = perconn > 0 ? (uint32_t)perconn : 1;
+
+	s_app.latencies = calloc(s_app.total, sizeof(*s_app.latencies));
+	if (s_app.latencies == NULL) {
+		res = -ENOMEM;
+		goto out;
+	}
+
+	res = setup_server(scn);
+	if (res < 0)
+		goto out;
+	res = setup_clients(scn);
+	if (res < 0)
+		goto out;
+
+	/* Start all clients then run until done, stalled or interrupted */
+	cpu = get_cpu_time();
+	start = get_time();
+	for (i = 0; i < scn->conns; i++)
+		client_pump(&s_app.clients[i]);
+	s_app.progress = get_time();
+	while (s_app.running && s_app.error == 0
+			&& s_app.completed + s_app.lost < s_app.total) {
+		pomp_loop_wait_and_process(s_app.loop, 100);
+		if (scn->transport == TRANSPORT_UDP
+				&& get_time() - s_app.progress > LOSS_TIMEOUT)
+			recover_loss(scn);
+		else if (get_time() - s_app.progress > STALL_TIMEOUT)
+			break;
+	}
+	end = get_time();
+	cpu = get_cpu_time() - cpu;
+	if (s_app.error != 0) {
+		res = s_app.error;
+		goto out;
+	}
+
+	/* Compute results */
+	qsort(s_app.latencies, s_app.latcount, sizeof(*s_app.latencies),
+			&cmp_u64);
+	result->msgs = s_app.completed;
+	result->lost = s_app.total - s_app.completed;
+	result->bytes = (uint64_t)s_app.completed * scn->size;
+	result->elapsed = (double)(end - start) / 1e9;
+	result->cpu = cpu;
+	result->p50 = percentile(0.50);
+	result->p99 = percentile(0.99);
+	result->p999 = percentile(0.999);
+
+out:
+	cleanup_scenario(scn);
+	return res;
+}
+
+/**
+ * Get the n-th combination of the parameter lists (last list varies
+ * fastest).
+ */
+static void get_scenario(uint32_t n, struct scenario *scn)
+{
+	memset(scn, 0, sizeof(*scn));
+	scn->conns = s_app.conns.values[n % s_app.conns.count];
+	n /= s_app.conns.count;
+	scn->fds = s_app.fds.values[n % s_app.fds.count] != 0;
+	n /= s_app.fds.count;
+	scn->size = s_app.sizes.values[n % s_app.sizes.count];
+	n /= s_app.sizes.count;
+	scn->mode = s_app.modes.values[n % s_app.modes.count];
+	n /= s_app.modes.count;
+	scn->transport = s_app.transports.values[n];
+}
+
+/**
+ *
+ */
+static void print_header(void)
+{
+	if (s_app.csv) {
+		printf("transport,mode,size,fds,conns,msgs,lost,time_s,"
+				"msgs_per_s,mb_per_s,p50_us,p99_us,p999_us,"
+				"cpu_us_per_msg\n");
+	} else {
+		printf("%-5s %-8s %8s %3s %5s %8s %5s %10s %9s %9s %9s %9s "
+				"%8s\n",
+				"trans", "mode", "size", "fds", "conns",
+				"msgs", "lost", "msgs/s", "MB/s", "p50_us",
+				"p99_us", "p999_us", "cpu_us");
+	}
+	fflush(stdout);
+}
+
+/**
+ *
+ */
+static void print_result(const struct scenario *scn,
+		const struct result *result)
+{
+	double rate = 0.0, mbps = 0.0, cpumsg = 0.0;
+
+	if (result->elapsed > 0.0) {
+		rate = result->msgs / result->elapsed;
+		mbps = result->bytes / result->elapsed / (1024.0 * 1024.0);
+	}
+	if (result->msgs > 0)
+		cpumsg = result->cpu * 1e6 / result->msgs;
+
+	if (s_app.csv) {
+		printf("%s,%s,%u,%u,%u,%u,%u,%.6f,%.0f,%.3f,%.3f,%.3f,%.3f,"
+				"%.3f\n",
+				s_transport_names[scn->transport],
+				s_mode_names[scn->mode], scn->size, scn->fds,
+				scn->conns, result->msgs, result->lost,
+				result->elapsed, rate, mbps, result->p50,
+				result->p99, result->p999, cpumsg);
+	} else {
+		printf("%-5s %-8s %8u %3u %5u %8u %5u %10.0f %9.1f %9.1f "
+				"%9.1f %9.1f %8.2f\n",
+				s_transport_names[scn->transport],
+				s_mode_names[scn->mode], scn->size, scn->fds,
+				scn->conns, result->msgs, result->lost, rate,
+				mbps, result->p50, result->p99, result->p999,
+				cpumsg);
+	}
+	fflush(stdout);
+}
+
+/**
+ * Parse a comma separated list of numbers or names.
+ * @param str : string to parse.
+ * @param names : names allowed instead of numbers (NULL for numbers).
+ * @param namecount : number of names.
+ * @param list : list to fill.
+ * @return 0 in case of success, negative errno value in case of error.
+ */
+static int parse_list(const char *str, const char * const *names,
+		uint32_t namecount, struct list *list)
+{
+	uint32_t i = 0;
+	size_t len = 0;
+	char *end = NULL;
+
+	list->count = 0;
+	while (*str != '\0') {
+		if (list->count >= MAX_LIST)
+			return -E2BIG;
+
+		len = strcspn(str, ",");
+		if (names != NULL) {
+			for (i = 0; i < namecount; i++) {
+				if (strlen(names[i]) == len
+						&& strncmp(str, names[i],
+							len) == 0) {
+					break;
+				}
+			}
+			if (i == namecount)
+				return -EINVAL;
+			list->values[list->count++] = i;
+		} else {
+			list->values[list->count++] =
+					(uint32_t)strtoul(str, &end, 0);
+			if (end != str + len)
+				return -EINVAL;
+		}
+
+		str += len;
+		if (*str == ',')
+			str++;
+	}
+
+	return list->count == 0 ? -EINVAL : 0;
+}
+
+/**
+ *
+ */
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [<options>]\n", progname);
+	fprintf(stderr, "Measure throughput and latency of libpomp transports\n"
+			"for every combination of the given parameters.\n"
+			"Client and server share a loop, so cpu time includes\n"
+			"both ends.\n"
+			"\n");
+	fprintf(stderr, "  -h --help : print this help message and exit\n");
+	fprintf(stderr, "  -t --transports <list> : unix,tcp,udp "
+			"(default all)\n");
+	fprintf(stderr, "  -m --modes <list> : pingpong,stream "
+			"(default all)\n");
+	fprintf(stderr, "  -s --sizes <list> : payload sizes in bytes\n"
+			"     (default 16,256,4096,65536,1048576,4194304)\n");
+	fprintf(stderr, "  -f --fds <list> : pass a file descriptor with "
+			"messages, unix only (default 0,1)\n");
+	fprintf(stderr, "  -c --conns <list> : connections per loop "
+			"(default 1,1000)\n");
+	fprintf(stderr, "  -n --count <n> : messages per scenario "
+			"(default %u)\n", s_app.count);
+	fprintf(stderr, "  -b --budget <n> : max payload bytes per scenario "
+			"(default %llu)\n", (unsigned long long)s_app.budget);
+	fprintf(stderr, "  -w --window <n> : messages in flight per "
+			"connection in stream mode (default %u)\n",
+			s_app.window);
+	fprintf(stderr, "  -p --path <path> : unix socket path (default %s)\n",
+			s_app.path);
+	fprintf(stderr, "  -C --csv : machine readable output\n");
+	fprintf(stderr, "\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[])
+{
+	int res = 0, status = EXIT_SUCCESS;
+	int c = 0;
+	uint32_t n = 0, total = 0;
+	struct scenario scn;
+	struct result result;
+	struct rlimit rl;
+
+	const char short_options[] = "ht:m:s:f:c:n:b:w:p:C";
+	const struct option long_options[] = {
+		{"help"      , no_argument      , NULL, 'h' },
+		{"transports", required_argument, NULL, 't' },
+		{"modes"     , required_argument, NULL, 'm' },
+		{"sizes"     , required_argument, NULL, 's' },
+		{"fds"       , required_argument, NULL, 'f' },
+		{"conns"     , required_argument, NULL, 'c' },
+		{"count"     , required_argument, NULL, 'n' },
+		{"budget"    , required_argument, NULL, 'b' },
+		{"window"    , required_argument, NULL, 'w' },
+		{"path"      , required_argument, NULL, 'p' },
+		{"csv"       , no_argument      , NULL, 'C' },
+		{0, 0, 0, 0},
+	};
+
+	/* Defaults */
+	parse_list("unix,tcp,udp", s_transport_names, TRANSPORT_COUNT,
+			&s_app.transports);
+	parse_list("pingpong,stream", s_mode_names, MODE_COUNT, &s_app.modes);
+	parse_list("16,256,4096,65536,1048576,4194304", NULL, 0, &s_app.sizes);
+	parse_list("0,1", NULL, 0, &s_app.fds);
+	parse_list("1,1000", NULL, 0, &s_app.conns);
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_options, long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			goto out;
+
+		case 't':
+			res = parse_list(optarg, s_transport_names,
+					TRANSPORT_COUNT, &s_app.transports);
+			break;
+
+		case 'm':
+			res = parse_list(optarg, s_mode_names, MODE_COUNT,
+					&s_app.modes);
+			break;
+
+		case 's':
+			res = parse_list(optarg, NULL, 0, &s_app.sizes);
+			break;
+
+		case 'f':
+			res = parse_list(optarg, NULL, 0, &s_app.fds);
+			break;
+
+		case 'c':
+			res = parse_list(optarg, NULL, 0, &s_app.conns);
+			break;
+
+		case 'n':
+			s_app.count = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 'b':
+			s_app.budget = strtoull(optarg, NULL, 0);
+			break;
+
+		case 'w':
+			s_app.window = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 'p':
+			s_app.path = optarg;
+			break;
+
+		case 'C':
+			s_app.csv = 1;
+			break;
+
+		default:
+			res = -EINVAL;
+			break;
+		}
+
+		if (res < 0) {
+			usage(argv[0]);
+			status = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	if (s_app.count == 0 || s_app.budget == 0 || s_app.window == 0) {
+		usage(argv[0]);
+		status = EXIT_FAILURE;
+		goto out;
+	}
+
+	signal(SIGINT, &sig_handler);
+	signal(SIGTERM, &sig_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Both ends of each connection live in this process */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	s_app.loop = pomp_loop_new();
+	s_app.msg = pomp_msg_new();
+	s_app.fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (s_app.loop == NULL || s_app.msg == NULL || s_app.fd < 0)
+		goto error;
+
+	print_header();
+	total = s_app.transports.count * s_app.modes.count
+			* s_app.sizes.count * s_app.fds.count
+			* s_app.conns.count;
+	for (n = 0; n < total && s_app.running; n++) {
+		get_scenario(n, &scn);
+		if (scn.conns == 0 || scn.size == 0)
+			continue;
+
+		/* Payload reused by all messages of the scenario */
+		free(s_app.payload);
+		s_app.payload = malloc(scn.size);
+		if (s_app.payload == NULL)
+			goto error;
+		memset(s_app.payload, 0xa5, scn.size);
+
+		memset(&result, 0, sizeof(result));
+		res = run_scenario(&scn, &result);
+		if (res < 0) {
+			diag("%s/%s size=%u fds=%u conns=%u: err=%d(%s)",
+					s_transport_names[scn.transport],
+					s_mode_names[scn.mode], scn.size,
+					scn.fds, scn.conns, res,
+					strerror(-res));
+			status = EXIT_FAILURE;
+		} else if (res == 0) {
+			print_result(&scn, &result);
+		}
+	}
+	goto out;
+
+error:
+	status = EXIT_FAILURE;
+out:
+	free(s_app.payload);
+	if (s_app.fd >= 0)
+		close(s_app.fd);
+	if (s_app.msg != NULL)
+		pomp_msg_destroy(s_app.msg);
+	if (s_app.loop != NULL)
+		pomp_loop_destroy(s_app.loop);
+	return status;
+}
@@ -0,0 +1,738 @@
+/**
+ * @file pomp_bench_codec.c
+ *
+ * @brief Microbenchmark of message encoding, decoding and parsing.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Standard headers */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif /* !_GNU_SOURCE */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "libpomp.h"
+
+#define DIAG_PFX "POMPBENCHCODEC: "
+
+#define diag(_fmt, ...) \
+	fprintf(stderr, DIAG_PFX _fmt "\n", ##__VA_ARGS__)
+
+#define MSGID	1
+
+/** Size of long strings */
+#define LONG_STR_LEN	1023
+
+/** Size of large buffers */
+#define LARGE_BUF_LEN	(64 * 1024)
+
+/** Size of buffers in mixed messages */
+#define SMALL_BUF_LEN	256
+
+/** Number of iterations between two checks of the elapsed time */
+#define BATCH		64
+
+/** Chunk sizes used to feed the protocol parser (0 for whole message) */
+static const size_t s_chunks[] = {1, 7, 64, 1500, 0};
+
+/*
+ * Allocation counting.
+ *
+ * With glibc the allocator entry points are interposed so that allocations
+ * done by the library are counted. Elsewhere counts are reported as -1.
+ */
+#ifdef __GLIBC__
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t s_allocs;
+
+void *malloc(size_t size)
+{
+	s_allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	s_allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	s_allocs++;
+	return __libc_realloc(ptr, size);
+}
+
+char *strdup(const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *dst = malloc(len);
+	if (dst != NULL)
+		memcpy(dst, s, len);
+	return dst;
+}
+
+#define ALLOCS_COUNTED	1
+#define get_allocs()	(s_allocs)
+
+#else /* !__GLIBC__ */
+
+#define ALLOCS_COUNTED	0
+#define get_allocs()	(0)
+
+#endif /* !__GLIBC__ */
+
+/** Operation measured on a message shape */
+typedef int (*bench_fn_t)(struct pomp_msg *msg);
+
+/** Message shape */
+struct shape {
+	const char      *name;
+	bench_fn_t      msg_write;      /**< pomp_msg_write */
+	bench_fn_t      msg_read;       /**< pomp_msg_read */
+	bench_fn_t      enc_write;      /**< pomp_encoder_write_xxx */
+	bench_fn_t      dec_read;       /**< pomp_decoder_read_xxx */
+};
+
+/** */
+struct app {
+	double                  mintime;
+	int                     csv;
+	const char              *filter;
+	char                    longstr[LONG_STR_LEN + 1];
+	uint8_t                 largebuf[LARGE_BUF_LEN];
+	struct pomp_encoder     *enc;
+	struct pomp_decoder     *dec;
+	struct pomp_prot        *prot;
+	size_t                  chunk;
+};
+static struct app s_app = {
+		.mintime = 0.2,
+		.csv = 0,
+		.filter = NULL,
+		.enc = NULL,
+		.dec = NULL,
+		.prot = NULL,
+		.chunk = 0,
+};
+
+/**
+ *
+ */
+static uint64_t get_time(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Many integers of every width.
+ */
+
+static int ints_msg_write(struct pomp_msg *msg)
+{
+	return pomp_msg_write(msg, MSGID,
+			"%hhu%hhd%hu%hd%u%d%llu%lld"
+			"%hhu%hhd%hu%hd%u%d%llu%lld",
+			200, -100, 60000, -30000, 4000000000u, -2000000000,
+			10000000000ULL, -10000000000LL,
+			1, -1, 2, -2, 3u, -3, 4ULL, -4LL);
+}
+
+static int ints_msg_read(struct pomp_msg *msg)
+{
+	uint8_t u8[2];
+	int8_t i8[2];
+	uint16_t u16[2];
+	int16_t i16[2];
+	uint32_t u32[2];
+	int32_t i32[2];
+	unsigned long long u64[2];
+	long long i64[2];
+
+	return pomp_msg_read(msg,
+			"%hhu%hhd%hu%hd%u%d%llu%lld"
+			"%hhu%hhd%hu%hd%u%d%llu%lld",
+			&u8[0], &i8[0], &u16[0], &i16[0],
+			&u32[0], &i32[0], &u64[0], &i64[0],
+			&u8[1], &i8[1], &u16[1], &i16[1],
+			&u32[1], &i32[1], &u64[1], &i64[1]);
+}
+
+static int ints_enc_write(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+
+	for (i = 0; i < 2 && res == 0; i++) {
+		res |= pomp_encoder_write_u8(s_app.enc, 200);
+		res |= pomp_encoder_write_i8(s_app.enc, -100);
+		res |= pomp_encoder_write_u16(s_app.enc, 60000);
+		res |= pomp_encoder_write_i16(s_app.enc, -30000);
+		res |= pomp_encoder_write_u32(s_app.enc, 4000000000u);
+		res |= pomp_encoder_write_i32(s_app.enc, -2000000000);
+		res |= pomp_encoder_write_u64(s_app.enc, 10000000000ULL);
+		res |= pomp_encoder_write_i64(s_app.enc, -10000000000LL);
+	}
+	return res;
+}
+
+static int ints_dec_read(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+	uint8_t u8;
+	int8_t i8;
+	uint16_t u16;
+	int16_t i16;
+	uint32_t u32;
+	int32_t i32;
+	uint64_t u64;
+	int64_t i64;
+
+	for (i = 0; i < 2 && res == 0; i++) {
+		res |= pomp_decoder_read_u8(s_app.dec, &u8);
+		res |= pomp_decoder_read_i8(s_app.dec, &i8);
+		res |= pomp_decoder_read_u16(s_app.dec, &u16);
+		res |= pomp_decoder_read_i16(s_app.dec, &i16);
+		res |= pomp_decoder_read_u32(s_app.dec, &u32);
+		res |= pomp_decoder_read_i32(s_app.dec, &i32);
+		res |= pomp_decoder_read_u64(s_app.dec, &u64);
+		res |= pomp_decoder_read_i64(s_app.dec, &i64);
+	}
+	return res;
+}
+
+/*
+ * Long strings.
+ */
+
+static int strs_msg_write(struct pomp_msg *msg)
+{
+	return pomp_msg_write(msg, MSGID, "%s%s%s%s",
+			s_app.longstr, s_app.longstr,
+			s_app.longstr, s_app.longstr);
+}
+
+static int strs_msg_read(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+	char *s[4] = {NULL, NULL, NULL, NULL};
+
+	res = pomp_msg_read(msg, "%ms%ms%ms%ms", &s[0], &s[1], &s[2], &s[3]);
+	for (i = 0; i < 4; i++)
+		free(s[i]);
+	return res;
+}
+
+static int strs_enc_write(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+
+	for (i = 0; i < 4 && res == 0; i++)
+		res = pomp_encoder_write_str(s_app.enc, s_app.longstr);
+	return res;
+}
+
+static int strs_dec_read(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+	const char *s = NULL;
+
+	for (i = 0; i < 4 && res == 0; i++)
+		res = pomp_decoder_read_cstr(s_app.dec, &s);
+	return res;
+}
+
+/*
+ * Large buffers.
+ */
+
+static int bufs_msg_write(struct pomp_msg *msg)
+{
+	return pomp_msg_write(msg, MSGID, "%p%u%p%u",
+			s_app.largebuf, LARGE_BUF_LEN,
+			s_app.largebuf, LARGE_BUF_LEN);
+}
+
+static int bufs_msg_read(struct pomp_msg *msg)
+{
+	const void *p[2] = {NULL, NULL};
+	uint32_t len[2] = {0, 0};
+
+	return pomp_msg_read(msg, "%p%u%p%u", &p[0], &len[0], &p[1], &len[1]);
+}
+
+static int bufs_enc_write(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+
+	for (i = 0; i < 2 && res == 0; i++) {
+		res = pomp_encoder_write_buf(s_app.enc, s_app.largebuf,
+				LARGE_BUF_LEN);
+	}
+	return res;
+}
+
+static int bufs_dec_read(struct pomp_msg *msg)
+{
+	int res = 0, i = 0;
+	const void *p = NULL;
+	uint32_t len = 0;
+
+	for (i = 0; i < 2 && res == 0; i++)
+		res = pomp_decoder_read_cbuf(s_app.dec, &p, &len);
+	return res;
+}
+
+/*
+ * Mixed arguments typical of a command or an event.
+ */
+
+static int mixed_msg_write(struct pomp_msg *msg)
+{
+	return pomp_msg_write(msg, MSGID, "%hhu%u%d%llu%s%f%lf%p%u",
+			3, 42u, -7, 1234567890123ULL, "wifi/status",
+			1.5f, 3.25, s_app.largebuf, SMALL_BUF_LEN);
+}
+
+static int mixed_msg_read(struct pomp_msg *msg)
+{
+	int res = 0;
+	uint8_t u8 = 0;
+	uint32_t u32 = 0, len = 0;
+	int32_t i32 = 0;
+	unsigned long long u64 = 0;
+	char *s = NULL;
+	float f32 = 0.0f;
+	double f64 = 0.0;
+	const void *p = NULL;
+
+	res = pomp_msg_read(msg, "%hhu%u%d%llu%ms%f%lf%p%u",
+			&u8, &u32, &i32, &u64, &s, &f32, &f64, &p, &len);
+	free(s);
+	return res;
+}
+
+static int mixed_enc_write(struct pomp_msg *msg)
+{
+	int res = 0;
+
+	res |= pomp_encoder_write_u8(s_app.enc, 3);
+	res |= pomp_encoder_write_u32(s_app.enc, 42u);
+	res |= pomp_encoder_write_i32(s_app.enc, -7);
+	res |= pomp_encoder_write_u64(s_app.enc, 1234567890123ULL);
+	res |= pomp_encoder_write_str(s_app.enc, "wifi/status");
+	res |= pomp_encoder_write_f32(s_app.enc, 1.5f);
+	res |= pomp_encoder_write_f64(s_app.enc, 3.25);
+	res |= pomp_encoder_write_buf(s_app.enc, s_app.largebuf,
+			SMALL_BUF_LEN);
+	return res;
+}
+
+static int mixed_dec_read(struct pomp_msg *msg)
+{
+	int res = 0;
+	uint8_t u8 = 0;
+	uint32_t u32 = 0, len = 0;
+	int32_t i32 = 0;
+	uint64_t u64 = 0;
+	const char *s = NULL;
+	float f32 = 0.0f;
+	double f64 = 0.0;
+	const void *p = NULL;
+
+	res |= pomp_decoder_read_u8(s_app.dec, &u8);
+	res |= pomp_decoder_read_u32(s_app.dec, &u32);
+	res |= pomp_decoder_read_i32(s_app.dec, &i32);
+	res |= pomp_decoder_read_u64(s_app.dec, &u64);
+	res |= pomp_decoder_read_cstr(s_app.dec, &s);
+	res |= pomp_decoder_read_f32(s_app.dec, &f32);
+	res |= pomp_decoder_read_f64(s_app.dec, &f64);
+	res |= pomp_decoder_read_cbuf(s_app.dec, &p, &len);
+	return res;
+}
+
+static const struct shape s_shapes[] = {
+	{"ints", &ints_msg_write, &ints_msg_read,
+		&ints_enc_write, &ints_dec_read},
+	{"strs", &strs_msg_write, &strs_msg_read,
+		&strs_enc_write, &strs_dec_read},
+	{"bufs", &bufs_msg_write, &bufs_msg_read,
+		&bufs_enc_write, &bufs_dec_read},
+	{"mixed", &mixed_msg_write, &mixed_msg_read,
+		&mixed_enc_write, &mixed_dec_read},
+};
+
+/*
+ * Operations. Each one processes one message per call, 'ref' being a
+ * message already written with the shape.
+ */
+
+/** Context of an operation */
+struct op_ctx {
+	const struct shape      *shape;
+	struct pomp_msg         *msg;
+	const struct pomp_msg   *ref;
+};
+
+static int op_msg_write(struct op_ctx *ctx)
+{
+	return (*ctx->shape->msg_write)(ctx->msg);
+}
+
+static int op_msg_read(struct op_ctx *ctx)
+{
+	return (*ctx->shape->msg_read)((struct pomp_msg *)ctx->ref);
+}
+
+static int op_enc_write(struct op_ctx *ctx)
+{
+	int res = 0;
+
+	res = pomp_msg_init(ctx->msg, MSGID);
+	if (res < 0)
+		return res;
+	res = pomp_encoder_init(s_app.enc, ctx->msg);
+	if (res < 0)
+		return res;
+	res = (*ctx->shape->enc_write)(ctx->msg);
+	if (res < 0)
+		return res;
+	res = pomp_msg_finish(ctx->msg);
+	(void)pomp_msg_clear(ctx->msg);
+	return res;
+}
+
+static int op_dec_read(struct op_ctx *ctx)
+{
+	int res = 0;
+
+	res = pomp_decoder_init(s_app.dec, ctx->ref);
+	if (res < 0)
+		return res;
+	res = (*ctx->shape->dec_read)(NULL);
+	(void)pomp_decoder_clear(s_app.dec);
+	return res;
+}
+
+static int op_prot_decode(struct op_ctx *ctx)
+{
+	int res = 0;
+	const void *data = NULL;
+	const uint8_t *p = NULL;
+	size_t len = 0, off = 0, chunk = 0;
+	struct pomp_msg *msg = NULL;
+
+	res = pomp_buffer_get_cdata(pomp_msg_get_buffer(ctx->ref),
+			&data, &len, NULL);
+	if (res < 0)
+		return res;
+
+	/* Feed the parser as the socket layer would, chunk by chunk */
+	p = data;
+	while (off < len) {
+		chunk = s_app.chunk == 0 || s_app.chunk > len - off ?
+				len - off : s_app.chunk;
+		while (chunk > 0) {
+			res = pomp_prot_decode_msg(s_app.prot, p + off, chunk,
+					&msg);
+			if (res < 0)
+				return res;
+			off += (size_t)res;
+			chunk -= (size_t)res;
+			if (msg != NULL) {
+				pomp_prot_release_msg(s_app.prot, msg);
+				msg = NULL;
+			}
+		}
+	}
+	return 0;
+}
+
+static int op_adump(struct op_ctx *ctx)
+{
+	int res = 0;
+	char *str = NULL;
+
+	res = pomp_msg_adump(ctx->ref, &str);
+	free(str);
+	return res;
+}
+
+/** Operation descriptor */
+struct op {
+	const char      *name;
+	int             (*fn)(struct op_ctx *ctx);
+};
+
+static const struct op s_ops[] = {
+	{"msg_write", &op_msg_write},
+	{"msg_read", &op_msg_read},
+	{"encoder", &op_enc_write},
+	{"decoder", &op_dec_read},
+	{"prot_decode", &op_prot_decode},
+	{"adump", &op_adump},
+};
+
+/**
+ * Run an operation repeatedly for at least the minimum time.
+ */
+static int run_op(const struct op *op, struct op_ctx *ctx, size_t msgsize)
+{
+	int res = 0;
+	uint32_t i = 0;
+	uint64_t iters = 0, start = 0, elapsed = 0, allocs = 0;
+	uint64_t mintime = (uint64_t)(s_app.mintime * 1e9);
+	char name[32];
+	double nsmsg = 0.0, allocsmsg = -1.0;
+
+	/* Warm up caches and lazily allocated structures */
+	for (i = 0; i < BATCH; i++) {
+		res = (*op->fn)(ctx);
+		if (res < 0) {
+			diag("%s/%s: err=%d(%s)", ctx->shape->name, op->name,
+					res, strerror(-res));
+			return res;
+		}
+	}
+
+	allocs = get_allocs();
+	start = get_time();
+	do {
+		for (i = 0; i < BATCH; i++)
+			(*op->fn)(ctx);
+		iters += BATCH;
+		elapsed = get_time() - start;
+	} while (elapsed < mintime);
+	allocs = get_allocs() - allocs;
+
+	nsmsg = (double)elapsed / (double)iters;
+	if (ALLOCS_COUNTED)
+		allocsmsg = (double)allocs / (double)iters;
+
+	if (op->fn == &op_prot_decode && s_app.chunk == 0)
+		snprintf(name, sizeof(name), "%s/all", op->name);
+	else if (op->fn == &op_prot_decode)
+		snprintf(name, sizeof(name), "%s/%zu", op->name, s_app.chunk);
+	else
+		snprintf(name, sizeof(name), "%s", op->name);
+
+	if (s_app.csv) {
+		printf("%s,%s,%zu,%llu,%.1f,%.2f\n", ctx->shape->name, name,
+				msgsize, (unsigned long long)iters, nsmsg,
+				allocsmsg);
+	} else {
+		printf("%-6s %-16s %8zu %10llu %12.1f %10.2f\n",
+				ctx->shape->name, name, msgsize,
+				(unsigned long long)iters, nsmsg, allocsmsg);
+	}
+	fflush(stdout);
+	return 0;
+}
+
+/**
+ * Run all operations on a shape.
+ */
+static int run_shape(const struct shape *shape)
+{
+	int res = 0;
+	uint32_t i = 0, j = 0;
+	size_t msgsize = 0;
+	struct op_ctx ctx;
+	struct pomp_msg *ref = NULL;
+	const void *data = NULL;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.shape = shape;
+	ctx.msg = pomp_msg_new();
+	ref = pomp_msg_new();
+	if (ctx.msg == NULL || ref == NULL) {
+		res = -ENOMEM;
+		goto out;
+	}
+
+	res = (*shape->msg_write)(ref);
+	if (res < 0)
+		goto out;
+	ctx.ref = ref;
+	pomp_buffer_get_cdata(pomp_msg_get_buffer(ref), &data, &msgsize, NULL);
+
+	for (i = 0; i < sizeof(s_ops) / sizeof(s_ops[0]); i++) {
+		if (s_app.filter != NULL && strstr(s_ops[i].name,
+				s_app.filter) == NULL) {
+			continue;
+		}
+
+		if (s_ops[i].fn != &op_prot_decode) {
+			res = run_op(&s_ops[i], &ctx, msgsize);
+			if (res < 0)
+				goto out;
+			continue;
+		}
+
+		/* Parser is run with several input fragmentations */
+		for (j = 0; j < sizeof(s_chunks) / sizeof(s_chunks[0]); j++) {
+			s_app.chunk = s_chunks[j];
+			res = run_op(&s_ops[i], &ctx, msgsize);
+			if (res < 0)
+				goto out;
+		}
+	}
+
+out:
+	if (ctx.msg != NULL)
+		pomp_msg_destroy(ctx.msg);
+	if (ref != NULL)
+		pomp_msg_destroy(ref);
+	return res;
+}
+
+/**
+ *
+ */
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [<options>] [<shape>...]\n", progname);
+	fprintf(stderr, "Measure time and allocations per message of the\n"
+			"codec functions, without any network.\n"
+			"Shapes: ints, strs, bufs, mixed (default all).\n"
+			"\n");
+	fprintf(stderr, "  -h --help : print this help message and exit\n");
+	fprintf(stderr, "  -t --time <s> : minimum time per measure "
+			"(default %.1f)\n", s_app.mintime);
+	fprintf(stderr, "  -o --op <name> : only run operations whose name "
+			"contains <name>\n");
+	fprintf(stderr, "  -C --csv : machine readable output\n");
+	fprintf(stderr, "\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[])
+{
+	int res = 0, status = EXIT_SUCCESS;
+	int c = 0, argidx = 0;
+	uint32_t i = 0;
+
+	const char short_options[] = "ht:o:C";
+	const struct option long_options[] = {
+		{"help", no_argument      , NULL, 'h' },
+		{"time", required_argument, NULL, 't' },
+		{"op"  , required_argument, NULL, 'o' },
+		{"csv" , no_argument      , NULL, 'C' },
+		{0, 0, 0, 0},
+	};
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_options, long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			goto out;
+
+		case 't':
+			s_app.mintime = strtod(optarg, NULL);
+			break;
+
+		case 'o':
+			s_app.filter = optarg;
+			break;
+
+		case 'C':
+			s_app.csv = 1;
+			break;
+
+		default:
+			usage(argv[0]);
+			status = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	memset(s_app.longstr, 'a', LONG_STR_LEN);
+	s_app.longstr[LONG_STR_LEN] = '\0';
+	for (i = 0; i < LARGE_BUF_LEN; i++)
+		s_app.largebuf[i] = (uint8_t)i;
+
+	s_app.enc = pomp_encoder_new();
+	s_app.dec = pomp_decoder_new();
+	s_app.prot = pomp_prot_new();
+	if (s_app.enc == NULL || s_app.dec == NULL || s_app.prot == NULL)
+		goto error;
+
+	if (s_app.csv) {
+		printf("shape,op,msg_size,iterations,ns_per_msg,"
+				"allocs_per_msg\n");
+	} else {
+		printf("%-6s %-16s %8s %10s %12s %10s\n", "shape", "op",
+				"size", "iters", "ns/msg", "allocs/msg");
+	}
+
+	for (i = 0; i < sizeof(s_shapes) / sizeof(s_shapes[0]); i++) {
+		/* Only the shapes given on the command line, if any */
+		if (optind < argc) {
+			for (argidx = optind; argidx < argc; argidx++) {
+				if (strcmp(argv[argidx],
+						s_shapes[i].name) == 0) {
+					break;
+				}
+			}
+			if (argidx == argc)
+				continue;
+		}
+
+		res = run_shape(&s_shapes[i]);
+		if (res < 0)
+			status = EXIT_FAILURE;
+	}
+	goto out;
+
+error:
+	status = EXIT_FAILURE;
+out:
+	if (s_app.prot != NULL)
+		pomp_prot_destroy(s_app.prot);
+	if (s_app.dec != NULL)
+		pomp_decoder_destroy(s_app.dec);
+	if (s_app.enc != NULL)
+		pomp_encoder_destroy(s_app.enc);
+	return status;
+}
@@ -0,0 +1,435 @@
+/**
+ * @file tools/pomp_bench_cxx.cpp
+ *
+ * @brief Benchmark of message dispatch in the c++ wrapper.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Standard headers */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif /* !_GNU_SOURCE */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+
+#include "libpomp.hpp"
+
+#define DIAG_PFX "POMPBENCHCXX: "
+
+#define diag(_fmt, ...) \
+	fprintf(stderr, DIAG_PFX _fmt "\n", ##__VA_ARGS__)
+
+#define MSGID		1
+
+/** Size of raw buffers */
+#define RAW_LEN		16
+
+/** Maximum number of messages sent but not yet received */
+#define WINDOW		1024
+
+/** Default connection counts */
+static const uint32_t s_def_conns[] = {1, 10, 100, 1000};
+
+namespace {
+
+/**
+ * Server side handler, counts what it receives.
+ */
+class BenchHandler : public pomp::EventHandler {
+public:
+	uint32_t  mConnCount;  /**< Connected clients */
+	uint64_t  mMsgCount;   /**< Received messages */
+	uint64_t  mByteCount;  /**< Received raw bytes */
+
+	inline BenchHandler() : mConnCount(0), mMsgCount(0), mByteCount(0) {}
+
+	inline virtual void onConnected(pomp::Context *ctx,
+			pomp::Connection *conn) {
+		(void)ctx;
+		(void)conn;
+		mConnCount++;
+	}
+
+	inline virtual void onDisconnected(pomp::Context *ctx,
+			pomp::Connection *conn) {
+		(void)ctx;
+		(void)conn;
+		mConnCount--;
+	}
+
+	inline virtual void recvMessage(pomp::Context *ctx,
+			pomp::Connection *conn, const pomp::Message &msg) {
+		(void)ctx;
+		(void)conn;
+		(void)msg;
+		mMsgCount++;
+	}
+
+	inline virtual void recvRawBuf(pomp::Context *ctx,
+			pomp::Connection *conn, const pomp::Buffer &buf) {
+		(void)ctx;
+		(void)conn;
+		mByteCount += buf.size();
+	}
+};
+
+} /* anonymous namespace */
+
+/**
+ *
+ */
+struct app {
+	uint32_t		msgcount;
+	const char		*path;
+	int			csv;
+	uint32_t		conns[16];
+	uint32_t		conncount;
+};
+
+/**
+ *
+ */
+static struct app s_app = {
+	/* .msgcount = */ 200000,
+	/* .path = */ "/tmp/pomp-bench-cxx",
+	/* .csv = */ 0,
+	/* .conns = */ {0},
+	/* .conncount = */ 0,
+};
+
+/**
+ *
+ */
+static uint64_t get_time(clockid_t clk)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(clk, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ *
+ */
+static void client_event_cb(struct pomp_ctx *ctx, enum pomp_event event,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		void *userdata)
+{
+	(void)ctx;
+	(void)event;
+	(void)conn;
+	(void)msg;
+	(void)userdata;
+}
+
+/**
+ *
+ */
+static void client_raw_cb(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		struct pomp_buffer *buf, void *userdata)
+{
+	(void)ctx;
+	(void)conn;
+	(void)buf;
+	(void)userdata;
+}
+
+/**
+ *
+ */
+static uint64_t get_received(const BenchHandler &handler, int israw)
+{
+	return israw ? handler.mByteCount / RAW_LEN : handler.mMsgCount;
+}
+
+/**
+ *
+ */
+static int run(uint32_t conncount, int israw)
+{
+	int res = 0;
+	uint32_t i = 0;
+	uint64_t sent = 0;
+	uint64_t wall = 0, cpu = 0;
+	struct sockaddr_un addr;
+	struct pomp_ctx **clients = NULL;
+	struct pomp_ctx *sender = NULL;
+	struct pomp_msg *msg = NULL;
+	struct pomp_buffer *buf = NULL;
+	BenchHandler handler;
+	pomp::Loop loop;
+	pomp::Context *server = NULL;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, s_app.path, sizeof(addr.sun_path) - 1);
+	unlink(s_app.path);
+
+	/* Server using the c++ wrapper */
+	server = new pomp::Context(&handler, &loop);
+	(void)pomp_ctx_set_max_conn(server->get(), conncount);
+	if (israw)
+		(void)server->setRaw();
+	res = server->listen((const struct sockaddr *)&addr, sizeof(addr));
+	if (res < 0) {
+		diag("listen: err=%d(%s)", res, strerror(-res));
+		goto out;
+	}
+
+	/* Clients using the c api, the last one sends data */
+	clients = (struct pomp_ctx **)calloc(conncount, sizeof(*clients));
+	if (clients == NULL) {
+		res = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < conncount; i++) {
+		clients[i] = pomp_ctx_new_with_loop(&client_event_cb, NULL,
+				loop.get());
+		if (clients[i] == NULL) {
+			res = -ENOMEM;
+			goto out;
+		}
+		if (israw)
+			(void)pomp_ctx_set_raw(clients[i], &client_raw_cb);
+		res = pomp_ctx_connect(clients[i],
+				(const struct sockaddr *)&addr, sizeof(addr));
+		if (res < 0) {
+			diag("connect: err=%d(%s)", res, strerror(-res));
+			goto out;
+		}
+	}
+	while (handler.mConnCount < conncount) {
+		res = loop.waitAndProcess(1000);
+		if (res < 0) {
+			diag("timeout waiting for connections (%u/%u)",
+					handler.mConnCount, conncount);
+			goto out;
+		}
+	}
+	sender = clients[conncount - 1];
+
+	/* Prepare data to send */
+	if (israw) {
+		buf = pomp_buffer_new(RAW_LEN);
+		if (buf == NULL || pomp_buffer_set_len(buf, RAW_LEN) < 0) {
+			res = -ENOMEM;
+			goto out;
+		}
+	} else {
+		msg = pomp_msg_new();
+		if (msg == NULL || pomp_msg_write(msg, MSGID, "%u", 42) < 0) {
+			res = -ENOMEM;
+			goto out;
+		}
+	}
+
+	/* Keep a window of data in flight until everything is received */
+	wall = get_time(CLOCK_MONOTONIC);
+	cpu = get_time(CLOCK_PROCESS_CPUTIME_ID);
+	while (get_received(handler, israw) < s_app.msgcount) {
+		while (sent < s_app.msgcount
+				&& sent - get_received(handler, israw) < WINDOW) {
+			if (israw)
+				res = pomp_ctx_send_raw_buf(sender, buf);
+			else
+				res = pomp_ctx_send_msg(sender, msg);
+			if (res < 0) {
+				diag("send: err=%d(%s)", res, strerror(-res));
+				goto out;
+			}
+			sent++;
+		}
+		res = loop.waitAndProcess(1000);
+		if (res < 0) {
+			diag("timeout waiting for data");
+			goto out;
+		}
+	}
+	wall = get_time(CLOCK_MONOTONIC) - wall;
+	cpu = get_time(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+	if (s_app.csv) {
+		printf("%s,%u,%u,%.1f,%.1f\n", israw ? "raw" : "msg",
+				conncount, s_app.msgcount,
+				(double)cpu / s_app.msgcount,
+				(double)s_app.msgcount * 1e9 / wall);
+	} else {
+		printf("%-4s %6u %10u %14.1f %12.0f\n", israw ? "raw" : "msg",
+				conncount, s_app.msgcount,
+				(double)cpu / s_app.msgcount,
+				(double)s_app.msgcount * 1e9 / wall);
+	}
+	res = 0;
+
+out:
+	if (buf != NULL)
+		pomp_buffer_unref(buf);
+	if (msg != NULL)
+		pomp_msg_destroy(msg);
+	if (clients != NULL) {
+		for (i = 0; i < conncount && clients[i] != NULL; i++) {
+			(void)pomp_ctx_stop(clients[i]);
+			(void)pomp_ctx_destroy(clients[i]);
+		}
+		free(clients);
+	}
+	if (server != NULL) {
+		(void)server->stop();
+		delete server;
+	}
+	unlink(s_app.path);
+	return res;
+}
+
+/**
+ *
+ */
+static void raise_fd_limit(void)
+{
+	struct rlimit rlim;
+	if (getrlimit(RLIMIT_NOFILE, &rlim) == 0
+			&& rlim.rlim_cur < rlim.rlim_max) {
+		rlim.rlim_cur = rlim.rlim_max;
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+}
+
+/**
+ *
+ */
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [<options>] [<conns>...]\n", progname);
+	fprintf(stderr, "Measure the cost per message of the c++ wrapper "
+			"dispatch with a server\n"
+			"having a given number of connected clients, only one "
+			"of them sending.\n"
+			"Default connection counts: 1 10 100 1000.\n"
+			"\n");
+	fprintf(stderr, "  -h --help : print this help message and exit\n");
+	fprintf(stderr, "  -n --count <n> : number of messages per run "
+			"(default %u)\n", s_app.msgcount);
+	fprintf(stderr, "  -p --path <path> : unix socket path "
+			"(default %s)\n", s_app.path);
+	fprintf(stderr, "  -C --csv : machine readable output\n");
+	fprintf(stderr, "\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[])
+{
+	int status = EXIT_SUCCESS;
+	int c = 0, israw = 0;
+	uint32_t i = 0;
+
+	const char short_options[] = "hn:p:C";
+	const struct option long_options[] = {
+		{"help" , no_argument      , NULL, 'h' },
+		{"count", required_argument, NULL, 'n' },
+		{"path" , required_argument, NULL, 'p' },
+		{"csv"  , no_argument      , NULL, 'C' },
+		{0, 0, 0, 0},
+	};
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_options, long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			goto out;
+
+		case 'n':
+			s_app.msgcount = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 'p':
+			s_app.path = optarg;
+			break;
+
+		case 'C':
+			s_app.csv = 1;
+			break;
+
+		default:
+			usage(argv[0]);
+			status = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	/* Connection counts from command line or default ones */
+	for (; optind < argc && s_app.conncount < 16; optind++) {
+		s_app.conns[s_app.conncount] =
+				(uint32_t)strtoul(argv[optind], NULL, 0);
+		if (s_app.conns[s_app.conncount] != 0)
+			s_app.conncount++;
+	}
+	if (s_app.conncount == 0) {
+		for (i = 0; i < sizeof(s_def_conns) / sizeof(s_def_conns[0]);
+				i++) {
+			s_app.conns[s_app.conncount++] = s_def_conns[i];
+		}
+	}
+	if (s_app.msgcount == 0) {
+		usage(argv[0]);
+		status = EXIT_FAILURE;
+		goto out;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	raise_fd_limit();
+
+	if (s_app.csv) {
+		printf("mode,conns,msgs,cpu_ns_per_msg,msgs_per_s\n");
+	} else {
+		printf("%-4s %6s %10s %14s %12s\n", "mode", "conns", "msgs",
+				"cpu ns/msg", "msgs/s");
+	}
+
+	for (israw = 0; israw <= 1; israw++) {
+		for (i = 0; i < s_app.conncount; i++) {
+			if (run(s_app.conns[i], israw) < 0)
+				status = EXIT_FAILURE;
+		}
+	}
+
+out:
+	return status;
+}
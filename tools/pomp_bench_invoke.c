@@ -0,0 +1,274 @@
+/**
+ * @file pomp_bench_invoke.c
+ *
+ * @brief Benchmark of pomp_loop_invoke against pomp_loop_lock/unlock.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Standard headers */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif /* !_GNU_SOURCE */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "libpomp.h"
+
+#define DIAG_PFX "POMPBENCHINVOKE: "
+
+#define diag(_fmt, ...) \
+	fprintf(stderr, DIAG_PFX _fmt "\n", ##__VA_ARGS__)
+
+#define MAX_THREADS	64
+
+/** Way other threads access the loop */
+enum mode {
+	MODE_INVOKE = 0,	/**< pomp_loop_invoke, waiting for completion */
+	MODE_INVOKE_ASYNC,	/**< pomp_loop_invoke, not waiting */
+	MODE_LOCK,		/**< pomp_loop_lock/pomp_loop_unlock */
+};
+
+/** */
+struct app {
+	uint32_t                count;
+	uint32_t                threads;
+	enum mode               mode;
+	struct pomp_loop        *loop;
+	uint32_t                calls;
+	uint32_t                failed;
+	uint32_t                running;
+};
+static struct app s_app = {
+		.count = 200000,
+		.threads = 1,
+		.mode = MODE_INVOKE,
+		.loop = NULL,
+		.calls = 0,
+		.failed = 0,
+		.running = 0,
+};
+
+/**
+ *
+ */
+static double get_time(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Work done on behalf of other threads, only touches loop thread data.
+ */
+static void invoke_cb(void *userdata)
+{
+	s_app.calls++;
+}
+
+/**
+ *
+ */
+static void *worker(void *userdata)
+{
+	int res = 0;
+	uint32_t i = 0;
+
+	for (i = 0; i < s_app.count; i++) {
+		switch (s_app.mode) {
+		case MODE_INVOKE:
+			res = pomp_loop_invoke(s_app.loop, &invoke_cb, NULL, 1);
+			break;
+
+		case MODE_INVOKE_ASYNC:
+			res = pomp_loop_invoke(s_app.loop, &invoke_cb, NULL, 0);
+			break;
+
+		case MODE_LOCK:
+			res = pomp_loop_lock(s_app.loop);
+			if (res == 0) {
+				invoke_cb(NULL);
+				res = pomp_loop_unlock(s_app.loop);
+			}
+			break;
+		}
+		if (res < 0)
+			__atomic_add_fetch(&s_app.failed, 1, __ATOMIC_RELAXED);
+	}
+
+	/* Last worker stops the loop */
+	if (__atomic_sub_fetch(&s_app.running, 1, __ATOMIC_ACQ_REL) == 0)
+		pomp_loop_wakeup(s_app.loop);
+	return NULL;
+}
+
+/**
+ *
+ */
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [<options>]\n", progname);
+	fprintf(stderr, "Measure the cost for other threads to run code on\n"
+			"the thread processing a loop.\n"
+			"\n");
+	fprintf(stderr, "  -h --help : print this help message and exit\n");
+	fprintf(stderr, "  -n --count <n> : calls per thread (default %u)\n",
+			s_app.count);
+	fprintf(stderr, "  -t --threads <n> : calling threads (default %u)\n",
+			s_app.threads);
+	fprintf(stderr, "  -m --mode <mode> : invoke, invoke-async or lock "
+			"(default invoke)\n");
+	fprintf(stderr, "\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[])
+{
+	int res = 0, status = EXIT_SUCCESS;
+	int c = 0;
+	uint32_t i = 0, started = 0, total = 0;
+	double start = 0.0, elapsed = 0.0;
+	pthread_t tids[MAX_THREADS];
+	static const char * const modes[] = {"invoke", "invoke-async", "lock"};
+
+	const char short_options[] = "hn:t:m:";
+	const struct option long_options[] = {
+		{"help"   , no_argument      , NULL, 'h' },
+		{"count"  , required_argument, NULL, 'n' },
+		{"threads", required_argument, NULL, 't' },
+		{"mode"   , required_argument, NULL, 'm' },
+		{0, 0, 0, 0},
+	};
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_options, long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			goto out;
+
+		case 'n':
+			s_app.count = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 't':
+			s_app.threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 'm':
+			if (strcmp(optarg, "invoke") == 0) {
+				s_app.mode = MODE_INVOKE;
+			} else if (strcmp(optarg, "invoke-async") == 0) {
+				s_app.mode = MODE_INVOKE_ASYNC;
+			} else if (strcmp(optarg, "lock") == 0) {
+				s_app.mode = MODE_LOCK;
+			} else {
+				usage(argv[0]);
+				status = EXIT_FAILURE;
+				goto out;
+			}
+			break;
+
+		default:
+			usage(argv[0]);
+			status = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	if (s_app.threads == 0 || s_app.threads > MAX_THREADS) {
+		usage(argv[0]);
+		status = EXIT_FAILURE;
+		goto out;
+	}
+
+	/* Create loop, lock/unlock requires thread synchronization */
+	s_app.loop = pomp_loop_new();
+	if (s_app.loop == NULL)
+		goto error;
+	if (s_app.mode == MODE_LOCK) {
+		res = pomp_loop_enable_thread_sync(s_app.loop);
+		if (res < 0) {
+			diag("pomp_loop_enable_thread_sync: err=%d(%s)",
+					res, strerror(-res));
+			goto error;
+		}
+	}
+
+	/* Start workers and process the loop until they are all done */
+	start = get_time();
+	s_app.running = s_app.threads;
+	for (started = 0; started < s_app.threads; started++) {
+		res = pthread_create(&tids[started], NULL, &worker, NULL);
+		if (res != 0) {
+			diag("pthread_create: err=%d(%s)", res, strerror(res));
+			__atomic_sub_fetch(&s_app.running,
+					s_app.threads - started,
+					__ATOMIC_ACQ_REL);
+			status = EXIT_FAILURE;
+			break;
+		}
+	}
+	while (__atomic_load_n(&s_app.running, __ATOMIC_ACQUIRE) != 0)
+		pomp_loop_wait_and_process(s_app.loop, 100);
+	for (i = 0; i < started; i++)
+		pthread_join(tids[i], NULL);
+
+	/* Run remaining asynchronous calls */
+	total = started * s_app.count;
+	while (s_app.calls + s_app.failed < total)
+		pomp_loop_wait_and_process(s_app.loop, 100);
+	elapsed = get_time() - start;
+
+	printf("mode=%s threads=%u calls=%u failed=%u time=%.3fs "
+			"calls/s=%.0f us/call=%.3f\n",
+			modes[s_app.mode], started, s_app.calls, s_app.failed,
+			elapsed,
+			elapsed > 0.0 ? s_app.calls / elapsed : 0.0,
+			s_app.calls > 0 ? elapsed * 1e6 / s_app.calls : 0.0);
+	if (s_app.failed != 0)
+		status = EXIT_FAILURE;
+	goto out;
+
+error:
+	status = EXIT_FAILURE;
+out:
+	if (s_app.loop != NULL)
+		pomp_loop_destroy(s_app.loop);
+	return status;
+}
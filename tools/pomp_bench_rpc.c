@@ -0,0 +1,308 @@
+/**
+ * @file pomp_bench_rpc.c
+ *
+ * @brief Benchmark of request/response calls over a local socket.
+ *
+ * Copyright (c) 2026 Parrot Drones SAS.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Standard headers */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif /* !_GNU_SOURCE */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+/* Unix headers */
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "libpomp.h"
+
+#define DIAG_PFX "POMPBENCHRPC: "
+
+#define diag(_fmt, ...) \
+	fprintf(stderr, DIAG_PFX _fmt "\n", ##__VA_ARGS__)
+
+#define MSGID_REQ	1
+#define MSGID_REP	2
+
+/** */
+struct app {
+	uint32_t                count;
+	uint32_t                window;
+	uint32_t                timeout;
+	const char              *path;
+	struct pomp_loop        *loop;
+	struct pomp_ctx         *srv;
+	struct pomp_ctx         *cli;
+	struct pomp_conn        *conn;
+	uint32_t                issued;
+	uint32_t                completed;
+	uint32_t                failed;
+};
+static struct app s_app = {
+		.count = 1000000,
+		.window = 64,
+		.timeout = 5000,
+		.path = "/tmp/pomp-bench-rpc",
+		.loop = NULL,
+		.srv = NULL,
+		.cli = NULL,
+		.conn = NULL,
+		.issued = 0,
+		.completed = 0,
+		.failed = 0,
+};
+
+/**
+ *
+ */
+static double get_time(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ *
+ */
+static void call_cb(struct pomp_conn *conn, enum pomp_rpc_status status,
+		const struct pomp_msg *msg, void *userdata);
+
+/**
+ *
+ */
+static void issue_call(void)
+{
+	int res = 0;
+
+	res = pomp_conn_call(s_app.conn, MSGID_REQ, MSGID_REP,
+			s_app.timeout, &call_cb, NULL, "%u", s_app.issued);
+	if (res < 0) {
+		diag("pomp_conn_call: err=%d(%s)", res, strerror(-res));
+		s_app.failed++;
+		s_app.completed++;
+	}
+	s_app.issued++;
+}
+
+/**
+ *
+ */
+static void call_cb(struct pomp_conn *conn, enum pomp_rpc_status status,
+		const struct pomp_msg *msg, void *userdata)
+{
+	if (status != POMP_RPC_STATUS_OK)
+		s_app.failed++;
+	s_app.completed++;
+
+	/* Keep the window full */
+	if (s_app.issued < s_app.count)
+		issue_call();
+}
+
+/**
+ *
+ */
+static void srv_event_cb(struct pomp_ctx *ctx, enum pomp_event event,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		void *userdata)
+{
+	uint32_t callid = 0, value = 0;
+
+	if (event != POMP_EVENT_MSG || pomp_msg_get_id(msg) != MSGID_REQ)
+		return;
+
+	if (pomp_msg_read(msg, "%u%u", &callid, &value) == 0)
+		pomp_conn_reply(conn, MSGID_REP, msg, "%u", value);
+}
+
+/**
+ *
+ */
+static void cli_event_cb(struct pomp_ctx *ctx, enum pomp_event event,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		void *userdata)
+{
+	if (event == POMP_EVENT_CONNECTED)
+		s_app.conn = conn;
+	else if (event == POMP_EVENT_DISCONNECTED)
+		s_app.conn = NULL;
+}
+
+/**
+ *
+ */
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [<options>]\n", progname);
+	fprintf(stderr, "Measure request/response calls per second between\n"
+			"a client and a server sharing a loop.\n"
+			"\n");
+	fprintf(stderr, "  -h --help : print this help message and exit\n");
+	fprintf(stderr, "  -n --count <n> : number of calls (default %u)\n",
+			s_app.count);
+	fprintf(stderr, "  -w --window <n> : calls in flight (default %u)\n",
+			s_app.window);
+	fprintf(stderr, "  -p --path <path> : unix socket path (default %s)\n",
+			s_app.path);
+	fprintf(stderr, "\n");
+}
+
+/**
+ *
+ */
+int main(int argc, char *argv[])
+{
+	int res = 0, status = EXIT_SUCCESS;
+	int c = 0;
+	uint32_t i = 0;
+	double start = 0.0, elapsed = 0.0;
+	struct sockaddr_un addr;
+
+	const char short_options[] = "hn:w:p:";
+	const struct option long_options[] = {
+		{"help"  , no_argument      , NULL, 'h' },
+		{"count" , required_argument, NULL, 'n' },
+		{"window", required_argument, NULL, 'w' },
+		{"path"  , required_argument, NULL, 'p' },
+		{0, 0, 0, 0},
+	};
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_options, long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			goto out;
+
+		case 'n':
+			s_app.count = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 'w':
+			s_app.window = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+
+		case 'p':
+			s_app.path = optarg;
+			break;
+
+		default:
+			usage(argv[0]);
+			status = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	if (s_app.window == 0 || strlen(s_app.path) >= sizeof(addr.sun_path)) {
+		usage(argv[0]);
+		status = EXIT_FAILURE;
+		goto out;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, s_app.path);
+	unlink(s_app.path);
+
+	/* Create loop and contexts */
+	s_app.loop = pomp_loop_new();
+	if (s_app.loop == NULL)
+		goto error;
+	s_app.srv = pomp_ctx_new_with_loop(&srv_event_cb, NULL, s_app.loop);
+	if (s_app.srv == NULL)
+		goto error;
+	s_app.cli = pomp_ctx_new_with_loop(&cli_event_cb, NULL, s_app.loop);
+	if (s_app.cli == NULL)
+		goto error;
+
+	res = pomp_ctx_listen(s_app.srv, (const struct sockaddr *)&addr,
+			sizeof(addr));
+	if (res < 0) {
+		diag("pomp_ctx_listen: err=%d(%s)", res, strerror(-res));
+		goto error;
+	}
+	res = pomp_ctx_connect(s_app.cli, (const struct sockaddr *)&addr,
+			sizeof(addr));
+	if (res < 0) {
+		diag("pomp_ctx_connect: err=%d(%s)", res, strerror(-res));
+		goto error;
+	}
+
+	/* Wait for connection */
+	while (s_app.conn == NULL) {
+		res = pomp_loop_wait_and_process(s_app.loop, 1000);
+		if (res < 0) {
+			diag("Unable to connect");
+			goto error;
+		}
+	}
+
+	/* Fill the window and run until all calls are completed */
+	start = get_time();
+	for (i = 0; i < s_app.window && s_app.issued < s_app.count; i++)
+		issue_call();
+	while (s_app.completed < s_app.count && s_app.conn != NULL)
+		pomp_loop_wait_and_process(s_app.loop, 1000);
+	elapsed = get_time() - start;
+
+	printf("calls=%u failed=%u window=%u time=%.3fs calls/s=%.0f "
+			"us/call=%.3f\n",
+			s_app.completed, s_app.failed, s_app.window, elapsed,
+			elapsed > 0.0 ? s_app.completed / elapsed : 0.0,
+			s_app.completed > 0 ?
+				elapsed * 1e6 / s_app.completed : 0.0);
+	if (s_app.failed != 0 || s_app.completed < s_app.count)
+		status = EXIT_FAILURE;
+	goto out;
+
+error:
+	status = EXIT_FAILURE;
+out:
+	if (s_app.cli != NULL) {
+		pomp_ctx_stop(s_app.cli);
+		pomp_ctx_destroy(s_app.cli);
+	}
+	if (s_app.srv != NULL) {
+		pomp_ctx_stop(s_app.srv);
+		pomp_ctx_destroy(s_app.srv);
+	}
+	if (s_app.loop != NULL)
+		pomp_loop_destroy(s_app.loop);
+	return status;
+}
@@ -46,13 +46,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <signal.h>
 #include <getopt.h>
 
 /* Unix headers */
 #ifndef _WIN32
 #  include <unistd.h>
+#  include <fcntl.h>
 #  include <sys/socket.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <netinet/in.h>
+#  include <time.h>
 #endif /* !_WIN32 */
 
 #include "libpomp.h"
@@ -77,6 +83,7 @@ static inline const char *strsignal(int signum) { return "??"; }
 struct app {
 	int                     timeout;
 	int                     dump;
+	int                     echo;
 	struct sockaddr         *addr;
 	uint32_t                addrlen;
 	struct sockaddr         *addrto;
@@ -96,6 +103,7 @@ struct app {
 static struct app s_app = {
 		.timeout = -1,
 		.dump = 0,
+		.echo = 0,
 		.addr = NULL,
 		.addrlen = 0,
 		.addrto = NULL,
@@ -219,8 +227,11 @@ static void event_cb(struct pomp_ctx *ctx, enum pomp_event event,
 	int res;
 	char *buf = NULL;
 
-	diag("%s : event=%d(%s) conn=%p msg=%p", __func__,
-			event, pomp_event_str(event), conn, msg);
+	/* Do not slow down echo server with a trace per message */
+	if (!s_app.echo || event != POMP_EVENT_MSG) {
+		diag("%s : event=%d(%s) conn=%p msg=%p", __func__,
+				event, pomp_event_str(event), conn, msg);
+	}
 
 	switch (event) {
 	case POMP_EVENT_CONNECTED:
@@ -230,8 +241,8 @@ static void event_cb(struct pomp_ctx *ctx, enum pomp_event event,
 			s_app.hasmsg = 0;
 		}
 
-		/* Exit loop if not dumping message */
-		if (!s_app.dump && !s_app.waitmsg)
+		/* Exit loop if not dumping or echoing message */
+		if (!s_app.dump && !s_app.waitmsg && !s_app.echo)
 			s_app.running = 0;
 		else if (!s_app.waitmsg)
 			cancel_timeout();
@@ -244,6 +255,13 @@ static void event_cb(struct pomp_ctx *ctx, enum pomp_event event,
 		break;
 
 	case POMP_EVENT_MSG:
+		if (s_app.echo) {
+			res = pomp_conn_send_msg(conn, msg);
+			if (res < 0) {
+				diag("pomp_conn_send_msg: err=%d(%s)", res,
+						strerror(-res));
+			}
+		}
 		if (s_app.dump) {
 			res = pomp_msg_adump(msg, &buf);
 			if (res < 0) {
@@ -266,6 +284,607 @@ static void event_cb(struct pomp_ctx *ctx, enum pomp_event event,
 	}
 }
 
+#ifndef _WIN32
+
+/** Capture record callback */
+typedef int (*capture_record_cb_t)(
+		const struct pomp_capture_record_header *rec,
+		void *userdata);
+
+/**
+ *
+ */
+static struct pomp_msg *capture_record_to_msg(
+		const struct pomp_capture_record_header *rec)
+{
+	const uint8_t *data = (const uint8_t *)(rec + 1) + rec->addrlen;
+	struct pomp_buffer *pbuf = NULL;
+	struct pomp_msg *msg = NULL;
+
+	pbuf = pomp_buffer_new_with_data(data, rec->datalen);
+	if (pbuf == NULL)
+		return NULL;
+	msg = pomp_msg_new_with_buffer(pbuf);
+	pomp_buffer_unref(pbuf);
+	if (msg == NULL)
+		diag("Invalid message in capture");
+	return msg;
+}
+
+/**
+ *
+ */
+static int dump_capture_record(const struct pomp_capture_record_header *rec,
+		void *userdata)
+{
+	int res = 0;
+	char addrbuf[128] = "";
+	char *buf = NULL;
+	struct pomp_msg *msg = NULL;
+
+	if (rec->addrlen != 0) {
+		pomp_addr_format(addrbuf, sizeof(addrbuf),
+				(const struct sockaddr *)(rec + 1),
+				rec->addrlen);
+	}
+
+	/* Wrap data in a message to dump it */
+	msg = capture_record_to_msg(rec);
+	if (msg == NULL)
+		return -EINVAL;
+
+	res = pomp_msg_adump(msg, &buf);
+	if (res < 0) {
+		diag("pomp_msg_adump: err=%d(%s)", res, strerror(-res));
+	} else {
+		printf("%" PRIu64 ".%09" PRIu64 " %s %s %s\n",
+				rec->timestamp / 1000000000,
+				rec->timestamp % 1000000000,
+				rec->dir == POMP_CAPTURE_DIR_RX ? "RX" : "TX",
+				addrbuf[0] != '\0' ? addrbuf : "-", buf);
+		free(buf);
+	}
+
+	pomp_msg_destroy(msg);
+	return res;
+}
+
+/**
+ *
+ */
+static int walk_capture(const char *path, capture_record_cb_t cb,
+		void *userdata)
+{
+	int res = 0;
+	int fd = -1;
+	struct stat st;
+	uint8_t *data = MAP_FAILED;
+	size_t off = 0;
+	const struct pomp_capture_file_header *hdr = NULL;
+	const struct pomp_capture_record_header *rec = NULL;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		res = -errno;
+		diag_errno("open");
+		goto out;
+	}
+
+	if ((size_t)st.st_size < sizeof(*hdr)) {
+		diag("Capture file too small");
+		res = -EINVAL;
+		goto out;
+	}
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		res = -errno;
+		diag_errno("mmap");
+		goto out;
+	}
+
+	hdr = (const struct pomp_capture_file_header *)data;
+	if (hdr->magic != POMP_CAPTURE_MAGIC
+			|| hdr->version != POMP_CAPTURE_VERSION
+			|| hdr->hdrsize < sizeof(*hdr)
+			|| hdr->hdrsize > (size_t)st.st_size) {
+		diag("Invalid capture file header");
+		res = -EINVAL;
+		goto out;
+	}
+
+	/* Walk records, stop at the first truncated one */
+	off = hdr->hdrsize;
+	while (off + sizeof(*rec) <= (size_t)st.st_size) {
+		rec = (const struct pomp_capture_record_header *)(data + off);
+		if (rec->size < sizeof(*rec)
+				|| rec->size > (size_t)st.st_size - off
+				|| sizeof(*rec) + rec->addrlen + rec->datalen
+					> rec->size) {
+			diag("Truncated record at offset %zu", off);
+			break;
+		}
+		res = (*cb)(rec, userdata);
+		if (res == -ENOMEM)
+			goto out;
+		res = 0;
+		off += rec->size;
+	}
+
+out:
+	if (data != MAP_FAILED)
+		munmap(data, (size_t)st.st_size);
+	if (fd >= 0)
+		close(fd);
+	return res;
+}
+
+/** Long only options */
+enum {
+	OPT_REPLAY_TX = 256,
+	OPT_COUNT,
+	OPT_RATE,
+	OPT_CONNS,
+	OPT_WINDOW,
+	OPT_ECHO,
+};
+
+/** Bench connection */
+struct bench_conn {
+	struct pomp_ctx         *ctx;
+	struct pomp_conn        *conn;
+	uint32_t                inflight;
+	uint64_t                *stamps;
+	uint32_t                stamphead;
+};
+
+/** Bench parameters and state */
+struct bench {
+	int                     enabled;
+	int                     udp;
+	uint32_t                count;
+	uint32_t                rate;
+	uint32_t                conncount;
+	uint32_t                window;
+	int                     echo;
+	const char              *replay;
+	int                     replaytx;
+	struct pomp_msg         **msgs;
+	size_t                  *msgsizes;
+	uint32_t                msgcount;
+	uint32_t                nextmsg;
+	struct bench_conn       *conns;
+	uint32_t                connected;
+	uint64_t                start;
+	uint64_t                lastsend;
+	uint32_t                sent;
+	uint64_t                bytes;
+	uint32_t                received;
+	uint64_t                *latencies;
+	uint32_t                latcount;
+	struct pomp_timer       *timer;
+};
+static struct bench s_bench = {
+		.enabled = 0,
+		.count = 100000,
+		.rate = 0,
+		.conncount = 1,
+		.window = 64,
+		.echo = 0,
+		.replay = NULL,
+		.replaytx = 0,
+};
+
+/** Delay to wait for remaining echoes after last send (in ns) */
+#define BENCH_ECHO_GRACE	(2ULL * 1000 * 1000 * 1000)
+
+/** Pacing timer period (ms) */
+#define BENCH_PERIOD_MS		5
+
+/**
+ *
+ */
+static uint64_t bench_get_time(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ *
+ */
+static int bench_add_msg(struct pomp_msg *msg)
+{
+	struct pomp_msg **msgs = NULL;
+	size_t *msgsizes = NULL;
+	const void *data = NULL;
+	size_t len = 0;
+
+	msgs = realloc(s_bench.msgs, (s_bench.msgcount + 1) * sizeof(*msgs));
+	if (msgs == NULL)
+		return -ENOMEM;
+	s_bench.msgs = msgs;
+	msgsizes = realloc(s_bench.msgsizes,
+			(s_bench.msgcount + 1) * sizeof(*msgsizes));
+	if (msgsizes == NULL)
+		return -ENOMEM;
+	s_bench.msgsizes = msgsizes;
+
+	pomp_buffer_get_cdata(pomp_msg_get_buffer(msg), &data, &len, NULL);
+	s_bench.msgs[s_bench.msgcount] = msg;
+	s_bench.msgsizes[s_bench.msgcount] = len;
+	s_bench.msgcount++;
+	return 0;
+}
+
+/**
+ *
+ */
+static int bench_replay_record(const struct pomp_capture_record_header *rec,
+		void *userdata)
+{
+	int res = 0;
+	struct pomp_msg *msg = NULL;
+	uint8_t dir = s_bench.replaytx ? POMP_CAPTURE_DIR_TX :
+			POMP_CAPTURE_DIR_RX;
+
+	if (rec->dir != dir)
+		return 0;
+
+	msg = capture_record_to_msg(rec);
+	if (msg == NULL)
+		return -EINVAL;
+
+	res = bench_add_msg(msg);
+	if (res < 0)
+		pomp_msg_destroy(msg);
+	return res;
+}
+
+/**
+ *
+ */
+static int bench_can_send(const struct bench_conn *bc, uint64_t now)
+{
+	if (s_bench.sent >= s_bench.count || bc->inflight >= s_bench.window)
+		return 0;
+	if (!s_bench.udp && bc->conn == NULL)
+		return 0;
+	if (s_bench.rate != 0 && (uint64_t)s_bench.sent * 1000000000ULL
+			>= (uint64_t)s_bench.rate * (now - s_bench.start))
+		return 0;
+	return 1;
+}
+
+/**
+ *
+ */
+static void bench_pump(struct bench_conn *bc)
+{
+	int res = 0;
+	uint64_t now = bench_get_time();
+	const struct pomp_msg *msg = NULL;
+
+	while (s_bench.start != 0 && bench_can_send(bc, now)) {
+		msg = s_bench.msgs[s_bench.nextmsg];
+		if (s_bench.udp) {
+			res = pomp_ctx_send_msg_to(bc->ctx, msg,
+					s_app.addrto, s_app.addrtolen);
+		} else {
+			res = pomp_conn_send_msg(bc->conn, msg);
+		}
+		if (res < 0) {
+			diag("send: err=%d(%s)", res, strerror(-res));
+			break;
+		}
+
+		if (s_bench.echo) {
+			bc->stamps[(bc->stamphead + bc->inflight)
+					% s_bench.window] = now;
+		}
+		bc->inflight++;
+		s_bench.bytes += s_bench.msgsizes[s_bench.nextmsg];
+		s_bench.sent++;
+		s_bench.lastsend = now;
+		s_bench.nextmsg = (s_bench.nextmsg + 1) % s_bench.msgcount;
+	}
+}
+
+/**
+ *
+ */
+static void bench_check_done(void)
+{
+	uint32_t i = 0;
+
+	if (s_bench.sent < s_bench.count)
+		return;
+
+	if (s_bench.echo) {
+		/* Wait for all echoes, but not forever on udp */
+		if (s_bench.received < s_bench.sent && bench_get_time()
+				- s_bench.lastsend < BENCH_ECHO_GRACE)
+			return;
+	} else {
+		/* Wait for all send completions */
+		for (i = 0; i < s_bench.conncount; i++) {
+			if (s_bench.conns[i].inflight != 0)
+				return;
+		}
+	}
+
+	s_app.running = 0;
+	pomp_loop_wakeup(s_app.loop);
+}
+
+/**
+ *
+ */
+static void bench_timer_cb(struct pomp_timer *timer, void *userdata)
+{
+	uint32_t i = 0;
+
+	/* Start when all connections are ready */
+	if (s_bench.start == 0) {
+		if (!s_bench.udp && s_bench.connected < s_bench.conncount)
+			return;
+		s_bench.start = bench_get_time();
+	}
+
+	for (i = 0; i < s_bench.conncount; i++)
+		bench_pump(&s_bench.conns[i]);
+	bench_check_done();
+}
+
+/**
+ *
+ */
+static void bench_send_cb(struct pomp_ctx *ctx, struct pomp_conn *conn,
+		struct pomp_buffer *buf, uint32_t status, void *cookie,
+		void *userdata)
+{
+	struct bench_conn *bc = userdata;
+
+	if (bc->inflight > 0)
+		bc->inflight--;
+	bench_pump(bc);
+	bench_check_done();
+}
+
+/**
+ *
+ */
+static void bench_event_cb(struct pomp_ctx *ctx, enum pomp_event event,
+		struct pomp_conn *conn, const struct pomp_msg *msg,
+		void *userdata)
+{
+	struct bench_conn *bc = userdata;
+
+	switch (event) {
+	case POMP_EVENT_CONNECTED:
+		bc->conn = conn;
+		s_bench.connected++;
+		break;
+
+	case POMP_EVENT_DISCONNECTED:
+		if (s_app.running)
+			diag("Connection lost");
+		bc->conn = NULL;
+		s_bench.connected--;
+		break;
+
+	case POMP_EVENT_MSG:
+		if (!s_bench.echo || bc->inflight == 0)
+			break;
+
+		/* Echoes are received in send order */
+		s_bench.latencies[s_bench.latcount++] = bench_get_time()
+				- bc->stamps[bc->stamphead];
+		bc->stamphead = (bc->stamphead + 1) % s_bench.window;
+		bc->inflight--;
+		s_bench.received++;
+		bench_pump(bc);
+		bench_check_done();
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ *
+ */
+static int bench_cmp_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a;
+	uint64_t vb = *(const uint64_t *)b;
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+/**
+ *
+ */
+static double bench_percentile(double p)
+{
+	size_t idx = (size_t)(p * s_bench.latcount);
+	if (idx >= s_bench.latcount)
+		idx = s_bench.latcount - 1;
+	return s_bench.latencies[idx] / 1000.0;
+}
+
+/**
+ *
+ */
+static void bench_report(void)
+{
+	uint64_t end = s_bench.lastsend != 0 ? s_bench.lastsend :
+			bench_get_time();
+	double elapsed = s_bench.start != 0 && end > s_bench.start ?
+			(end - s_bench.start) / 1e9 : 0.0;
+
+	printf("sent=%u bytes=%" PRIu64 " time=%.3fs msgs/s=%.0f "
+			"bytes/s=%.0f conns=%u\n",
+			s_bench.sent, s_bench.bytes, elapsed,
+			elapsed > 0.0 ? s_bench.sent / elapsed : 0.0,
+			elapsed > 0.0 ? s_bench.bytes / elapsed : 0.0,
+			s_bench.conncount);
+
+	if (s_bench.echo && s_bench.latcount > 0) {
+		qsort(s_bench.latencies, s_bench.latcount,
+				sizeof(*s_bench.latencies), &bench_cmp_u64);
+		printf("received=%u latency_us p50=%.1f p90=%.1f p99=%.1f "
+				"p999=%.1f max=%.1f\n",
+				s_bench.received,
+				bench_percentile(0.50),
+				bench_percentile(0.90),
+				bench_percentile(0.99),
+				bench_percentile(0.999),
+				bench_percentile(1.0));
+	} else if (s_bench.echo) {
+		printf("received=0\n");
+	}
+}
+
+/**
+ *
+ */
+static int bench_run(void)
+{
+	int res = 0;
+	uint32_t i = 0;
+	struct pomp_msg *msg = NULL;
+	struct bench_conn *bc = NULL;
+	struct sockaddr_storage bindaddr;
+
+	/* Messages to send */
+	if (s_bench.replay != NULL) {
+		res = walk_capture(s_bench.replay, &bench_replay_record, NULL);
+		if (res < 0)
+			goto out;
+	} else {
+		msg = pomp_msg_new();
+		if (msg == NULL) {
+			res = -ENOMEM;
+			goto out;
+		}
+		res = pomp_msg_write_argv(msg, s_app.msgid, s_app.msgfmt,
+				s_app.msgargc, s_app.msgargv);
+		if (res < 0) {
+			diag("pomp_msg_write_argv: err=%d(%s)", res,
+					strerror(-res));
+			pomp_msg_destroy(msg);
+			goto out;
+		}
+		res = bench_add_msg(msg);
+		if (res < 0) {
+			pomp_msg_destroy(msg);
+			goto out;
+		}
+	}
+	if (s_bench.msgcount == 0) {
+		diag("No message to send");
+		res = -EINVAL;
+		goto out;
+	}
+
+	if (s_bench.udp && s_bench.conncount > 1
+			&& s_app.addr->sa_family != AF_INET
+			&& s_app.addr->sa_family != AF_INET6) {
+		diag("Several udp connections require an inet address");
+		res = -EINVAL;
+		goto out;
+	}
+
+	s_bench.conns = calloc(s_bench.conncount, sizeof(*s_bench.conns));
+	s_bench.latencies = calloc(s_bench.count,
+			sizeof(*s_bench.latencies));
+	if (s_bench.conns == NULL || s_bench.latencies == NULL) {
+		res = -ENOMEM;
+		goto out;
+	}
+
+	/* Create connections */
+	for (i = 0; i < s_bench.conncount; i++) {
+		bc = &s_bench.conns[i];
+		bc->stamps = calloc(s_bench.window, sizeof(*bc->stamps));
+		if (bc->stamps == NULL) {
+			res = -ENOMEM;
+			goto out;
+		}
+
+		bc->ctx = pomp_ctx_new_with_loop(&bench_event_cb, bc,
+				s_app.loop);
+		if (bc->ctx == NULL) {
+			res = -ENOMEM;
+			goto out;
+		}
+		if (!s_bench.echo)
+			pomp_ctx_set_send_cb(bc->ctx, &bench_send_cb);
+
+		if (!s_bench.udp) {
+			res = pomp_ctx_connect(bc->ctx, s_app.addr,
+					s_app.addrlen);
+		} else {
+			/* Only the first one binds to the given port */
+			memcpy(&bindaddr, s_app.addr, s_app.addrlen);
+			if (i > 0 && bindaddr.ss_family == AF_INET)
+				((struct sockaddr_in *)&bindaddr)->sin_port = 0;
+			else if (i > 0 && bindaddr.ss_family == AF_INET6)
+				((struct sockaddr_in6 *)&bindaddr)->sin6_port = 0;
+			res = pomp_ctx_bind(bc->ctx,
+					(const struct sockaddr *)&bindaddr,
+					s_app.addrlen);
+		}
+		if (res < 0) {
+			diag("pomp_ctx_%s : err=%d(%s)",
+					s_bench.udp ? "bind" : "connect",
+					res, strerror(-res));
+			goto out;
+		}
+	}
+
+	/* Pace sending periodically */
+	s_bench.timer = pomp_timer_new(s_app.loop, &bench_timer_cb, NULL);
+	if (s_bench.timer == NULL) {
+		res = -ENOMEM;
+		goto out;
+	}
+	res = pomp_timer_set_periodic(s_bench.timer, 1, BENCH_PERIOD_MS);
+	if (res < 0)
+		goto out;
+
+	s_app.running = 1;
+	while (s_app.running)
+		pomp_loop_wait_and_process(s_app.loop, -1);
+
+	bench_report();
+
+out:
+	if (s_bench.timer != NULL) {
+		pomp_timer_clear(s_bench.timer);
+		pomp_timer_destroy(s_bench.timer);
+	}
+	for (i = 0; s_bench.conns != NULL && i < s_bench.conncount; i++) {
+		bc = &s_bench.conns[i];
+		if (bc->ctx != NULL) {
+			pomp_ctx_stop(bc->ctx);
+			pomp_ctx_destroy(bc->ctx);
+		}
+		free(bc->stamps);
+	}
+	for (i = 0; i < s_bench.msgcount; i++)
+		pomp_msg_destroy(s_bench.msgs[i]);
+	free(s_bench.msgs);
+	free(s_bench.msgsizes);
+	free(s_bench.conns);
+	free(s_bench.latencies);
+	return res;
+}
+
+#endif /* !_WIN32 */
+
 /**
  *
  */
@@ -309,6 +928,30 @@ static void usage(const char *progname)
 	fprintf(stderr, "                with the given message id\n");
 	fprintf(stderr, "  -t --timeout: timeout to wait connection\n");
 	fprintf(stderr, "                in seconds (default no timeout)\n");
+	fprintf(stderr, "  -C --capture <file>: record messages in a\n");
+	fprintf(stderr, "                capture file\n");
+	fprintf(stderr, "  -r --read <file>: dump messages of a capture\n");
+	fprintf(stderr, "                file and exit (no <addr> needed)\n");
+	fprintf(stderr, "  -E --echo-server: send back received messages\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Load generation (client or udp):\n");
+	fprintf(stderr, "  -b --bench  : send <msgid> [<fmt> [<args>...]]\n");
+	fprintf(stderr, "                repeatedly and report throughput\n");
+	fprintf(stderr, "  -R --replay <file>: send messages of a capture\n");
+	fprintf(stderr, "                file instead (implies --bench)\n");
+	fprintf(stderr, "  --replay-tx : replay sent messages of capture\n");
+	fprintf(stderr, "                (default received ones)\n");
+	fprintf(stderr, "  --count <n> : number of messages (default %u)\n",
+			s_bench.count);
+	fprintf(stderr, "  --rate <n>  : messages per second\n");
+	fprintf(stderr, "                (default as fast as possible)\n");
+	fprintf(stderr, "  --conns <n> : number of connections (default %u)\n",
+			s_bench.conncount);
+	fprintf(stderr, "  --window <n>: max messages in flight per\n");
+	fprintf(stderr, "                connection (default %u)\n",
+			s_bench.window);
+	fprintf(stderr, "  --echo      : peer echoes messages, measure\n");
+	fprintf(stderr, "                round-trip latency\n");
 	fprintf(stderr, "\n");
 }
 
@@ -323,6 +966,8 @@ int main(int argc, char *argv[])
 	const char *arg_addr = NULL;
 	const char *arg_addrto = NULL;
 	const char *arg_msgid = NULL;
+	const char *arg_capture = NULL;
+	const char *arg_read = NULL;
 	struct sockaddr_storage addr_storage;
 	struct sockaddr_storage addrto_storage;
 
@@ -334,9 +979,20 @@ int main(int argc, char *argv[])
 		{"dump",    no_argument,       NULL, 'd' },
 		{"timeout", required_argument, NULL, 't' },
 		{"wait",    required_argument, NULL, 'w' },
+		{"capture", required_argument, NULL, 'C' },
+		{"read",    required_argument, NULL, 'r' },
+		{"echo-server", no_argument,   NULL, 'E' },
+		{"bench",   no_argument,       NULL, 'b' },
+		{"replay",  required_argument, NULL, 'R' },
+		{"replay-tx", no_argument,     NULL, OPT_REPLAY_TX },
+		{"count",   required_argument, NULL, OPT_COUNT },
+		{"rate",    required_argument, NULL, OPT_RATE },
+		{"conns",   required_argument, NULL, OPT_CONNS },
+		{"window",  required_argument, NULL, OPT_WINDOW },
+		{"echo",    no_argument,       NULL, OPT_ECHO },
 		{NULL,     0,                  NULL, 0   },
 	};
-	const char short_options[] = "hscudt:w:";
+	const char short_options[] = "hscudt:w:C:r:EbR:";
 
 	/* Parse options */
 	while ((c = getopt_long(argc, argv, short_options,
@@ -375,11 +1031,65 @@ int main(int argc, char *argv[])
 			s_app.waitmsg = 1;
 			break;
 
+		case 'C':
+			arg_capture = optarg;
+			break;
+
+		case 'r':
+			arg_read = optarg;
+			break;
+
+		case 'E':
+			s_app.echo = 1;
+			break;
+
+		case 'R':
+			s_bench.replay = optarg;
+			/* FALLTHROUGH */
+		case 'b':
+			s_bench.enabled = 1;
+			break;
+
+		case OPT_REPLAY_TX:
+			s_bench.replaytx = 1;
+			break;
+
+		case OPT_COUNT:
+			s_bench.count = strtoul(optarg, NULL, 10);
+			break;
+
+		case OPT_RATE:
+			s_bench.rate = strtoul(optarg, NULL, 10);
+			break;
+
+		case OPT_CONNS:
+			s_bench.conncount = strtoul(optarg, NULL, 10);
+			break;
+
+		case OPT_WINDOW:
+			s_bench.window = strtoul(optarg, NULL, 10);
+			break;
+
+		case OPT_ECHO:
+			s_bench.echo = 1;
+			break;
+
 		default:
 			break;
 		}
 	}
 
+	/* Only dump a capture file */
+	if (arg_read != NULL) {
+#ifndef _WIN32
+		res = walk_capture(arg_read, &dump_capture_record, NULL);
+#else /* _WIN32 */
+		diag("Reading capture files is not supported");
+		res = -ENOSYS;
+#endif /* _WIN32 */
+		goto out;
+	}
+
 	/* Create pomp context, get loop BEFORE parsing address
 	 * (required for WIN32 as it is the lib that initialize winsock API) */
 	s_app.ctx = pomp_ctx_new(&event_cb, NULL);
@@ -404,7 +1114,7 @@ int main(int argc, char *argv[])
 		goto error;
 	}
 
-	/* Get destination address for udp (optional if dumping) */
+	/* Get destination address for udp (optional if dumping or echoing) */
 	if (udp) {
 		if (argc - optind >= 1) {
 			arg_addrto = argv[optind++];
@@ -418,18 +1128,18 @@ int main(int argc, char *argv[])
 				diag("Failed to parse address: %s", arg_addrto);
 				goto error;
 			}
-		} else if (!s_app.dump) {
+		} else if (!s_app.dump && !s_app.echo) {
 			diag("Missing destination address");
 			goto error;
 		}
 	}
 
-	/* Get message id (optional if dumping) */
+	/* Get message id (optional if dumping, echoing or replaying) */
 	if (argc - optind >= 1) {
 		arg_msgid = argv[optind++];
 		s_app.msgid = strtoul(arg_msgid, NULL, 10);
 		s_app.hasmsg = 1;
-	} else if (!s_app.dump) {
+	} else if (!s_app.dump && !s_app.echo && s_bench.replay == NULL) {
 		diag("Missing message id");
 		goto error;
 	}
@@ -445,10 +1155,45 @@ int main(int argc, char *argv[])
 		optind += s_app.msgargc;
 	}
 
+	/* Run load generation instead of normal operation */
+	if (s_bench.enabled) {
+#ifndef _WIN32
+		if (server || s_bench.count == 0 || s_bench.conncount == 0
+				|| s_bench.window == 0) {
+			diag("Invalid bench parameters");
+			goto error;
+		}
+		signal(SIGINT, &sig_handler);
+		signal(SIGTERM, &sig_handler);
+		signal(SIGPIPE, SIG_IGN);
+		s_bench.udp = udp;
+		res = bench_run();
+#else /* _WIN32 */
+		diag("Bench mode is not supported");
+		res = -ENOSYS;
+#endif /* _WIN32 */
+		goto out;
+	}
+
+	/* Start recording if needed */
+	if (arg_capture != NULL) {
+		res = pomp_ctx_start_capture(s_app.ctx, arg_capture, 0);
+		if (res < 0) {
+			diag("pomp_ctx_start_capture: err=%d(%s)", res,
+					strerror(-res));
+			goto error;
+		}
+	}
+
 	/* Attach sig handler */
 	s_app.running = 1;
 	signal(SIGINT, &sig_handler);
 	signal(SIGTERM, &sig_handler);
+#ifndef _WIN32
+	/* Peer may close while echoed messages are still being written */
+	if (s_app.echo)
+		signal(SIGPIPE, SIG_IGN);
+#endif /* !_WIN32 */
 
 	/* Setup timeout if needed (ignore errors) */
 	if (s_app.timeout >= 0)
@@ -473,8 +1218,8 @@ int main(int argc, char *argv[])
 		if (s_app.hasmsg)
 			send_msg();
 
-		/* Do not run loop if not dumping or waiting */
-		if (!s_app.dump && !s_app.waitmsg)
+		/* Do not run loop if not dumping, waiting or echoing */
+		if (!s_app.dump && !s_app.waitmsg && !s_app.echo)
 			goto out;
 	}
 